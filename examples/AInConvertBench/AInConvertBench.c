@@ -0,0 +1,121 @@
+/*****************************************************************************/
+/*                  Analog input conversion benchmark                        */
+/*                                                                           */
+/*  This example compares the time it takes to convert raw analog input     */
+/*  data to volts with PdAInRawToVolts() (called once per scan, as the       */
+/*  buffered examples do) and with a prepared converter created by           */
+/*  PdAInCreateConverter() (called once per frame).                          */
+/*  No acquisition is started, the board is only used to read its ranges.   */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+/*      Copyright (C) 2001 United Electronic Industries, Inc.                */
+/*      All rights reserved.                                                 */
+/*---------------------------------------------------------------------------*/
+/*                                                                           */ 
+/*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <signal.h>
+#include <unistd.h>
+#include "win_sdk_types.h"
+#include "powerdaq.h"
+#include "powerdaq32.h"
+
+#define NB_CHANNELS  8
+#define NB_SCANS     4096
+#define NB_FRAMES    200
+
+static double elapsed(struct timeval *start)
+{
+   struct timeval now;
+
+   gettimeofday(&now, NULL);
+   return (now.tv_sec - start->tv_sec) + (now.tv_usec - start->tv_usec) / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+   int board = 0;
+   int i, j, retVal;
+   DWORD aiCfg = AIN_BIPOLAR | AIN_RANGE_10V;
+   DWORD chList[NB_CHANNELS];
+   WORD *rawBuffer;
+   double *voltBuffer;
+   float *voltBufferF;
+   PPD_AIN_CONVERTER pConv;
+   struct timeval start;
+   double tRef, tConv, tConvF, maxErr = 0;
+
+   if (argc > 1)
+      board = atoi(argv[1]);
+
+   rawBuffer = (WORD*)malloc(NB_CHANNELS * NB_SCANS * sizeof(WORD));
+   voltBuffer = (double*)malloc(NB_CHANNELS * NB_SCANS * sizeof(double));
+   voltBufferF = (float*)malloc(NB_CHANNELS * NB_SCANS * sizeof(float));
+   if (!rawBuffer || !voltBuffer || !voltBufferF)
+   {
+      fprintf(stderr, "AInConvertBench: out of memory\n");
+      return EXIT_FAILURE;
+   }
+
+   for (i = 0; i < NB_CHANNELS * NB_SCANS; i++)
+      rawBuffer[i] = (WORD)rand();
+
+   /* gain 1 on every channel so that both methods give the same result */
+   for (i = 0; i < NB_CHANNELS; i++)
+      chList[i] = CHLIST_ENT(i, 0, 0);
+
+   retVal = PdAInCreateConverter(board, aiCfg, NB_CHANNELS, chList, &pConv);
+   if (retVal < 0)
+   {
+      fprintf(stderr, "AInConvertBench: error %d in PdAInCreateConverter\n", retVal);
+      return EXIT_FAILURE;
+   }
+
+   /* reference: one PdAInRawToVolts() call per scan */
+   gettimeofday(&start, NULL);
+   for (j = 0; j < NB_FRAMES; j++)
+      for (i = 0; i < NB_SCANS; i++)
+         PdAInRawToVolts(board, aiCfg, rawBuffer + i*NB_CHANNELS, 
+                         voltBuffer + i*NB_CHANNELS, NB_CHANNELS);
+   tRef = elapsed(&start);
+
+   /* keep the reference result for comparison */
+   for (i = 0; i < NB_CHANNELS * NB_SCANS; i++)
+      voltBufferF[i] = (float)voltBuffer[i];
+
+   gettimeofday(&start, NULL);
+   for (j = 0; j < NB_FRAMES; j++)
+      PdAInConvert(pConv, rawBuffer, voltBuffer, NB_CHANNELS * NB_SCANS);
+   tConv = elapsed(&start);
+
+   for (i = 0; i < NB_CHANNELS * NB_SCANS; i++)
+   {
+      double err = voltBuffer[i] - voltBufferF[i];
+      if (err < 0) err = -err;
+      if (err > maxErr) maxErr = err;
+   }
+
+   gettimeofday(&start, NULL);
+   for (j = 0; j < NB_FRAMES; j++)
+      PdAInConvertF(pConv, rawBuffer, voltBufferF, NB_CHANNELS * NB_SCANS);
+   tConvF = elapsed(&start);
+
+   printf("Converted %d frames of %d scans x %d channels\n", NB_FRAMES, NB_SCANS, NB_CHANNELS);
+   printf("PdAInRawToVolts (per scan) : %8.3f ms/frame\n", tRef * 1000 / NB_FRAMES);
+   printf("PdAInConvert    (double)   : %8.3f ms/frame\n", tConv * 1000 / NB_FRAMES);
+   printf("PdAInConvertF   (float)    : %8.3f ms/frame\n", tConvF * 1000 / NB_FRAMES);
+   printf("max difference             : %g V\n", maxErr);
+
+   PdAInFreeConverter(pConv);
+   free(rawBuffer);
+   free(voltBuffer);
+   free(voltBufferF);
+
+   return EXIT_SUCCESS;
+}
@@ -0,0 +1,392 @@
+/*****************************************************************************/
+/*                AIn FIFO overrun restart simulation                        */
+/*                                                                           */
+/*  This example builds the driver gap accounting (pdfw_lib/pdl_gap.c) in   */
+/*  user space and runs it against a simulated board: a FIFO filled at a    */
+/*  constant rate, a bottom half that empties it into the DAQ buffer and    */
+/*  sometimes comes too late, and a consumer that reads whole scans. On an  */
+/*  overrun the simulated driver does what pd_ain_overrun_restart() does.   */
+/*                                                                           */
+/*  Every value carries its scan number and channel, so the consumer checks */
+/*  that scans stay aligned on the channel list, that the data is           */
+/*  contiguous except where a gap is logged, and how far the logged         */
+/*  LostScans is from the number of scans really missing. No board is      */
+/*  needed.                                                                  */
+/*                                                                           */
+/*  Without a soak time the gap log is checked on its own, then a fixed     */
+/*  set of scenarios is run (stall at start, back-to-back overruns, bursts  */
+/*  of them) followed by random stalls. With a soak time random runs go on  */
+/*  for that many seconds more.                                             */
+/*                                                                           */
+/*  Usage: AInGapSim [soak time, s]                                          */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+/*      Copyright (C) 2001 United Electronic Industries, Inc.                */
+/*      All rights reserved.                                                 */
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "win_sdk_types.h"
+#include "powerdaq.h"
+
+#define do_div(n, base) ({ u32 __rem = (n) % (base); (n) /= (base); __rem; })
+
+#include "pd_gap.h"
+#include "../../pdfw_lib/pdl_gap.c"
+
+#define FIFO_VALUES   1024
+#define NB_FRAMES     8
+
+typedef struct
+{
+   /* scenario */
+   u32 nbChan;          /* values in a scan */
+   u32 chBits;          /* bits used by the channel number in a value */
+   u64 rate;            /* values per second */
+   u64 bhPeriod;        /* bottom half period, ns */
+   u32 stallPct;        /* random stalls, percent of bottom halves */
+
+   /* board */
+   u64 segStart;        /* time the conversions (re)started */
+   u32 segScan0;        /* scan clock at segStart */
+   u64 produced;        /* values converted since segStart */
+   u32 fifoN;           /* values in the FIFO */
+   u64 fifoFirst;       /* index since segStart of the oldest one */
+   int overrun;
+
+   /* driver */
+   u16 *ring;
+   u32 maxValues, head, tail, count, wrapCount;
+   TGapLog log;
+
+   /* consumer */
+   u32 readWraps;
+   u32 nextScan;
+   int haveScan;
+   u32 nextGap;
+
+   /* results */
+   u32 scans, gaps, unknown, errors;
+   u32 maxErr;
+   u64 sumErr;
+} TSim;
+
+static u32 scanMask(TSim *s)
+{
+   return (1u << (16 - s->chBits)) - 1;
+}
+
+static u16 make_value(TSim *s, u64 idx)
+{
+   u32 scan = s->segScan0 + (u32)(idx / s->nbChan);
+   return (u16)(((scan & scanMask(s)) << s->chBits) | (idx % s->nbChan));
+}
+
+/* values converted in Ns nanoseconds since the (re)start */
+static u64 produced_in(TSim *s, u64 Ns)
+{
+   return (Ns / 1000000000ULL) * s->rate + (Ns % 1000000000ULL) * s->rate / 1000000000ULL;
+}
+
+static void fail(TSim *s, const char *msg, u32 a, u32 b)
+{
+   if (s->errors++ < 10)
+      printf("  %u ch: %s (%u, %u)\n", s->nbChan, msg, a, b);
+}
+
+static void board_run(TSim *s, u64 now)
+{
+   u64 total = produced_in(s, now - s->segStart);
+   u64 n = total - s->produced;
+
+   if (s->fifoN + n > FIFO_VALUES)
+   {
+      s->fifoN = FIFO_VALUES;
+      s->overrun = 1;
+   }
+   else
+      s->fifoN += (u32)n;
+   s->produced = total;
+}
+
+/* pd_process_driver_events() / pd_process_pd_ain_get_samples() */
+static void bottom_half(TSim *s, u64 now)
+{
+   u32 i, trimmed, lostValues;
+
+   board_run(s, now);
+
+   if (s->overrun)
+   {
+      /* pd_ain_overrun_restart() */
+      lostValues = pd_gap_lost_values(&s->log, now, FIFO_VALUES);
+      trimmed = pd_gap_trim_scan(&s->head, &s->count, s->nbChan);
+      pd_gap_record(&s->log, s->head, s->wrapCount,
+                    pd_gap_lost_scans(lostValues, trimmed, s->nbChan), now);
+
+      s->overrun = 0;
+      s->fifoN = 0;
+      s->segStart = now;
+      s->segScan0 = (u32)(produced_in(s, now) / s->nbChan);
+      s->produced = 0;
+      s->fifoFirst = 0;
+      return;
+   }
+
+   if (!s->fifoN)
+      return;
+
+   if (s->count + s->fifoN > s->maxValues)
+   {
+      fail(s, "DAQ buffer full", s->count, s->fifoN);
+      s->fifoN = 0;
+      return;
+   }
+
+   for (i = 0; i < s->fifoN; i++)
+   {
+      s->ring[s->head] = make_value(s, s->fifoFirst + i);
+      if (++s->head == s->maxValues)
+      {
+         s->head = 0;
+         s->wrapCount++;
+      }
+   }
+   s->count += s->fifoN;
+   pd_gap_note_xfer(&s->log, s->fifoN, now);
+   s->fifoFirst += s->fifoN;
+   s->fifoN = 0;
+}
+
+/* reads all the whole scans, like _PdAInGetScans() does */
+static void consumer(TSim *s)
+{
+   tGapInfo gaps[PD_GAP_LOG_SIZE];
+   u32 nRet, i, k, scan, diff, err, nbGaps, nbUnknown, expected;
+   u64 pos;
+
+   while (s->count >= s->nbChan)
+   {
+      pos = (u64)s->readWraps * s->maxValues + s->tail;
+
+      /* gaps logged right before this scan */
+      pd_gap_get(&s->log, s->nextGap, gaps, PD_GAP_LOG_SIZE, &nRet);
+      if (nRet && (gaps[0].Seq != s->nextGap))
+         fail(s, "gap log overflow", s->nextGap, gaps[0].Seq);
+      nbGaps = 0;
+      nbUnknown = 0;
+      expected = 0;
+      for (k = 0; k < nRet; k++)
+      {
+         u64 gapPos = (u64)gaps[k].WrapCount * s->maxValues + gaps[k].Head;
+         if (gapPos < pos)
+            fail(s, "gap behind the consumer", (u32)gapPos, (u32)pos);
+         if (gapPos != pos)
+            break;
+         nbGaps++;
+         if (!gaps[k].LostScans)
+            nbUnknown++;
+         expected += gaps[k].LostScans;
+         s->nextGap = gaps[k].Seq + 1;
+      }
+
+      /* the scan must be aligned on the channel list */
+      scan = s->ring[s->tail] >> s->chBits;
+      for (i = 0; i < s->nbChan; i++)
+      {
+         u16 v = s->ring[s->tail + i];
+         if (((v & ((1u << s->chBits) - 1)) != i) || ((u32)(v >> s->chBits) != scan))
+         {
+            fail(s, "scan not aligned", s->tail, v);
+            break;
+         }
+      }
+
+      if (s->haveScan)
+      {
+         diff = (scan - s->nextScan) & scanMask(s);
+         if (diff && !nbGaps)
+            fail(s, "discontinuity without a gap", s->tail, diff);
+         else if (nbGaps && !diff)
+            fail(s, "gap without discontinuity", s->tail, nbGaps);
+         else if (nbGaps && !nbUnknown)
+         {
+            /* rounded up at each gap, rate measured within 0.2% */
+            err = (diff > expected) ? diff - expected : expected - diff;
+            if (err > nbGaps + diff / 500)
+               fail(s, "lost scans estimate off", diff, expected);
+            if (err > s->maxErr)
+               s->maxErr = err;
+            s->sumErr += err;
+         }
+      }
+      s->gaps += nbGaps;
+      s->unknown += nbUnknown;
+      s->nextScan = (scan + 1) & scanMask(s);
+      s->haveScan = 1;
+
+      s->tail = (s->tail + s->nbChan) % s->maxValues;
+      if (!s->tail)
+         s->readWraps++;
+      s->count -= s->nbChan;
+      s->scans++;
+   }
+}
+
+static void sim_init(TSim *s, u32 nbChan, u64 rate, u32 stallPct)
+{
+   memset(s, 0, sizeof(TSim));
+   s->nbChan = nbChan;
+   while ((1u << s->chBits) < nbChan)
+      s->chBits++;
+   s->rate = rate;
+   /* a bit more than half the FIFO per bottom half, not a whole scan */
+   s->bhPeriod = (u64)FIFO_VALUES * 1000000000ULL * 37 / 64 / rate + 13;
+   s->stallPct = stallPct;
+   s->maxValues = NB_FRAMES * FIFO_VALUES * nbChan;
+   s->ring = (u16*)malloc(s->maxValues * sizeof(u16));
+   pd_gap_reset(&s->log);
+   pd_gap_start(&s->log, 0);
+}
+
+/* stall[] lists the bottom halves that come late, in FIFO fill times */
+static void sim_run(TSim *s, u32 nbBh, const u32 *stallAt, const u32 *stallLen)
+{
+   u64 now = 0, fifoNs = (u64)FIFO_VALUES * 1000000000ULL / s->rate;
+   u32 i, k = 0;
+
+   for (i = 0; i < nbBh; i++)
+   {
+      if (stallAt && stallAt[k] == i)
+         now += fifoNs * stallLen[k++] + s->bhPeriod;
+      else if (s->stallPct && ((u32)rand() % 100 < s->stallPct))
+         now += fifoNs + (u64)rand() % (fifoNs * 6);
+      else
+         now += s->bhPeriod - s->bhPeriod / 8 + (u64)rand() % (s->bhPeriod / 4);
+
+      bottom_half(s, now);
+      consumer(s);
+   }
+}
+
+static int sim_report(TSim *s, const char *name)
+{
+   printf("  %-26s %2u ch: %8u scans, %4u gaps (%u unknown), max error %u, avg %.2f scans%s\n",
+          name, s->nbChan, s->scans, s->gaps, s->unknown, s->maxErr,
+          (s->gaps > s->unknown) ? (double)s->sumErr / (s->gaps - s->unknown) : 0.0,
+          s->errors ? "  FAILED" : "");
+   free(s->ring);
+   return s->errors;
+}
+
+/* pd_gap_get() and pd_gap_scale() corner cases */
+static int check_log(void)
+{
+   TGapLog log;
+   tGapInfo gaps[PD_GAP_LOG_SIZE];
+   u32 i, nRet, num, errors = 0;
+   double want;
+
+   pd_gap_reset(&log);
+   for (i = 0; i < 40; i++)
+      pd_gap_record(&log, i, 0, i + 1, (u64)i << 33);
+
+   num = pd_gap_get(&log, 3, gaps, PD_GAP_LOG_SIZE, &nRet);
+   if ((num != 40) || (nRet != PD_GAP_LOG_SIZE) || (gaps[0].Seq != 24) ||
+       (gaps[nRet-1].Seq != 39) || (gaps[nRet-1].TimestampHigh != 39 << 1))
+      errors++;
+   num = pd_gap_get(&log, 38, gaps, PD_GAP_LOG_SIZE, &nRet);
+   if ((nRet != 2) || (gaps[0].Head != 38))
+      errors++;
+   num = pd_gap_get(&log, 40, gaps, PD_GAP_LOG_SIZE, &nRet);
+   if (nRet != 0)
+      errors++;
+
+   /* 3.3 GS/s sustained for a while, then 10 s without a transfer */
+   log.RateValues = 13200000000ULL;
+   log.RateNs = 4000000000ULL;
+   log.RefTime = 1000;
+   if (pd_gap_lost_values(&log, 1000 + 10000000000ULL, FIFO_VALUES) != 0xFFFFFFFF)
+      errors++;
+   want = 3.3 * 1000000000.0;
+   i = pd_gap_lost_values(&log, 1000 + 1000000000ULL, FIFO_VALUES);
+   if ((i < want * 0.999) || (i > want * 1.001))
+      errors++;
+   if (pd_gap_lost_values(&log, 1001, FIFO_VALUES) != FIFO_VALUES)
+      errors++;
+   log.RateNs = 0;
+   if (pd_gap_lost_values(&log, 5000, FIFO_VALUES) != 0)
+      errors++;
+
+   printf("  gap log and rate scaling: %s\n", errors ? "FAILED" : "ok");
+   return errors;
+}
+
+int main(int argc, char *argv[])
+{
+   static const u32 chans[] = { 1, 3, 8, 16 };
+   /* stall at start, back-to-back, long, many close ones */
+   static const u32 stallAt[]  = { 0, 50, 51, 120, 300, 302, 304, 306, 308, 310, 312,
+                                   314, 316, 318, 320, 322, 324, 326, 328, 330, ~0u };
+   static const u32 stallLen[] = { 2, 1, 3, 7, 1, 1, 1, 1, 1, 1, 1,
+                                   1, 1, 1, 1, 1, 1, 1, 1, 1, 0 };
+   long soak = (argc > 1) ? atol(argv[1]) : 0;
+   TSim s;
+   u32 i, runs = 0;
+   int errors = 0;
+   time_t end;
+
+   printf("AInGapSim: FIFO %d values, DAQ buffer %d FIFOs\n", FIFO_VALUES, NB_FRAMES);
+
+   errors += check_log();
+
+   srand(1);
+   for (i = 0; i < sizeof(chans) / sizeof(chans[0]); i++)
+   {
+      sim_init(&s, chans[i], 200000, 0);
+      sim_run(&s, 2000, stallAt, stallLen);
+      errors += sim_report(&s, "scripted stalls");
+   }
+
+   for (i = 0; i < sizeof(chans) / sizeof(chans[0]); i++)
+   {
+      sim_init(&s, chans[i], 1000000, 5);
+      sim_run(&s, 20000, NULL, NULL);
+      errors += sim_report(&s, "random stalls");
+   }
+
+   if (soak > 0)
+   {
+      u64 gaps = 0, scans = 0;
+      u32 maxErr = 0;
+
+      printf("AInGapSim: soak for %ld s\n", soak);
+      end = time(NULL) + soak;
+      while (time(NULL) < end)
+      {
+         sim_init(&s, 1 + (u32)rand() % 16, 10000 + (u64)rand() % 2000000,
+                  1 + (u32)rand() % 20);
+         sim_run(&s, 50000, NULL, NULL);
+         if (s.errors)
+            errors += sim_report(&s, "soak");
+         else
+            free(s.ring);
+         gaps += s.gaps;
+         scans += s.scans;
+         if (s.maxErr > maxErr)
+            maxErr = s.maxErr;
+         runs++;
+      }
+      printf("  soak: %u runs, %llu scans, %llu gaps, max error %u scans\n",
+             runs, scans, gaps, maxErr);
+   }
+
+   printf("AInGapSim: %s\n", errors ? "FAILED" : "all checks passed");
+   return errors ? 1 : 0;
+}
@@ -0,0 +1,136 @@
+/*****************************************************************************/
+/*                  DSP receive register read benchmark                      */
+/*                                                                           */
+/*  This example compares the two ways the driver drains AIn blocks from    */
+/*  the DSP receive data register (PCI_HRXS) against a stubbed register    */
+/*  window in memory: pd_dsp_read() for every word, which polls HSTR_HRRQ   */
+/*  before each read, and pd_dsp_read_block(), which polls once and then    */
+/*  reads the block with pd_readl_rep16(). It reports the cycles the ISR   */
+/*  spends per 512-sample block. No board is needed.                        */
+/*                                                                           */
+/*  On a real board both the status polls and the data reads are           */
+/*  non-posted PCI reads that stall the CPU. Pass the read latency in ns    */
+/*  (e.g. 600) to add it to every stubbed register read.                    */
+/*                                                                           */
+/*  Usage: AInReadBlockBench [register read latency, ns]                     */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+/*      Copyright (C) 2001 United Electronic Industries, Inc.                */
+/*      All rights reserved.                                                 */
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+#include "pdpcidef.h"
+
+#define BLOCK_WORDS   512
+#define NB_PASSES     2000
+
+typedef uint32_t u32;
+typedef uint16_t u16;
+
+static volatile u32 regs[0x40/4];     /* stubbed register window */
+static long readLatencyNs;
+static u32 statusReads;
+
+static uint64_t now_ns(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t cycles(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+   return __rdtsc();
+#else
+   return now_ns();
+#endif
+}
+
+static void read_stall(void)
+{
+   if (readLatencyNs)
+   {
+      uint64_t end = now_ns() + readLatencyNs;
+      while (now_ns() < end) { }
+   }
+}
+
+static u32 get_status(void)
+{
+   statusReads++;
+   read_stall();
+   return regs[PCI_HSTR/4];
+}
+
+static u32 read_data(void)
+{
+   read_stall();
+   return regs[PCI_HRXS/4];
+}
+
+/* pd_dsp_read(): status check before every word */
+static void read_per_word(u16 *buf, u32 count)
+{
+   u32 i;
+
+   for (i = 0; i < count; i++)
+   {
+      while (!(get_status() & (1 << HSTR_HRRQ))) { }
+      buf[i] = (u16)read_data();
+   }
+}
+
+/* pd_dsp_read_block(): one status check, then pd_readl_rep16() */
+static void read_block(u16 *buf, u32 count)
+{
+   while (!(get_status() & (1 << HSTR_HRRQ))) { }
+   while (count--)
+      *(buf++) = (u16)read_data();
+}
+
+static double bench(void (*fn)(u16*, u32), u16 *buf, u32 *pReads)
+{
+   uint64_t start;
+   u32 i, passes = readLatencyNs ? NB_PASSES / 100 : NB_PASSES;
+
+   statusReads = 0;
+   start = cycles();
+   for (i = 0; i < passes; i++)
+      fn(buf, BLOCK_WORDS);
+   *pReads = statusReads / passes;
+   return (double)(cycles() - start) / passes;
+}
+
+int main(int argc, char *argv[])
+{
+   u16 buf[BLOCK_WORDS];
+   u32 readsWord, readsBlock;
+   double cWord, cBlock;
+
+   readLatencyNs = (argc > 1) ? atol(argv[1]) : 0;
+
+   regs[PCI_HSTR/4] = 1 << HSTR_HRRQ;   /* receiver always has data */
+   regs[PCI_HRXS/4] = 0x12345678;
+
+   cWord = bench(read_per_word, buf, &readsWord);
+   cBlock = bench(read_block, buf, &readsBlock);
+
+   printf("AInReadBlockBench: %d-sample block, register read latency %ld ns\n",
+          BLOCK_WORDS, readLatencyNs);
+   printf("  per-word check : %10.0f cycles, %4u status reads\n", cWord, readsWord);
+   printf("  block read     : %10.0f cycles, %4u status reads\n", cBlock, readsBlock);
+   printf("  speedup        : x%.1f\n", cWord / cBlock);
+
+   return 0;
+}
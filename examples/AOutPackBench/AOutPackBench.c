@@ -0,0 +1,216 @@
+/*****************************************************************************/
+/*                  AOut transfer buffer packing benchmark                   */
+/*                                                                           */
+/*  This example builds the driver packing kernels (pdfw_lib/pdl_aopack.c)  */
+/*  in user space and compares them with the per-sample loops the driver    */
+/*  used before in pd_aout_put_xbuf(). For each of the six packing cases    */
+/*  the output is checked bit-exact for many head positions and sizes,      */
+/*  including a wrap of the user ring, then the throughput of both          */
+/*  versions is reported. No board is needed.                               */
+/*                                                                           */
+/*  Usage: AOutPackBench [channels in list]                                  */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+/*      Copyright (C) 2001 United Electronic Industries, Inc.                */
+/*      All rights reserved.                                                 */
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/time.h>
+
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+
+#define PD_MAX_CL_SIZE 256
+#include "../../pdfw_lib/pdl_aopack.c"
+
+#define MAX_VALUES   4096      /* user ring size, values */
+#define XFER_VALUES  2048      /* transfer size, like PD_AOUT_MAX_FIFO_VALUES */
+#define NB_PASSES    20000
+
+enum { CASE_MFX16 = 1, CASE_MFX32, CASE_TAG16, CASE_TAG32, CASE_COPY32, CASE_WIDEN16 };
+
+static const char *caseName[] = { "", "MFx WORD", "MFx DWORD", "AO WORD+CL",
+                                  "AO DWORD+CL", "AO DWORD", "AO WORD" };
+
+static u32 chList[PD_MAX_CL_SIZE];
+static u32 nbChan;
+static u32 tags[2*PD_MAX_CL_SIZE];
+static u32 tagLen;
+
+/* Reference: the loops pd_aout_put_xbuf() used, SamplesB part placed   */
+/* right after SamplesA part (cases 3 and 5 used to overwrite it).     */
+static void pack_ref(int c, u32 *pBuf, void *user, u32 Head, u32 SamplesA, u32 SamplesB)
+{
+   u32 *pdw = (u32*)user;
+   u16 *pw = (u16*)user;
+   u32 i, j;
+
+   switch (c)
+   {
+   case CASE_MFX16:
+      for (i = 0; i < SamplesA; i += 2)
+         pBuf[i>>1] = ((u32)pw[i+Head] >> 4) | ((u32)pw[i+1+Head] << 8);
+      for (j = i, i = 0; i < SamplesB; i += 2, j += 2)
+         pBuf[j>>1] = ((u32)pw[i] >> 4) | ((u32)pw[i+1] << 8);
+      break;
+   case CASE_MFX32:
+   case CASE_COPY32:
+      for (i = 0; i < SamplesA; i++)
+         pBuf[i] = pdw[i+Head];
+      for (j = i, i = 0; i < SamplesB; i++, j++)
+         pBuf[j] = pdw[i];
+      break;
+   case CASE_TAG16:
+      for (i = 0; i < SamplesA; i++)
+         pBuf[i] = pw[i+Head] | chList[(i+Head)%nbChan]<<16;
+      for (j = i, i = 0; i < SamplesB; i++, j++)
+         pBuf[j] = pw[i] | chList[i%nbChan]<<16;
+      break;
+   case CASE_TAG32:
+      for (i = 0; i < SamplesA; i++)
+         pBuf[i] = pdw[i+Head] | chList[(i+Head)%nbChan]<<16;
+      for (j = i, i = 0; i < SamplesB; i++, j++)
+         pBuf[j] = pdw[i] | chList[i%nbChan]<<16;
+      break;
+   case CASE_WIDEN16:
+      for (i = 0; i < SamplesA; i++)
+         pBuf[i] = pw[i+Head];
+      for (j = i, i = 0; i < SamplesB; i++, j++)
+         pBuf[j] = pw[i];
+      break;
+   }
+}
+
+/* Same dispatch as pd_aout_put_xbuf() does now */
+static void pack_new(int c, u32 *pBuf, void *user, u32 Head, u32 SamplesA, u32 SamplesB)
+{
+   u32 *pdw = (u32*)user;
+   u16 *pw = (u16*)user;
+
+   switch (c)
+   {
+   case CASE_MFX16:
+      pd_aopack_mfx16(pBuf, pw+Head, (SamplesA+1)>>1);
+      if (SamplesB)
+         pd_aopack_mfx16(pBuf+((SamplesA+1)>>1), pw, (SamplesB+1)>>1);
+      break;
+   case CASE_MFX32:
+   case CASE_COPY32:
+      memcpy(pBuf, pdw+Head, SamplesA * sizeof(u32));
+      if (SamplesB)
+         memcpy(pBuf+SamplesA, pdw, SamplesB * sizeof(u32));
+      break;
+   case CASE_TAG16:
+      pd_aopack_tag16(pBuf, pw+Head, SamplesA, tags, tagLen, Head % tagLen);
+      if (SamplesB)
+         pd_aopack_tag16(pBuf+SamplesA, pw, SamplesB, tags, tagLen, 0);
+      break;
+   case CASE_TAG32:
+      pd_aopack_tag32(pBuf, pdw+Head, SamplesA, tags, tagLen, Head % tagLen);
+      if (SamplesB)
+         pd_aopack_tag32(pBuf+SamplesA, pdw, SamplesB, tags, tagLen, 0);
+      break;
+   case CASE_WIDEN16:
+      pd_aopack_widen16(pBuf, pw+Head, SamplesA);
+      if (SamplesB)
+         pd_aopack_widen16(pBuf+SamplesA, pw, SamplesB);
+      break;
+   }
+}
+
+static double elapsed(struct timeval *start)
+{
+   struct timeval now;
+
+   gettimeofday(&now, NULL);
+   return (now.tv_sec - start->tv_sec) + (now.tv_usec - start->tv_usec) / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+   u32 *user, *bufRef, *bufNew;
+   u32 i, Head, Num, SamplesA, SamplesB, errors = 0;
+   double tRef, tNew;
+   struct timeval start;
+   int c;
+
+   nbChan = (argc > 1) ? atoi(argv[1]) : 8;
+   if (nbChan < 1 || nbChan > PD_MAX_CL_SIZE)
+   {
+      fprintf(stderr, "AOutPackBench: channels must be 1..%d\n", PD_MAX_CL_SIZE);
+      return 1;
+   }
+   for (i = 0; i < nbChan; i++)
+      chList[i] = 0x100 | i;
+   tagLen = pd_aout_build_tags(tags, chList, nbChan);
+
+   /* one extra value: odd MFx sizes read one WORD past the end */
+   user = (u32*)malloc((MAX_VALUES + 2) * sizeof(u32));
+   bufRef = (u32*)malloc(MAX_VALUES * sizeof(u32));
+   bufNew = (u32*)malloc(MAX_VALUES * sizeof(u32));
+   if (!user || !bufRef || !bufNew)
+   {
+      fprintf(stderr, "AOutPackBench: out of memory\n");
+      return 1;
+   }
+   srand(1);
+   for (i = 0; i < MAX_VALUES + 2; i++)
+      user[i] = ((u32)rand() << 16) ^ (u32)rand();
+
+   printf("AOutPackBench: %u channels, tag pattern %u\n", nbChan, tagLen);
+
+   for (c = CASE_MFX16; c <= CASE_WIDEN16; c++)
+   {
+      u32 maxValues = MAX_VALUES;
+
+      /* bit-exact check, head positions and sizes around every alignment */
+      for (Head = 0; Head < maxValues; Head += (Head < 64 || Head > maxValues - 64) ? 1 : 61)
+      {
+         for (Num = 0; Num <= maxValues; Num += (Num < 80) ? 1 : 509)
+         {
+            SamplesA = (maxValues - Head < Num) ? maxValues - Head : Num;
+            SamplesB = Num - SamplesA;
+            memset(bufRef, 0xAA, MAX_VALUES * sizeof(u32));
+            memset(bufNew, 0xAA, MAX_VALUES * sizeof(u32));
+            pack_ref(c, bufRef, user, Head, SamplesA, SamplesB);
+            pack_new(c, bufNew, user, Head, SamplesA, SamplesB);
+            if (memcmp(bufRef, bufNew, MAX_VALUES * sizeof(u32)))
+            {
+               if (errors++ < 10)
+                  printf("  %s: mismatch Head=%u SamplesA=%u SamplesB=%u\n",
+                         caseName[c], Head, SamplesA, SamplesB);
+            }
+         }
+      }
+
+      /* throughput, one FIFO worth of values per pass */
+      Num = (c == CASE_MFX16) ? 2 * XFER_VALUES : XFER_VALUES;
+      Head = 5;
+      gettimeofday(&start, NULL);
+      for (i = 0; i < NB_PASSES; i++)
+         pack_ref(c, bufRef, user, Head, Num, 0);
+      tRef = elapsed(&start);
+      gettimeofday(&start, NULL);
+      for (i = 0; i < NB_PASSES; i++)
+         pack_new(c, bufNew, user, Head, Num, 0);
+      tNew = elapsed(&start);
+
+      printf("  case %d %-12s old %8.1f Mvalues/s  new %8.1f Mvalues/s  (x%.2f)\n",
+             c, caseName[c], (double)Num * NB_PASSES / tRef / 1e6,
+             (double)Num * NB_PASSES / tNew / 1e6, tRef / tNew);
+   }
+
+   printf("AOutPackBench: %s\n", errors ? "FAILED" : "all cases bit-exact");
+
+   free(user);
+   free(bufRef);
+   free(bufNew);
+   return errors ? 1 : 0;
+}
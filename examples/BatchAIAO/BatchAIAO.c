@@ -0,0 +1,129 @@
+/*****************************************************************************/
+/*                  Batched commands closed loop example                     */
+/*                                                                           */
+/*  This example runs a software timed AI->AO loop on channel 0 and         */
+/*  compares the cost of one cycle done with one ioctl per command          */
+/*  (_PdAOutPutValue, _PdAInGetValue, _PdAInSwClStart) with the same cycle  */
+/*  done as a single batch (_PdBatchExecute).                               */
+/*  Each cycle outputs the value computed from the previous sample, reads   */
+/*  the sample converted during the previous cycle and starts the next     */
+/*  conversion, so the three commands always fit in one batch.             */
+/*                                                                           */
+/*  Usage: BatchAIAO [board] [cycles]                                        */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+/*      Copyright (C) 2001 United Electronic Industries, Inc.                */
+/*      All rights reserved.                                                 */
+/*---------------------------------------------------------------------------*/
+/*                                                                           */ 
+/*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <signal.h>
+#include <unistd.h>
+#include "win_sdk_types.h"
+#include "powerdaq.h"
+#include "powerdaq32.h"
+
+#define NB_CYCLES    10000
+
+static double elapsed(struct timeval *start)
+{
+   struct timeval now;
+
+   gettimeofday(&now, NULL);
+   return (now.tv_sec - start->tv_sec) + (now.tv_usec - start->tv_usec) / 1e6;
+}
+
+/* toy control law: AI raw sample (16 bits) to AO channel 0 (12 bits)*/
+static DWORD control(WORD sample)
+{
+   return (sample >> 4) & 0xFFF;
+}
+
+int main(int argc, char *argv[])
+{
+   int board = 0;
+   int aiHandle, aoHandle;
+   int i, cycles = NB_CYCLES;
+   int idxAo, idxAi, idxCl;
+   DWORD chList[1];
+   DWORD aoValue = 0x800;
+   DWORD value;
+   WORD sample;
+   PD_BATCH batch;
+   struct timeval start;
+   double tSingle, tBatch;
+   int retVal;
+
+   if (argc > 1)
+      board = atoi(argv[1]);
+   if (argc > 2)
+      cycles = atoi(argv[2]);
+
+   aiHandle = PdAcquireSubsystem(board, AnalogIn, 1);
+   aoHandle = PdAcquireSubsystem(board, AnalogOut, 1);
+   if (aiHandle < 0 || aoHandle < 0)
+   {
+      fprintf(stderr, "BatchAIAO: PdAcquireSubsystem failed\n");
+      return EXIT_FAILURE;
+   }
+
+   /* AI: software channel list clock, channel 0*/
+   chList[0] = CHLIST_ENT(0, 0, 0);
+   _PdAInReset(aiHandle);
+   _PdAInSetCfg(aiHandle, AIB_CVSTART0 | AIB_CVSTART1, 0, 0);
+   _PdAInSetChList(aiHandle, 1, chList);
+   _PdAInEnableConv(aiHandle, TRUE);
+   _PdAInSwStartTrig(aiHandle);
+   _PdAInSwClStart(aiHandle);
+
+   _PdAOutSetCfg(aoHandle, 0, 0);
+
+   /* one ioctl per command*/
+   gettimeofday(&start, NULL);
+   for (i = 0; i < cycles; i++)
+   {
+      _PdAOutPutValue(aoHandle, aoValue);
+      _PdAInGetValue(aiHandle, &sample);
+      _PdAInSwClStart(aiHandle);
+      aoValue = control(sample);
+   }
+   tSingle = elapsed(&start);
+
+   /* same cycle as one batch*/
+   _PdBatchInit(&batch, PD_BATCH_STOPONERROR);
+   idxAo = _PdBatchAddAOutPutValue(&batch, aoValue);
+   idxAi = _PdBatchAddAInGetValue(&batch);
+   idxCl = _PdBatchAddAInSwClStart(&batch);
+
+   gettimeofday(&start, NULL);
+   for (i = 0; i < cycles; i++)
+   {
+      batch.Entry[idxAo].dwParam[0] = aoValue;
+      retVal = _PdBatchExecute(aiHandle, &batch);
+      if (retVal < 0 || _PdBatchGetResult(&batch, idxCl, NULL) < 0)
+      {
+         fprintf(stderr, "BatchAIAO: batch failed (%d)\n", retVal);
+         break;
+      }
+      _PdBatchGetResult(&batch, idxAi, &value);
+      aoValue = control((WORD)value);
+   }
+   tBatch = elapsed(&start);
+
+   printf("%d cycles: single ioctls %.2f us/cycle, batched %.2f us/cycle\n",
+          cycles, tSingle * 1e6 / cycles, tBatch * 1e6 / cycles);
+
+   _PdAInReset(aiHandle);
+   _PdAOutReset(aoHandle);
+   PdAcquireSubsystem(aiHandle, AnalogIn, 0);
+   PdAcquireSubsystem(aoHandle, AnalogOut, 0);
+
+   return EXIT_SUCCESS;
+}
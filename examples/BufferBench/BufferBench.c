@@ -0,0 +1,127 @@
+/*****************************************************************************/
+/*                  DAQ buffer allocation benchmark                          */
+/*                                                                           */
+/*  This example registers an analog input DAQ buffer twice, once with the  */
+/*  default (vmalloc) allocation and once with BUF_CONTIGUOUS, and reports  */
+/*  the time to set up and release the buffer and the bandwidth of copying  */
+/*  data out of the mapped buffer, like a consumer draining the ring does.  */
+/*  No acquisition is started.                                               */
+/*                                                                           */
+/*  Usage: BufferBench [board] [buffer size in MB]                           */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+/*      Copyright (C) 2001 United Electronic Industries, Inc.                */
+/*      All rights reserved.                                                 */
+/*---------------------------------------------------------------------------*/
+/*                                                                           */ 
+/*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <signal.h>
+#include <unistd.h>
+#include "win_sdk_types.h"
+#include "powerdaq.h"
+#include "powerdaq32.h"
+
+#define NB_CHANNELS  16
+#define NB_SCANS     8192
+#define NB_PASSES    8
+
+static double elapsed(struct timeval *start)
+{
+   struct timeval now;
+
+   gettimeofday(&now, NULL);
+   return (now.tv_sec - start->tv_sec) + (now.tv_usec - start->tv_usec) / 1e6;
+}
+
+static int bench(int handle, DWORD nbFrames, DWORD mode, const char *name)
+{
+   WORD *buffer;
+   char *dest;
+   DWORD frameBytes = NB_CHANNELS * NB_SCANS * sizeof(WORD);
+   DWORD i, j;
+   double tSetup, tCopy, tRelease;
+   struct timeval start;
+   int retVal;
+
+   dest = (char*)malloc(frameBytes);
+   if (!dest)
+   {
+      fprintf(stderr, "BufferBench: out of memory\n");
+      return -1;
+   }
+
+   gettimeofday(&start, NULL);
+   retVal = _PdAcquireBuffer(handle, (void**)&buffer, nbFrames, NB_SCANS,
+                             NB_CHANNELS, AnalogIn, BUF_BUFFERWRAPPED | mode);
+   if (retVal < 0)
+   {
+      fprintf(stderr, "BufferBench: error %d in _PdAcquireBuffer (%s)\n", retVal, name);
+      free(dest);
+      return retVal;
+   }
+   /* touch every page so that the setup time includes the mapping */
+   for (i = 0; i < nbFrames * frameBytes / sizeof(WORD); i += 2048)
+      buffer[i] = (WORD)i;
+   tSetup = elapsed(&start);
+
+   /* drain the ring frame by frame into one destination frame */
+   gettimeofday(&start, NULL);
+   for (j = 0; j < NB_PASSES; j++)
+      for (i = 0; i < nbFrames; i++)
+         memcpy(dest, (char*)buffer + i * frameBytes, frameBytes);
+   tCopy = elapsed(&start);
+
+   gettimeofday(&start, NULL);
+   retVal = _PdReleaseBuffer(handle, AnalogIn, buffer);
+   tRelease = elapsed(&start);
+   if (retVal < 0)
+      fprintf(stderr, "BufferBench: error %d in _PdReleaseBuffer (%s)\n", retVal, name);
+
+   printf("%-12s setup %8.3f ms  release %8.3f ms  copy %8.1f MB/s\n", name,
+          tSetup * 1e3, tRelease * 1e3,
+          (double)NB_PASSES * nbFrames * frameBytes / tCopy / 1e6);
+
+   free(dest);
+   return retVal;
+}
+
+int main(int argc, char *argv[])
+{
+   int board = 0;
+   int handle;
+   DWORD sizeMB = 64;
+   DWORD nbFrames;
+
+   if (argc > 1)
+      board = atoi(argv[1]);
+   if (argc > 2)
+      sizeMB = atoi(argv[2]);
+
+   nbFrames = (sizeMB << 20) / (NB_CHANNELS * NB_SCANS * sizeof(WORD));
+   if (nbFrames < 2)
+      nbFrames = 2;
+
+   handle = PdAcquireSubsystem(board, AnalogIn, 1);
+   if (handle < 0)
+   {
+      fprintf(stderr, "BufferBench: PdAcquireSubsystem failed\n");
+      return EXIT_FAILURE;
+   }
+
+   printf("Board %d, %lu frames of %d bytes\n", board, (unsigned long)nbFrames,
+          (int)(NB_CHANNELS * NB_SCANS * sizeof(WORD)));
+
+   bench(handle, nbFrames, 0, "vmalloc");
+   bench(handle, nbFrames, BUF_CONTIGUOUS, "contiguous");
+
+   PdAcquireSubsystem(handle, AnalogIn, 0);
+
+   return EXIT_SUCCESS;
+}
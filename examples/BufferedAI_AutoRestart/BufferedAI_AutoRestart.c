@@ -0,0 +1,337 @@
+/*****************************************************************************/
+/*              Buffered analog input with overrun restart                   */
+/*                                                                           */
+/*  This example shows how to keep a long running acquisition going when    */
+/*  the driver cannot empty the board's FIFO in time. The buffer is         */
+/*  allocated with BUF_AUTORESTART: on a FIFO overrun the driver clears     */
+/*  the FIFO and restarts the conversions instead of stopping, and logs     */
+/*  the restart as a gap. The example reads the gaps with _PdAInGetGaps()   */
+/*  and checks that the acquisition never stops.                            */
+/*                                                                           */
+/*  It runs until CTRL+C and prints statistics every 10 seconds, so it can  */
+/*  be left running as a soak test. Use a rate close to what the machine    */
+/*  can sustain, or load the machine, to provoke overruns.                  */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+/*      Copyright (C) 2004 United Electronic Industries, Inc.                */
+/*      All rights reserved.                                                 */
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include "win_sdk_types.h"
+#include "powerdaq.h"
+#include "powerdaq32.h"
+
+#include "ParseParams.h"
+
+typedef enum _state
+{
+   closed,
+   unconfigured,
+   configured,
+   running
+} tState;
+
+typedef struct _autoRestartAiData
+{
+   int abort;
+   int board;                    // board number to be used for the AI operation
+   int handle;                   // board handle
+   unsigned short *rawBuffer;    // address of the buffer allocated by the driver to store
+                                 // the raw binary data
+   int nbOfChannels;             // number of channels
+   DWORD channelList[64];
+   DWORD aiCfg;
+   int nbOfFrames;               // number of frames used in the asynchronous circular buffer
+   int nbOfSamplesPerChannel;    // number of samples per channel
+   double scanRate;              // sampling frequency on each channel
+   int trigger;
+   tState state;                 // state of the acquisition session
+
+   unsigned long long scans;     // scans read
+   unsigned long long lostScans; // scans lost in the gaps (estimate)
+   DWORD nextGap;                // next gap to read
+   DWORD unknownGaps;            // gaps without an estimate
+} tAutoRestartAiData;
+
+
+void CleanUpAutoRestartAI(tAutoRestartAiData *pAiData);
+
+static tAutoRestartAiData G_AiData;
+
+// exit handler
+void AutoRestartAIExitHandler(int status, void *arg)
+{
+   CleanUpAutoRestartAI((tAutoRestartAiData *)arg);
+}
+
+
+int InitAutoRestartAI(tAutoRestartAiData *pAiData)
+{
+   int retVal = 0;
+
+   pAiData->handle = PdAcquireSubsystem(pAiData->board, AnalogIn, 1);
+   if(pAiData->handle < 0)
+   {
+      printf("AutoRestartAI: PdAcquireSubsystem failed\n");
+      exit(EXIT_FAILURE);
+   }
+
+   pAiData->state = unconfigured;
+
+   retVal = _PdAInReset(pAiData->handle);
+   if (retVal < 0)
+   {
+      printf("AutoRestartAI: PdAInReset error %d\n", retVal);
+      exit(EXIT_FAILURE);
+   }
+
+   return 0;
+}
+
+
+// read and print the gaps logged since the last call
+int ReadGaps(tAutoRestartAiData *pAiData)
+{
+   tGapInfo gaps[PD_GAP_LOG_SIZE];
+   DWORD numRet, numGaps, i;
+   int retVal;
+
+   retVal = _PdAInGetGaps(pAiData->handle, pAiData->nextGap, gaps, PD_GAP_LOG_SIZE,
+                          &numRet, &numGaps);
+   if (retVal < 0)
+   {
+      printf("AutoRestartAI: PdAInGetGaps error %d\n", retVal);
+      return retVal;
+   }
+
+   if (numRet && (gaps[0].Seq != pAiData->nextGap))
+      printf("AutoRestartAI: gaps %d to %d were dropped from the log\n",
+             pAiData->nextGap, gaps[0].Seq - 1);
+
+   for (i = 0; i < numRet; i++)
+   {
+      printf("AutoRestartAI: gap %d at scan %d (wrap %d), %d scans lost, t=%llu ns\n",
+             gaps[i].Seq, gaps[i].Head / pAiData->nbOfChannels, gaps[i].WrapCount,
+             gaps[i].LostScans,
+             ((unsigned long long)gaps[i].TimestampHigh << 32) | gaps[i].TimestampLow);
+
+      if (gaps[i].LostScans)
+         pAiData->lostScans += gaps[i].LostScans;
+      else
+         pAiData->unknownGaps++;
+      pAiData->nextGap = gaps[i].Seq + 1;
+   }
+
+   return numGaps;
+}
+
+
+int RunAutoRestartAI(tAutoRestartAiData *pAiData)
+{
+   int retVal;
+   DWORD divider;
+   DWORD events;
+   DWORD scanIndex, numScans;
+   DWORD eventsToNotify = eFrameDone | eBufferDone | eBufferError | eStopped;
+   time_t start, lastReport;
+
+   // setup the board to use hardware internal clock
+   pAiData->aiCfg = AIB_CLSTART0 | AIB_CVSTART1 | AIB_CVSTART0 | AIN_RANGE_10V |
+                    AIN_SINGLE_ENDED | AIN_BIPOLAR | pAiData->trigger;
+
+   retVal = _PdRegisterBuffer(pAiData->handle, &pAiData->rawBuffer, AnalogIn,
+                              pAiData->nbOfFrames, pAiData->nbOfSamplesPerChannel,
+                              pAiData->nbOfChannels,
+                              BUF_BUFFERRECYCLED | BUF_BUFFERWRAPPED | BUF_AUTORESTART);
+   if (retVal < 0)
+   {
+      // BUF_AUTORESTART is refused in the bus master modes
+      printf("AutoRestartAI: PdRegisterBuffer error %d (driver loaded with xferMode=0 or 1?)\n", retVal);
+      exit(EXIT_FAILURE);
+   }
+
+   // set clock divider, assuming that we use the 11MHz timebase
+   divider = (11000000.0 / pAiData->scanRate)-1;
+
+   retVal = _PdAInAsyncInit(pAiData->handle, pAiData->aiCfg, 0, 0,
+                            divider, divider, eventsToNotify,
+                            pAiData->nbOfChannels, pAiData->channelList);
+   if (retVal < 0)
+   {
+      printf("AutoRestartAI: PdAInAsyncInit error %d\n", retVal);
+      exit(EXIT_FAILURE);
+   }
+
+   pAiData->state = configured;
+
+   retVal = _PdSetUserEvents(pAiData->handle, AnalogIn, eventsToNotify);
+   if (retVal < 0)
+   {
+      printf("AutoRestartAI: PdSetUserEvents error %d\n", retVal);
+      exit(EXIT_FAILURE);
+   }
+
+   retVal = _PdAInAsyncStart(pAiData->handle);
+   if (retVal < 0)
+   {
+      printf("AutoRestartAI: PdAInAsyncStart error %d\n", retVal);
+      exit(EXIT_FAILURE);
+   }
+
+   pAiData->state = running;
+   start = lastReport = time(NULL);
+
+   while(!pAiData->abort)
+   {
+      usleep(10000);
+
+      retVal = _PdGetUserEvents(pAiData->handle, AnalogIn, &events);
+      if (retVal < 0)
+      {
+         printf("AutoRestartAI: PdGetUserEvents error %d\n", retVal);
+         exit(EXIT_FAILURE);
+      }
+
+      // with BUF_AUTORESTART an overrun must not stop the acquisition
+      if (events & eStopped)
+      {
+         printf("AutoRestartAI: acquisition stopped after %ld s\n", (long)(time(NULL) - start));
+         exit(EXIT_FAILURE);
+      }
+
+      if (events & eBufferError)
+         ReadGaps(pAiData);
+
+      do
+      {
+         retVal = _PdAInGetScans(pAiData->handle, pAiData->nbOfSamplesPerChannel,
+                                 AIN_SCANRETMODE_MMAP, &scanIndex, &numScans);
+         if (retVal < 0)
+            break;
+         pAiData->scans += numScans;
+      } while (numScans);
+
+      if (events)
+         _PdSetUserEvents(pAiData->handle, AnalogIn, eventsToNotify);
+
+      if (time(NULL) - lastReport >= 10)
+      {
+         lastReport = time(NULL);
+         printf("AutoRestartAI: %ld s, %llu scans read, %d gaps, %llu scans lost (%d unknown)\n",
+                (long)(lastReport - start), pAiData->scans, pAiData->nextGap,
+                pAiData->lostScans, pAiData->unknownGaps);
+      }
+   }
+
+   ReadGaps(pAiData);
+   printf("AutoRestartAI: ran %ld s, %llu scans read, %d gaps, %llu scans lost (%d unknown)\n",
+          (long)(time(NULL) - start), pAiData->scans, pAiData->nextGap,
+          pAiData->lostScans, pAiData->unknownGaps);
+
+   return 0;
+}
+
+
+void CleanUpAutoRestartAI(tAutoRestartAiData *pAiData)
+{
+   int retVal;
+
+   if(pAiData->state == running)
+   {
+      retVal = _PdAInAsyncStop(pAiData->handle);
+      if (retVal < 0)
+         printf("AutoRestartAI: PdAInAsyncStop error %d\n", retVal);
+
+      pAiData->state = configured;
+   }
+
+   if(pAiData->state == configured)
+   {
+      retVal = _PdClearUserEvents(pAiData->handle, AnalogIn, eAllEvents);
+      if (retVal < 0)
+         printf("AutoRestartAI: PdClearUserEvents error %d\n", retVal);
+
+      retVal = _PdAInAsyncTerm(pAiData->handle);
+      if (retVal < 0)
+         printf("AutoRestartAI: PdAInAsyncTerm error %d\n", retVal);
+
+      retVal = _PdUnregisterBuffer(pAiData->handle, pAiData->rawBuffer, AnalogIn);
+      if (retVal < 0)
+         printf("AutoRestartAI: PdUnregisterBuffer error %d\n", retVal);
+
+      pAiData->state = unconfigured;
+   }
+
+   if(pAiData->handle > 0 && pAiData->state == unconfigured)
+   {
+      retVal = PdAcquireSubsystem(pAiData->handle, AnalogIn, 0);
+      if (retVal < 0)
+         printf("AutoRestartAI: PdReleaseSubsystem error %d\n", retVal);
+   }
+
+   pAiData->state = closed;
+}
+
+
+void SigInt(int signum)
+{
+   if(signum == SIGINT)
+   {
+      printf("CTRL+C detected, stopping acquisition\n");
+      G_AiData.abort = TRUE;
+   }
+}
+
+
+int main(int argc, char *argv[])
+{
+   int i;
+   PD_PARAMS params = {0, 1, {0}, 100000.0, 0, 4096};
+
+   ParseParameters(argc, argv, &params);
+
+   // initializes acquisition session parameters
+   G_AiData.board = params.board;
+   G_AiData.handle = 0;
+   G_AiData.abort = FALSE;
+   G_AiData.nbOfChannels = params.numChannels;
+   for(i=0; i<params.numChannels; i++)
+       G_AiData.channelList[i] = params.channels[i];
+   G_AiData.nbOfFrames = 16;
+   G_AiData.rawBuffer = NULL;
+   G_AiData.nbOfSamplesPerChannel = params.numSamplesPerChannel;
+   G_AiData.scanRate = params.frequency;
+   G_AiData.state = closed;
+   if(params.trigger == 1)
+       G_AiData.trigger = AIB_STARTTRIG0;
+   else if(params.trigger == 2)
+       G_AiData.trigger = AIB_STARTTRIG0 + AIB_STARTTRIG1;
+   else
+       G_AiData.trigger = 0;
+
+   // setup exit handler that will clean-up the acquisition session
+   // if an error occurs
+   on_exit(AutoRestartAIExitHandler, &G_AiData);
+
+   signal(SIGINT, SigInt);
+
+   // initializes acquisition session
+   InitAutoRestartAI(&G_AiData);
+
+   // run the acquisition until CTRL+C
+   RunAutoRestartAI(&G_AiData);
+
+   // Cleanup acquisition
+   CleanUpAutoRestartAI(&G_AiData);
+
+   return 0;
+}
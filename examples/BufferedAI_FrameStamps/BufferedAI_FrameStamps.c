@@ -0,0 +1,375 @@
+/*****************************************************************************/
+/*              Buffered analog input with frame timestamps                  */
+/*                                                                           */
+/*  This example shows how to place the acquired samples in time using the  */
+/*  frame stamps the driver logs on the DAQ buffer control page. Each time  */
+/*  a transfer from the board completes a frame, the driver records the     */
+/*  absolute index of the last value transferred and the CLOCK_MONOTONIC    */
+/*  time it got to the host. The example reads the stamps with              */
+/*  _PdAInGetFrameStamps() and compares the scan rate they give with the    */
+/*  nominal one, which shows how far the board clock drifts from the host   */
+/*  clock over a long run.                                                  */
+/*                                                                           */
+/*  It runs until CTRL+C and prints the measured rate every 10 seconds.     */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+/*      Copyright (C) 2004 United Electronic Industries, Inc.                */
+/*      All rights reserved.                                                 */
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include "win_sdk_types.h"
+#include "powerdaq.h"
+#include "powerdaq32.h"
+
+#include "ParseParams.h"
+
+typedef enum _state
+{
+   closed,
+   unconfigured,
+   configured,
+   running
+} tState;
+
+typedef struct _frameStampsAiData
+{
+   int abort;
+   int board;                    // board number to be used for the AI operation
+   int handle;                   // board handle
+   unsigned short *rawBuffer;    // address of the buffer allocated by the driver to store
+                                 // the raw binary data
+   tDaqBufCtrl *pCtrl;           // control page of the buffer
+   int nbOfChannels;             // number of channels
+   DWORD channelList[64];
+   DWORD aiCfg;
+   int nbOfFrames;               // number of frames used in the asynchronous circular buffer
+   int nbOfSamplesPerChannel;    // number of samples per channel
+   double scanRate;              // sampling frequency on each channel
+   int trigger;
+   tState state;                 // state of the acquisition session
+
+   DWORD nextStamp;              // next stamp to read
+   DWORD lostStamps;             // stamps overwritten before we read them
+   int haveFirst;
+   tFrameStamp first;            // first stamp read
+   tFrameStamp last;             // last stamp read
+} tFrameStampsAiData;
+
+
+void CleanUpFrameStampsAI(tFrameStampsAiData *pAiData);
+
+static tFrameStampsAiData G_AiData;
+
+// exit handler
+void FrameStampsAIExitHandler(int status, void *arg)
+{
+   CleanUpFrameStampsAI((tFrameStampsAiData *)arg);
+}
+
+
+static unsigned long long StampIndex(tFrameStamp *pStamp)
+{
+   return ((unsigned long long)pStamp->ValueIndexHigh << 32) | pStamp->ValueIndexLow;
+}
+
+
+static unsigned long long StampTime(tFrameStamp *pStamp)
+{
+   return ((unsigned long long)pStamp->TimestampHigh << 32) | pStamp->TimestampLow;
+}
+
+
+int InitFrameStampsAI(tFrameStampsAiData *pAiData)
+{
+   int retVal = 0;
+
+   pAiData->handle = PdAcquireSubsystem(pAiData->board, AnalogIn, 1);
+   if(pAiData->handle < 0)
+   {
+      printf("FrameStampsAI: PdAcquireSubsystem failed\n");
+      exit(EXIT_FAILURE);
+   }
+
+   pAiData->state = unconfigured;
+
+   retVal = _PdAInReset(pAiData->handle);
+   if (retVal < 0)
+   {
+      printf("FrameStampsAI: PdAInReset error %d\n", retVal);
+      exit(EXIT_FAILURE);
+   }
+
+   return 0;
+}
+
+
+// read the stamps logged since the last call
+void ReadStamps(tFrameStampsAiData *pAiData)
+{
+   tFrameStamp stamps[PD_FRAMESTAMP_RING_SIZE];
+   DWORD numRet, numStamps, i;
+
+   do
+   {
+      _PdAInGetFrameStamps(pAiData->pCtrl, pAiData->nextStamp, stamps,
+                           PD_FRAMESTAMP_RING_SIZE, &numRet, &numStamps);
+
+      for (i = 0; i < numRet; i++)
+      {
+         if (stamps[i].Seq != pAiData->nextStamp)
+            pAiData->lostStamps += stamps[i].Seq - pAiData->nextStamp;
+
+         if (!pAiData->haveFirst)
+         {
+            pAiData->first = stamps[i];
+            pAiData->haveFirst = TRUE;
+         }
+         pAiData->last = stamps[i];
+         pAiData->nextStamp = stamps[i].Seq + 1;
+      }
+   } while (numRet && (pAiData->nextStamp < numStamps));
+}
+
+
+void PrintRate(tFrameStampsAiData *pAiData)
+{
+   unsigned long long scans, ns;
+   double rate;
+
+   if (!pAiData->haveFirst || (pAiData->last.Seq == pAiData->first.Seq))
+   {
+      printf("FrameStampsAI: not enough stamps yet (none on RT kernels)\n");
+      return;
+   }
+
+   scans = (StampIndex(&pAiData->last) - StampIndex(&pAiData->first)) / pAiData->nbOfChannels;
+   ns = StampTime(&pAiData->last) - StampTime(&pAiData->first);
+   rate = scans * 1e9 / ns;
+
+   printf("FrameStampsAI: %d stamps (%d lost) over %.1f s, %llu scans, %.3f scans/s (%+.1f ppm)\n",
+          pAiData->nextStamp, pAiData->lostStamps, ns / 1e9, scans, rate,
+          (rate / pAiData->scanRate - 1.0) * 1e6);
+}
+
+
+int RunFrameStampsAI(tFrameStampsAiData *pAiData)
+{
+   int retVal;
+   DWORD divider;
+   DWORD events;
+   DWORD scanIndex, numScans;
+   DWORD eventsToNotify = eFrameDone | eBufferDone | eBufferError | eStopped;
+   time_t lastReport;
+
+   // setup the board to use hardware internal clock
+   pAiData->aiCfg = AIB_CLSTART0 | AIB_CVSTART1 | AIB_CVSTART0 | AIN_RANGE_10V |
+                    AIN_SINGLE_ENDED | AIN_BIPOLAR | pAiData->trigger;
+
+   retVal = _PdRegisterBuffer(pAiData->handle, &pAiData->rawBuffer, AnalogIn,
+                              pAiData->nbOfFrames, pAiData->nbOfSamplesPerChannel,
+                              pAiData->nbOfChannels,
+                              BUF_BUFFERRECYCLED | BUF_BUFFERWRAPPED);
+   if (retVal < 0)
+   {
+      printf("FrameStampsAI: PdRegisterBuffer error %d\n", retVal);
+      exit(EXIT_FAILURE);
+   }
+
+   retVal = _PdMapDaqBufCtrl(pAiData->handle, AnalogIn, &pAiData->pCtrl);
+   if (retVal < 0)
+   {
+      printf("FrameStampsAI: PdMapDaqBufCtrl error %d\n", retVal);
+      exit(EXIT_FAILURE);
+   }
+
+   // set clock divider, assuming that we use the 11MHz timebase
+   divider = (11000000.0 / pAiData->scanRate)-1;
+   pAiData->scanRate = 11000000.0 / (divider + 1);
+
+   retVal = _PdAInAsyncInit(pAiData->handle, pAiData->aiCfg, 0, 0,
+                            divider, divider, eventsToNotify,
+                            pAiData->nbOfChannels, pAiData->channelList);
+   if (retVal < 0)
+   {
+      printf("FrameStampsAI: PdAInAsyncInit error %d\n", retVal);
+      exit(EXIT_FAILURE);
+   }
+
+   pAiData->state = configured;
+
+   retVal = _PdSetUserEvents(pAiData->handle, AnalogIn, eventsToNotify);
+   if (retVal < 0)
+   {
+      printf("FrameStampsAI: PdSetUserEvents error %d\n", retVal);
+      exit(EXIT_FAILURE);
+   }
+
+   retVal = _PdAInAsyncStart(pAiData->handle);
+   if (retVal < 0)
+   {
+      printf("FrameStampsAI: PdAInAsyncStart error %d\n", retVal);
+      exit(EXIT_FAILURE);
+   }
+
+   pAiData->state = running;
+   lastReport = time(NULL);
+
+   while(!pAiData->abort)
+   {
+      usleep(10000);
+
+      retVal = _PdGetUserEvents(pAiData->handle, AnalogIn, &events);
+      if (retVal < 0)
+      {
+         printf("FrameStampsAI: PdGetUserEvents error %d\n", retVal);
+         exit(EXIT_FAILURE);
+      }
+
+      if (events & eStopped)
+      {
+         printf("FrameStampsAI: acquisition stopped\n");
+         exit(EXIT_FAILURE);
+      }
+
+      // the stamps don't depend on the data being read, but keep the
+      // buffer moving as a real application would
+      do
+      {
+         retVal = _PdAInGetScans(pAiData->handle, pAiData->nbOfSamplesPerChannel,
+                                 AIN_SCANRETMODE_MMAP, &scanIndex, &numScans);
+         if (retVal < 0)
+            break;
+      } while (numScans);
+
+      ReadStamps(pAiData);
+
+      if (events)
+         _PdSetUserEvents(pAiData->handle, AnalogIn, eventsToNotify);
+
+      if (time(NULL) - lastReport >= 10)
+      {
+         lastReport = time(NULL);
+         PrintRate(pAiData);
+      }
+   }
+
+   ReadStamps(pAiData);
+   PrintRate(pAiData);
+
+   return 0;
+}
+
+
+void CleanUpFrameStampsAI(tFrameStampsAiData *pAiData)
+{
+   int retVal;
+
+   if(pAiData->state == running)
+   {
+      retVal = _PdAInAsyncStop(pAiData->handle);
+      if (retVal < 0)
+         printf("FrameStampsAI: PdAInAsyncStop error %d\n", retVal);
+
+      pAiData->state = configured;
+   }
+
+   if(pAiData->state == configured)
+   {
+      retVal = _PdClearUserEvents(pAiData->handle, AnalogIn, eAllEvents);
+      if (retVal < 0)
+         printf("FrameStampsAI: PdClearUserEvents error %d\n", retVal);
+
+      retVal = _PdAInAsyncTerm(pAiData->handle);
+      if (retVal < 0)
+         printf("FrameStampsAI: PdAInAsyncTerm error %d\n", retVal);
+
+      if (pAiData->pCtrl)
+      {
+         _PdUnmapDaqBufCtrl(pAiData->pCtrl);
+         pAiData->pCtrl = NULL;
+      }
+
+      retVal = _PdUnregisterBuffer(pAiData->handle, pAiData->rawBuffer, AnalogIn);
+      if (retVal < 0)
+         printf("FrameStampsAI: PdUnregisterBuffer error %d\n", retVal);
+
+      pAiData->state = unconfigured;
+   }
+
+   if(pAiData->handle > 0 && pAiData->state == unconfigured)
+   {
+      retVal = PdAcquireSubsystem(pAiData->handle, AnalogIn, 0);
+      if (retVal < 0)
+         printf("FrameStampsAI: PdReleaseSubsystem error %d\n", retVal);
+   }
+
+   pAiData->state = closed;
+}
+
+
+void SigInt(int signum)
+{
+   if(signum == SIGINT)
+   {
+      printf("CTRL+C detected, stopping acquisition\n");
+      G_AiData.abort = TRUE;
+   }
+}
+
+
+int main(int argc, char *argv[])
+{
+   int i;
+   PD_PARAMS params = {0, 1, {0}, 100000.0, 0, 4096};
+
+   ParseParameters(argc, argv, &params);
+
+   // initializes acquisition session parameters
+   G_AiData.board = params.board;
+   G_AiData.handle = 0;
+   G_AiData.abort = FALSE;
+   G_AiData.nbOfChannels = params.numChannels;
+   for(i=0; i<params.numChannels; i++)
+       G_AiData.channelList[i] = params.channels[i];
+   G_AiData.nbOfFrames = 16;
+   G_AiData.rawBuffer = NULL;
+   G_AiData.pCtrl = NULL;
+   G_AiData.nbOfSamplesPerChannel = params.numSamplesPerChannel;
+   G_AiData.scanRate = params.frequency;
+   G_AiData.state = closed;
+   G_AiData.nextStamp = 0;
+   G_AiData.lostStamps = 0;
+   G_AiData.haveFirst = FALSE;
+   if(params.trigger == 1)
+       G_AiData.trigger = AIB_STARTTRIG0;
+   else if(params.trigger == 2)
+       G_AiData.trigger = AIB_STARTTRIG0 + AIB_STARTTRIG1;
+   else
+       G_AiData.trigger = 0;
+
+   // setup exit handler that will clean-up the acquisition session
+   // if an error occurs
+   on_exit(FrameStampsAIExitHandler, &G_AiData);
+
+   signal(SIGINT, SigInt);
+
+   // initializes acquisition session
+   InitFrameStampsAI(&G_AiData);
+
+   // run the acquisition until CTRL+C
+   RunFrameStampsAI(&G_AiData);
+
+   // Cleanup acquisition
+   CleanUpFrameStampsAI(&G_AiData);
+
+   return 0;
+}
@@ -0,0 +1,164 @@
+/*****************************************************************************/
+/*              Synchronized buffered analog input on several boards         */
+/*                                                                           */
+/*  This example shows how to use the group API (pdgroup.h) to acquire on   */
+/*  several boards as one acquisition. The first board is the master, the   */
+/*  others take its scan clock from the PD-CONN-SYNC cable (or from a PXI   */
+/*  trigger line, change SYNC_MODE). The group starts all the boards on     */
+/*  the same clock edge and a single thread delivers one interleaved        */
+/*  stream: scan n of board 0, scan n of board 1, ...                       */
+/*                                                                           */
+/*  It runs until CTRL+C or until the group reports an error, and prints    */
+/*  the first value of every board once per second.                         */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+/*      Copyright (C) 2004 United Electronic Industries, Inc.                */
+/*      All rights reserved.                                                 */
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <signal.h>
+#include <time.h>
+#include "win_sdk_types.h"
+#include "powerdaq.h"
+#include "powerdaq32.h"
+#include "pxi.h"
+#include "pdgroup.h"
+
+#include "ParseParams.h"
+
+// Number of boards to synchronize
+#define NB_BOARDS 3
+
+// PD_GROUP_SYNC_CABLE, PD_GROUP_SYNC_PXI or PD_GROUP_SYNC_EXTCLOCK
+#define SYNC_MODE PD_GROUP_SYNC_CABLE
+
+typedef struct _groupAiData
+{
+   PD_GROUP_CONFIG config;
+   DWORD totalChannels;          // channels in a stream scan
+   time_t lastPrint;
+   volatile int ended;           // the stream ended on an error
+} tGroupAiData;
+
+static tGroupAiData G_AiData;
+static volatile int G_Abort = FALSE;
+
+static const char* G_Errors[] =
+{
+   "none", "buffer over run", "stopped", "scan sequence broken",
+   "board lagging behind", "timeout", "system error"
+};
+
+
+// called from the group consumer thread
+void GroupCallback(void* arg, WORD* pScans, DWORD numScans, unsigned long long firstScan)
+{
+   tGroupAiData *pAiData = (tGroupAiData *)arg;
+   DWORD offset = 0;
+   int b;
+
+   if (!pScans)
+   {
+      pAiData->ended = TRUE;
+      return;
+   }
+
+   if (time(NULL) == pAiData->lastPrint)
+      return;
+   pAiData->lastPrint = time(NULL);
+
+   printf("GroupAI: scan %llu:", firstScan);
+   for (b = 0; b < pAiData->config.nbBoards; b++)
+   {
+      printf(" board%d ch%d = 0x%04x", pAiData->config.boards[b].board,
+             pAiData->config.boards[b].channelList[0], pScans[offset]);
+      offset += pAiData->config.boards[b].nbChannels;
+   }
+   printf("\n");
+}
+
+
+void SigInt(int signum)
+{
+   if (signum == SIGINT)
+   {
+      printf("CTRL+C detected, stopping acquisition\n");
+      G_Abort = TRUE;
+   }
+}
+
+
+int main(int argc, char *argv[])
+{
+   int i, b, retVal;
+   PD_PARAMS params = {0, 1, {0}, 10000.0, 0, 4096};
+   PD_GROUP *pGroup;
+   PD_GROUP_STATUS status;
+
+   ParseParameters(argc, argv, &params);
+
+   G_AiData.config.nbBoards = NB_BOARDS;
+   G_AiData.config.syncMode = SYNC_MODE;
+   G_AiData.config.flags = (params.trigger) ? PD_GROUP_STARTTRIG : 0;
+   G_AiData.config.clockLine = PXI_TRIG0;
+   G_AiData.config.trigLine = PXI_TRIG1;
+   G_AiData.config.scanRate = params.frequency;
+   G_AiData.config.scansPerFrame = params.numSamplesPerChannel;
+   G_AiData.config.nbFrames = 16;
+   G_AiData.config.timeoutms = (params.trigger) ? 0 : 5000;
+
+   for (b = 0; b < NB_BOARDS; b++)
+   {
+      G_AiData.config.boards[b].board = params.board + b;
+      G_AiData.config.boards[b].nbChannels = params.numChannels;
+      for (i = 0; i < params.numChannels; i++)
+         G_AiData.config.boards[b].channelList[i] = params.channels[i];
+      G_AiData.config.boards[b].aiCfg = AIN_RANGE_10V | AIN_SINGLE_ENDED | AIN_BIPOLAR;
+      G_AiData.totalChannels += params.numChannels;
+   }
+
+   retVal = _PdGroupCreate(&G_AiData.config, &pGroup);
+   if (retVal < 0)
+   {
+      printf("GroupAI: PdGroupCreate error %d\n", retVal);
+      exit(EXIT_FAILURE);
+   }
+
+   signal(SIGINT, SigInt);
+
+   retVal = _PdGroupStart(pGroup, GroupCallback, &G_AiData);
+   if (retVal < 0)
+   {
+      printf("GroupAI: PdGroupStart error %d\n", retVal);
+      _PdGroupDestroy(pGroup);
+      exit(EXIT_FAILURE);
+   }
+
+   printf("GroupAI: %d boards, %d channels per stream scan%s\n", NB_BOARDS,
+          G_AiData.totalChannels, (params.trigger) ? ", waiting for trigger" : "");
+
+   while (!G_Abort && !G_AiData.ended)
+      sleep(1);
+
+   _PdGroupStop(pGroup);
+   _PdGroupGetStatus(pGroup, &status);
+
+   printf("GroupAI: %llu scans delivered, error: %s", status.scans, G_Errors[status.error]);
+   if (status.error)
+      printf(" on board%d", G_AiData.config.boards[status.errorBoard].board);
+   printf("\n");
+   for (b = 0; b < NB_BOARDS; b++)
+      printf("GroupAI: board%d acquired %llu scans\n", G_AiData.config.boards[b].board,
+             status.boardScans[b]);
+
+   _PdGroupDestroy(pGroup);
+
+   return (status.error) ? EXIT_FAILURE : 0;
+}
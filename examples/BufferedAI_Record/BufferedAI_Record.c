@@ -0,0 +1,157 @@
+/*****************************************************************************/
+/*              Recording analog input from several boards to disk           */
+/*                                                                           */
+/*  This example shows how to record the interleaved stream of a group      */
+/*  (pdgroup.h) with the recorder (pdrecord.h). The raw samples are written */
+/*  to record.dat with O_DIRECT by the recorder's own thread. The file      */
+/*  header holds the channel lists, the calibration and the scan rate, and  */
+/*  each block the last frame stamp of every board.                         */
+/*                                                                           */
+/*  It runs until CTRL+C or until the group reports an error, and prints    */
+/*  the recorder status once per second. Read the file back with            */
+/*  examples/ReadStreamFile.                                                */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+/*      Copyright (C) 2004 United Electronic Industries, Inc.                */
+/*      All rights reserved.                                                 */
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <signal.h>
+#include "win_sdk_types.h"
+#include "powerdaq.h"
+#include "powerdaq32.h"
+#include "pxi.h"
+#include "pdgroup.h"
+#include "pdrecord.h"
+
+#include "ParseParams.h"
+
+// Number of boards to record
+#define NB_BOARDS 2
+
+// PD_GROUP_SYNC_CABLE, PD_GROUP_SYNC_PXI or PD_GROUP_SYNC_EXTCLOCK
+#define SYNC_MODE PD_GROUP_SYNC_CABLE
+
+// Blocks in the recorder pool, 3 for triple buffering
+#define NB_BUFFERS 3
+
+#define FILE_NAME "record.dat"
+
+static volatile int G_Abort = FALSE;
+
+static const char* G_Errors[] =
+{
+   "none", "buffer over run", "stopped", "scan sequence broken",
+   "board lagging behind", "timeout", "system error"
+};
+
+
+void SigInt(int signum)
+{
+   if (signum == SIGINT)
+   {
+      printf("CTRL+C detected, stopping acquisition\n");
+      G_Abort = TRUE;
+   }
+}
+
+
+int main(int argc, char *argv[])
+{
+   int i, b, retVal;
+   PD_PARAMS params = {0, 1, {0}, 10000.0, 0, 4096};
+   PD_GROUP_CONFIG config;
+   PD_GROUP *pGroup;
+   PD_GROUP_STATUS status;
+   PD_RECORDER *pRec;
+   PD_REC_STATUS recStatus;
+
+   ParseParameters(argc, argv, &params);
+
+   memset(&config, 0, sizeof(config));
+   config.nbBoards = NB_BOARDS;
+   config.syncMode = SYNC_MODE;
+   config.flags = (params.trigger) ? PD_GROUP_STARTTRIG : 0;
+   config.clockLine = PXI_TRIG0;
+   config.trigLine = PXI_TRIG1;
+   config.scanRate = params.frequency;
+   config.scansPerFrame = params.numSamplesPerChannel;
+   config.nbFrames = 16;
+   config.timeoutms = (params.trigger) ? 0 : 5000;
+
+   for (b = 0; b < NB_BOARDS; b++)
+   {
+      config.boards[b].board = params.board + b;
+      config.boards[b].nbChannels = params.numChannels;
+      for (i = 0; i < params.numChannels; i++)
+         config.boards[b].channelList[i] = params.channels[i];
+      config.boards[b].aiCfg = AIN_RANGE_10V | AIN_SINGLE_ENDED | AIN_BIPOLAR;
+   }
+
+   retVal = _PdGroupCreate(&config, &pGroup);
+   if (retVal < 0)
+   {
+      printf("RecordAI: PdGroupCreate error %d\n", retVal);
+      exit(EXIT_FAILURE);
+   }
+
+   retVal = _PdRecorderCreate(FILE_NAME, pGroup, NB_BUFFERS, 0, &pRec);
+   if (retVal < 0)
+   {
+      printf("RecordAI: PdRecorderCreate error %d\n", retVal);
+      _PdGroupDestroy(pGroup);
+      exit(EXIT_FAILURE);
+   }
+
+   signal(SIGINT, SigInt);
+
+   retVal = _PdGroupStart(pGroup, _PdRecorderGroupCallback, pRec);
+   if (retVal < 0)
+   {
+      printf("RecordAI: PdGroupStart error %d\n", retVal);
+      _PdRecorderClose(pRec);
+      _PdGroupDestroy(pGroup);
+      exit(EXIT_FAILURE);
+   }
+
+   _PdRecorderGetStatus(pRec, &recStatus);
+   printf("RecordAI: recording %d boards to %s%s\n", NB_BOARDS, FILE_NAME,
+          (recStatus.bDirect) ? " with O_DIRECT" : "");
+
+   while (!G_Abort)
+   {
+      sleep(1);
+
+      _PdGroupGetStatus(pGroup, &status);
+      _PdRecorderGetStatus(pRec, &recStatus);
+      printf("RecordAI: %llu scans on disk, %d blocks, %d stalls, %d blocks queued at most\n",
+             recStatus.scans, recStatus.blocks, recStatus.stalls, recStatus.maxQueued);
+
+      if (status.error || recStatus.error)
+         break;
+   }
+
+   // stop the group first, the recorder writes what it was given
+   _PdGroupStop(pGroup);
+   _PdGroupGetStatus(pGroup, &status);
+   retVal = _PdRecorderClose(pRec);
+
+   printf("RecordAI: %llu scans delivered, error: %s", status.scans, G_Errors[status.error]);
+   if (status.error)
+      printf(" on board%d", config.boards[status.errorBoard].board);
+   printf("\n");
+   if (retVal < 0)
+      printf("RecordAI: write error: %s\n", strerror(-retVal));
+
+   _PdGroupDestroy(pGroup);
+
+   return (status.error || (retVal < 0)) ? EXIT_FAILURE : 0;
+}
@@ -104,7 +104,8 @@ int BufferedAI(tBufferedAiData *pAiData, double *buffer)
    int retVal;
    DWORD divider;
    DWORD eventsToNotify = eFrameDone | eBufferDone | eTimeout | eBufferError | eStopped;
-   DWORD event;
+   DWORD eventCounts[PD_EVENT_COUNTERS];
+   int event;
    DWORD scanIndex, numScans;
    int i;
    DWORD aiCfg;
@@ -136,10 +137,11 @@ int BufferedAI(tBufferedAiData *pAiData, double *buffer)
 
    pAiData->state = configured;
 
-   retVal = _PdSetUserEvents(pAiData->handle, AnalogIn, eventsToNotify);
+   // the events stay armed, no need to set them again after each wait
+   retVal = _PdSubscribeUserEvents(pAiData->handle, AnalogIn, eventsToNotify);
    if (retVal < 0)
    {
-      printf("BufferedAI: PdAInAsyncInit error %d\n", retVal);
+      printf("BufferedAI: _PdSubscribeUserEvents error %d\n", retVal);
       exit(EXIT_FAILURE);
    }
 
@@ -154,17 +156,16 @@ int BufferedAI(tBufferedAiData *pAiData, double *buffer)
 
    while(!pAiData->abort)
    {
-      event = _PdWaitForEvent(pAiData->handle, eventsToNotify, 3000);
-
-      printf("Received event 0x%x\n", event);
-
-      retVal = _PdSetUserEvents(pAiData->handle, AnalogIn, eventsToNotify);
-      if (retVal < 0)
+      event = _PdWaitForEvents(pAiData->handle, eventsToNotify, 3000, eventCounts);
+      if (event < 0)
       {
-         printf("BufferedAI: _PdSetUserEvents error %d\n", retVal);
+         printf("BufferedAI: _PdWaitForEvents error %d\n", event);
          exit(EXIT_FAILURE);
       }
 
+      // eFrameDone is event bit 5
+      printf("Received event 0x%x, %d frames done\n", event, eventCounts[5]);
+
       if (event & eTimeout)
       {
          printf("BufferedAI: timeout error\n");
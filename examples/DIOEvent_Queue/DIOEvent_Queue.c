@@ -0,0 +1,270 @@
+/*****************************************************************************/
+/*               Digital input change of state queue example                 */
+/*                                                                           */
+/*  This example shows how to log the changes of state of the digital       */
+/*  inputs of a PD2-DIO board with the driver's change of state queue.      */
+/*  The driver reads and re-arms each DIn interrupt itself and logs the     */
+/*  lines that changed with the time of the interrupt. The program waits   */
+/*  on a persistent eDInEvent subscription and reads the records from the  */
+/*  mapped queue, there is no other system call per change.                */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+/*      Copyright (C) 2001 United Electronic Industries, Inc.                */
+/*      All rights reserved.                                                 */
+/*---------------------------------------------------------------------------*/
+/*                                                                           */ 
+/*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <signal.h>
+#include "win_sdk_types.h"
+#include "powerdaq.h"
+#include "powerdaq32.h"
+
+#include "ParseParams.h"
+
+#define MAX_RECORDS  256
+
+typedef enum _state
+{
+   closed,
+   unconfigured,
+   configured,
+   running
+} tState;
+
+typedef struct _dioQueueData
+{
+   int board;                    // board number to be used for the DIn operation
+   int handle;                   // board handle
+   int port;                     // port to use
+   DWORD lines;                  // lines to watch on the selected port
+   int abort;
+   tCosRing* pRing;              // change of state queue, mapped
+   tState state;                 // state of the acquisition session
+} tDioQueueData;
+
+
+int InitDioQueue(tDioQueueData *pDioData);
+int DioQueue(tDioQueueData *pDioData);
+void CleanUpDioQueue(tDioQueueData *pDioData);
+
+
+static tDioQueueData G_DioData;
+
+// exit handler
+void DioQueueExitHandler(int status, void *arg)
+{
+   CleanUpDioQueue((tDioQueueData *)arg);
+}
+
+
+int InitDioQueue(tDioQueueData *pDioData)
+{
+   Adapter_Info adaptInfo;
+   int retVal = 0;
+
+   // get adapter type
+   retVal = _PdGetAdapterInfo(pDioData->board, &adaptInfo);
+   if (retVal < 0)
+   {
+      printf("DioQueue: _PdGetAdapterInfo error %d\n", retVal);
+      exit(EXIT_FAILURE);
+   }
+
+   if(!(adaptInfo.atType & atPD2DIO))
+   {
+      printf("This board is not a PD2-DIO\n");
+      exit(EXIT_FAILURE);
+   }
+
+   pDioData->handle = PdAcquireSubsystem(pDioData->board, DigitalIn, 1);
+   if(pDioData->handle < 0)
+   {
+      printf("DioQueue: PdAcquireSubsystem failed\n");
+      exit(EXIT_FAILURE);
+   }
+
+   pDioData->state = unconfigured;
+
+   retVal = _PdDIOReset(pDioData->handle);
+   if (retVal < 0)
+   {
+      printf("DioQueue: PdDIOReset error %d\n", retVal);
+      exit(EXIT_FAILURE);
+   }
+
+   return 0;
+}
+
+
+int DioQueue(tDioQueueData *pDioData)
+{
+   int i, events, retVal;
+   DWORD masks[8]={0,0,0,0,0,0,0,0};
+   DWORD nextSeq = 0, numRet, numLost, total = 0;
+   tCosRecord records[MAX_RECORDS];
+   unsigned long long ts;
+
+   masks[pDioData->port] = pDioData->lines;
+   retVal = _PdDIOSetIntrMask(pDioData->handle, masks);
+   if (retVal < 0)
+   {
+      printf("DioQueue: _PdDIOSetIntrMask error %d\n", retVal);
+      exit(EXIT_FAILURE);
+   } 
+
+   pDioData->state = configured;
+
+   // the events stay armed, no need to set them again after each wait
+   retVal = _PdSubscribeUserEvents(pDioData->handle, DigitalIn|EdgeDetect, eDInEvent);
+   if (retVal < 0)
+   {
+      printf("DioQueue: _PdSubscribeUserEvents error %d\n", retVal);
+      exit(EXIT_FAILURE);
+   } 
+
+   // the driver reads and re-arms the interrupts from now on
+   retVal = _PdDIOCosStart(pDioData->handle);
+   if (retVal < 0)
+   {
+      printf("DioQueue: _PdDIOCosStart error %d\n", retVal);
+      exit(EXIT_FAILURE);
+   } 
+
+   pDioData->state = running;
+
+   retVal = _PdDIOCosMap(pDioData->handle, &pDioData->pRing);
+   if (retVal < 0)
+   {
+      printf("DioQueue: _PdDIOCosMap error %d\n", retVal);
+      exit(EXIT_FAILURE);
+   } 
+
+   while(!pDioData->abort)
+   {
+      events = _PdWaitForEvents(pDioData->handle, eDInEvent, 5000, NULL);
+      if (events < 0)
+      {
+         printf("DioQueue: _PdWaitForEvents error %d\n", events);
+         exit(EXIT_FAILURE);
+      }
+
+      if (events & eTimeout)
+      {
+         printf("DioQueue: no change in 5s\n"); 
+         continue;
+      }
+
+      // several interrupts may have been logged for one wake-up
+      do
+      {
+         _PdDIOCosRead(pDioData->pRing, &nextSeq, records, MAX_RECORDS, &numRet, &numLost);
+         if (numLost)
+            printf("DioQueue: %d changes lost\n", numLost);
+
+         for (i = 0; i < numRet; i++)
+         {
+            ts = ((unsigned long long)records[i].TimestampHigh << 32) | records[i].TimestampLow;
+            printf("DioQueue: #%d at %llu ns: changed 0x%04x, rising 0x%04x\n",
+                   records[i].Seq, ts,
+                   records[i].IntData[pDioData->port] & 0xFFFF,
+                   records[i].IntData[pDioData->port] & records[i].EdgeData[pDioData->port] & 0xFFFF);
+         }
+         total += numRet;
+      } while (numRet == MAX_RECORDS);
+   }
+
+   printf("DioQueue: %d changes logged\n", total);
+
+   return 0;
+}
+
+
+void CleanUpDioQueue(tDioQueueData *pDioData)
+{
+   int retVal;
+      
+   if(pDioData->pRing)
+   {
+      _PdDIOCosUnmap(pDioData->pRing);
+      pDioData->pRing = NULL;
+   }
+
+   if(pDioData->state == running)
+   {
+      retVal = _PdDIOCosStop(pDioData->handle);
+      if (retVal < 0)
+         printf("DioQueue: _PdDIOCosStop error %d\n", retVal);
+         
+      pDioData->state = configured;
+   }
+
+   if(pDioData->state == configured)
+   {
+      _PdClearUserEvents(pDioData->handle, DigitalIn|EdgeDetect, eDInEvent);
+
+      retVal = _PdDIOReset(pDioData->handle);
+      if (retVal < 0)
+         printf("DioQueue: _PdDIOReset error %d\n", retVal);
+
+      pDioData->state = unconfigured;
+   }
+
+   if(pDioData->handle > 0 && pDioData->state == unconfigured)
+   {
+      retVal = PdAcquireSubsystem(pDioData->handle, DigitalIn, 0);
+      if (retVal < 0)
+         printf("DioQueue: PdReleaseSubsystem error %d\n", retVal);
+   }
+
+   pDioData->state = closed;
+}
+
+
+void SigInt(int signum)
+{
+   if(signum == SIGINT)
+   {
+      printf("CTRL+C detected, stopping acquisition\n");
+      G_DioData.abort = TRUE;
+   }
+}
+
+
+int main(int argc, char *argv[])
+{
+   PD_PARAMS params = {0, 1, {0}, 1000.0, 0, 4096};
+
+   ParseParameters(argc, argv, &params);
+
+   // initializes acquisition session parameters
+   G_DioData.board = params.board;
+   G_DioData.handle = 0;
+   G_DioData.port = 1;
+   G_DioData.lines = 0xFFFF;
+   G_DioData.abort = 0;
+   G_DioData.pRing = NULL;
+   G_DioData.state = closed;
+
+   signal(SIGINT, SigInt);
+
+   // setup exit handler that will clean-up the acquisition session
+   // if an error occurs
+   on_exit(DioQueueExitHandler, &G_DioData);
+
+   // initializes acquisition session
+   InitDioQueue(&G_DioData);
+
+   // run the acquisition
+   DioQueue(&G_DioData);
+
+   // Cleanup acquisition
+   CleanUpDioQueue(&G_DioData);
+
+   return 0;
+}
@@ -0,0 +1,126 @@
+/*****************************************************************************/
+/*                  DSP transmit register write benchmark                    */
+/*                                                                           */
+/*  This example compares the two ways the driver feeds the DSP transmit    */
+/*  data register (PCI_HTXR) against a stubbed register window in memory:  */
+/*  pd_dsp_write() for every word, which polls HSTR_HTRQ before each write, */
+/*  and pd_dsp_write_block(), which polls once and then streams the block.  */
+/*  It reports cycles per 1024-word AOut refill. No board is needed.        */
+/*                                                                           */
+/*  On a real board every status poll is a non-posted PCI read that stalls  */
+/*  the CPU, while the data writes are posted. Pass the read latency in ns  */
+/*  (e.g. 600) to add it to every stubbed status read.                      */
+/*                                                                           */
+/*  Usage: DspWriteBench [status read latency, ns]                           */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+/*      Copyright (C) 2001 United Electronic Industries, Inc.                */
+/*      All rights reserved.                                                 */
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+#include "pdpcidef.h"
+
+#define REFILL_WORDS  1024
+#define NB_PASSES     2000
+
+typedef uint32_t u32;
+
+static volatile u32 regs[0x40/4];     /* stubbed register window */
+static long readLatencyNs;
+static u32 statusReads;
+
+static uint64_t now_ns(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t cycles(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+   return __rdtsc();
+#else
+   return now_ns();
+#endif
+}
+
+static u32 get_status(void)
+{
+   statusReads++;
+   if (readLatencyNs)
+   {
+      uint64_t end = now_ns() + readLatencyNs;
+      while (now_ns() < end) { }
+   }
+   return regs[PCI_HSTR/4];
+}
+
+/* pd_dsp_write(): status check before every word */
+static void write_per_word(const u32 *buf, u32 count)
+{
+   u32 i;
+
+   for (i = 0; i < count; i++)
+   {
+      while (!(get_status() & (1 << HSTR_HTRQ))) { }
+      regs[PCI_HTXR/4] = buf[i];
+   }
+}
+
+/* pd_dsp_write_block(): one status check, then the block */
+static void write_block(const u32 *buf, u32 count)
+{
+   u32 i;
+
+   while (!(get_status() & (1 << HSTR_HTRQ))) { }
+   for (i = 0; i < count; i++)
+      regs[PCI_HTXR/4] = buf[i];
+}
+
+static double bench(void (*fn)(const u32*, u32), const u32 *buf, u32 *pReads)
+{
+   uint64_t start;
+   u32 i, passes = readLatencyNs ? NB_PASSES / 100 : NB_PASSES;
+
+   statusReads = 0;
+   start = cycles();
+   for (i = 0; i < passes; i++)
+      fn(buf, REFILL_WORDS);
+   *pReads = statusReads / passes;
+   return (double)(cycles() - start) / passes;
+}
+
+int main(int argc, char *argv[])
+{
+   u32 buf[REFILL_WORDS];
+   u32 i, readsWord, readsBlock;
+   double cWord, cBlock;
+
+   readLatencyNs = (argc > 1) ? atol(argv[1]) : 0;
+
+   for (i = 0; i < REFILL_WORDS; i++)
+      buf[i] = i * 0x10001;
+   regs[PCI_HSTR/4] = 1 << HSTR_HTRQ;   /* transmitter always ready */
+
+   cWord = bench(write_per_word, buf, &readsWord);
+   cBlock = bench(write_block, buf, &readsBlock);
+
+   printf("DspWriteBench: %d-word refill, status read latency %ld ns\n",
+          REFILL_WORDS, readLatencyNs);
+   printf("  per-word check : %10.0f cycles, %4u status reads\n", cWord, readsWord);
+   printf("  block write    : %10.0f cycles, %4u status reads\n", cBlock, readsBlock);
+   printf("  speedup        : x%.1f\n", cWord / cBlock);
+
+   return 0;
+}
@@ -3,6 +3,12 @@
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "win_sdk_types.h"
+#include "powerdaq.h"
+#include "pdgroup.h"
+#include "pdrecord.h"
 #include "gnuplot.h"
 #include "StreamFile.h"
 
@@ -36,6 +42,94 @@ int getSsIndex(unsigned short id)
 }
 
 
+// Reads a file written by the recorder (pdrecord.h) from the second
+// start, for length seconds (0: up to the end). Short ranges are plotted
+// sample by sample, long ones as the min and max of each channel over
+// PLOT_POINTS slices, taken from the overview of the recording.
+#define PLOT_POINTS 1000
+
+int ReadRecordFile(const char *fileName, double start, double length, FILE *gnuplot)
+{
+   PD_REC_FILE *pFile;
+   PD_REC_HEADER *pHdr;
+   unsigned long long first, numScans, total;
+   double *buffer, *pMin, *pMax;
+   DWORD b, p, c, numRet;
+   int ret;
+
+   ret = _PdRecFileOpen(fileName, &pFile);
+   if(ret < 0)
+   {
+      fprintf(stderr, "Error opening recording %s: %s\n", fileName, strerror(-ret));
+      return -1;
+   }
+
+   pHdr = _PdRecFileGetHeader(pFile);
+   total = _PdRecFileGetScans(pFile);
+
+   printf("Subsystem type = AnalogInput (raw)\n");
+   printf("Number of boards = %d\n", pHdr->nbBoards);
+   printf("Number of channels = %d\n", pHdr->totalChannels);
+   printf("Number of scans Per Block = %d\n", pHdr->blockScans);
+   printf("Scan rate = %f\n", pHdr->scanRate);
+   printf("Total number of scans = %llu%s\n", total, 
+          (pHdr->nbBlocks) ? "" : " (recording not closed)");
+   if(pHdr->error)
+      printf("Recording ended on error: %s\n", strerror(pHdr->error));
+   for(b=0; b<pHdr->nbBoards; b++)
+   {
+      printf("Board %d: serial %.20s, %d channels\n", pHdr->boards[b].board,
+             pHdr->boards[b].serialNumber, pHdr->boards[b].nbChannels);
+   }
+
+   first = (unsigned long long)(start * pHdr->scanRate);
+   numScans = (length > 0) ? (unsigned long long)(length * pHdr->scanRate) : total;
+   if(first >= total)
+   {
+      fprintf(stderr, "The recording is only %f s long\n", total / pHdr->scanRate);
+      _PdRecFileClose(pFile);
+      return -1;
+   }
+   if(numScans > total - first)
+      numScans = total - first;
+
+   if(numScans <= PLOT_POINTS * 4)
+   {
+      buffer = (double*)malloc(numScans * pHdr->totalChannels * sizeof(double));
+      _PdRecFileReadVolts(pFile, first, (DWORD)numScans, buffer, &numRet);
+      GnuPlot(gnuplot, first / pHdr->scanRate, 1.0/pHdr->scanRate, buffer,
+              pHdr->totalChannels, numRet);
+   }
+   else
+   {
+      // min of every channel, then max of every channel, for each slice
+      buffer = (double*)malloc(PLOT_POINTS * pHdr->totalChannels * 2 * sizeof(double));
+      pMin = (double*)malloc(PLOT_POINTS * pHdr->totalChannels * sizeof(double));
+      pMax = (double*)malloc(PLOT_POINTS * pHdr->totalChannels * sizeof(double));
+      ret = _PdRecFileGetMinMax(pFile, first, numScans, PLOT_POINTS, pMin, pMax);
+      if(ret < 0)
+         fprintf(stderr, "Error reading the overview: %s\n", strerror(-ret));
+
+      for(p=0; p<PLOT_POINTS; p++)
+      {
+         for(c=0; c<pHdr->totalChannels; c++)
+         {
+            buffer[(p*2)*pHdr->totalChannels + c] = pMin[p*pHdr->totalChannels + c];
+            buffer[(p*2+1)*pHdr->totalChannels + c] = pMax[p*pHdr->totalChannels + c];
+         }
+      }
+      GnuPlot(gnuplot, first / pHdr->scanRate, numScans / pHdr->scanRate / (PLOT_POINTS*2), 
+              buffer, pHdr->totalChannels, PLOT_POINTS*2);
+      free(pMin);
+      free(pMax);
+   }
+
+   free(buffer);
+   _PdRecFileClose(pFile);
+   return 0;
+}
+
+
 int main(int argc, char *argv[])
 {
    char s[256];
@@ -45,10 +139,11 @@ int main(int argc, char *argv[])
    double *buffer;
    int numScans, fileSize;
    int k=0;
+   DWORD magic = 0;
 
    if(argc < 2)
    {
-      printf("Usage: ReadStreamFile <stream file name>\n");
+      printf("Usage: ReadStreamFile <stream file name> [start (s) [length (s)]]\n");
       exit(EXIT_FAILURE);
    }
 
@@ -64,6 +159,24 @@ int main(int argc, char *argv[])
    fileSize = ftell (fp);
    rewind (fp);
 
+   // files written by the recorder start with a magic number
+   if((fread(&magic, sizeof(magic), 1, fp) == 1) && (magic == PD_REC_MAGIC))
+   {
+      rewind(fp);
+      gnuplot=GnuPlotOpen();
+      if(!gnuplot) 
+      {
+         fprintf(stderr, "Could not start Gnuplot: %s\n",  strerror(errno));
+         exit(EXIT_FAILURE);
+      }
+      fclose(fp);
+      if(ReadRecordFile(argv[1], (argc > 2) ? atof(argv[2]) : 0.0, 
+                        (argc > 3) ? atof(argv[3]) : 0.0, gnuplot) < 0)
+         exit(EXIT_FAILURE);
+      goto done;
+   }
+   rewind(fp);
+
    if(fread(&hdr, sizeof(tStreamFileHeader), 1, fp) < 1)
    {
       fprintf(stderr, "Error reading data: %s\n", strerror(errno));
@@ -107,6 +220,7 @@ int main(int argc, char *argv[])
    free(buffer);
    fclose(fp);
 
+done:
    fprintf(stderr,"Press enter to continue program.\n");
    fgets(s,256,stdin);
    while(strcmp(s,"\n")!=0) 
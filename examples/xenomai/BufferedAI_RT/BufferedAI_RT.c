@@ -0,0 +1,398 @@
+/*****************************************************************************/
+/*                 Real-time buffered analog input example                   */
+/*                                                                           */
+/*  This example shows how to stream analog input from a Xenomai task       */
+/*  with rt_dev_read(). The DAQ buffer is registered without mapping it and  */
+/*  the task drains it frame by frame in primary mode. The frames are read   */
+/*  three ways: blocking in rt_dev_read(), after _PdWaitForEvent() and      */
+/*  after _PdWaitForEvents().                                                */
+/*                                                                           */
+/*  The number of switches to secondary mode is counted once the            */
+/*  acquisition runs. The example fails if there was any: a steady state    */
+/*  acquisition must not leave primary mode.                                 */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+/*      Copyright (C) 2005 United Electronic Industries, Inc.                */
+/*      All rights reserved.                                                 */
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+
+#include <native/task.h>
+#include <native/timer.h>
+#include <rtdm/rtdm.h>
+
+#include "win_sdk_types.h"
+#include "powerdaq.h"
+#include "powerdaq32.h"
+
+#include "ParseParams.h"
+
+#define errorChk(functionCall) {int error; if((error=functionCall)<0) { \
+	                           fprintf(stderr, "Error %d at line %d in function call %s\n", error, __LINE__, #functionCall); \
+	                           exit(EXIT_FAILURE);}}
+
+#define NB_OF_FRAMES    8
+
+typedef enum _state
+{
+   closed,
+   unconfigured,
+   configured,
+   running
+} tState;
+
+typedef struct _rtAiData
+{
+   int board;                    // board number to be used for the AI operation
+   int handle;                   // board handle
+   int nbOfChannels;             // number of channels
+   int nbOfScansPerFrame;        // number of scans read at once
+   int nbOfFrames;               // number of frames to acquire
+   unsigned int channelList[64];
+   double scanRate;              // sampling frequency on each channel
+   int polarity;                 // AIN_UNIPOLAR or AIN_BIPOLAR
+   int range;                    // AIN_RANGE_5V or AIN_RANGE_10V
+   int inputMode;                // AIN_SINGLE_ENDED or AIN_DIFFERENTIAL
+   tState state;                 // state of the acquisition session
+   int bAbort;
+   unsigned short* rawData;
+   int modeSwitches;             // switches to secondary mode while acquiring
+   int warnSwitches;             // SIGXCPU received while acquiring
+   int result;
+   RT_TASK task;
+   sem_t stopEvent;
+} tRtAiData;
+
+
+void CleanUpRtAI(tRtAiData *pAiData);
+
+static tRtAiData G_AiData;
+
+// exit handler
+void RtAIExitHandler(int status, void *arg)
+{
+   CleanUpRtAI((tRtAiData *)arg);
+}
+
+// Xenomai sends SIGXCPU to a T_WARNSW task that switches to secondary mode
+void WarnSwitchHandler(int signum)
+{
+   G_AiData.warnSwitches++;
+}
+
+int InitRtAI(tRtAiData *pAiData)
+{
+   DWORD aiCfg, divider;
+
+   pAiData->handle = PdAcquireSubsystem(pAiData->board, AnalogIn, 1);
+   if(pAiData->handle < 0)
+   {
+      printf("BufferedAI_RT: PdAcquireSubsystem failed\n");
+      exit(EXIT_FAILURE);
+   }
+
+   pAiData->state = unconfigured;
+
+   errorChk(_PdAInReset(pAiData->handle));
+
+   // RTDM devices can't be mmaped, the buffer is only read with rt_dev_read()
+   errorChk(_PdRegisterBuffer(pAiData->handle, NULL, AnalogIn, NB_OF_FRAMES,
+                              pAiData->nbOfScansPerFrame, pAiData->nbOfChannels,
+                              BUF_BUFFERWRAPPED));
+
+   // setup the board to use hardware internal clock
+   aiCfg = AIB_CLSTART0 | AIB_CVSTART1 | AIB_CVSTART0 | pAiData->range | pAiData->inputMode |
+           AIB_INTCVSBASE | AIB_INTCLSBASE | pAiData->polarity;
+
+   // set clock divider, assuming that we use the 33MHz timebase
+   divider = (33000000.0 / pAiData->scanRate)-1;
+
+   errorChk(_PdAInAsyncInit(pAiData->handle, aiCfg, 0, 0, divider, divider,
+                            eFrameDone | eBufferError | eStopped,
+                            pAiData->nbOfChannels, pAiData->channelList));
+
+   pAiData->state = configured;
+
+   return 0;
+}
+
+void CleanUpRtAI(tRtAiData *pAiData)
+{
+   if(pAiData->state == running)
+   {
+      errorChk(_PdAInAsyncStop(pAiData->handle));
+      pAiData->state = configured;
+   }
+
+   if(pAiData->state == configured)
+   {
+      errorChk(_PdAInAsyncTerm(pAiData->handle));
+      errorChk(_PdUnregisterBuffer(pAiData->handle, NULL, AnalogIn));
+      pAiData->state = unconfigured;
+   }
+
+   if(pAiData->handle >= 0 && pAiData->state == unconfigured)
+   {
+      errorChk(PdAcquireSubsystem(pAiData->handle, AnalogIn, 0));
+   }
+
+   pAiData->state = closed;
+}
+
+static int ModeSwitches(void)
+{
+   RT_TASK_INFO info;
+
+   rt_task_inquire(NULL, &info);
+   return info.modeswitches;
+}
+
+// no printf() in the loops below, it would switch to secondary mode
+
+// rt_dev_read() sleeps until a frame is available
+int ReadLoop(tRtAiData *pAiData, int nbFrames, int frameBytes)
+{
+   ssize_t ret;
+   int frames;
+
+   for (frames = 0; frames < nbFrames && !pAiData->bAbort; frames++)
+   {
+      ret = rt_dev_read(pAiData->handle, pAiData->rawData, frameBytes);
+      if (ret <= 0)
+         return (ret < 0) ? (int)ret : -EPIPE;
+   }
+
+   return 0;
+}
+
+// events are set again before each wait, _PdWaitForEvent() sleeps
+int WaitEventLoop(tRtAiData *pAiData, int nbFrames, int frameBytes)
+{
+   ssize_t ret;
+   int events, frames;
+
+   for (frames = 0; frames < nbFrames && !pAiData->bAbort; frames++)
+   {
+      ret = _PdSetUserEvents(pAiData->handle, AnalogIn, eFrameDone | eBufferError | eStopped);
+      if (ret < 0)
+         return (int)ret;
+
+      events = _PdWaitForEvent(pAiData->handle, eFrameDone | eBufferError | eStopped, 1000);
+      if (events < 0)
+         return events;
+      if (events & (eBufferError | eStopped))
+         return -EPIPE;
+
+      ret = rt_dev_read(pAiData->handle, pAiData->rawData, frameBytes);
+      if (ret <= 0)
+         return (ret < 0) ? (int)ret : -EPIPE;
+   }
+
+   return 0;
+}
+
+// events stay subscribed, _PdWaitForEvents() returns those notified since
+// the last call
+int WaitEventsLoop(tRtAiData *pAiData, int nbFrames, int frameBytes)
+{
+   DWORD counts[PD_EVENT_COUNTERS];
+   ssize_t ret;
+   int events, frames = 0;
+
+   ret = _PdSubscribeUserEvents(pAiData->handle, AnalogIn, eFrameDone | eBufferError | eStopped);
+   if (ret < 0)
+      return (int)ret;
+
+   while (frames < nbFrames && !pAiData->bAbort)
+   {
+      events = _PdWaitForEvents(pAiData->handle, eFrameDone | eBufferError | eStopped, 1000, counts);
+      if (events < 0)
+         return events;
+      if (events & (eBufferError | eStopped))
+         return -EPIPE;
+      if (events & eTimeout)
+         return -ETIMEDOUT;
+
+      ret = rt_dev_read(pAiData->handle, pAiData->rawData, frameBytes);
+      if (ret <= 0)
+         return (ret < 0) ? (int)ret : -EPIPE;
+
+      frames++;
+   }
+
+   return _PdClearUserEvents(pAiData->handle, AnalogIn, eFrameDone | eBufferError | eStopped);
+}
+
+typedef int (*tLoopProc)(tRtAiData *pAiData, int nbFrames, int frameBytes);
+
+void RtAiProc(void *arg)
+{
+   tRtAiData *pAiData = (tRtAiData*)arg;
+   static const char *loopNames[] = {"rt_dev_read", "_PdWaitForEvent", "_PdWaitForEvents"};
+   static const tLoopProc loops[] = {ReadLoop, WaitEventLoop, WaitEventsLoop};
+   int frameBytes = pAiData->nbOfScansPerFrame * pAiData->nbOfChannels * sizeof(unsigned short);
+   int switches[3];
+   int i, start, done = 0;
+   int error;
+   ssize_t ret;
+   RTIME time[3];
+
+   pAiData->result = EXIT_FAILURE;
+
+   // setup runs in secondary mode, it allocates the DAQ buffer
+   InitRtAI(pAiData);
+
+   errorChk(_PdAInAsyncStart(pAiData->handle));
+   pAiData->state = running;
+
+   // switch to primary mode and get SIGXCPU if we ever leave it
+   ret = rt_task_set_mode(0, T_PRIMARY | T_WARNSW, NULL);
+   if (ret)
+   {
+      printf("error while rt_task_set_mode, code %d\n", (int)ret);
+      sem_post(&pAiData->stopEvent);
+      return;
+   }
+
+   // steady state starts with the first frame
+   error = ReadLoop(pAiData, 1, frameBytes);
+   pAiData->warnSwitches = 0;
+   pAiData->modeSwitches = 0;
+
+   for (i = 0; i < 3 && !error; i++)
+   {
+      start = ModeSwitches();
+      time[i] = rt_timer_read();
+      error = loops[i](pAiData, pAiData->nbOfFrames, frameBytes);
+      time[i] = rt_timer_read() - time[i];
+      switches[i] = ModeSwitches() - start;
+      pAiData->modeSwitches += switches[i];
+      if (!error)
+         done++;
+   }
+
+   rt_task_set_mode(T_WARNSW, 0, NULL);
+
+   for (i = 0; i < done; i++)
+   {
+      printf("%s: acquired %d frames of %d scans in %f ms, %d switches to secondary mode\n",
+             loopNames[i], pAiData->nbOfFrames, pAiData->nbOfScansPerFrame,
+             rt_timer_ticks2ns(time[i]) / 1000000.0, switches[i]);
+   }
+
+   if (error)
+      printf("%s loop failed, code %d (%s)\n", loopNames[done], error, strerror(-error));
+
+   printf("Switches to secondary mode while acquiring: %d (SIGXCPU: %d)\n",
+          pAiData->modeSwitches, pAiData->warnSwitches);
+
+   if (done == 3 && !pAiData->modeSwitches)
+      pAiData->result = EXIT_SUCCESS;
+
+   CleanUpRtAI(pAiData);
+
+   sem_post(&pAiData->stopEvent);
+}
+
+void SignalHandler(int signum)
+{
+   if(signum == SIGINT)
+   {
+      printf("CTRL+C detected, stopping acquisition\n");
+      G_AiData.bAbort = TRUE;
+   }
+   else if(signum == SIGTERM)
+   {
+      printf("Program is terminating\n");
+      G_AiData.bAbort = TRUE;
+   }
+}
+
+int main(int argc, char *argv[])
+{
+   int i, ret;
+   int gain = 0;
+   PD_PARAMS params = {0, 1, {0}, 1000.0, 0, 1000};
+
+   ParseParameters(argc, argv, &params);
+
+   // initializes acquisition session parameters
+   G_AiData.board = params.board;
+   G_AiData.nbOfChannels = params.numChannels;
+   for(i=0; i<params.numChannels; i++)
+       G_AiData.channelList[i] = params.channels[i] | (gain << 6);
+   G_AiData.handle = -1;
+   G_AiData.nbOfScansPerFrame = params.numSamplesPerChannel;
+   G_AiData.nbOfFrames = 100;
+   G_AiData.scanRate = params.frequency;
+   G_AiData.polarity = AIN_BIPOLAR;
+   G_AiData.range = AIN_RANGE_10V;
+   G_AiData.inputMode = AIN_SINGLE_ENDED;
+   G_AiData.state = closed;
+   G_AiData.bAbort = 0;
+
+   // setup exit handler that will clean-up the acquisition session
+   // if an error occurs
+   on_exit(RtAIExitHandler, &G_AiData);
+
+   signal(SIGTERM, SignalHandler);
+   signal(SIGINT, SignalHandler);
+   signal(SIGXCPU, WarnSwitchHandler);
+
+   // no memory-swapping for this programm, a page fault is a mode switch
+   mlockall(MCL_CURRENT | MCL_FUTURE);
+
+   G_AiData.rawData = (unsigned short *) malloc(G_AiData.nbOfChannels *
+                                                G_AiData.nbOfScansPerFrame *
+                                                sizeof(unsigned short));
+   if(G_AiData.rawData == NULL)
+   {
+      printf("BufferedAI_RT: could not allocate enough memory for the acquisition buffer\n");
+      exit(EXIT_FAILURE);
+   }
+
+   // touch the buffer so that it is mapped before the task reads into it
+   memset(G_AiData.rawData, 0, G_AiData.nbOfChannels * G_AiData.nbOfScansPerFrame *
+          sizeof(unsigned short));
+
+   ret = rt_task_create(&G_AiData.task, "RtAiTask", 0, T_HIPRIO, 0);
+   if (ret)
+   {
+      printf("failed to create task, code %d\n",ret);
+      exit(EXIT_FAILURE);
+   }
+
+   ret = sem_init(&G_AiData.stopEvent,0,0);
+   if (ret)
+   {
+      printf("failed to create semaphore, code %d\n",ret);
+      exit(EXIT_FAILURE);
+   }
+
+   ret = rt_task_start(&G_AiData.task, &RtAiProc, &G_AiData);
+   if (ret)
+   {
+      printf("failed to start task, code %d\n",ret);
+      exit(EXIT_FAILURE);
+   }
+
+   ret = sem_wait(&G_AiData.stopEvent);
+   if(ret)
+   {
+      printf("sem_wait failed with error %d\n", ret);
+   }
+
+   free(G_AiData.rawData);
+
+   return G_AiData.result;
+}
@@ -0,0 +1,37 @@
+//===========================================================================
+//
+// NAME:    pd_gap.h
+//
+// DESCRIPTION:
+//
+//          AIn overrun gap log kept by the driver for BUF_AUTORESTART
+//          buffers, see pdfw_lib/pdl_gap.c. Needs powerdaq.h (tGapInfo).
+//
+//          No kernel dependencies so pdl_gap.c can be built in user
+//          space (see examples/AInGapSim).
+//
+//---------------------------------------------------------------------------
+//      Copyright (C) 2000,2004 United Electronic Industries, Inc.
+//      All rights reserved.
+//---------------------------------------------------------------------------
+// For more informations on using and distributing this software, please see
+// the accompanying "LICENSE" file.
+//
+#ifndef __PD_GAP_H__
+#define __PD_GAP_H__
+
+#define PD_GAP_RATE_WINDOW  4000000000ULL   // ns, rate average halves past it
+
+typedef struct
+{
+    u32   Num;                      // gaps recorded since async init
+    tGapInfo Gap[PD_GAP_LOG_SIZE];  // gap n is in Gap[n % PD_GAP_LOG_SIZE]
+
+    // value rate, measured between transfers from the FIFO
+    u64   RefTime;                  // last transfer (or start) time, ns
+    u32   bRefXfer;                 // RefTime is a transfer, not a start
+    u64   RateValues;               // values transferred ...
+    u64   RateNs;                   // ... in that time
+} TGapLog;
+
+#endif /* __PD_GAP_H__ */
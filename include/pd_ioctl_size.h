@@ -0,0 +1,149 @@
+//===========================================================================
+//
+// NAME:    pd_ioctl_size.h
+//
+// DESCRIPTION:
+//
+//          Size of the part of tCmd that each command uses. The library
+//          sends it in the v2 ioctl codes, the driver checks that a v2
+//          command carries at least that much.
+//
+//---------------------------------------------------------------------------
+//      Copyright (C) 2000,2004 United Electronic Industries, Inc.
+//      All rights reserved.
+//---------------------------------------------------------------------------
+// For more informations on using and distributing this software, please see
+// the accompanying "LICENSE" file.
+//
+#ifndef __PD_IOCTL_SIZE_H__
+#define __PD_IOCTL_SIZE_H__
+
+//+
+// static inline u32 pd_ioctl_size(u32 code, tCmd* pCmd)
+// Returns the size of the part of tCmd that a command uses
+//
+// Arguments:  u32 code -- IOCTL_PWRDAQ_xxx
+//             tCmd* pCmd -- argument, for the sizes that depend on it
+//
+// Returns: size in bytes, sizeof(tCmd) for the commands not listed
+//-
+static inline u32 pd_ioctl_size(u32 code, tCmd* pCmd)
+{
+    u32 n;
+
+    switch (code)
+    {
+    case IOCTL_PWRDAQ_GET_NUMBER_ADAPTER:
+    case IOCTL_PWRDAQ_PRIVATE_CLR_EVENT:
+    case IOCTL_PWRDAQ_BRDENABLEINTERRUPT:
+    case IOCTL_PWRDAQ_SET_BH_CPU:
+    case IOCTL_PWRDAQ_BRDSETEVNTS1:
+    case IOCTL_PWRDAQ_BRDSETEVNTS2:
+    case IOCTL_PWRDAQ_GETADCFIFOSIZE:
+    case IOCTL_PWRDAQ_AISETCVCLK:
+    case IOCTL_PWRDAQ_AISETCLCLK:
+    case IOCTL_PWRDAQ_AISETEVNT:
+    case IOCTL_PWRDAQ_AISTATUS:
+    case IOCTL_PWRDAQ_AICVEN:
+    case IOCTL_PWRDAQ_AIGETVALUE:
+    case IOCTL_PWRDAQ_AIGETSAMPLECOUNT:
+    case IOCTL_PWRDAQ_AISETXFERSIZE:
+    case IOCTL_PWRDAQ_AOSETCVCLK:
+    case IOCTL_PWRDAQ_AOSETEVNT:
+    case IOCTL_PWRDAQ_AOSTATUS:
+    case IOCTL_PWRDAQ_AOCVEN:
+    case IOCTL_PWRDAQ_AOPUTVALUE:
+    case IOCTL_PWRDAQ_DISETCFG:
+    case IOCTL_PWRDAQ_DISTATUS:
+    case IOCTL_PWRDAQ_DIREAD:
+    case IOCTL_PWRDAQ_DOWRITE:
+    case IOCTL_PWRDAQ_DIO256INTRREENABLE:
+    case IOCTL_PWRDAQ_DIO256COSSTART:
+    case IOCTL_PWRDAQ_DIO256COSSTOP:
+    case IOCTL_PWRDAQ_UCTSETCFG:
+    case IOCTL_PWRDAQ_UCTSTATUS:
+    case IOCTL_PWRDAQ_UCTWRITE:
+    case IOCTL_PWRDAQ_UCTSWGATE:
+    case IOCTL_PWRDAQ_CALDACWRITE:
+        return sizeof(u32);
+
+    case IOCTL_PWRDAQ_PRIVATE_SET_EVENT:
+    case IOCTL_PWRDAQ_UNREGISTER_BUFFER:
+    case IOCTL_PWRDAQ_GETKERNELBUFSIZE:
+    case IOCTL_PWRDAQ_SET_USER_EVENTS:
+    case IOCTL_PWRDAQ_CLEAR_USER_EVENTS:
+    case IOCTL_PWRDAQ_GET_USER_EVENTS:
+    case IOCTL_PWRDAQ_SUBSCRIBE_EVENTS:
+    case IOCTL_PWRDAQ_BRDREGWR:
+    case IOCTL_PWRDAQ_BRDREGRD:
+    case IOCTL_PWRDAQ_AOSETCFG:
+    case IOCTL_PWRDAQ_DIO256CMDWR:
+    case IOCTL_PWRDAQ_DIO256CMDRD:
+    case IOCTL_PWRDAQ_UCTREAD:
+    case IOCTL_PWRDAQ_MEASURE_LATENCY:
+        return 2 * sizeof(u32);
+
+    case IOCTL_PWRDAQ_AISETCFG:
+    case IOCTL_PWRDAQ_DIODMASET:
+    case IOCTL_PWRDAQ_AODMASET:
+        return 3 * sizeof(u32);
+
+    case IOCTL_PWRDAQ_BATCH:
+    case IOCTL_PWRDAQ_DIO256CMDWR_ALL:
+    case IOCTL_PWRDAQ_DIO256CMDRD_ALL:
+        return 4 * sizeof(u32);
+
+    case IOCTL_PWRDAQ_REGISTER_BUFFER:
+        return 5 * sizeof(u32);
+
+    case IOCTL_PWRDAQ_OPENSUBSYSTEM:
+    case IOCTL_PWRDAQ_CLOSESUBSYSTEM:
+        return sizeof(tAcqSS);
+
+    case IOCTL_PWRDAQ_PRIVATE_GETCFG:
+        return sizeof(PD_PCI_CONFIG);
+
+    case IOCTL_PWRDAQ_BRDSTATUS:
+        return sizeof(tEvents);
+
+    case IOCTL_PWRDAQ_GET_DAQBUF_SCANS:
+    case IOCTL_PWRDAQ_RELEASE_DAQBUF_SCANS:
+        return sizeof(tScanInfo);
+
+    case IOCTL_PWRDAQ_AIN_GET_GAPS:
+        return sizeof(tGapQuery);
+
+    case IOCTL_PWRDAQ_WAIT_EVENTS:
+        return sizeof(tEventWait);
+
+    case IOCTL_PWRDAQ_BRDEEPROMREAD:
+    case IOCTL_PWRDAQ_BRDEEPROMWRITE:
+        return sizeof(tEepromAcc);
+
+    // channel lists: the entries used only
+    case IOCTL_PWRDAQ_AISETCHLIST:
+        n = (pCmd->SyncCfg.dwChListSize < PD_MAX_CL_SIZE) ? pCmd->SyncCfg.dwChListSize : PD_MAX_CL_SIZE;
+        return offsetof(tSyncCfg, dwChList) + n * sizeof(u32);
+
+    case IOCTL_PWRDAQ_AIN_ASYNC_INIT:
+    case IOCTL_PWRDAQ_AO_ASYNC_INIT:
+        n = (pCmd->AsyncCfg.dwChListSize < PD_MAX_CL_SIZE) ? pCmd->AsyncCfg.dwChListSize : PD_MAX_CL_SIZE;
+        return offsetof(tAsyncCfg, dwChList) + n * sizeof(u32);
+
+    // buffers: bufParam.size bytes are read or written
+    case IOCTL_PWRDAQ_AIGETSAMPLES:
+    case IOCTL_PWRDAQ_AIGETXFERSAMPLES:
+    case IOCTL_PWRDAQ_AOPUTBLOCK:
+    case IOCTL_PWRDAQ_DIO256SETINTRMASK:
+    case IOCTL_PWRDAQ_DIO256GETINTRDATA:
+    case IOCTL_PWRDAQ_GETSERIALNUMBER:
+    case IOCTL_PWRDAQ_GETMANFCTRDATE:
+    case IOCTL_PWRDAQ_GETCALIBRATIONDATE:
+        n = (pCmd->bufParam.size < PD_MAX_BUFFER_SIZE) ? pCmd->bufParam.size : PD_MAX_BUFFER_SIZE;
+        return offsetof(tBuffer, buffer) + n;
+    }
+
+    return sizeof(tCmd);
+}
+
+#endif
@@ -0,0 +1,60 @@
+/*===========================================================================*/
+/*                                                                           */
+/* NAME:    pdfw_bin.h                                                       */
+/*                                                                           */
+/*                                                                           */
+/* DESCRIPTION:                                                              */
+/*                                                                           */
+/*          Binary DSP firmware image loaded with request_firmware().        */
+/*          tools/FwBin generates the images from the built-in tables.       */
+/*                                                                           */
+/*          All fields are little-endian 32-bit words:                       */
+/*                                                                           */
+/*            PD_FW_HEADER                                                   */
+/*            NumSegs x { PD_FW_SEGHEADER, MemSize data words }              */
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+/*      Copyright (C) 2000,2004 United Electronic Industries, Inc.           */
+/*      All rights reserved.                                                 */
+/*---------------------------------------------------------------------------*/
+/* For more informations on using and distributing this software, please see */
+/* the accompanying "LICENSE" file.                                          */
+/*===========================================================================*/
+
+#ifndef _INC_PDFW_BIN
+#define _INC_PDFW_BIN
+
+#define PD_FW_MAGIC     0x57464450  /* "PDFW"*/
+#define PD_FW_VERSION   1
+#define PD_FW_MAXSEGS   64          /* most segments in one image*/
+#define PD_FW_MAXWORDS  2048        /* most data words in one segment*/
+
+/* firmware families, one image each*/
+#define PD_FW_MAIN      0           /* common firmware (USECOMMONFW)*/
+#define PD_FW_MF        1           /* PD2-MF(S), PDXI-MF(S)*/
+#define PD_FW_AO        2           /* PD2-AO*/
+#define PD_FW_DIO       3           /* PD2-DIO*/
+#define PD_FW_LAB       4           /* PD-LAB-MF*/
+#define PD_FW_FAMILIES  5
+
+/* file names under /lib/firmware, in family order*/
+#define PD_FW_FILES { "pwrdaq/pdfw_main.bin", "pwrdaq/pdfw_mf.bin", \
+                      "pwrdaq/pdfw_ao.bin", "pwrdaq/pdfw_dio.bin", \
+                      "pwrdaq/pdfw_lab.bin" }
+
+typedef struct
+{
+    DWORD Magic;                    /* PD_FW_MAGIC*/
+    DWORD Version;                  /* PD_FW_VERSION*/
+    DWORD ExecAdrs;                 /* address to start execution*/
+    DWORD NumSegs;                  /* number of segments following*/
+} PD_FW_HEADER;
+
+typedef struct
+{
+    DWORD MemType;                  /* 1..3, DSP memory space to load*/
+    DWORD MemAdrs;                  /* DSP load address*/
+    DWORD MemSize;                  /* number of data words following*/
+} PD_FW_SEGHEADER;
+
+#endif /* _INC_PDFW_BIN */
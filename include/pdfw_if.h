@@ -27,7 +27,13 @@ void pd_dsp_set_flags(int board, u32 new_flags);
 void pd_dsp_command(int board, int command);
 void pd_dsp_cmd_no_ret(int board, u16 command);
 void pd_dsp_write(int board, u32 data);
+int pd_dsp_write_block(int board, const u32* buffer, u32 count);
 u32 pd_dsp_read(int board);
+int pd_dsp_read_block(int board, u16* buffer, u32 count);
+int pd_dsp_read_block_term(int board, u16* buffer, u32 max_words, u32* words);
+int pd_dsp_read_block_split(int board, u16* buf1, u32 len1, u16* buf2, u32 count);
+int pd_dsp_read_block_term_split(int board, u16* buf1, u32 len1, u16* buf2, 
+                                 u32 max_words, u32* words);
 u32 pd_dsp_cmd_ret_ack(int board, u16 wCmd);
 u32 pd_dsp_cmd_ret_value(int board, u16 wCmd);
 u32 pd_dsp_read_ack(int board);
@@ -58,12 +64,15 @@ int pd_ain_set_enable_conversion(int board, int enable);
 int pd_ain_get_value(int board, u16* value);
 int pd_ain_set_ssh_gain(int board, u32 dwCfg);
 int pd_ain_get_samples(int board, int max_samples, u16* buffer, u32* samples);
+int pd_ain_get_samples_split(int board, int max_samples, u16* buf1, u32 len1, 
+                             u16* buf2, u32* samples);
 int pd_ain_reset(int board);
 int pd_ain_sw_cl_start(int board);
 int pd_ain_sw_cv_start(int board);
 int pd_ain_reset_cl(int board);
 int pd_ain_clear_data(int board);
 int pd_ain_flush_fifo(int board, int from_isr);
+int pd_ain_flush_fifo_split(int board, int from_isr, u16* pwSeg1, u32 dwSeg1, u16* pwSeg2);
 int pd_ain_get_xfer_samples(int board, u16* buffer);
 int pd_ain_set_xfer_size(int board, u32 size);
 int pd_ain_get_BM_ctr(int board, u32 dwCh, u32* pBurstCtr, u32* pFrameCtr);
@@ -82,6 +91,8 @@ int pd_ain_async_start(int board);
 int pd_ain_async_stop(int board);
 int pd_ain_async_retrieve(int board);
 int pd_ain_get_scans(int board, tScanInfo* pScanInfo);
+int pd_ain_release_scans(int board, u32 ScanIndex);
+int pd_ain_get_gaps(int board, tGapQuery* pQuery);
 int pd_aout_async_init(int board, tAsyncCfg* pAOutCfg);
 int pd_aout_async_term(int board);
 int pd_aout_async_start(int board);
@@ -90,6 +101,19 @@ int pd_aout_get_scans(int board, tScanInfo* pScanInfo);
 int pd_get_buf_status(int board, int subsystem, PTBuf_Info pDaqBuf);
 int pd_aout_dmaSet(int board, u32 offset, u32 count, u32 source);
 int pd_aout_put_xbuf(int board, u32 NumToCopy, u32 *UserBufCopied);
+u32 pd_aout_build_tags(u32 *pTags, const u32 *pChList, u32 dwChan);
+void pd_aopack_tag16(u32 *pDst, const u16 *pSrc, u32 dwNum, const u32 *pTags, u32 L, u32 dwPhase);
+void pd_aopack_tag32(u32 *pDst, const u32 *pSrc, u32 dwNum, const u32 *pTags, u32 L, u32 dwPhase);
+void pd_aopack_mfx16(u32 *pDst, const u16 *pSrc, u32 dwPairs);
+void pd_aopack_widen16(u32 *pDst, const u16 *pSrc, u32 dwNum);
+void pd_gap_reset(TGapLog *pLog);
+void pd_gap_start(TGapLog *pLog, u64 Now);
+void pd_gap_note_xfer(TGapLog *pLog, u32 Values, u64 Now);
+u32 pd_gap_lost_values(TGapLog *pLog, u64 Now, u32 MinValues);
+u32 pd_gap_lost_scans(u32 LostValues, u32 Trimmed, u32 ScanValues);
+u32 pd_gap_trim_scan(u32 *pHead, u32 *pCount, u32 ScanValues);
+u32 pd_gap_record(TGapLog *pLog, u32 Head, u32 WrapCount, u32 LostScans, u64 Now);
+u32 pd_gap_get(TGapLog *pLog, u32 FirstSeq, tGapInfo *pGap, u32 MaxGaps, u32 *pNumRet);
 
 
 // pdl_ao.c
@@ -122,6 +146,9 @@ int pd_dio_dmaSet(int board, u32 offset, u32 count, u32 source);
 int pd_dio256_setIntrMask(int board);
 int pd_dio256_getIntrData(int board);
 int pd_dio256_intrEnable(int board, u32 enable);
+int pd_dio256_cos_start(int board);
+int pd_dio256_cos_stop(int board);
+void pd_dio256_cos_log(int board, u64 Now);
 int pd_dio256_make_reg_mask(u32 bank, u32 regMask);
 u32 pd_dio256_make_cmd(u32 dwRegister);
 int pd_dio256_read_all(int board, u32* pdata);
@@ -165,6 +192,7 @@ int pd_uct_reset(int board);
 int pd_enable_events(int board, tEvents* pEvents);
 int pd_disable_events(int board, tEvents* pEvents);
 int pd_set_user_events(int board, u32 subsystem, u32 events);
+int pd_subscribe_user_events(int board, u32 subsystem, u32 events);
 int pd_clear_user_events(int board, u32 subsystem, u32 events);
 int pd_get_user_events(int board, u32 subsystem, u32* events);
 int pd_immediate_update(int board);
@@ -183,14 +211,21 @@ int pd_adapter_test_interrupt(int board);
 
 // pdl_int.c
 void pd_stop_and_disable_ain(int board);
+int pd_ain_overrun_restart(int board);
 void pd_process_pd_ain_get_samples(int board, int bFHFState);
 void pd_process_ain_move_samples(int board, u32 page, u32 numready);
+void pd_process_ain_move_values(int board, u32* pSrc, u32 numready, u64 now);
 void pd_stop_and_disable_aout(int board);
 void pd_process_pd_aout_put_samples(int board, int bFHFState);
 void pd_process_driver_events(int board, tEvents* pEvents);
 int pd_notify_user_events(int board, tEvents* pNewFwEvents);
 void pd_process_events(int board);
 
+// pdl_bmring.c
+void pd_bm_ring_reset(int board);
+int pd_bm_ring_isr(int board, u64 Now);
+u32 pd_bm_ring_drain(int board);
+
 // pdl_init.c
 void  pd_init_pd_board(int board);
 int pd_enum_devices(int board, char* board_name, int board_name_size, 
@@ -224,15 +259,28 @@ u32 pd_dspct_get_compare_addr(u32 dwCounter);
 int pd_register_user_isr(int board, TUser_isr user_isr, void* user_param);
 int pd_unregister_user_isr(int board);
 
-int pd_notify_event(int board, PD_SUBSYSTEM ss, int event);
+int pd_notify_event(int board, PD_SUBSYSTEM ss, int event, u32 frames, u32 data);
 int pd_sleep_on_event(int board, PD_SUBSYSTEM, int event, int timeoutms);
+int pd_wait_events(int board, PD_SUBSYSTEM ss, tEventWait* pWait);
 TSynchSS* pd_get_synch(int board, PD_SUBSYSTEM ss, int event);
 
 int pd_alloc_contig_memory(int board, tAllocContigMem *allocMemory); 
 void pd_dealloc_contig_memory(int board, tAllocContigMem *pDeallocMemory);
+int pd_bm_ring_alloc(int board, u32 Slots, u32 SlotValues);
+void pd_bm_ring_free(int board);
+int pd_dio256_cos_alloc(int board);
+void pd_dio256_cos_free(int board);
+void pd_dio256_cos_put(int board, u64 Now, u32* pIntData, u32* pEdgeData);
 
 unsigned int pd_readl(void *address);
 void pd_writel(unsigned int value, void *address);
+void pd_fw_cache_free(void);
+
+void pd_writel_rep32(void *address, const u32 *buf, u32 count);
+void pd_readl_rep16(void *address, u16 *buf, u32 count);
+u32 pd_readl_rep16_term(void *address, u16 *buf, u32 count, u32 term, int *pbTerm);
+void pd_daqbuf_ctrl_publish(PTBuf_Info pDaqBuf, u32 SubsysState, u32 Events);
+void pd_daqbuf_ctrl_stamp(PTBuf_Info pDaqBuf, u64 Now);
 
 pd_board_t* pd_get_board_object(int board);
 char* pd_get_board_name(int board);
@@ -0,0 +1,100 @@
+//=======================================================================
+//
+// NAME:    pdgroup.h
+//
+// SYNOPSIS:
+//
+//      Definitions for the synchronized multi-board AIn group
+//
+//
+// DESCRIPTION:
+//
+//      A group runs the AIn subsystem of several boards on one clock and
+//      one start, and serves them with a single consumer thread that
+//      delivers one interleaved, time-aligned stream: each scan of the
+//      stream is scan n of board 0, then scan n of board 1, ...
+//
+// NOTES:   See notice below.
+//
+//-----------------------------------------------------------------------
+//
+//      Copyright (C) 2004 United Electronic Industries, Inc.
+//      All rights reserved.
+//      United Electronic Industries Confidential Information.
+//
+//-----------------------------------------------------------------------
+
+#ifndef __PDGROUP_H__
+#define __PDGROUP_H__
+
+#define     PD_GROUP_MAX_BOARDS     16
+
+// how the boards share the scan (CL) clock, boards[0] is the master
+#define     PD_GROUP_SYNC_CABLE     0   // PD-CONN-SYNC cable, master clock
+#define     PD_GROUP_SYNC_PXI       1   // PXI trigger bus, master clock
+#define     PD_GROUP_SYNC_EXTCLOCK  2   // all boards on an external clock
+
+// group flags
+#define     PD_GROUP_STARTTRIG      0x1 // all boards wait for the external
+                                        // start trigger (rising edge)
+
+// errors reported by _PdGroupGetStatus, per board
+#define     PD_GROUP_ERR_NONE       0
+#define     PD_GROUP_ERR_OVERRUN    1   // DAQ buffer over run (eBufferError)
+#define     PD_GROUP_ERR_STOPPED    2   // acquisition stopped by the driver
+#define     PD_GROUP_ERR_SEQUENCE   3   // scans lost, frame sequence broken
+#define     PD_GROUP_ERR_SKEW       4   // board fell behind, no common clock?
+#define     PD_GROUP_ERR_TIMEOUT    5   // no data within the timeout
+#define     PD_GROUP_ERR_SYSTEM     6   // system call failed
+
+typedef struct _PD_GROUP_BOARD
+{
+    int     board;                  // board number
+    DWORD   nbChannels;             // channel list size
+    DWORD   channelList[64];
+    DWORD   aiCfg;                  // range, input mode, polarity: the
+                                    // clock and trigger bits are set by
+                                    // the group
+} PD_GROUP_BOARD;
+
+typedef struct _PD_GROUP_CONFIG
+{
+    int     nbBoards;
+    PD_GROUP_BOARD boards[PD_GROUP_MAX_BOARDS];
+    DWORD   syncMode;               // PD_GROUP_SYNC_xxx
+    DWORD   flags;                  // PD_GROUP_xxx
+    DWORD   clockLine;              // PXI: line carrying the scan clock
+    DWORD   trigLine;               // PXI: line carrying the start trigger
+    double  scanRate;               // master scan rate (internal clock)
+    DWORD   scansPerFrame;          // DAQ buffer frame size and largest
+                                    // block handed to the callback
+    DWORD   nbFrames;               // frames in each DAQ buffer
+    DWORD   timeoutms;              // longest wait for data, 0: none
+} PD_GROUP_CONFIG;
+
+typedef struct _PD_GROUP_STATUS
+{
+    unsigned long long scans;       // scans delivered per board
+    int     error;                  // PD_GROUP_ERR_xxx of the first error
+    int     errorBoard;             // group index of the board in error
+    unsigned long long boardScans[PD_GROUP_MAX_BOARDS]; // scans acquired
+} PD_GROUP_STATUS;
+
+// Called from the consumer thread with numScans interleaved scans, the
+// first one being scan firstScan since the start. The data is only
+// valid during the call. A last call with pScans NULL and numScans 0
+// tells that the stream ended on an error, see _PdGroupGetStatus.
+typedef void (*PD_GROUP_CALLBACK)(void* arg, WORD* pScans, DWORD numScans,
+                                  unsigned long long firstScan);
+
+typedef struct _PD_GROUP PD_GROUP;
+
+int _PdGroupCreate(PD_GROUP_CONFIG* pConfig, PD_GROUP** ppGroup);
+int _PdGroupStart(PD_GROUP* pGroup, PD_GROUP_CALLBACK callback, void* arg);
+int _PdGroupStop(PD_GROUP* pGroup);
+int _PdGroupGetStatus(PD_GROUP* pGroup, PD_GROUP_STATUS* pStatus);
+int _PdGroupGetConfig(PD_GROUP* pGroup, PD_GROUP_CONFIG* pConfig);
+tDaqBufCtrl* _PdGroupGetDaqBufCtrl(PD_GROUP* pGroup, int index);
+int _PdGroupDestroy(PD_GROUP* pGroup);
+
+#endif
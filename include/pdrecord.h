@@ -0,0 +1,164 @@
+//=======================================================================
+//
+// NAME:    pdrecord.h
+//
+// SYNOPSIS:
+//
+//      Definitions for the AIn stream recorder
+//
+//
+// DESCRIPTION:
+//
+//      The recorder writes the raw samples of a group (pdgroup.h) to a
+//      file, from its own thread. The file starts with a versioned
+//      header of PD_REC_HEADER_SIZE bytes, followed by blocks of
+//      blockBytes bytes: a PD_REC_BLOCK header, then numScans scans of
+//      totalChannels raw WORDs, then padding. Convert a sample of
+//      channel c of board b to volts with
+//
+//          ((raw & andMask) ^ xorMask) * scale[c] - offset[c]
+//
+//      All the structures are packed, little endian.
+//
+//      _PdRecFileXxx read a recording through a mapping, from any scan
+//      or host time, and give its min/max overview for plotting.
+//
+// NOTES:   See notice below.
+//
+//-----------------------------------------------------------------------
+//
+//      Copyright (C) 2004 United Electronic Industries, Inc.
+//      All rights reserved.
+//      United Electronic Industries Confidential Information.
+//
+//-----------------------------------------------------------------------
+
+#ifndef __PDRECORD_H__
+#define __PDRECORD_H__
+
+#define     PD_REC_MAGIC            0x43455250  // "PREC"
+#define     PD_REC_BLOCK_MAGIC      0x4B4C4250  // "PBLK"
+#define     PD_REC_VERSION          1
+
+#define     PD_REC_ALIGN            4096        // alignment of every write
+#define     PD_REC_HEADER_SIZE      32768       // first block starts here
+#define     PD_REC_BLOCK_HEADER_SIZE 512        // scans start here in a block
+#define     PD_REC_MAX_BOARDS       16
+#define     PD_REC_MAX_CHANNELS     64
+#define     PD_REC_MAX_BUFFERS      8
+
+// recorder flags
+#define     PD_REC_NODIRECT         0x1         // don't use O_DIRECT
+
+// min/max overview of a recording, saved next to it as <file>.ovw
+#define     PD_REC_OVW_MAGIC        0x57564F50  // "POVW"
+#define     PD_REC_OVW_VERSION      1
+#define     PD_REC_OVW_BASE         256         // scans per level 0 entry
+#define     PD_REC_OVW_FACTOR       16          // entries merged per level
+#define     PD_REC_OVW_MAX_LEVELS   16
+
+typedef struct _PD_REC_BOARD
+{
+    DWORD   board;                  // board number
+    DWORD   nbChannels;
+    DWORD   firstChannel;           // index of its first channel in a scan
+    DWORD   aiCfg;                  // AIn configuration (range, mode...)
+    char    serialNumber[20];
+    WORD    andMask;                // raw to volts, see above
+    WORD    xorMask;
+    DWORD   channelList[PD_REC_MAX_CHANNELS];   // with the gain bits
+    double  scale[PD_REC_MAX_CHANNELS];         // calibrated, gain applied
+    double  offset[PD_REC_MAX_CHANNELS];
+} __attribute__((packed)) PD_REC_BOARD;
+
+typedef struct _PD_REC_HEADER
+{
+    DWORD   magic;                  // PD_REC_MAGIC
+    DWORD   version;                // PD_REC_VERSION
+    DWORD   headerSize;             // PD_REC_HEADER_SIZE
+    DWORD   blockHeaderSize;        // PD_REC_BLOCK_HEADER_SIZE
+    DWORD   blockBytes;             // size of a block, header and padding included
+    DWORD   blockScans;             // scans in a full block
+    DWORD   sampleSize;             // bytes per sample
+    DWORD   nbBoards;
+    DWORD   totalChannels;          // channels in a scan, all boards
+    DWORD   syncMode;               // PD_GROUP_SYNC_xxx
+    DWORD   groupFlags;             // PD_GROUP_xxx
+    DWORD   nbBlocks;               // set when the file is closed
+    double  scanRate;               // scans per second
+    unsigned long long startTime;   // CLOCK_REALTIME ns at creation
+    unsigned long long totalScans;  // set when the file is closed
+    int     error;                  // errno of the first write error
+    DWORD   reserved;
+    PD_REC_BOARD boards[PD_REC_MAX_BOARDS];
+} __attribute__((packed)) PD_REC_HEADER;
+
+typedef struct _PD_REC_BLOCK
+{
+    DWORD   magic;                  // PD_REC_BLOCK_MAGIC
+    DWORD   seq;                    // block number, from 0
+    DWORD   numScans;               // scans in this block
+    DWORD   reserved;
+    unsigned long long firstScan;   // scan number of its first scan
+    unsigned long long hostTime;    // CLOCK_MONOTONIC ns, block filled
+    tFrameStamp stamps[PD_REC_MAX_BOARDS];  // last frame stamp of each
+                                            // board at that time, Seq is
+                                            // PD_FRAMESTAMP_INVALID if none
+} __attribute__((packed)) PD_REC_BLOCK;
+
+// The overview file holds nbLevels levels, level L has one entry per
+// PD_REC_OVW_BASE * PD_REC_OVW_FACTOR^L scans. An entry is a pair
+// (min, max) per channel of (raw & andMask) ^ xorMask, which is
+// monotonic in volts.
+typedef struct _PD_REC_OVW_HEADER
+{
+    DWORD   magic;                  // PD_REC_OVW_MAGIC
+    DWORD   version;                // PD_REC_OVW_VERSION
+    DWORD   baseScans;              // PD_REC_OVW_BASE
+    DWORD   factor;                 // PD_REC_OVW_FACTOR
+    DWORD   totalChannels;
+    DWORD   nbLevels;
+    unsigned long long startTime;   // of the recording, with totalScans
+    unsigned long long totalScans;  // tells if the overview is up to date
+    unsigned long long levelEntries[PD_REC_OVW_MAX_LEVELS];
+} __attribute__((packed)) PD_REC_OVW_HEADER;
+
+typedef struct _PD_REC_STATUS
+{
+    unsigned long long scans;       // scans written
+    DWORD   blocks;                 // blocks written
+    DWORD   stalls;                 // times the acquisition waited for the disk
+    DWORD   maxQueued;              // most blocks waiting to be written
+    DWORD   bDirect;                // O_DIRECT is used
+    int     error;                  // errno of the first write error, 0 if none
+} PD_REC_STATUS;
+
+typedef struct _PD_RECORDER PD_RECORDER;
+
+int _PdRecorderCreate(const char* fileName, PD_GROUP* pGroup, DWORD nbBuffers,
+                      DWORD flags, PD_RECORDER** ppRec);
+void _PdRecorderGroupCallback(void* arg, WORD* pScans, DWORD numScans,
+                              unsigned long long firstScan);
+int _PdRecorderWrite(PD_RECORDER* pRec, WORD* pScans, DWORD numScans);
+int _PdRecorderGetStatus(PD_RECORDER* pRec, PD_REC_STATUS* pStatus);
+int _PdRecorderClose(PD_RECORDER* pRec);
+
+// reading a recording, the file is mapped and can be read in any order
+typedef struct _PD_REC_FILE PD_REC_FILE;
+
+int _PdRecFileOpen(const char* fileName, PD_REC_FILE** ppFile);
+PD_REC_HEADER* _PdRecFileGetHeader(PD_REC_FILE* pFile);
+unsigned long long _PdRecFileGetScans(PD_REC_FILE* pFile);
+int _PdRecFileRead(PD_REC_FILE* pFile, unsigned long long firstScan, DWORD numScans,
+                   WORD* pScans, DWORD* pNumRet);
+int _PdRecFileReadVolts(PD_REC_FILE* pFile, unsigned long long firstScan, DWORD numScans,
+                        double* pVolts, DWORD* pNumRet);
+int _PdRecFileScanAtTime(PD_REC_FILE* pFile, unsigned long long hostTime,
+                         unsigned long long* pScan);
+int _PdRecFileLoadOverview(PD_REC_FILE* pFile);
+int _PdRecFileGetMinMax(PD_REC_FILE* pFile, unsigned long long firstScan,
+                        unsigned long long numScans, DWORD nbPoints,
+                        double* pMin, double* pMax);
+int _PdRecFileClose(PD_REC_FILE* pFile);
+
+#endif
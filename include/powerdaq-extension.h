@@ -34,6 +34,11 @@ struct _synchSS
 #elif defined(_PD_RTAI)
    CND event;
    SEM event_lock;
+#elif defined(_PD_XENOMAI)
+   rtdm_event_t event;         // waited on by RT callers
+   wait_queue_head_t wait_q;   // waited on by Linux callers, woken by the board's nrtSig
+   int bSignal;                // signal the event once the board lock is dropped
+   u64 signalTime;             // time of the last signal, for latWakeup
 #else
    spinlock_t lock;
    unsigned long lock_flags;
@@ -44,10 +49,12 @@ struct _synchSS
 #else
    wait_queue_head_t wait_q;
 #endif
+   u64 signalTime;             // time of the last signal, for latWakeup
 #endif // _PD_RTL
    PD_SUBSYSTEM subsystem;     // Id of the subsystem that owns this structure
    int wakeupEvents;           // Events that will wake-up the subsystem
    int notifiedEvents;         // Events that were received
+   u32 eventCount[PD_EVENT_COUNTERS]; // times each persistent event was received
 };
 
 // This extension is specific to RTLinux
@@ -66,6 +73,9 @@ typedef struct _board_extension
 #elif defined(_PD_XENOMAI)
    rtdm_mutex_t user_isr_lock;
    struct rtdm_device* rtdmdev[PD_MAX_SUBSYSTEMS];
+   struct _synchSS synch[PD_MAX_SUBSYSTEMS];  // synch objects, see pd_event_create
+   int synchCount;                            // synch objects handed out
+   rtdm_nrtsig_t nrtSig;                      // wakes the Linux waiters of the synch objects
 #endif
 } pd_board_ext_t;
 
@@ -74,6 +84,7 @@ typedef struct _pd_rtdm_ctx
 {
    int board;
    PD_SUBSYSTEM ss;
+   int nonblock;               // opened with O_NONBLOCK
 } pd_rtdm_ctx_t;
 #endif
 
@@ -20,6 +20,7 @@
 #define __POWER_DAQ_INTERNAL_H__
 
 #include "powerdaq.h"
+#include "pd_gap.h"
 #include "pdfw_def.h"
 #include "win_ddk_types.h"
 #include "pd_debug.h"
@@ -98,6 +99,12 @@ typedef struct
     u32   bRecycle;         // buffer is in the "RECYCLED" mode
     u32   FirstTimestamp;   // first sample timestamp
     u32   LastTimestamp;    // last sample timestamp
+    u32   StampCount;       // frame stamps logged in pCtrl->Stamp
+    tDaqBufCtrl* pCtrl;     // control page shared with user space
+    u32   bContig;          // buffer is physically contiguous (BUF_CONTIGUOUS)
+    dma_addr_t ContigHandle; // DMA handle of the contiguous buffer
+    u32   bAutoRestart;     // AIn restarts after FIFO overrun (BUF_AUTORESTART)
+    TGapLog GapLog;         // restarts done, see pdl_gap.c
 } TBuf_Info, * PTBuf_Info;
 
 // set up run parameters (set parameter to -1 to keep default):
@@ -125,6 +132,61 @@ struct _synchSS;
 
 typedef struct _synchSS TSynchSS, *PTSynchSS;
 
+// interrupt path latency histograms, shown in /proc/pwrdaq_latency
+typedef enum
+{
+    latIsrPeriod        = 0,        // ISR entry to next ISR entry
+    latIsr              = 1,        // ISR duration
+    latBhSched          = 2,        // ISR exit to bottom half start
+    latBh               = 3,        // bottom half duration
+    latBhWords          = 4,        // AIn values moved by the bottom half
+    latWakeup           = 5,        // event signaled to waiter running
+    latBmRingPages      = 6,        // bus-master ring pages per bottom half
+    latNum              = 7
+} PDLatHist;
+
+// board bring-up phases, timed at module load
+typedef enum
+{
+    initDspStartup      = 0,        // DSP reset, firmware download, echo test
+    initBoard           = 1,        // EEPROM and firmware revision read
+    initCalibration     = 2,        // CALDAC programming
+    initSetup           = 3,        // IRQ, synch objects, bus-master memory
+    initNum             = 4
+} PDInitPhase;
+
+#define PD_LAT_BUCKETS  32          // bucket n counts values in [2^n, 2^(n+1))
+
+typedef struct
+{
+    u32   Count;                    // number of values recorded
+    u32   Max;                      // largest value recorded
+    u64   Sum;                      // sum of values, for the average
+    u32   Bucket[PD_LAT_BUCKETS];   // log2 histogram
+} TLatHist;
+
+// AIn bus-master page ring (bm_ring=N), see pdl_bmring.c. The board only
+// knows two pages, the ISR moves each page it completes into the next
+// slot and the bottom half consumes the slots in order.
+typedef struct
+{
+    u32*  pValues;                // one bus-master page of values
+    u32   Values;                 // values in the slot
+    u64   Time;                   // time the page was done, ns
+} TBmSlot;
+
+typedef struct
+{
+    u32   Slots;                  // number of slots, 0 = no ring
+    u32   SlotValues;             // values per slot
+    u32*  pData;                  // Slots * SlotValues values
+    TBmSlot* pSlot;
+    u32   Put;                    // next slot the ISR fills
+    u32   Get;                    // next slot the bottom half consumes
+    u32   Count;                  // slots filled, not consumed yet
+    u32   bOverrun;               // a page was lost, the ring was full
+} TBmRing;
+
 
 // this structure holds information about AIn subsystem
 typedef struct
@@ -140,6 +202,10 @@ typedef struct
     u32   dwEventsNotify;         // subsystem user events notification
     u32   dwEventsStatus;         // subsystem user events status
     u32   dwEventsNew;            // new events
+    u32   dwEventsPersist;        // events that stay armed after notification
+    u32   dwEventsPoll;           // events that wake pd_poll(), not notified to the user
+    u32   dwFramesNew;            // eFrameDone occurrences in dwEventsNew (frames completed)
+    u32   dwDataNew;              // eDataAvailable occurrences in dwEventsNew (transfers)
     u32   dwChListChan;           // number of channels in list
     u32   ChList[PD_MAX_CL_SIZE]; // channel list data buffer
     TBuf_Info BufInfo;            // buffer information
@@ -179,8 +245,13 @@ typedef struct
     u32   dwEventsNotify;
     u32   dwEventsStatus;
     u32   dwEventsNew;
+    u32   dwEventsPersist;        // events that stay armed after notification
+    u32   dwEventsPoll;           // events that wake pd_poll(), not notified to the user
+    u32   dwFramesNew;            // eFrameDone occurrences in dwEventsNew (frames sent)
     u32   dwChListChan;           // number of channels in list
     u32   ChList[PD_MAX_CL_SIZE]; // channel list data buffer
+    u32   ChTagLen;               // channel list tag pattern length
+    u32   ChTags[2*PD_MAX_CL_SIZE]; // ChList<<16 pattern, stored twice (pdl_aopack.c)
     TBuf_Info BufInfo;
     tScanInfo ScanInfo;
     u32   FifoValues;             // ???
@@ -219,6 +290,7 @@ typedef struct
     u32   dwEventsNotify;
     u32   dwEventsStatus;
     u32   dwEventsNew;
+    u32   dwEventsPersist;        // events that stay armed after notification
     u32   bInUse;                 // TRUE -> SS is in use
     u32   dwWakeupEvents;         // events to wake up blocked request
     u32   dwNotifyEvents;         // events to notify on wakeup
@@ -236,12 +308,15 @@ typedef struct
     u32   dwEventsNotify;
     u32   dwEventsStatus;
     u32   dwEventsNew;
+    u32   dwEventsPersist;        // events that stay armed after notification
     u32   bInUse;                 // TRUE -> SS is in use
     u32   dwWakeupEvents;         // events to wake up blocked request
     u32   dwNotifyEvents;         // events to notify on wakeup
     u32   timeout;
     u32   intrData[16];
     u32   intrMask[8];
+    tCosRing* pCosRing;           // DIO-256 change of state ring, see pdl_dio.c
+    u32   bCosRunning;            // TRUE -> the bottom half logs DIn interrupts
     struct _synchSS *synch;
 } TDioSS, * PTDioSS;
 
@@ -297,6 +372,7 @@ typedef struct
    void*  pLinBMB[4];          // linear, i.e. user space address
    u32    SizeBMB[4];          // size of BM buffer
    u32    cp;                  // current AIn page
+   TBmRing BmRing;             // AIn bus-master page ring, see pdl_bmring.c
 
 #ifdef MEASURE_LATENCY
    unsigned int tscLow;
@@ -308,6 +384,32 @@ typedef struct
 #else
    struct tq_struct worker;
 #endif
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,36)
+   struct workqueue_struct *bh_wq; // per-board bottom half workqueue
+#endif
+   int    bh_cpu;              // CPU running the bottom half, -1 = any
+
+   // latency instrumentation, ns (words for latBhWords)
+   TLatHist LatHist[latNum];
+   u64    LatIsrEntry;         // last ISR entry time
+   u64    LatBhQueued;         // time the bottom half was queued
+   u64    InitTime[initNum];   // bring-up phase durations, ns
+
+   // per-board firmware spinlock, see _fw_spinlock in powerdaq_kernel.h
+#if defined(_PD_RTL)
+   pthread_spinlock_t fw_lock;
+#elif defined(_PD_RTLPRO)
+   rtl_pthread_spinlock_t fw_lock;
+#elif defined(_PD_RTAI)
+   spinlock_t fw_lock;
+   unsigned long fw_flags;
+#elif defined(_PD_XENOMAI)
+   rtdm_lock_t fw_lock;
+   rtdm_lockctx_t fw_lock_ctx;
+#else
+   spinlock_t fw_lock;
+   unsigned long fw_flags;
+#endif
 
    void *extension;
 } pd_board_t;
@@ -331,12 +433,14 @@ typedef struct
 #define PD_AIN_MAX_XFERSIZE     0x1000   //AI00310: maximum xfer size
 #define PD_BM_PAGES             4        // number of contigous pages
 #define PD_BM_SPP               0x400    // samples per page
+#define PD_BM_RING_MAX          1024     // most slots in the bus-master ring
 
 #define ANALOG_XFERBUF_VALUES   0x10000
 #define ANALOG_XFERBUF_SIZE     (ANALOG_XFERBUF_VALUES * sizeof(ULONG))
 #define PD_AOUT_MAX_FIFO_VALUES 0x800   // Maximum number of samples in DAC FIFO
 
-#define XFERMODE_NORMAL     0       // use read/write with status register check
+#define XFERMODE_NORMAL     0       // use read/write with status register check,
+                                    // before each word written, once per AIn block read
 #define XFERMODE_FAST       1       // use read/write without status register check
 #define XFERMODE_BM         2       // use bus master for downstream transfers
 #define XFERMODE_BM8WORD    3       // use bus master with shorter bursts
@@ -228,6 +228,9 @@ typedef enum {
 #define     BUF_BUFFERRECYCLED  0x2
 #define     BUF_DWORDVALUES     0x10
 #define     BUF_FIXEDDMA        0x20
+#define     BUF_CONTIGUOUS      0x40 /* physically contiguous (CMA) buffer if available */
+#define     BUF_AUTORESTART     0x80 /* AIn: restart after FIFO overrun, log a gap*/
+                                     /* (xferMode 0 or 1 only)                   */
 
 
 /*---------------------------------------------------------------------------*/
@@ -238,6 +241,14 @@ typedef enum {
 #define PWRDAQX_CONTROL_CODE(request, method) request+0x100
 #define METHOD_BUFFERED 0
 
+/* v2 ioctl codes: an IOCTL_PWRDAQ_xxx code, which fills the type and      */
+/* number fields, plus a direction and the size of the part of tCmd that  */
+/* the command uses (_IOC_SIZE). The driver copies only that much in and  */
+/* out. A code without direction is a tCmd one, the whole tCmd is copied. */
+#define PD_IOC_V2(code, size)   ((code) | _IOC(_IOC_READ|_IOC_WRITE, 0, 0, (size)))
+#define PD_IOC_IS_V2(command)   (_IOC_DIR(command) != 0)
+#define PD_IOC_CODE(command)    ((_IOC_TYPE(command) << _IOC_TYPESHIFT) | _IOC_NR(command))
+
 /*---------------------------------------------------------------------------*/
 
 #define IOCTL_PWRDAQ_PRIVATE_MAP_DEVICE   PWRDAQX_CONTROL_CODE(0, METHOD_BUFFERED)
@@ -267,6 +278,10 @@ typedef enum {
 #define IOCTL_PWRDAQ_GET_USER_EVENTS    PWRDAQX_CONTROL_CODE(0x16, METHOD_BUFFERED)
 #define IOCTL_PWRDAQ_IMMEDIATE_UPDATE   PWRDAQX_CONTROL_CODE(0x17, METHOD_BUFFERED)
 #define IOCTL_PWRDAQ_SET_TIMED_UPDATE   PWRDAQX_CONTROL_CODE(0x18, METHOD_BUFFERED)
+#define IOCTL_PWRDAQ_SET_BH_CPU         PWRDAQX_CONTROL_CODE(0x19, METHOD_BUFFERED)
+#define IOCTL_PWRDAQ_BATCH              PWRDAQX_CONTROL_CODE(0x1A, METHOD_BUFFERED)
+#define IOCTL_PWRDAQ_SUBSCRIBE_EVENTS   PWRDAQX_CONTROL_CODE(0x1B, METHOD_BUFFERED)
+#define IOCTL_PWRDAQ_WAIT_EVENTS        PWRDAQX_CONTROL_CODE(0x1C, METHOD_BUFFERED)
 
 /* PowerDAQ Asynchronous Buffered AIn/AOut Operations.*/
 #define IOCTL_PWRDAQ_AIN_ASYNC_INIT     PWRDAQX_CONTROL_CODE(0x1E, METHOD_BUFFERED)
@@ -282,6 +297,8 @@ typedef enum {
 #define IOCTL_PWRDAQ_GET_DAQBUF_STATUS  PWRDAQX_CONTROL_CODE(0x28, METHOD_BUFFERED)
 #define IOCTL_PWRDAQ_GET_DAQBUF_SCANS   PWRDAQX_CONTROL_CODE(0x29, METHOD_BUFFERED)
 #define IOCTL_PWRDAQ_CLEAR_DAQBUF       PWRDAQX_CONTROL_CODE(0x2A, METHOD_BUFFERED)
+#define IOCTL_PWRDAQ_RELEASE_DAQBUF_SCANS PWRDAQX_CONTROL_CODE(0x2B, METHOD_BUFFERED)
+#define IOCTL_PWRDAQ_AIN_GET_GAPS       PWRDAQX_CONTROL_CODE(0x2C, METHOD_BUFFERED)
 
 /* Low Level PowerDAQ Board Level Commands.*/
 #define IOCTL_PWRDAQ_BRDRESET           PWRDAQX_CONTROL_CODE(0x64, METHOD_BUFFERED)
@@ -363,6 +380,8 @@ typedef enum {
 #define IOCTL_PWRDAQ_DIODMASET          PWRDAQX_CONTROL_CODE(0x1FB, METHOD_BUFFERED) 
 #define IOCTL_PWRDAQ_DIO256CMDWR_ALL    PWRDAQX_CONTROL_CODE(0x1FC, METHOD_BUFFERED)
 #define IOCTL_PWRDAQ_DIO256CMDRD_ALL    PWRDAQX_CONTROL_CODE(0x1FD, METHOD_BUFFERED)
+#define IOCTL_PWRDAQ_DIO256COSSTART     PWRDAQX_CONTROL_CODE(0x1FE, METHOD_BUFFERED)
+#define IOCTL_PWRDAQ_DIO256COSSTOP      PWRDAQX_CONTROL_CODE(0x1FF, METHOD_BUFFERED)
 
 
 
@@ -449,6 +468,116 @@ typedef struct
    u32   ScanRetMode;    /* how to copy scans into user buffer*/
 } tScanInfo;
 
+/* Frame completion stamp, see tDaqBufCtrl.Stamp. The bottom half logs  */
+/* one for each transfer from the board that completes a frame: the      */
+/* absolute index of the value after the last one transferred            */
+/* (WrapCount * MaxValues + Head) and the time the values got to the     */
+/* host. Seq is PD_FRAMESTAMP_INVALID while the entry is being written.  */
+#define PD_FRAMESTAMP_RING_SIZE 64
+#define PD_FRAMESTAMP_INVALID   0xFFFFFFFF
+
+typedef struct
+{
+   u32   Seq;            /* stamp number since async init, from 0*/
+   u32   ValueIndexLow;  /* absolute value index, values*/
+   u32   ValueIndexHigh;
+   u32   TimestampLow;   /* time of the transfer, CLOCK_MONOTONIC ns*/
+   u32   TimestampHigh;
+} tFrameStamp;
+
+/* DaqBuf control page. The driver maps it read-only right after the DAQ */
+/* buffer (mmap offset = buffer size rounded up to the page size) and    */
+/* updates it from the bottom half. Seq is odd while an update is in     */
+/* progress: read Seq, the fields, then Seq again and retry if it        */
+/* changed or is odd.                                                    */
+typedef struct
+{
+   u32   Seq;            /* update sequence counter*/
+   u32   Head;           /* buffer head (values)*/
+   u32   Tail;           /* buffer tail (values)*/
+   u32   Count;          /* values in the buffer*/
+   u32   WrapCount;      /* total num times buffer wrapped*/
+   u32   ScanIndex;      /* driver side index of the next scan to get*/
+   u32   SubsysState;    /* current subsystem state*/
+   u32   Events;         /* subsystem events status*/
+   u32   TimestampLow;   /* time of the update, CLOCK_MONOTONIC ns*/
+   u32   TimestampHigh;
+   u32   MaxValues;      /* maximum number of samples in buffer*/
+   u32   ScanValues;     /* number of samples in a scan*/
+   u32   FrameValues;    /* number of samples in a frame*/
+   u32   GapCount;       /* number of BUF_AUTORESTART gaps since async init*/
+   u32   StampCount;     /* number of frame stamps since async init*/
+   tFrameStamp Stamp[PD_FRAMESTAMP_RING_SIZE]; /* stamp n is in Stamp[n % size]*/
+} tDaqBufCtrl;
+
+/* DIO-256 change of state queue, see IOCTL_PWRDAQ_DIO256COSSTART. For   */
+/* each DIn interrupt the bottom half reads the interrupt and edge words */
+/* (same as PdDIOGetIntrData), re-arms the interrupt and logs them with  */
+/* the ISR entry time. The ring is mapped read-only from the DIn device  */
+/* at offset PD_COS_MMAP_OFFSET. Record n is in Rec[n % size], its Seq   */
+/* is PD_COS_INVALID while it is being written. On DIO boards the input */
+/* DAQ buffer and its control page are kept below that offset: the      */
+/* buffer must be at least one page smaller than 1GB.                    */
+#define PD_COS_RING_SIZE        4096
+#define PD_COS_INVALID          0xFFFFFFFF
+#define PD_COS_MMAP_OFFSET      0x40000000
+#define PD_DIO256_REGS          8
+
+typedef struct
+{
+   u32   Seq;            /* record number since COS start, from 0*/
+   u32   TimestampLow;   /* ISR entry time, CLOCK_MONOTONIC ns*/
+   u32   TimestampHigh;
+   u32   IntData[PD_DIO256_REGS];  /* 1 where the line changed, LSW only*/
+   u32   EdgeData[PD_DIO256_REGS]; /* where IntData is 1: 1 rising, 0 falling*/
+} tCosRecord;
+
+typedef struct
+{
+   u32   Count;          /* records logged since COS start*/
+   u32   Errors;         /* interrupts whose words couldn't be read*/
+   u32   Reserved[2];
+   tCosRecord Rec[PD_COS_RING_SIZE];
+} tCosRing;
+
+/* AIn overrun gap, see BUF_AUTORESTART and IOCTL_PWRDAQ_AIN_GET_GAPS.     */
+/* The driver keeps the last PD_GAP_LOG_SIZE gaps. The values from        */
+/* WrapCount * MaxValues + Head on follow the restart, the scans before   */
+/* them are contiguous.                                                   */
+#define PD_GAP_LOG_SIZE         16
+
+typedef struct
+{
+   u32   Seq;            /* gap number since async init, from 0*/
+   u32   Head;           /* buffer index (values) of the first value after the gap*/
+   u32   WrapCount;      /* buffer wrap count at the gap*/
+   u32   LostScans;      /* estimated number of scans lost, 0 if unknown*/
+   u32   TimestampLow;   /* time of the restart, CLOCK_MONOTONIC ns*/
+   u32   TimestampHigh;
+} tGapInfo;
+
+typedef struct
+{
+   u32      FirstSeq;    /* IN: first gap wanted*/
+   u32      NumGaps;     /* OUT: number of gaps since async init*/
+   u32      NumRet;      /* OUT: entries returned in Gap[]*/
+   tGapInfo Gap[PD_GAP_LOG_SIZE];
+} tGapQuery;
+
+/* Persistent events, see IOCTL_PWRDAQ_SUBSCRIBE_EVENTS. Subscribed events */
+/* stay armed after they are notified. The driver accumulates and counts */
+/* them, IOCTL_PWRDAQ_WAIT_EVENTS returns them and starts over.           */
+/* eFrameDone counts the frames completed and eDataAvailable the buffer  */
+/* transfers, even when one notification stands for several of them.    */
+#define PD_EVENT_COUNTERS       18   /* event bits 0..17, eStartTrig..eTimeout*/
+
+typedef struct
+{
+   u32   Events;         /* IN: events to wait for, OUT: events notified since the last wait*/
+   u32   Timeout;        /* IN: timeout, ms*/
+   u32   Count[PD_EVENT_COUNTERS]; /* OUT: times event bit n occurred since the last wait*/
+} tEventWait;
+
 typedef struct _PD_DAQBUF_STATUS_INFO
 {
    u32           dwAdapterId;        /* Adapter ID*/
@@ -486,6 +615,18 @@ typedef struct
 } tBuffer;
 
 
+/* Batched command, see IOCTL_PWRDAQ_BATCH                                   */
+/* Only the commands that take their parameters in dwParam can be batched    */
+#define PD_MAX_BATCH            64
+#define PD_BATCH_STOPONERROR    0x1   /* don't run the entries after a failed one*/
+
+typedef struct
+{
+   u32 Command;                  /* IN: IOCTL_PWRDAQ_xxx code*/
+   int Result;                   /* OUT: ioctl result, -ECANCELED if not run*/
+   u32 dwParam[8];               /* IN/OUT: same as tCmd.dwParam*/
+} tBatchEntry;
+
 /* Main command structure                                                    */
 /* union contains ioctl-specific information needed to communicate           */
 /* with the driver                                                           */
@@ -500,6 +641,8 @@ typedef union
    tAsyncCfg    AsyncCfg;
    tAcqSS       AcqSS; 
    tScanInfo    ScanInfo;
+   tGapQuery    GapQuery;
+   tEventWait   EventWait;
    PD_PCI_CONFIG PciConfig;
 } tCmd;
 
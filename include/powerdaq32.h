@@ -173,6 +173,32 @@ typedef struct ADAPTER_Info_STRUCT
     unsigned char         PXI_Config[5];         /* PXI line config S.S.*/
 } Adapter_Info, *PAdapter_Info;
 
+/* Batch of commands executed with one ioctl (see _PdBatchExecute)*/
+typedef struct _PD_BATCH
+{
+   DWORD       dwCount;                /* Number of entries added*/
+   DWORD       dwFlags;                /* PD_BATCH_xxx flags*/
+   DWORD       dwExecuted;             /* Entries run by the last execute*/
+   tBatchEntry Entry[PD_MAX_BATCH];    /* Commands and results*/
+} PD_BATCH, *PPD_BATCH;
+
+/* Prepared AIn raw-to-volts converter (see PdAInCreateConverter)*/
+/* The per-channel tables are repeated PD_CONV_PATTERN times so that */
+/* blocks of PD_CONV_PATTERN samples never straddle the table end   */
+#define PD_CONV_PATTERN 8
+
+typedef struct _PD_AIN_CONVERTER
+{
+   DWORD   dwChListSize;        /* Number of channels in one scan*/
+   DWORD   dwPattern;           /* Table length = dwChListSize * PD_CONV_PATTERN*/
+   WORD    wXorMask;            /* Xor mask*/
+   WORD    wAndMask;            /* And mask*/
+   float*  pfScale;             /* Per-sample factor/gain (float kernel)*/
+   float*  pfOffset;            /* Per-sample offset/gain (float kernel)*/
+   double* pdScale;             /* Per-sample factor/gain (double kernel)*/
+   double* pdOffset;            /* Per-sample offset/gain (double kernel)*/
+} PD_AIN_CONVERTER, *PPD_AIN_CONVERTER;
+
 
 
 /*------------------------------------------------------------------------*/
@@ -198,15 +224,31 @@ int PdAcquireSubsystem(int board, int dwSubsystem, int Action);
 int _PdSetUserEvents(int handle, PD_SUBSYSTEM Subsystem, DWORD dwEvents);
 int _PdClearUserEvents(int handle, PD_SUBSYSTEM Subsystem, DWORD dwEvents);
 int _PdGetUserEvents(int handle, PD_SUBSYSTEM Subsystem, DWORD *pdwEvents);
+int _PdSubscribeUserEvents(int handle, PD_SUBSYSTEM Subsystem, DWORD dwEvents);
 int _PdSetAsyncNotify(int handle, struct sigaction *io_act, void (*sig_proc)(int));
 int _PdImmediateUpdate(int handle);
 
 int _PdWaitForEvent(int handle, int events, int timeoutms);
+int _PdWaitForEvents(int handle, int events, int timeoutms, DWORD *pCounts);
 
 int _PdAdapterGetBoardStatus(int handle, tEvents* pEvents);
 int _PdAdapterSetBoardEvents1(int handle, DWORD dwEvents);
 int _PdAdapterSetBoardEvents2(int handle, DWORD dwEvents);
 int _PdAdapterEnableInterrupt(int handle, DWORD dwEnable);
+int _PdAdapterSetBottomHalfCpu(int handle, int cpu);
+
+/*--- Batched commands ---------------------------------------------*/
+void _PdBatchInit(PPD_BATCH pBatch, DWORD dwFlags);
+int _PdBatchAdd(PPD_BATCH pBatch, DWORD dwCommand, DWORD dwNumParams, DWORD* pdwParams);
+int _PdBatchAddAInSwClStart(PPD_BATCH pBatch);
+int _PdBatchAddAInGetValue(PPD_BATCH pBatch);
+int _PdBatchAddAOutPutValue(PPD_BATCH pBatch, DWORD dwValue);
+int _PdBatchAddDInRead(PPD_BATCH pBatch);
+int _PdBatchAddDOutWrite(PPD_BATCH pBatch, DWORD dwValue);
+int _PdBatchAddDIO256CmdWriteAll(PPD_BATCH pBatch, DWORD* pdwValues);
+int _PdBatchAddDIO256CmdReadAll(PPD_BATCH pBatch);
+int _PdBatchExecute(int handle, PPD_BATCH pBatch);
+int _PdBatchGetResult(PPD_BATCH pBatch, int nIndex, DWORD* pdwValue);
 
 /*--- Buffering functions ------------------------------------------------*/
 int _PdRegisterBuffer(int handle,PWORD* pBuffer,
@@ -216,6 +258,8 @@ int _PdRegisterBuffer(int handle,PWORD* pBuffer,
                                  DWORD dwScanSize,
                                  DWORD bWrapAround);
 int _PdUnregisterBuffer(int handle, PWORD pBuf, DWORD dwSubSystem);
+int _PdMapDaqBufCtrl(int handle, DWORD dwSubSystem, tDaqBufCtrl** ppCtrl);
+int _PdUnmapDaqBufCtrl(tDaqBufCtrl* pCtrl);
 
 int _PdAdapterEepromRead(int handle, DWORD dwMaxSize, WORD *pwReadBuf, DWORD *pdwWORDs);
 int _PdAdapterEepromWrite(int handle,WORD *pwWriteBuf, DWORD dwSize);
@@ -244,6 +288,13 @@ int _PdAInGetScans(int handle,DWORD NumScans, DWORD ScanRetMode, DWORD *pScanInd
                              DWORD *pNumValidScans);
 int _PdAInGetBufState(int handle, DWORD NumScans, DWORD ScanRetMode, 
                       DWORD *pScanIndex, DWORD *pNumValidScans); 
+int _PdAInPollScans(tDaqBufCtrl* pCtrl, DWORD ScanIndex, DWORD NumScans, 
+                    DWORD *pNumValidScans);
+int _PdAInGetFrameStamps(tDaqBufCtrl* pCtrl, DWORD FirstSeq, tFrameStamp* pStamps,
+                         DWORD MaxStamps, DWORD* pNumRet, DWORD* pNumStamps);
+int _PdAInReleaseScans(int handle, DWORD ScanIndex);
+int _PdAInGetGaps(int handle, DWORD FirstSeq, tGapInfo* pGaps, DWORD MaxGaps,
+                  DWORD* pNumRet, DWORD* pNumGaps);
 
 
 int _PdAInSetCfg(int handle, DWORD dwAInCfg, DWORD dwAInPreTrig, DWORD dwAInPostTrig);
@@ -313,6 +364,12 @@ int _PdDIOExtLatchRead(int handle, DWORD dwRegister, BOOL *bLatch);
 int _PdDIOSetIntrMask(int handle, DWORD* dwIntMask);
 int _PdDIOGetIntrData(int handle, DWORD* dwIntData, DWORD* dwEdgeData);
 int _PdDIOIntrEnable(int handle, DWORD dwEnable);
+int _PdDIOCosStart(int handle);
+int _PdDIOCosStop(int handle);
+int _PdDIOCosMap(int handle, tCosRing** ppRing);
+int _PdDIOCosUnmap(tCosRing* pRing);
+int _PdDIOCosRead(tCosRing* pRing, DWORD* pNextSeq, tCosRecord* pRecs,
+                  DWORD MaxRecs, DWORD* pNumRet, DWORD* pNumLost);
 int _PdDIOSetIntCh(int handle, DWORD dwChannels);
 int _PdDIODMASet(int handle, DWORD dwOffset, DWORD dwCount, DWORD dwSource);
 int _PdDIOReadAll(int handle, DWORD *pdwValue);
@@ -474,6 +531,14 @@ int PdAOutVoltsToRaw(int board, DWORD dwMode, double* fVoltage, DWORD* dwRawData
 int _PdGetAdapterInfo(DWORD dwBoardNum, PAdapter_Info pAdInfo);
 int __PdGetAdapterInfo(DWORD dwBoardNum, PAdapter_Info pAdInfo);
 
+/* Prepared converter: resolves board ranges, mode and per-channel gains*/
+/* once, then converts interleaved scans with a vectorized kernel      */
+int PdAInCreateConverter(int board, DWORD dwMode, DWORD dwChListSize, 
+                         DWORD* dwChList, PPD_AIN_CONVERTER* ppConv);
+void PdAInFreeConverter(PPD_AIN_CONVERTER pConv);
+int PdAInConvert(PPD_AIN_CONVERTER pConv, WORD* wRawData, double* fVoltage, DWORD dwCount);
+int PdAInConvertF(PPD_AIN_CONVERTER pConv, WORD* wRawData, float* fVoltage, DWORD dwCount);
+
 /*--- Easy functions -----------------------------------------------*/
 /* Single-point (one scan) acquisition*/
 int PdAInAcqScan(int handle,
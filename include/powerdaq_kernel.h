@@ -79,12 +79,16 @@
       #include <linux/moduleparam.h>
       #include <linux/device.h>
       #include <linux/workqueue.h>
+      #include <linux/kthread.h>
+      #include <linux/completion.h>
+      #include <linux/firmware.h>
    #else
       #include <linux/tqueue.h>
    #endif
    
    #include <linux/proc_fs.h>
    #include <linux/fs.h>
+   #include <linux/poll.h>
    
    #include <asm/io.h>
    #if LINUX_VERSION_CODE < KERNEL_VERSION(3, 4, 0)
@@ -157,36 +161,64 @@ extern int num_pd_boards;
 // writes/reads to board registers. Those sequences
 // of writes and reads need to be atomic or the board's
 // firmware will get very confused.
-// This spinlock ensure that only one thread can access
-// one given board.
+// Each board has its own spinlock (pd_board[].fw_lock) so that
+// only one thread can access one given board while operations
+// on different boards run in parallel.
+// The pd_brd_lock spinlock protects the global board table
+// (num_pd_boards and the board slots being added).
 #if defined(_PD_RTL)
-   PD_GLOBAL_PREFIX pthread_spinlock_t pd_fw_lock;
-   
-   #define _fw_spinlock pthread_spin_lock(&pd_fw_lock);
-   #define _fw_spinunlock pthread_spin_unlock(&pd_fw_lock);
+   PD_GLOBAL_PREFIX pthread_spinlock_t pd_brd_lock;
+
+   #define _fw_spin_init(b) pthread_spin_init(&pd_board[b].fw_lock, 0);
+   #define _fw_spinlock(b) pthread_spin_lock(&pd_board[b].fw_lock);
+   #define _fw_spinunlock(b) pthread_spin_unlock(&pd_board[b].fw_lock);
+
+   #define _brd_spin_init pthread_spin_init(&pd_brd_lock, 0);
+   #define _brd_spinlock pthread_spin_lock(&pd_brd_lock);
+   #define _brd_spinunlock pthread_spin_unlock(&pd_brd_lock);
 #elif defined(_PD_RTLPRO)
-   PD_GLOBAL_PREFIX rtl_pthread_spinlock_t pd_fw_lock;
+   PD_GLOBAL_PREFIX rtl_pthread_spinlock_t pd_brd_lock;
 
-   #define _fw_spinlock rtl_pthread_spin_lock(&pd_fw_lock);
-   #define _fw_spinunlock rtl_pthread_spin_unlock(&pd_fw_lock);
+   #define _fw_spin_init(b) rtl_pthread_spin_init(&pd_board[b].fw_lock, 0);
+   #define _fw_spinlock(b) rtl_pthread_spin_lock(&pd_board[b].fw_lock);
+   #define _fw_spinunlock(b) rtl_pthread_spin_unlock(&pd_board[b].fw_lock);
+
+   #define _brd_spin_init rtl_pthread_spin_init(&pd_brd_lock, 0);
+   #define _brd_spinlock rtl_pthread_spin_lock(&pd_brd_lock);
+   #define _brd_spinunlock rtl_pthread_spin_unlock(&pd_brd_lock);
 #elif defined(_PD_RTAI)
-   PD_GLOBAL_PREFIX spinlock_t pd_fw_lock;
-   PD_GLOBAL_PREFIX unsigned long pd_fw_flags;
+   PD_GLOBAL_PREFIX spinlock_t pd_brd_lock;
+   PD_GLOBAL_PREFIX unsigned long pd_brd_flags;
+
+   #define _fw_spin_init(b) pd_board[b].fw_lock = SPIN_LOCK_UNLOCKED;
+   #define _fw_spinlock(b) pd_board[b].fw_flags = rt_spin_lock_irqsave(&pd_board[b].fw_lock);
+   #define _fw_spinunlock(b) rt_spin_unlock_irqrestore(pd_board[b].fw_flags, &pd_board[b].fw_lock);
 
-   #define _fw_spinlock pd_fw_flags = rt_spin_lock_irqsave(&pd_fw_lock);
-   #define _fw_spinunlock rt_spin_unlock_irqrestore(pd_fw_flags, &pd_fw_lock);
+   #define _brd_spin_init pd_brd_lock = SPIN_LOCK_UNLOCKED;
+   #define _brd_spinlock pd_brd_flags = rt_spin_lock_irqsave(&pd_brd_lock);
+   #define _brd_spinunlock rt_spin_unlock_irqrestore(pd_brd_flags, &pd_brd_lock);
 #elif defined(_PD_XENOMAI)
-   PD_GLOBAL_PREFIX rtdm_lock_t pd_fw_lock;
-   PD_GLOBAL_PREFIX rtdm_lockctx_t pd_fw_lock_ctx;
+   PD_GLOBAL_PREFIX rtdm_lock_t pd_brd_lock;
+   PD_GLOBAL_PREFIX rtdm_lockctx_t pd_brd_lock_ctx;
 
-   #define _fw_spinlock rtdm_lock_get_irqsave(&pd_fw_lock, pd_fw_lock_ctx);
-   #define _fw_spinunlock rtdm_lock_put_irqrestore(&pd_fw_lock, pd_fw_lock_ctx);
+   #define _fw_spin_init(b) rtdm_lock_init(&pd_board[b].fw_lock);
+   #define _fw_spinlock(b) rtdm_lock_get_irqsave(&pd_board[b].fw_lock, pd_board[b].fw_lock_ctx);
+   #define _fw_spinunlock(b) rtdm_lock_put_irqrestore(&pd_board[b].fw_lock, pd_board[b].fw_lock_ctx);
+
+   #define _brd_spin_init rtdm_lock_init(&pd_brd_lock);
+   #define _brd_spinlock rtdm_lock_get_irqsave(&pd_brd_lock, pd_brd_lock_ctx);
+   #define _brd_spinunlock rtdm_lock_put_irqrestore(&pd_brd_lock, pd_brd_lock_ctx);
 #else
-   PD_GLOBAL_PREFIX spinlock_t pd_fw_lock;
-   PD_GLOBAL_PREFIX unsigned long pd_fw_flags;
+   PD_GLOBAL_PREFIX spinlock_t pd_brd_lock;
+   PD_GLOBAL_PREFIX unsigned long pd_brd_flags;
+
+   #define _fw_spin_init(b) spin_lock_init(&pd_board[b].fw_lock);
+   #define _fw_spinlock(b) spin_lock_irqsave(&pd_board[b].fw_lock, pd_board[b].fw_flags);
+   #define _fw_spinunlock(b) spin_unlock_irqrestore(&pd_board[b].fw_lock, pd_board[b].fw_flags);
 
-   #define _fw_spinlock spin_lock_irqsave(&pd_fw_lock, pd_fw_flags);
-   #define _fw_spinunlock spin_unlock_irqrestore(&pd_fw_lock, pd_fw_flags);
+   #define _brd_spin_init spin_lock_init(&pd_brd_lock);
+   #define _brd_spinlock spin_lock_irqsave(&pd_brd_lock, pd_brd_flags);
+   #define _brd_spinunlock spin_unlock_irqrestore(&pd_brd_lock, pd_brd_flags);
 #endif
 
 // global variables for deferred processing of interrupts
@@ -249,11 +281,20 @@ void pd_udelay(u32 usecs);
 void pd_mdelay(u32 msecs);
 void* pd_alloc_bigbuf(u32 size);
 void pd_free_bigbuf(void* mem, u32 size);
+u64 pd_get_time_ns(void);
+void pd_lat_add(int board, int hist, u32 value);
+void pd_lat_since(int board, int hist, u64 start, u64 now);
+void pd_lat_reset(int board);
+void* pd_alloc_contig_bigbuf(int board, u32 size, dma_addr_t* pHandle);
+void pd_free_contig_bigbuf(int board, void* mem, u32 size, dma_addr_t handle);
+int pd_mmap_contig_bigbuf(int board, void* mem, u32 size, dma_addr_t handle,
+                          struct vm_area_struct *vma);
         
 int pd_event_create(int board, TSynchSS **sync);
 int pd_event_wait(int board, TSynchSS *sync, int timeoutms);
 int pd_event_signal(int board, TSynchSS *sync);
 int pd_event_destroy(int board, TSynchSS *synch);
+void pd_event_flush(int board);
 
 // Operating system abstraction layer function calls
 typedef int (* tPdIrqHandler)(int board);
@@ -261,7 +302,21 @@ int pd_driver_register(int board, int minor);
 int pd_driver_unregister(int board, int minor);
 int pd_driver_open(int board, int minor);
 int pd_driver_close(int board, int minor);
+// pd_driver_read/pd_driver_write flags
+#define PD_RW_NONBLOCK  0x1   // don't sleep
+#define PD_RW_KERNEL    0x2   // buffer is in kernel space (RTDM kernel callers)
+// caller of pd_driver_read/pd_driver_write, NULL for Linux file operations
+#if defined(_PD_XENOMAI)
+typedef rtdm_user_info_t pd_user_info_t;
+#else
+typedef void pd_user_info_t;
+#endif
+int pd_driver_read(int board, int minor, char* buffer, u32 count, int flags,
+                   pd_user_info_t* user_info);
+int pd_driver_write(int board, int minor, const char* buffer, u32 count, int flags,
+                    pd_user_info_t* user_info);
 int pd_driver_ioctl(int board, int board_minor, int command, tCmd* argcmd);
 int pd_driver_request_irq(int board, tPdIrqHandler handler);
 int pd_driver_release_irq(int board);
+int pd_driver_set_bh_cpu(int board, int cpu);
 
@@ -69,6 +69,11 @@
 #include <signal.h>
 #include <unistd.h>
 #include "../include/win_sdk_types.h"
+#if defined(PD_AVX2)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #define PD_STRTOK strtok_r
 #define PD_STRCPY strcpy
 #define PD_STRSTR strstr
@@ -478,45 +483,54 @@ int __PdGetAdapterInfo(DWORD dwBoardNum,       // Number of board
 
 #if !defined(_PD_RTLPRO)
 //
-// Converts analog input data from raw format to volts (for MF/MFS boards)
-//
+// Returns pointer to the AIn subsystem information of the board. When the
+// DLL adapter table is loaded it is used in place, otherwise the adapter
+// information is read into *pAdInfo (allocated by caller)
 //
-int PdAInRawToVolts(int boardNumber,
-                       DWORD dwMode,          // Mode used
-                       WORD* wRawData,          // Raw data
-                       double* fVoltage,        // Engineering unit
-                       DWORD dwCount            // Number of samples to convert
-                     )
+static int _PdGetAInSSI(int boardNumber, PAdapter_Info pAdInfo, PSubSys_Info* ppSSI)
 {
-    Adapter_Info AdpInfo;
     int retVal;
+
+    if ((G_pAdapterInfo != NULL) && (boardNumber >= 0) && (boardNumber < G_NbBoards))
+    {
+       *ppSSI = &G_pAdapterInfo[boardNumber].SSI[AnalogIn];
+       return 0;
+    }
+
+    retVal = _PdGetAdapterInfo(boardNumber, pAdInfo);
+    if (retVal < 0)
+       return retVal;
+
+    *ppSSI = &pAdInfo->SSI[AnalogIn];
+    return 0;
+}
+
+//
+// Selects index of the fFactor/fOffset range that matches AIn
+// configuration dwMode (polarity and range bits)
+//
+static int _PdAInGetModeIndex(PSubSys_Info pSSI, DWORD dwMode)
+{
     int i;
     int modeIndex;
     int polarModes[10];
     int nbOfPolarModes;
     int range;
 
-    // check parameters
-    if (!(wRawData && fVoltage && dwCount)) return -1;
-
-    retVal = _PdGetAdapterInfo(boardNumber, &AdpInfo);
-    if(retVal <0)
-       return retVal;
-
     // Get a list of modes
     modeIndex = 0;
-    for(i=0; i<AdpInfo.SSI[AnalogIn].dwMaxRanges*2; i++)
+    for(i=0; i<pSSI->dwMaxRanges*2; i++)
     {
        // if we are in bipolar mode look for bipolar modes
        // in board caps
        if(dwMode & AIB_INPTYPE)
        { 
-          if(AdpInfo.SSI[AnalogIn].fRangeLow[i] < 0)
+          if(pSSI->fRangeLow[i] < 0)
              polarModes[modeIndex++] = i;
        }
        else 
        {
-          if(AdpInfo.SSI[AnalogIn].fRangeLow[i] == 0)
+          if(pSSI->fRangeLow[i] == 0)
              polarModes[modeIndex++] = i;
        }
     }
@@ -524,39 +538,348 @@ int PdAInRawToVolts(int boardNumber,
 
     // if we are in high range, look for the highest range
     // else look for the lowest
-    range = AdpInfo.SSI[AnalogIn].fRangeHigh[polarModes[0]] - AdpInfo.SSI[AnalogIn].fRangeLow[polarModes[0]];
+    range = pSSI->fRangeHigh[polarModes[0]] - pSSI->fRangeLow[polarModes[0]];
     modeIndex = polarModes[0];
     for(i=0; i<nbOfPolarModes; i++)
     {
        if(dwMode & AIB_INPRANGE)
        {
-          if((AdpInfo.SSI[AnalogIn].fRangeHigh[polarModes[i]] - 
-              AdpInfo.SSI[AnalogIn].fRangeLow[polarModes[i]]) > range)
+          if((pSSI->fRangeHigh[polarModes[i]] - 
+              pSSI->fRangeLow[polarModes[i]]) > range)
           {
-             range = AdpInfo.SSI[AnalogIn].fRangeHigh[polarModes[i]] - AdpInfo.SSI[AnalogIn].fRangeLow[polarModes[i]];
+             range = pSSI->fRangeHigh[polarModes[i]] - pSSI->fRangeLow[polarModes[i]];
              modeIndex = polarModes[i];
           }
        }
        else
        {
-          if((AdpInfo.SSI[AnalogIn].fRangeHigh[polarModes[i]] - 
-              AdpInfo.SSI[AnalogIn].fRangeLow[polarModes[i]]) < range)
+          if((pSSI->fRangeHigh[polarModes[i]] - 
+              pSSI->fRangeLow[polarModes[i]]) < range)
           {
-             range = AdpInfo.SSI[AnalogIn].fRangeHigh[polarModes[i]] - AdpInfo.SSI[AnalogIn].fRangeLow[polarModes[i]];
+             range = pSSI->fRangeHigh[polarModes[i]] - pSSI->fRangeLow[polarModes[i]];
              modeIndex = polarModes[i];
           }
        }
     }
 
+    return modeIndex;
+}
+
+//
+// Conversion kernels: fVoltage[i] = ((raw[i] & and) ^ xor) * scale[p] - offset[p]
+// where p runs over the per-sample tables of dwPattern entries (a multiple
+// of PD_CONV_PATTERN). SSE2 is used when the library is built for it, scalar
+// code otherwise and for the tail. With AVX2=1 in lib/Makefile only the AVX2
+// loops below are compiled for AVX2, they are used when the CPU has it.
+// They convert whole groups of 8 samples and return the number converted,
+// *pP is the pattern index to continue from.
+//
+#if defined(PD_AVX2)
+__attribute__((target("avx2")))
+static DWORD _PdAInConvertAvx2F(WORD* wRawData, float* fVoltage, DWORD dwCount,
+                                WORD wAndMask, WORD wXorMask,
+                                float* pfScale, float* pfOffset, DWORD dwPattern, DWORD* pP)
+{
+    DWORD i = 0, p = 0;
+    __m128i vAnd = _mm_set1_epi16((short)wAndMask);
+    __m128i vXor = _mm_set1_epi16((short)wXorMask);
+
+    for (; i + 8 <= dwCount; i += 8)
+    {
+       __m128i w = _mm_loadu_si128((__m128i*)(wRawData + i));
+       __m256 v;
+
+       w = _mm_xor_si128(_mm_and_si128(w, vAnd), vXor);
+       v = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(w));
+       v = _mm256_sub_ps(_mm256_mul_ps(v, _mm256_loadu_ps(pfScale + p)), 
+                         _mm256_loadu_ps(pfOffset + p));
+       _mm256_storeu_ps(fVoltage + i, v);
+
+       p += 8;
+       if (p == dwPattern) p = 0;
+    }
+
+    *pP = p;
+    return i;
+}
+
+__attribute__((target("avx2")))
+static DWORD _PdAInConvertAvx2(WORD* wRawData, double* fVoltage, DWORD dwCount,
+                               WORD wAndMask, WORD wXorMask,
+                               double* pdScale, double* pdOffset, DWORD dwPattern, DWORD* pP)
+{
+    DWORD i = 0, p = 0;
+    __m128i vAnd = _mm_set1_epi16((short)wAndMask);
+    __m128i vXor = _mm_set1_epi16((short)wXorMask);
+
+    for (; i + 8 <= dwCount; i += 8)
+    {
+       __m128i w = _mm_loadu_si128((__m128i*)(wRawData + i));
+       __m256i d;
+       __m256d lo, hi;
+
+       w = _mm_xor_si128(_mm_and_si128(w, vAnd), vXor);
+       d = _mm256_cvtepu16_epi32(w);
+       lo = _mm256_cvtepi32_pd(_mm256_castsi256_si128(d));
+       hi = _mm256_cvtepi32_pd(_mm256_extracti128_si256(d, 1));
+       lo = _mm256_sub_pd(_mm256_mul_pd(lo, _mm256_loadu_pd(pdScale + p)), 
+                          _mm256_loadu_pd(pdOffset + p));
+       hi = _mm256_sub_pd(_mm256_mul_pd(hi, _mm256_loadu_pd(pdScale + p + 4)), 
+                          _mm256_loadu_pd(pdOffset + p + 4));
+       _mm256_storeu_pd(fVoltage + i, lo);
+       _mm256_storeu_pd(fVoltage + i + 4, hi);
+
+       p += 8;
+       if (p == dwPattern) p = 0;
+    }
+
+    *pP = p;
+    return i;
+}
+#endif
+
+static void _PdAInConvertKernelF(WORD* wRawData, float* fVoltage, DWORD dwCount,
+                                 WORD wAndMask, WORD wXorMask,
+                                 float* pfScale, float* pfOffset, DWORD dwPattern)
+{
+    DWORD i = 0, p = 0;
+#if defined(__SSE2__)
+    __m128i vAnd = _mm_set1_epi16((short)wAndMask);
+    __m128i vXor = _mm_set1_epi16((short)wXorMask);
+    __m128i vZero = _mm_setzero_si128();
+#endif
+
+#if defined(PD_AVX2)
+    if (__builtin_cpu_supports("avx2"))
+       i = _PdAInConvertAvx2F(wRawData, fVoltage, dwCount, wAndMask, wXorMask,
+                              pfScale, pfOffset, dwPattern, &p);
+#endif
+#if defined(__SSE2__)
+    for (; i + 8 <= dwCount; i += 8)
+    {
+       __m128i w = _mm_loadu_si128((__m128i*)(wRawData + i));
+       __m128 lo, hi;
+
+       w = _mm_xor_si128(_mm_and_si128(w, vAnd), vXor);
+       lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(w, vZero));
+       hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(w, vZero));
+       lo = _mm_sub_ps(_mm_mul_ps(lo, _mm_loadu_ps(pfScale + p)), _mm_loadu_ps(pfOffset + p));
+       hi = _mm_sub_ps(_mm_mul_ps(hi, _mm_loadu_ps(pfScale + p + 4)), _mm_loadu_ps(pfOffset + p + 4));
+       _mm_storeu_ps(fVoltage + i, lo);
+       _mm_storeu_ps(fVoltage + i + 4, hi);
+
+       p += 8;
+       if (p == dwPattern) p = 0;
+    }
+#endif
+
+    for (; i < dwCount; i++)
+    {
+       fVoltage[i] = ((wRawData[i] & wAndMask) ^ wXorMask) * pfScale[p] - pfOffset[p];
+       if (++p == dwPattern) p = 0;
+    }
+}
+
+static void _PdAInConvertKernel(WORD* wRawData, double* fVoltage, DWORD dwCount,
+                                WORD wAndMask, WORD wXorMask,
+                                double* pdScale, double* pdOffset, DWORD dwPattern)
+{
+    DWORD i = 0, p = 0;
+#if defined(__SSE2__)
+    __m128i vAnd = _mm_set1_epi16((short)wAndMask);
+    __m128i vXor = _mm_set1_epi16((short)wXorMask);
+    __m128i vZero = _mm_setzero_si128();
+#endif
+
+#if defined(PD_AVX2)
+    if (__builtin_cpu_supports("avx2"))
+       i = _PdAInConvertAvx2(wRawData, fVoltage, dwCount, wAndMask, wXorMask,
+                             pdScale, pdOffset, dwPattern, &p);
+#endif
+#if defined(__SSE2__)
+    for (; i + 8 <= dwCount; i += 8)
+    {
+       __m128i w = _mm_loadu_si128((__m128i*)(wRawData + i));
+       __m128i d[2];
+       int k;
+
+       w = _mm_xor_si128(_mm_and_si128(w, vAnd), vXor);
+       d[0] = _mm_unpacklo_epi16(w, vZero);
+       d[1] = _mm_unpackhi_epi16(w, vZero);
+       for (k = 0; k < 2; k++)
+       {
+          __m128d lo = _mm_cvtepi32_pd(d[k]);
+          __m128d hi = _mm_cvtepi32_pd(_mm_srli_si128(d[k], 8));
+          DWORD o = p + k*4;
+
+          lo = _mm_sub_pd(_mm_mul_pd(lo, _mm_loadu_pd(pdScale + o)), _mm_loadu_pd(pdOffset + o));
+          hi = _mm_sub_pd(_mm_mul_pd(hi, _mm_loadu_pd(pdScale + o + 2)), _mm_loadu_pd(pdOffset + o + 2));
+          _mm_storeu_pd(fVoltage + i + k*4, lo);
+          _mm_storeu_pd(fVoltage + i + k*4 + 2, hi);
+       }
+
+       p += 8;
+       if (p == dwPattern) p = 0;
+    }
+#endif
+
+    for (; i < dwCount; i++)
+    {
+       fVoltage[i] = ((wRawData[i] & wAndMask) ^ wXorMask) * pdScale[p] - pdOffset[p];
+       if (++p == dwPattern) p = 0;
+    }
+}
+
+//
+// Converts analog input data from raw format to volts (for MF/MFS boards)
+//
+//
+int PdAInRawToVolts(int boardNumber,
+                       DWORD dwMode,          // Mode used
+                       WORD* wRawData,          // Raw data
+                       double* fVoltage,        // Engineering unit
+                       DWORD dwCount            // Number of samples to convert
+                     )
+{
+    Adapter_Info AdpInfo;
+    PSubSys_Info pSSI;
+    int retVal;
+    int i;
+    int modeIndex;
+    double dScale[PD_CONV_PATTERN];
+    double dOffset[PD_CONV_PATTERN];
+
+    // check parameters
+    if (!(wRawData && fVoltage && dwCount)) return -1;
+
+    retVal = _PdGetAInSSI(boardNumber, &AdpInfo, &pSSI);
+    if(retVal <0)
+       return retVal;
+
+    modeIndex = _PdAInGetModeIndex(pSSI, dwMode);
+
     // Perform one-channel conversion
-    for (i = 0; i < dwCount; i++)
+    for (i = 0; i < PD_CONV_PATTERN; i++)
     {
-        *(fVoltage + i) = ((*(wRawData + i) & AdpInfo.SSI[AnalogIn].wAndMask) ^ AdpInfo.SSI[AnalogIn].wXorMask) *
-                          AdpInfo.SSI[AnalogIn].fFactor[modeIndex] -
-                          AdpInfo.SSI[AnalogIn].fOffset[modeIndex];
+        dScale[i] = pSSI->fFactor[modeIndex];
+        dOffset[i] = pSSI->fOffset[modeIndex];
+    }
+
+    _PdAInConvertKernel(wRawData, fVoltage, dwCount, pSSI->wAndMask, pSSI->wXorMask,
+                        dScale, dOffset, PD_CONV_PATTERN);
 
-    }   
+    return 0;
+}
+
+//
+// Creates a prepared converter for AIn data acquired with configuration
+// dwMode and channel list dwChList (gain of each entry is applied).
+// dwChList can be NULL: then dwChListSize channels at gain index 0 are assumed.
+// Release with PdAInFreeConverter()
+//
+int PdAInCreateConverter(int boardNumber,
+                         DWORD dwMode,            // Mode used
+                         DWORD dwChListSize,      // Channel list size
+                         DWORD* dwChList,         // Pointer to the channel list
+                         PPD_AIN_CONVERTER* ppConv  // Converter (allocated here)
+                        )
+{
+    Adapter_Info AdpInfo;
+    PSubSys_Info pSSI;
+    PPD_AIN_CONVERTER pConv;
+    DWORD dwPattern;
+    int retVal;
+    int modeIndex;
+    DWORD i, ch;
+    double fGain;
+
+    // check parameters
+    if (!(ppConv && dwChListSize) || (dwChListSize > PD_MAX_CL_SIZE)) return -EINVAL;
+
+    retVal = _PdGetAInSSI(boardNumber, &AdpInfo, &pSSI);
+    if(retVal <0)
+       return retVal;
+
+    modeIndex = _PdAInGetModeIndex(pSSI, dwMode);
+
+    // one allocation: header then the four per-sample tables
+    dwPattern = dwChListSize * PD_CONV_PATTERN;
+    pConv = (PPD_AIN_CONVERTER)malloc(sizeof(PD_AIN_CONVERTER) + 
+                                      dwPattern * 2 * (sizeof(double) + sizeof(float)));
+    if (pConv == NULL)
+       return -ENOMEM;
+
+    pConv->dwChListSize = dwChListSize;
+    pConv->dwPattern = dwPattern;
+    pConv->wAndMask = pSSI->wAndMask;
+    pConv->wXorMask = pSSI->wXorMask;
+    pConv->pdScale = (double*)(pConv + 1);
+    pConv->pdOffset = pConv->pdScale + dwPattern;
+    pConv->pfScale = (float*)(pConv->pdOffset + dwPattern);
+    pConv->pfOffset = pConv->pfScale + dwPattern;
+
+    for (i = 0; i < dwPattern; i++)
+    {
+       ch = i % dwChListSize;
+       fGain = 1.0;
+       if (dwChList)
+       {
+          DWORD g = (dwChList[ch] >> 6) & 0x3;   // see GAIN() in powerdaq.h
+          if ((g < pSSI->dwMaxGains) && (pSSI->fGains[g] > 0))
+             fGain = pSSI->fGains[g];
+       }
+
+       pConv->pdScale[i] = pSSI->fFactor[modeIndex] / fGain;
+       pConv->pdOffset[i] = pSSI->fOffset[modeIndex] / fGain;
+       pConv->pfScale[i] = (float)pConv->pdScale[i];
+       pConv->pfOffset[i] = (float)pConv->pdOffset[i];
+    }
+
+    *ppConv = pConv;
+    return 0;
+}
+
+//
+// Releases converter created by PdAInCreateConverter()
+//
+void PdAInFreeConverter(PPD_AIN_CONVERTER pConv)
+{
+    free(pConv);
+}
+
+//
+// Converts interleaved AIn scans to volts (double). wRawData must start
+// at the beginning of a scan, dwCount is the number of samples
+//
+int PdAInConvert(PPD_AIN_CONVERTER pConv,
+                 WORD* wRawData,          // Raw data
+                 double* fVoltage,        // Engineering unit
+                 DWORD dwCount            // Number of samples to convert
+                )
+{
+    // check parameters
+    if (!(pConv && wRawData && fVoltage && dwCount)) return -1;
+
+    _PdAInConvertKernel(wRawData, fVoltage, dwCount, pConv->wAndMask, pConv->wXorMask,
+                        pConv->pdScale, pConv->pdOffset, pConv->dwPattern);
+    return 0;
+}
+
+//
+// Converts interleaved AIn scans to volts (float). wRawData must start
+// at the beginning of a scan, dwCount is the number of samples
+//
+int PdAInConvertF(PPD_AIN_CONVERTER pConv,
+                  WORD* wRawData,          // Raw data
+                  float* fVoltage,         // Engineering unit
+                  DWORD dwCount            // Number of samples to convert
+                 )
+{
+    // check parameters
+    if (!(pConv && wRawData && fVoltage && dwCount)) return -1;
 
+    _PdAInConvertKernelF(wRawData, fVoltage, dwCount, pConv->wAndMask, pConv->wXorMask,
+                         pConv->pfScale, pConv->pfOffset, pConv->dwPattern);
     return 0;
 }
 
@@ -0,0 +1,789 @@
+//=======================================================================
+//
+// NAME:    pdgroup.c
+//
+// SYNOPSIS:
+//
+//      Synchronized multi-board AIn group
+//
+//
+// DESCRIPTION:
+//
+//      This file runs the AIn subsystem of several boards as one
+//      acquisition. boards[0] is the master: it runs on its internal scan
+//      clock and the others take that clock from the PD-CONN-SYNC cable
+//      or from a PXI trigger line (or they all share an external clock).
+//      The slaves are started first, they do not convert until the
+//      master's clock runs, so all boards take scan 0 on the same edge.
+//
+//      A single consumer thread waits on all the boards with epoll,
+//      reads the buffer positions from the control pages, and hands the
+//      scans every board has to the application interleaved:
+//      scan n of board 0, scan n of board 1, ... It checks that every
+//      board's scan sequence is unbroken and that no board lags behind.
+//
+// OPTIONS: none
+//
+//
+// NOTES:   See notice below.
+//
+//
+//-----------------------------------------------------------------------
+//
+//      Copyright (C) 2004 United Electronic Industries, Inc.
+//      All rights reserved.
+//      United Electronic Industries Confidential Information.
+//
+//-----------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+
+#ifndef _PD_XENOMAI
+#include <sys/epoll.h>
+#endif
+
+#include "../include/win_sdk_types.h"
+#include "../include/powerdaq.h"
+#include "../include/powerdaq32.h"
+#include "../include/pd_debug.h"
+#include "../include/pxi.h"
+#include "../include/pdgroup.h"
+
+
+// ======================================================================
+// Module constants & variables
+
+// PXI lines of the MF boards, see Board_PXI_Info in pxi.c
+#define PXI_MF_CHAN_CLK_IN      1
+#define PXI_MF_CHAN_CLK_OUT     3
+#define PXI_MF_TRIG_IN          4
+
+// clock and trigger bits of the AIn configuration set by the group
+#define PD_GROUP_CFG_MASK       (AIB_CLSTART0 | AIB_CLSTART1 | \
+                                 AIB_STARTTRIG0 | AIB_STARTTRIG1)
+
+#define PD_GROUP_WAIT_MS        100     // consumer checks for stop this often
+
+// what has been done to a board, undone in reverse order
+enum
+{
+    grpClosed,
+    grpAcquired,
+    grpRegistered,
+    grpConfigured,
+    grpRunning
+};
+
+struct _PD_GROUP
+{
+    PD_GROUP_CONFIG     cfg;
+    int                 handle[PD_GROUP_MAX_BOARDS];
+    WORD*               pBuffer[PD_GROUP_MAX_BOARDS];
+    tDaqBufCtrl*        pCtrl[PD_GROUP_MAX_BOARDS];
+    int                 state[PD_GROUP_MAX_BOARDS];
+    int                 bPXI[PD_GROUP_MAX_BOARDS];  // PXI lines connected
+    DWORD               totalChannels;          // channels in a stream scan
+    DWORD               maxScans;               // scans in each DAQ buffer
+    WORD*               pStream;                // interleaved scans
+    pthread_t           thread;
+    int                 bThread;
+    volatile int        bStop;
+    PD_GROUP_CALLBACK   callback;
+    void*               arg;
+    pthread_mutex_t     lock;                   // protects status
+    PD_GROUP_STATUS     status;
+};
+
+
+//+
+// ----------------------------------------------------------------------
+// Function:    PdGroupSetError
+//
+// Parameters:  PD_GROUP* pGroup -- group
+//              int error        -- PD_GROUP_ERR_xxx
+//              int index        -- group index of the board in error
+//
+// Description: Keeps the first error, the later ones are consequences
+//
+// ----------------------------------------------------------------------
+//-
+static void PdGroupSetError(PD_GROUP* pGroup, int error, int index)
+{
+    pthread_mutex_lock(&pGroup->lock);
+    if (pGroup->status.error == PD_GROUP_ERR_NONE)
+    {
+        pGroup->status.error = error;
+        pGroup->status.errorBoard = index;
+    }
+    pthread_mutex_unlock(&pGroup->lock);
+
+    DPRINTK("PdGroup: board %d error %d\n", pGroup->cfg.boards[index].board, error);
+}
+
+
+//+
+// ----------------------------------------------------------------------
+// Function:    PdGroupSnapshot
+//
+// Parameters:  tDaqBufCtrl* pCtrl         -- control page of the board
+//              unsigned long long* pScans -- OUT: scans acquired since start
+//              DWORD* pEvents             -- OUT: subsystem events
+//
+// Description: Reads a consistent snapshot of the control page, see
+//              _PdAInPollScans
+//
+// ----------------------------------------------------------------------
+//-
+static void PdGroupSnapshot(tDaqBufCtrl* pCtrl, unsigned long long* pScans,
+                            DWORD* pEvents)
+{
+    volatile tDaqBufCtrl* pVCtrl = pCtrl;
+    DWORD Seq, Head, WrapCount, MaxValues, ScanValues, Events;
+
+    do
+    {
+        Seq = pVCtrl->Seq;
+        __sync_synchronize();
+        Head = pVCtrl->Head;
+        WrapCount = pVCtrl->WrapCount;
+        MaxValues = pVCtrl->MaxValues;
+        ScanValues = pVCtrl->ScanValues;
+        Events = pVCtrl->Events;
+        __sync_synchronize();
+    } while ((Seq & 1) || (Seq != pVCtrl->Seq));
+
+    *pScans = (ScanValues) ?
+              ((unsigned long long)WrapCount * MaxValues + Head) / ScanValues : 0;
+    *pEvents = Events;
+}
+
+
+//+
+// ----------------------------------------------------------------------
+// Function:    PdGroupInterleave
+//
+// Parameters:  PD_GROUP* pGroup       -- group
+//              unsigned long long first -- first scan to copy
+//              DWORD numScans         -- scans to copy, they must not
+//                                        cross the end of the buffers
+//
+// Description: Builds numScans stream scans in pStream
+//
+// ----------------------------------------------------------------------
+//-
+static void PdGroupInterleave(PD_GROUP* pGroup, unsigned long long first,
+                              DWORD numScans)
+{
+    DWORD index = (DWORD)(first % pGroup->maxScans);
+    DWORD offset = 0;
+    DWORD nbCh, i;
+    WORD *pSrc, *pDst;
+    int b;
+
+    for (b = 0; b < pGroup->cfg.nbBoards; b++)
+    {
+        nbCh = pGroup->cfg.boards[b].nbChannels;
+        pSrc = pGroup->pBuffer[b] + index * nbCh;
+        pDst = pGroup->pStream + offset;
+
+        for (i = 0; i < numScans; i++)
+        {
+            memcpy(pDst, pSrc, nbCh * sizeof(WORD));
+            pSrc += nbCh;
+            pDst += pGroup->totalChannels;
+        }
+
+        offset += nbCh;
+    }
+}
+
+
+#ifndef _PD_XENOMAI
+//+
+// ----------------------------------------------------------------------
+// Function:    PdGroupThreadProc
+//
+// Parameters:  void* arg -- group
+//
+// Description: Consumer thread. Only the boards that hold the group back
+//              (the fewest scans acquired) are waited on for data, the
+//              others would wake the thread up for nothing. All of them
+//              are waited on for errors.
+//
+// ----------------------------------------------------------------------
+//-
+static void* PdGroupThreadProc(void* arg)
+{
+    PD_GROUP* pGroup = (PD_GROUP*)arg;
+    int nbBoards = pGroup->cfg.nbBoards;
+    struct epoll_event ev, evs[PD_GROUP_MAX_BOARDS];
+    unsigned long long acquired[PD_GROUP_MAX_BOARDS];
+    unsigned long long prev[PD_GROUP_MAX_BOARDS];
+    unsigned long long readScans = 0, released = 0, minScans, maxScans;
+    DWORD armed[PD_GROUP_MAX_BOARDS];
+    DWORD events, idlems = 0, chunk, index;
+    int epfd, n, i, b;
+    sigset_t set;
+
+    // signals are for the application threads
+    sigfillset(&set);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+    epfd = epoll_create(nbBoards);
+    if (epfd < 0)
+    {
+        PdGroupSetError(pGroup, PD_GROUP_ERR_SYSTEM, 0);
+        pGroup->callback(pGroup->arg, NULL, 0, 0);
+        return NULL;
+    }
+
+    for (b = 0; b < nbBoards; b++)
+    {
+        prev[b] = 0;
+        armed[b] = ev.events = EPOLLIN | EPOLLPRI;
+        ev.data.fd = b;             // group index, not the handle
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, pGroup->handle[b], &ev) < 0)
+        {
+            PdGroupSetError(pGroup, PD_GROUP_ERR_SYSTEM, b);
+            goto exit;
+        }
+    }
+
+    while (!pGroup->bStop)
+    {
+        n = epoll_wait(epfd, evs, nbBoards, PD_GROUP_WAIT_MS);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            PdGroupSetError(pGroup, PD_GROUP_ERR_SYSTEM, 0);
+            break;
+        }
+
+        for (i = 0; i < n; i++)
+        {
+            if (evs[i].events & (EPOLLPRI | EPOLLERR))
+            {
+                PdGroupSetError(pGroup, PD_GROUP_ERR_OVERRUN, evs[i].data.fd);
+                goto exit;
+            }
+        }
+
+        // where is every board
+        minScans = maxScans = 0;
+        for (b = 0; b < nbBoards; b++)
+        {
+            PdGroupSnapshot(pGroup->pCtrl[b], &acquired[b], &events);
+
+            if (events & eStopped)
+            {
+                PdGroupSetError(pGroup, PD_GROUP_ERR_STOPPED, b);
+                goto exit;
+            }
+
+            // the scans not read yet must all still be in the buffer
+            if ((acquired[b] < prev[b]) || (acquired[b] - readScans > pGroup->maxScans))
+            {
+                PdGroupSetError(pGroup, PD_GROUP_ERR_SEQUENCE, b);
+                goto exit;
+            }
+            prev[b] = acquired[b];
+
+            if (!b || (acquired[b] < minScans))
+                minScans = acquired[b];
+            if (!b || (acquired[b] > maxScans))
+                maxScans = acquired[b];
+        }
+
+        pthread_mutex_lock(&pGroup->lock);
+        for (b = 0; b < nbBoards; b++)
+            pGroup->status.boardScans[b] = acquired[b];
+        pthread_mutex_unlock(&pGroup->lock);
+
+        // on a common clock the boards stay within a few transfers
+        if (maxScans - minScans > pGroup->maxScans / 2)
+        {
+            for (b = 0; acquired[b] != minScans; b++);
+            PdGroupSetError(pGroup, PD_GROUP_ERR_SKEW, b);
+            break;
+        }
+
+        if (minScans == readScans)
+        {
+            idlems += (n) ? 0 : PD_GROUP_WAIT_MS;
+            if (pGroup->cfg.timeoutms && (idlems >= pGroup->cfg.timeoutms))
+            {
+                for (b = 0; acquired[b] != minScans; b++);
+                PdGroupSetError(pGroup, PD_GROUP_ERR_TIMEOUT, b);
+                break;
+            }
+        }
+        else
+            idlems = 0;
+
+        // hand over what every board has, in blocks that don't cross the
+        // end of the buffers
+        while (readScans < minScans)
+        {
+            index = (DWORD)(readScans % pGroup->maxScans);
+            chunk = pGroup->maxScans - index;
+            if (chunk > pGroup->cfg.scansPerFrame)
+                chunk = pGroup->cfg.scansPerFrame;
+            if (chunk > minScans - readScans)
+                chunk = (DWORD)(minScans - readScans);
+
+            PdGroupInterleave(pGroup, readScans, chunk);
+            pGroup->callback(pGroup->arg, pGroup->pStream, chunk, readScans);
+            readScans += chunk;
+
+            pthread_mutex_lock(&pGroup->lock);
+            pGroup->status.scans = readScans;
+            pthread_mutex_unlock(&pGroup->lock);
+        }
+
+        for (b = 0; b < nbBoards; b++)
+        {
+            // give the frames read back to the driver
+            if ((readScans != released) &&
+                (_PdAInReleaseScans(pGroup->handle[b],
+                                    (DWORD)(readScans % pGroup->maxScans)) < 0))
+            {
+                PdGroupSetError(pGroup, PD_GROUP_ERR_SYSTEM, b);
+                goto exit;
+            }
+
+            // wait for data only on the boards that are behind
+            ev.events = EPOLLPRI;
+            if (acquired[b] == minScans)
+                ev.events |= EPOLLIN;
+            if (ev.events != armed[b])
+            {
+                ev.data.fd = b;
+                epoll_ctl(epfd, EPOLL_CTL_MOD, pGroup->handle[b], &ev);
+                armed[b] = ev.events;
+            }
+        }
+        released = readScans;
+    }
+
+exit:
+    close(epfd);
+
+    if (pGroup->status.error != PD_GROUP_ERR_NONE)
+        pGroup->callback(pGroup->arg, NULL, 0, readScans);
+
+    return NULL;
+}
+#endif
+
+
+//+
+// ----------------------------------------------------------------------
+// Function:    PdGroupRoutePXI
+//
+// Parameters:  PD_GROUP* pGroup -- group
+//              int index        -- group index of the board
+//
+// Returns:     Negative error code or 0
+//
+// Description: Connects the scan clock (out on the master, in on the
+//              slaves) and the start trigger to the PXI lines
+//
+// ----------------------------------------------------------------------
+//-
+static int PdGroupRoutePXI(PD_GROUP* pGroup, int index)
+{
+    int board = pGroup->cfg.boards[index].board;
+    PD_BOARD_PXI_LINES* pLines;
+    int ret;
+
+    pLines = _PdPXIGetAdapterInfo(board);
+    if (!pLines || (pLines->BoardType != atMF))
+    {
+        DPRINTK("PdGroup: board %d is not a PXI MF board\n", board);
+        return -ENODEV;
+    }
+
+    pGroup->bPXI[index] = 1;
+
+    ret = _PdPXIConnectLine(board, (index) ? PXI_MF_CHAN_CLK_IN : PXI_MF_CHAN_CLK_OUT,
+                            pGroup->cfg.clockLine);
+    if ((ret >= 0) && (pGroup->cfg.flags & PD_GROUP_STARTTRIG))
+        ret = _PdPXIConnectLine(board, PXI_MF_TRIG_IN, pGroup->cfg.trigLine);
+    if (ret >= 0)
+        ret = _PdPXIConnect(board);
+
+    return (ret < 0) ? ret : 0;
+}
+
+
+//+
+// ----------------------------------------------------------------------
+// Function:    PdGroupInitBoard
+//
+// Parameters:  PD_GROUP* pGroup -- group
+//              int index        -- group index of the board
+//
+// Returns:     Negative error code or 0
+//
+// Description: Acquires the AIn subsystem, registers its DAQ buffer and
+//              programs the acquisition, without starting it
+//
+// ----------------------------------------------------------------------
+//-
+static int PdGroupInitBoard(PD_GROUP* pGroup, int index)
+{
+    PD_GROUP_BOARD* pBoard = &pGroup->cfg.boards[index];
+    DWORD events = eFrameDone | eBufferError | eStopped;
+    DWORD aiCfg, divider = 0;
+    int ret;
+
+    pGroup->handle[index] = PdAcquireSubsystem(pBoard->board, AnalogIn, 1);
+    if (pGroup->handle[index] < 0)
+        return pGroup->handle[index];
+    pGroup->state[index] = grpAcquired;
+
+    ret = _PdAInReset(pGroup->handle[index]);
+    if (ret < 0)
+        return ret;
+
+    // no recycling: an over run stops the board rather than dropping
+    // frames from one stream only
+    ret = _PdRegisterBuffer(pGroup->handle[index], &pGroup->pBuffer[index], AnalogIn,
+                            pGroup->cfg.nbFrames, pGroup->cfg.scansPerFrame,
+                            pBoard->nbChannels, BUF_BUFFERWRAPPED);
+    if (ret < 0)
+        return ret;
+    pGroup->state[index] = grpRegistered;
+
+    ret = _PdMapDaqBufCtrl(pGroup->handle[index], AnalogIn, &pGroup->pCtrl[index]);
+    if (ret < 0)
+        return ret;
+
+    aiCfg = pBoard->aiCfg & ~PD_GROUP_CFG_MASK;
+    if (!(aiCfg & (AIB_CVSTART0 | AIB_CVSTART1)))
+        aiCfg |= AIN_CV_CLOCK_CONTINUOUS;
+    if (!index && (pGroup->cfg.syncMode != PD_GROUP_SYNC_EXTCLOCK))
+        aiCfg |= AIN_CL_CLOCK_INTERNAL;
+    else
+        aiCfg |= AIN_CL_CLOCK_EXTERNAL;
+    if (pGroup->cfg.flags & PD_GROUP_STARTTRIG)
+        aiCfg |= AIN_START_TRIGGER_RISE;
+
+    // set clock divider, assuming that we use the 11MHz timebase
+    if (pGroup->cfg.scanRate > 0)
+        divider = (11000000.0 / pGroup->cfg.scanRate) - 1;
+
+    ret = _PdAInAsyncInit(pGroup->handle[index], aiCfg, 0, 0, divider, divider,
+                          events, pBoard->nbChannels, pBoard->channelList);
+    if (ret < 0)
+        return ret;
+    pGroup->state[index] = grpConfigured;
+
+    return 0;
+}
+
+
+//+
+// ----------------------------------------------------------------------
+// Function:    _PdGroupCreate
+//
+// Parameters:  PD_GROUP_CONFIG* pConfig -- boards and synchronization
+//              PD_GROUP** ppGroup       -- OUT: new group
+//
+// Returns:     Negative error code or 0
+//
+// Description: Routes the clock and trigger lines and arms the AIn
+//              subsystem of every board of the group. The acquisition
+//              starts with _PdGroupStart.
+//
+// Notes:       All the boards use the same frame size and number of
+//              frames, so scan n is at the same place in every buffer.
+//
+// ----------------------------------------------------------------------
+//-
+int _PdGroupCreate(PD_GROUP_CONFIG* pConfig, PD_GROUP** ppGroup)
+{
+    PD_GROUP* pGroup;
+    int b, ret;
+
+#ifdef _PD_XENOMAI
+    return -ENOSYS;
+#endif
+
+    *ppGroup = NULL;
+
+    if ((pConfig->nbBoards < 1) || (pConfig->nbBoards > PD_GROUP_MAX_BOARDS) ||
+        !pConfig->scansPerFrame || (pConfig->nbFrames < 2) ||
+        (pConfig->syncMode > PD_GROUP_SYNC_EXTCLOCK) ||
+        ((pConfig->syncMode != PD_GROUP_SYNC_EXTCLOCK) && (pConfig->scanRate <= 0)))
+        return -EINVAL;
+
+    pGroup = (PD_GROUP*)calloc(1, sizeof(PD_GROUP));
+    if (!pGroup)
+        return -ENOMEM;
+
+    pGroup->cfg = *pConfig;
+    pGroup->maxScans = pConfig->scansPerFrame * pConfig->nbFrames;
+    pthread_mutex_init(&pGroup->lock, NULL);
+
+    for (b = 0; b < pConfig->nbBoards; b++)
+    {
+        if (!pConfig->boards[b].nbChannels || (pConfig->boards[b].nbChannels > 64))
+        {
+            _PdGroupDestroy(pGroup);
+            return -EINVAL;
+        }
+        pGroup->totalChannels += pConfig->boards[b].nbChannels;
+    }
+
+    pGroup->pStream = (WORD*)malloc(pConfig->scansPerFrame * pGroup->totalChannels *
+                                    sizeof(WORD));
+    if (!pGroup->pStream)
+    {
+        _PdGroupDestroy(pGroup);
+        return -ENOMEM;
+    }
+
+    for (b = 0; b < pConfig->nbBoards; b++)
+    {
+        ret = 0;
+        if (pConfig->syncMode == PD_GROUP_SYNC_PXI)
+            ret = PdGroupRoutePXI(pGroup, b);
+        if (ret >= 0)
+            ret = PdGroupInitBoard(pGroup, b);
+        if (ret < 0)
+        {
+            DPRINTK("PdGroup: cannot set up board %d, error %d\n",
+                    pConfig->boards[b].board, ret);
+            _PdGroupDestroy(pGroup);
+            return ret;
+        }
+    }
+
+    *ppGroup = pGroup;
+
+    return 0;
+}
+
+
+//+
+// ----------------------------------------------------------------------
+// Function:    _PdGroupStart
+//
+// Parameters:  PD_GROUP* pGroup           -- group
+//              PD_GROUP_CALLBACK callback -- receives the interleaved scans
+//              void* arg                  -- passed to the callback
+//
+// Returns:     Negative error code or 0
+//
+// Description: Starts the consumer thread, then the slaves and the master
+//              last: the slaves wait for its clock. With
+//              PD_GROUP_STARTTRIG all of them wait for the trigger.
+//
+// ----------------------------------------------------------------------
+//-
+int _PdGroupStart(PD_GROUP* pGroup, PD_GROUP_CALLBACK callback, void* arg)
+{
+    int b, ret;
+
+#ifdef _PD_XENOMAI
+    return -ENOSYS;
+#else
+    if (pGroup->bThread)
+        return -EBUSY;
+    if (!callback)
+        return -EINVAL;
+
+    pGroup->callback = callback;
+    pGroup->arg = arg;
+    pGroup->bStop = 0;
+    memset(&pGroup->status, 0, sizeof(PD_GROUP_STATUS));
+
+    ret = pthread_create(&pGroup->thread, NULL, PdGroupThreadProc, pGroup);
+    if (ret)
+        return -ret;
+    pGroup->bThread = 1;
+
+    for (b = pGroup->cfg.nbBoards - 1; b >= 0; b--)
+    {
+        ret = _PdAInAsyncStart(pGroup->handle[b]);
+        if (ret < 0)
+        {
+            _PdGroupStop(pGroup);
+            return ret;
+        }
+        pGroup->state[b] = grpRunning;
+    }
+
+    return 0;
+#endif
+}
+
+
+//+
+// ----------------------------------------------------------------------
+// Function:    _PdGroupStop
+//
+// Parameters:  PD_GROUP* pGroup -- group
+//
+// Returns:     Negative error code or 0
+//
+// Description: Stops the consumer thread, then the master first, so the
+//              slaves stop on the same scan, then the slaves
+//
+// ----------------------------------------------------------------------
+//-
+int _PdGroupStop(PD_GROUP* pGroup)
+{
+    int b, ret, result = 0;
+
+    // the stops would look like errors to the thread
+    if (pGroup->bThread)
+    {
+        pGroup->bStop = 1;
+        pthread_join(pGroup->thread, NULL);
+        pGroup->bThread = 0;
+    }
+
+    for (b = 0; b < pGroup->cfg.nbBoards; b++)
+    {
+        if (pGroup->state[b] != grpRunning)
+            continue;
+
+        ret = _PdAInAsyncStop(pGroup->handle[b]);
+        if ((ret < 0) && !result)
+            result = ret;
+        pGroup->state[b] = grpConfigured;
+    }
+
+    return result;
+}
+
+
+//+
+// ----------------------------------------------------------------------
+// Function:    _PdGroupGetStatus
+//
+// Parameters:  PD_GROUP* pGroup         -- group
+//              PD_GROUP_STATUS* pStatus -- OUT: status
+//
+// Returns:     0
+//
+// Description: Scans delivered and acquired, and the first error
+//
+// ----------------------------------------------------------------------
+//-
+int _PdGroupGetStatus(PD_GROUP* pGroup, PD_GROUP_STATUS* pStatus)
+{
+    pthread_mutex_lock(&pGroup->lock);
+    *pStatus = pGroup->status;
+    pthread_mutex_unlock(&pGroup->lock);
+
+    return 0;
+}
+
+
+//+
+// ----------------------------------------------------------------------
+// Function:    _PdGroupGetConfig
+//
+// Parameters:  PD_GROUP* pGroup         -- group
+//              PD_GROUP_CONFIG* pConfig -- OUT: configuration
+//
+// Returns:     0
+//
+// Description: Configuration the group was created with
+//
+// ----------------------------------------------------------------------
+//-
+int _PdGroupGetConfig(PD_GROUP* pGroup, PD_GROUP_CONFIG* pConfig)
+{
+    *pConfig = pGroup->cfg;
+    return 0;
+}
+
+
+//+
+// ----------------------------------------------------------------------
+// Function:    _PdGroupGetDaqBufCtrl
+//
+// Parameters:  PD_GROUP* pGroup -- group
+//              int index        -- group index of the board
+//
+// Returns:     Control page of the board's DAQ buffer, NULL if none
+//
+// Description: The page stays mapped until _PdGroupDestroy, use it to
+//              read the board's frame stamps
+//
+// ----------------------------------------------------------------------
+//-
+tDaqBufCtrl* _PdGroupGetDaqBufCtrl(PD_GROUP* pGroup, int index)
+{
+    if ((index < 0) || (index >= pGroup->cfg.nbBoards))
+        return NULL;
+
+    return pGroup->pCtrl[index];
+}
+
+
+//+
+// ----------------------------------------------------------------------
+// Function:    _PdGroupDestroy
+//
+// Parameters:  PD_GROUP* pGroup -- group
+//
+// Returns:     Negative error code or 0
+//
+// Description: Stops the group if needed, releases the boards and
+//              disconnects the PXI lines
+//
+// ----------------------------------------------------------------------
+//-
+int _PdGroupDestroy(PD_GROUP* pGroup)
+{
+    int b, board;
+
+    _PdGroupStop(pGroup);
+
+    for (b = pGroup->cfg.nbBoards - 1; b >= 0; b--)
+    {
+        board = pGroup->cfg.boards[b].board;
+
+        if (pGroup->state[b] >= grpConfigured)
+        {
+            _PdClearUserEvents(pGroup->handle[b], AnalogIn, eAllEvents);
+            _PdAInAsyncTerm(pGroup->handle[b]);
+        }
+
+        if (pGroup->pCtrl[b])
+            _PdUnmapDaqBufCtrl(pGroup->pCtrl[b]);
+
+        if (pGroup->state[b] >= grpRegistered)
+            _PdUnregisterBuffer(pGroup->handle[b], pGroup->pBuffer[b], AnalogIn);
+
+        if (pGroup->state[b] >= grpAcquired)
+            PdAcquireSubsystem(pGroup->handle[b], AnalogIn, 0);
+
+        if (pGroup->bPXI[b])
+        {
+            _PdPXIDisconnectLine(board, (b) ? PXI_MF_CHAN_CLK_IN : PXI_MF_CHAN_CLK_OUT);
+            if (pGroup->cfg.flags & PD_GROUP_STARTTRIG)
+                _PdPXIDisconnectLine(board, PXI_MF_TRIG_IN);
+            _PdPXIDisconnect(board);
+        }
+    }
+
+    pthread_mutex_destroy(&pGroup->lock);
+    free(pGroup->pStream);
+    free(pGroup);
+
+    return 0;
+}
@@ -0,0 +1,880 @@
+//=======================================================================
+//
+// NAME:    pdrecfile.c
+//
+// SYNOPSIS:
+//
+//      Random access to the files written by the AIn stream recorder
+//
+//
+// DESCRIPTION:
+//
+//      This file maps a recording (pdrecord.h) read-only and reads any
+//      range of scans without reading what comes before. The blocks all
+//      hold blockScans scans but the last one, so the block of a scan is
+//      found by a division. The frame stamps saved in the block headers
+//      give the scan taken at a given host time.
+//
+//      It also builds a min/max overview: level 0 has the minimum and
+//      maximum of every channel over each PD_REC_OVW_BASE scans, each
+//      level above merges PD_REC_OVW_FACTOR entries of the level below.
+//      A plot of any range then reads a few thousand entries whatever
+//      the length of the range. The overview is saved next to the
+//      recording as <file>.ovw and loaded from there the next time.
+//
+// OPTIONS: none
+//
+//
+// NOTES:   See notice below.
+//
+//
+//-----------------------------------------------------------------------
+//
+//      Copyright (C) 2004 United Electronic Industries, Inc.
+//      All rights reserved.
+//      United Electronic Industries Confidential Information.
+//
+//-----------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "../include/win_sdk_types.h"
+#include "../include/powerdaq.h"
+#include "../include/powerdaq32.h"
+#include "../include/pd_debug.h"
+#include "../include/pdgroup.h"
+#include "../include/pdrecord.h"
+
+// ======================================================================
+// Module constants & variables
+
+#define PD_REC_MAX_TOTAL_CHANNELS   (PD_REC_MAX_BOARDS * PD_REC_MAX_CHANNELS)
+
+struct _PD_REC_FILE
+{
+    int                 fd;
+    BYTE*               pMap;               // whole file, read-only
+    size_t              mapSize;
+    PD_REC_HEADER*      pHeader;
+    DWORD               nbBlocks;           // complete blocks found
+    unsigned long long  totalScans;
+    char*               ovwName;            // <file>.ovw
+    PD_REC_OVW_HEADER   ovw;
+    WORD*               pOverview;          // all the levels, NULL: not loaded
+    WORD*               pLevel[PD_REC_OVW_MAX_LEVELS];
+    WORD                andMask[PD_REC_MAX_TOTAL_CHANNELS];  // per stream channel
+    WORD                xorMask[PD_REC_MAX_TOTAL_CHANNELS];
+    double              scale[PD_REC_MAX_TOTAL_CHANNELS];
+    double              offset[PD_REC_MAX_TOTAL_CHANNELS];
+};
+
+
+//+
+// ----------------------------------------------------------------------
+// Function:    PdRecFileBlock
+//
+// Parameters:  PD_REC_FILE* pFile -- recording
+//              DWORD k            -- block number
+//
+// Returns:     Header of block k
+//
+// ----------------------------------------------------------------------
+//-
+static PD_REC_BLOCK* PdRecFileBlock(PD_REC_FILE* pFile, DWORD k)
+{
+    return (PD_REC_BLOCK*)(pFile->pMap + pFile->pHeader->headerSize +
+                           (size_t)k * pFile->pHeader->blockBytes);
+}
+
+
+//+
+// ----------------------------------------------------------------------
+// Function:    PdRecFileBlockScans
+//
+// Parameters:  PD_REC_FILE* pFile -- recording
+//              DWORD k            -- block number, < nbBlocks
+//
+// Returns:     Scans in block k. Derived from totalScans, which was
+//              checked at open, rather than from the block header.
+//
+// ----------------------------------------------------------------------
+//-
+static DWORD PdRecFileBlockScans(PD_REC_FILE* pFile, DWORD k)
+{
+    unsigned long long first = (unsigned long long)k * pFile->pHeader->blockScans;
+
+    if (pFile->totalScans - first < pFile->pHeader->blockScans)
+        return (DWORD)(pFile->totalScans - first);
+    return pFile->pHeader->blockScans;
+}
+
+
+//+
+// ----------------------------------------------------------------------
+// Function:    PdRecFileScans
+//
+// Parameters:  PD_REC_FILE* pFile -- recording
+//              unsigned long long scan -- scan number, < totalScans
+//              DWORD* pCount      -- OUT: scans that follow in the block,
+//                                    that one included
+//
+// Returns:     Raw samples of the scan
+//
+// ----------------------------------------------------------------------
+//-
+static WORD* PdRecFileScans(PD_REC_FILE* pFile, unsigned long long scan, DWORD* pCount)
+{
+    PD_REC_HEADER* pHeader = pFile->pHeader;
+    DWORD k = (DWORD)(scan / pHeader->blockScans);
+    DWORD index = (DWORD)(scan % pHeader->blockScans);
+    PD_REC_BLOCK* pBlock = PdRecFileBlock(pFile, k);
+
+    *pCount = PdRecFileBlockScans(pFile, k) - index;
+    return (WORD*)((BYTE*)pBlock + pHeader->blockHeaderSize) + index * pHeader->totalChannels;
+}
+
+
+//+
+// ----------------------------------------------------------------------
+// Function:    PdRecFileBlockTime
+//
+// Parameters:  PD_REC_FILE* pFile -- recording
+//              DWORD k            -- block number
+//              unsigned long long* pScan -- OUT: scan number
+//              unsigned long long* pTime -- OUT: CLOCK_MONOTONIC ns
+//
+// Description: A scan of block k and the time it got to the host: from
+//              the frame stamp of the first board if there is one, else
+//              the block's end and the time it was filled (later)
+//
+// ----------------------------------------------------------------------
+//-
+static void PdRecFileBlockTime(PD_REC_FILE* pFile, DWORD k, unsigned long long* pScan,
+                               unsigned long long* pTime)
+{
+    PD_REC_BLOCK* pBlock = PdRecFileBlock(pFile, k);
+    tFrameStamp stamp = pBlock->stamps[0];
+
+    if (stamp.Seq != PD_FRAMESTAMP_INVALID)
+    {
+        *pScan = (((unsigned long long)stamp.ValueIndexHigh << 32) | stamp.ValueIndexLow) /
+                 pFile->pHeader->boards[0].nbChannels;
+        *pTime = ((unsigned long long)stamp.TimestampHigh << 32) | stamp.TimestampLow;
+    }
+    else
+    {
+        *pScan = pBlock->firstScan + PdRecFileBlockScans(pFile, k);
+        *pTime = pBlock->hostTime;
+    }
+}
+
+
+//+
+// ----------------------------------------------------------------------
+// Function:    _PdRecFileOpen
+//
+// Parameters:  const char* fileName -- recording
+//              PD_REC_FILE** ppFile -- OUT: opened recording
+//
+// Returns:     Negative error code or 0
+//
+// Description: Maps the recording and checks its header. If the
+//              recorder wasn't closed, or the totals in the header don't
+//              fit its blocks, the blocks are counted up to the first
+//              incomplete one.
+//
+// ----------------------------------------------------------------------
+//-
+int _PdRecFileOpen(const char* fileName, PD_REC_FILE** ppFile)
+{
+    PD_REC_FILE* pFile;
+    PD_REC_HEADER* pHeader;
+    PD_REC_BLOCK* pBlock;
+    struct stat st;
+    DWORD avail, b, i, c = 0;
+    int ret;
+
+    if (!fileName || !ppFile)
+        return -EINVAL;
+
+    pFile = (PD_REC_FILE*)calloc(1, sizeof(PD_REC_FILE));
+    if (!pFile)
+        return -ENOMEM;
+    pFile->fd = -1;
+    pFile->pMap = MAP_FAILED;
+
+    pFile->ovwName = (char*)malloc(strlen(fileName) + 5);
+    if (!pFile->ovwName)
+    {
+        ret = -ENOMEM;
+        goto error;
+    }
+    sprintf(pFile->ovwName, "%s.ovw", fileName);
+
+    pFile->fd = open(fileName, O_RDONLY);
+    if ((pFile->fd < 0) || fstat(pFile->fd, &st))
+    {
+        ret = -errno;
+        goto error;
+    }
+
+    ret = -EINVAL;
+    if (st.st_size < PD_REC_HEADER_SIZE)
+        goto error;
+
+    pFile->mapSize = st.st_size;
+    pFile->pMap = (BYTE*)mmap(NULL, pFile->mapSize, PROT_READ, MAP_SHARED, pFile->fd, 0);
+    if (pFile->pMap == MAP_FAILED)
+    {
+        ret = -errno;
+        goto error;
+    }
+    pHeader = pFile->pHeader = (PD_REC_HEADER*)pFile->pMap;
+
+    if ((pHeader->magic != PD_REC_MAGIC) || (pHeader->version != PD_REC_VERSION) ||
+        (pHeader->headerSize < sizeof(PD_REC_HEADER)) ||
+        (pHeader->headerSize > pFile->mapSize) ||
+        (pHeader->blockHeaderSize < sizeof(PD_REC_BLOCK)) ||
+        (pHeader->blockBytes < pHeader->blockHeaderSize) ||
+        (pHeader->sampleSize != sizeof(WORD)) || !pHeader->blockScans ||
+        (pHeader->nbBoards < 1) || (pHeader->nbBoards > PD_REC_MAX_BOARDS) ||
+        ((unsigned long long)pHeader->blockScans * pHeader->totalChannels * sizeof(WORD) >
+         pHeader->blockBytes - pHeader->blockHeaderSize))
+        goto error;
+
+    // stream channel c is channel i of board b
+    for (b = 0; b < pHeader->nbBoards; b++)
+    {
+        if (!pHeader->boards[b].nbChannels ||
+            (pHeader->boards[b].nbChannels > PD_REC_MAX_CHANNELS) ||
+            (pHeader->boards[b].firstChannel != c))
+            goto error;
+
+        for (i = 0; i < pHeader->boards[b].nbChannels; i++, c++)
+        {
+            pFile->andMask[c] = pHeader->boards[b].andMask;
+            pFile->xorMask[c] = pHeader->boards[b].xorMask;
+            pFile->scale[c] = pHeader->boards[b].scale[i];
+            pFile->offset[c] = pHeader->boards[b].offset[i];
+        }
+    }
+    if (!c || (c != pHeader->totalChannels))
+        goto error;
+
+    // all blocks but the last one are full
+    avail = (pFile->mapSize - pHeader->headerSize) / pHeader->blockBytes;
+    if (pHeader->nbBlocks && (pHeader->nbBlocks <= avail) &&
+        ((unsigned long long)(pHeader->nbBlocks - 1) * pHeader->blockScans < pHeader->totalScans) &&
+        (pHeader->totalScans <= (unsigned long long)pHeader->nbBlocks * pHeader->blockScans))
+    {
+        pFile->nbBlocks = pHeader->nbBlocks;
+        pFile->totalScans = pHeader->totalScans;
+    }
+    else
+    {
+        // not closed: a partial block is the last one
+        while (pFile->nbBlocks < avail)
+        {
+            pBlock = PdRecFileBlock(pFile, pFile->nbBlocks);
+            if ((pBlock->magic != PD_REC_BLOCK_MAGIC) || (pBlock->seq != pFile->nbBlocks) ||
+                (pBlock->numScans > pHeader->blockScans))
+                break;
+
+            pFile->nbBlocks++;
+            pFile->totalScans += pBlock->numScans;
+            if (pBlock->numScans < pHeader->blockScans)
+                break;
+        }
+    }
+
+    *ppFile = pFile;
+    return 0;
+
+error:
+    DPRINTK_F("_PdRecFileOpen: can't open %s, error %d\n", fileName, ret);
+    _PdRecFileClose(pFile);
+    return ret;
+}
+
+
+//+
+// ----------------------------------------------------------------------
+// Function:    _PdRecFileGetHeader
+//
+// Parameters:  PD_REC_FILE* pFile -- recording
+//
+// Returns:     Header of the recording, in the mapping
+//
+// ----------------------------------------------------------------------
+//-
+PD_REC_HEADER* _PdRecFileGetHeader(PD_REC_FILE* pFile)
+{
+    return pFile->pHeader;
+}
+
+
+//+
+// ----------------------------------------------------------------------
+// Function:    _PdRecFileGetScans
+//
+// Parameters:  PD_REC_FILE* pFile -- recording
+//
+// Returns:     Number of scans that can be read
+//
+// ----------------------------------------------------------------------
+//-
+unsigned long long _PdRecFileGetScans(PD_REC_FILE* pFile)
+{
+    return pFile->totalScans;
+}
+
+
+//+
+// ----------------------------------------------------------------------
+// Function:    _PdRecFileRead
+//
+// Parameters:  PD_REC_FILE* pFile -- recording
+//              unsigned long long firstScan -- first scan to read
+//              DWORD numScans     -- scans to read
+//              WORD* pScans       -- OUT: numScans * totalChannels raw samples
+//              DWORD* pNumRet     -- OUT: scans read, fewer at the end
+//
+// Returns:     Negative error code or 0
+//
+// Description: Copies raw interleaved scans out of the mapping
+//
+// ----------------------------------------------------------------------
+//-
+int _PdRecFileRead(PD_REC_FILE* pFile, unsigned long long firstScan, DWORD numScans,
+                   WORD* pScans, DWORD* pNumRet)
+{
+    DWORD channels = pFile->pHeader->totalChannels;
+    DWORD count, n = 0;
+    WORD* pSrc;
+
+    if (!pScans || !pNumRet)
+        return -EINVAL;
+
+    if (firstScan >= pFile->totalScans)
+        numScans = 0;
+    else if (numScans > pFile->totalScans - firstScan)
+        numScans = (DWORD)(pFile->totalScans - firstScan);
+
+    while (n < numScans)
+    {
+        pSrc = PdRecFileScans(pFile, firstScan + n, &count);
+        if (count > numScans - n)
+            count = numScans - n;
+
+        memcpy(pScans + (size_t)n * channels, pSrc, (size_t)count * channels * sizeof(WORD));
+        n += count;
+    }
+
+    *pNumRet = n;
+    return 0;
+}
+
+
+//+
+// ----------------------------------------------------------------------
+// Function:    _PdRecFileReadVolts
+//
+// Parameters:  PD_REC_FILE* pFile -- recording
+//              unsigned long long firstScan -- first scan to read
+//              DWORD numScans     -- scans to read
+//              double* pVolts     -- OUT: numScans * totalChannels values
+//              DWORD* pNumRet     -- OUT: scans read, fewer at the end
+//
+// Returns:     Negative error code or 0
+//
+// Description: Reads interleaved scans converted to volts with the
+//              calibration saved in the header
+//
+// ----------------------------------------------------------------------
+//-
+int _PdRecFileReadVolts(PD_REC_FILE* pFile, unsigned long long firstScan, DWORD numScans,
+                        double* pVolts, DWORD* pNumRet)
+{
+    DWORD channels = pFile->pHeader->totalChannels;
+    DWORD count, n = 0, i, c;
+    WORD* pSrc;
+
+    if (!pVolts || !pNumRet)
+        return -EINVAL;
+
+    if (firstScan >= pFile->totalScans)
+        numScans = 0;
+    else if (numScans > pFile->totalScans - firstScan)
+        numScans = (DWORD)(pFile->totalScans - firstScan);
+
+    while (n < numScans)
+    {
+        pSrc = PdRecFileScans(pFile, firstScan + n, &count);
+        if (count > numScans - n)
+            count = numScans - n;
+
+        for (i = 0; i < count; i++, pSrc += channels, pVolts += channels)
+            for (c = 0; c < channels; c++)
+                pVolts[c] = ((pSrc[c] & pFile->andMask[c]) ^ pFile->xorMask[c]) *
+                            pFile->scale[c] - pFile->offset[c];
+        n += count;
+    }
+
+    *pNumRet = n;
+    return 0;
+}
+
+
+//+
+// ----------------------------------------------------------------------
+// Function:    _PdRecFileScanAtTime
+//
+// Parameters:  PD_REC_FILE* pFile -- recording
+//              unsigned long long hostTime -- CLOCK_MONOTONIC ns
+//              unsigned long long* pScan   -- OUT: scan taken at that time
+//
+// Returns:     Negative error code or 0
+//
+// Description: Finds the blocks around hostTime by bisection and
+//              interpolates between their frame stamps. Before the
+//              first and after the last, extrapolates at the scan rate.
+//              The result is limited to the scans of the recording.
+//
+// Notes:       Without frame stamps (RT kernels) the time the blocks
+//              were filled is used, which is later by up to a block.
+//
+// ----------------------------------------------------------------------
+//-
+int _PdRecFileScanAtTime(PD_REC_FILE* pFile, unsigned long long hostTime,
+                         unsigned long long* pScan)
+{
+    unsigned long long scan0, time0, scan1, time1;
+    double scan, rate = pFile->pHeader->scanRate;
+    DWORD lo, hi, mid;
+
+    if (!pScan || !pFile->nbBlocks || (rate <= 0))
+        return -EINVAL;
+
+    // last block at or before hostTime
+    PdRecFileBlockTime(pFile, 0, &scan0, &time0);
+    if (hostTime < time0)
+    {
+        scan = scan0 - (time0 - hostTime) * rate / 1e9;
+    }
+    else
+    {
+        lo = 0;
+        hi = pFile->nbBlocks - 1;
+        while (lo < hi)
+        {
+            mid = (lo + hi + 1) / 2;
+            PdRecFileBlockTime(pFile, mid, &scan1, &time1);
+            if (time1 <= hostTime)
+                lo = mid;
+            else
+                hi = mid - 1;
+        }
+
+        PdRecFileBlockTime(pFile, lo, &scan0, &time0);
+        if (lo + 1 < pFile->nbBlocks)
+            PdRecFileBlockTime(pFile, lo + 1, &scan1, &time1);
+        else
+            time1 = time0;
+
+        if (time1 > time0)
+            scan = scan0 + ((double)scan1 - scan0) * (hostTime - time0) / (time1 - time0);
+        else
+            scan = scan0 + (hostTime - time0) * rate / 1e9;
+    }
+
+    if (scan < 0)
+        *pScan = 0;
+    else if (scan >= pFile->totalScans)
+        *pScan = (pFile->totalScans) ? pFile->totalScans - 1 : 0;
+    else
+        *pScan = (unsigned long long)scan;
+
+    return 0;
+}
+
+
+//+
+// ----------------------------------------------------------------------
+// Function:    PdRecFileReadOverview
+//
+// Parameters:  PD_REC_FILE* pFile -- recording
+//
+// Returns:     Negative error code or 0
+//
+// Description: Loads <file>.ovw if it was built for this recording.
+//              -EINVAL if its level sizes don't match the recording.
+//
+// ----------------------------------------------------------------------
+//-
+static int PdRecFileReadOverview(PD_REC_FILE* pFile)
+{
+    PD_REC_OVW_HEADER* pOvw = &pFile->ovw;
+    size_t entries = 0, bytes;
+    DWORD l;
+    int fd, ret = -EINVAL;
+
+    fd = open(pFile->ovwName, O_RDONLY);
+    if (fd < 0)
+        return -errno;
+
+    if ((read(fd, pOvw, sizeof(*pOvw)) != sizeof(*pOvw)) ||
+        (pOvw->magic != PD_REC_OVW_MAGIC) || (pOvw->version != PD_REC_OVW_VERSION) ||
+        (pOvw->baseScans != PD_REC_OVW_BASE) || (pOvw->factor != PD_REC_OVW_FACTOR) ||
+        (pOvw->totalChannels != pFile->pHeader->totalChannels) ||
+        (pOvw->nbLevels < 1) || (pOvw->nbLevels > PD_REC_OVW_MAX_LEVELS) ||
+        (pOvw->startTime != pFile->pHeader->startTime) ||
+        (pOvw->totalScans != pFile->totalScans))
+        goto out;
+
+    // the level sizes follow from totalScans, anything else would make
+    // _PdRecFileGetMinMax read past the levels
+    if (pOvw->levelEntries[0] != (pOvw->totalScans + PD_REC_OVW_BASE - 1) / PD_REC_OVW_BASE)
+        goto out;
+
+    for (l = 0; l < pOvw->nbLevels; l++)
+    {
+        if ((l > 0) && (pOvw->levelEntries[l] !=
+            (pOvw->levelEntries[l-1] + PD_REC_OVW_FACTOR - 1) / PD_REC_OVW_FACTOR))
+            goto out;
+        entries += pOvw->levelEntries[l];
+    }
+
+    ret = -ENOMEM;
+    bytes = entries * pOvw->totalChannels * 2 * sizeof(WORD);
+    pFile->pOverview = (WORD*)malloc(bytes);
+    if (!pFile->pOverview)
+        goto out;
+
+    ret = 0;
+    if (read(fd, pFile->pOverview, bytes) != (ssize_t)bytes)
+    {
+        free(pFile->pOverview);
+        pFile->pOverview = NULL;
+        ret = -EINVAL;
+    }
+
+out:
+    close(fd);
+    return ret;
+}
+
+
+//+
+// ----------------------------------------------------------------------
+// Function:    PdRecFileWriteOverview
+//
+// Parameters:  PD_REC_FILE* pFile -- recording
+//              size_t bytes       -- size of the levels
+//
+// Description: Saves the overview as <file>.ovw. The overview is in
+//              memory anyway, a failure is only traced.
+//
+// ----------------------------------------------------------------------
+//-
+static void PdRecFileWriteOverview(PD_REC_FILE* pFile, size_t bytes)
+{
+    int fd;
+
+    fd = open(pFile->ovwName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        DPRINTK_F("PdRecFileWriteOverview: can't create %s\n", pFile->ovwName);
+        return;
+    }
+
+    if ((write(fd, &pFile->ovw, sizeof(pFile->ovw)) != sizeof(pFile->ovw)) ||
+        (write(fd, pFile->pOverview, bytes) != (ssize_t)bytes))
+    {
+        DPRINTK_F("PdRecFileWriteOverview: can't write %s\n", pFile->ovwName);
+        close(fd);
+        unlink(pFile->ovwName);
+        return;
+    }
+
+    close(fd);
+}
+
+
+//+
+// ----------------------------------------------------------------------
+// Function:    _PdRecFileLoadOverview
+//
+// Parameters:  PD_REC_FILE* pFile -- recording
+//
+// Returns:     Negative error code or 0
+//
+// Description: Loads the min/max overview from <file>.ovw, or builds it
+//              from the samples and saves it. The levels go up to a
+//              single entry.
+//
+// Notes:       Building reads the whole recording once. Called by
+//              _PdRecFileGetMinMax when needed.
+//
+// ----------------------------------------------------------------------
+//-
+int _PdRecFileLoadOverview(PD_REC_FILE* pFile)
+{
+    PD_REC_OVW_HEADER* pOvw = &pFile->ovw;
+    DWORD channels = pFile->pHeader->totalChannels;
+    unsigned long long n, scan, end, entries = 0;
+    WORD *pEntry, *pSrc, *pBelow, v;
+    DWORD l, c, count, i;
+    size_t bytes;
+
+    if (!pFile->pOverview && (PdRecFileReadOverview(pFile) < 0))
+    {
+        memset(pOvw, 0, sizeof(*pOvw));
+        pOvw->magic = PD_REC_OVW_MAGIC;
+        pOvw->version = PD_REC_OVW_VERSION;
+        pOvw->baseScans = PD_REC_OVW_BASE;
+        pOvw->factor = PD_REC_OVW_FACTOR;
+        pOvw->totalChannels = channels;
+        pOvw->startTime = pFile->pHeader->startTime;
+        pOvw->totalScans = pFile->totalScans;
+
+        n = (pFile->totalScans + PD_REC_OVW_BASE - 1) / PD_REC_OVW_BASE;
+        if (!n)
+            return -ENODATA;
+
+        do
+        {
+            pOvw->levelEntries[pOvw->nbLevels++] = n;
+            entries += n;
+            n = (n + PD_REC_OVW_FACTOR - 1) / PD_REC_OVW_FACTOR;
+        } while ((pOvw->levelEntries[pOvw->nbLevels - 1] > 1) &&
+                 (pOvw->nbLevels < PD_REC_OVW_MAX_LEVELS));
+
+        bytes = entries * channels * 2 * sizeof(WORD);
+        pFile->pOverview = (WORD*)malloc(bytes);
+        if (!pFile->pOverview)
+            return -ENOMEM;
+
+        // level 0 from the samples
+        pEntry = pFile->pOverview;
+        for (n = 0; n < pOvw->levelEntries[0]; n++, pEntry += channels * 2)
+        {
+            for (c = 0; c < channels; c++)
+            {
+                pEntry[2*c] = 0xFFFF;
+                pEntry[2*c+1] = 0;
+            }
+
+            scan = n * PD_REC_OVW_BASE;
+            end = scan + PD_REC_OVW_BASE;
+            if (end > pFile->totalScans)
+                end = pFile->totalScans;
+
+            while (scan < end)
+            {
+                pSrc = PdRecFileScans(pFile, scan, &count);
+                if (count > end - scan)
+                    count = (DWORD)(end - scan);
+
+                for (i = 0; i < count; i++, pSrc += channels)
+                {
+                    for (c = 0; c < channels; c++)
+                    {
+                        v = (pSrc[c] & pFile->andMask[c]) ^ pFile->xorMask[c];
+                        if (v < pEntry[2*c])
+                            pEntry[2*c] = v;
+                        if (v > pEntry[2*c+1])
+                            pEntry[2*c+1] = v;
+                    }
+                }
+                scan += count;
+            }
+        }
+
+        // each level from the one below
+        pBelow = pFile->pOverview;
+        for (l = 1; l < pOvw->nbLevels; l++)
+        {
+            for (n = 0; n < pOvw->levelEntries[l]; n++, pEntry += channels * 2)
+            {
+                memcpy(pEntry, pBelow, channels * 2 * sizeof(WORD));
+                pBelow += channels * 2;
+
+                for (i = 1; (i < PD_REC_OVW_FACTOR) &&
+                            (n * PD_REC_OVW_FACTOR + i < pOvw->levelEntries[l-1]); i++)
+                {
+                    for (c = 0; c < channels; c++)
+                    {
+                        if (pBelow[2*c] < pEntry[2*c])
+                            pEntry[2*c] = pBelow[2*c];
+                        if (pBelow[2*c+1] > pEntry[2*c+1])
+                            pEntry[2*c+1] = pBelow[2*c+1];
+                    }
+                    pBelow += channels * 2;
+                }
+            }
+        }
+
+        PdRecFileWriteOverview(pFile, bytes);
+    }
+
+    pFile->pLevel[0] = pFile->pOverview;
+    for (l = 1; l < pOvw->nbLevels; l++)
+        pFile->pLevel[l] = pFile->pLevel[l-1] + pOvw->levelEntries[l-1] * channels * 2;
+
+    return 0;
+}
+
+
+//+
+// ----------------------------------------------------------------------
+// Function:    _PdRecFileGetMinMax
+//
+// Parameters:  PD_REC_FILE* pFile -- recording
+//              unsigned long long firstScan -- start of the range
+//              unsigned long long numScans  -- length of the range
+//              DWORD nbPoints     -- the range is cut in nbPoints slices
+//              double* pMin       -- OUT: nbPoints * totalChannels minimums
+//              double* pMax       -- OUT: nbPoints * totalChannels maximums
+//
+// Returns:     Negative error code or 0
+//
+// Description: Minimum and maximum in volts of every channel over each
+//              slice, interleaved like the scans. Uses the coarsest
+//              overview level that still has an entry per slice, or the
+//              samples for slices shorter than PD_REC_OVW_BASE scans.
+//
+// Notes:       With the overview, a slice is widened to the entries it
+//              overlaps, by less than an entry on each side
+//
+// ----------------------------------------------------------------------
+//-
+int _PdRecFileGetMinMax(PD_REC_FILE* pFile, unsigned long long firstScan,
+                        unsigned long long numScans, DWORD nbPoints,
+                        double* pMin, double* pMax)
+{
+    DWORD channels = pFile->pHeader->totalChannels;
+    WORD lo[PD_REC_MAX_TOTAL_CHANNELS], hi[PD_REC_MAX_TOTAL_CHANNELS];
+    unsigned long long span, size, a, b, e;
+    WORD *pSrc, *pEntry, v;
+    DWORD p, c, i, count;
+    int l, ret;
+
+    if (!pMin || !pMax || !nbPoints || (firstScan >= pFile->totalScans))
+        return -EINVAL;
+    if (numScans > pFile->totalScans - firstScan)
+        numScans = pFile->totalScans - firstScan;
+
+    span = numScans / nbPoints;
+    if ((span >= PD_REC_OVW_BASE) && !pFile->pOverview)
+    {
+        ret = _PdRecFileLoadOverview(pFile);
+        if (ret < 0)
+            return ret;
+    }
+
+    // coarsest level with entries no longer than a slice
+    l = -1;
+    size = PD_REC_OVW_BASE;
+    while ((size <= span) && (l + 1 < (int)pFile->ovw.nbLevels))
+    {
+        l++;
+        size *= PD_REC_OVW_FACTOR;
+    }
+    size /= PD_REC_OVW_FACTOR;
+
+    for (p = 0; p < nbPoints; p++, pMin += channels, pMax += channels)
+    {
+        a = firstScan + numScans * p / nbPoints;
+        b = firstScan + numScans * (p + 1) / nbPoints;
+        if (b <= a)
+            b = a + 1;
+
+        for (c = 0; c < channels; c++)
+        {
+            lo[c] = 0xFFFF;
+            hi[c] = 0;
+        }
+
+        if (l < 0)
+        {
+            while (a < b)
+            {
+                pSrc = PdRecFileScans(pFile, a, &count);
+                if (count > b - a)
+                    count = (DWORD)(b - a);
+
+                for (i = 0; i < count; i++, pSrc += channels)
+                {
+                    for (c = 0; c < channels; c++)
+                    {
+                        v = (pSrc[c] & pFile->andMask[c]) ^ pFile->xorMask[c];
+                        if (v < lo[c])
+                            lo[c] = v;
+                        if (v > hi[c])
+                            hi[c] = v;
+                    }
+                }
+                a += count;
+            }
+        }
+        else
+        {
+            for (e = a / size; e <= (b - 1) / size; e++)
+            {
+                pEntry = pFile->pLevel[l] + e * channels * 2;
+                for (c = 0; c < channels; c++)
+                {
+                    if (pEntry[2*c] < lo[c])
+                        lo[c] = pEntry[2*c];
+                    if (pEntry[2*c+1] > hi[c])
+                        hi[c] = pEntry[2*c+1];
+                }
+            }
+        }
+
+        for (c = 0; c < channels; c++)
+        {
+            pMin[c] = lo[c] * pFile->scale[c] - pFile->offset[c];
+            pMax[c] = hi[c] * pFile->scale[c] - pFile->offset[c];
+        }
+    }
+
+    return 0;
+}
+
+
+//+
+// ----------------------------------------------------------------------
+// Function:    _PdRecFileClose
+//
+// Parameters:  PD_REC_FILE* pFile -- recording
+//
+// Returns:     0
+//
+// Description: Unmaps and closes the recording
+//
+// ----------------------------------------------------------------------
+//-
+int _PdRecFileClose(PD_REC_FILE* pFile)
+{
+    if (pFile->pMap != MAP_FAILED)
+        munmap(pFile->pMap, pFile->mapSize);
+    if (pFile->fd >= 0)
+        close(pFile->fd);
+
+    free(pFile->pOverview);
+    free(pFile->ovwName);
+    free(pFile);
+
+    return 0;
+}
@@ -0,0 +1,612 @@
+//=======================================================================
+//
+// NAME:    pdrecord.c
+//
+// SYNOPSIS:
+//
+//      AIn stream recorder
+//
+//
+// DESCRIPTION:
+//
+//      This file writes the interleaved stream of a group (pdgroup.c) to
+//      disk in the raw format described in pdrecord.h. The group's
+//      consumer thread copies the scans into a small pool of aligned
+//      blocks (two to eight), a writer thread writes the full blocks
+//      with O_DIRECT so the page cache is neither polluted nor allowed
+//      to hide a slow disk. When every block is waiting for the disk,
+//      the consumer thread waits as well: the group then stops releasing
+//      frames, and if the disk can't catch up the driver reports a
+//      buffer over run instead of silently dropping data.
+//
+//      The samples are copied once: the DAQ buffer is mapped with
+//      remap_pfn_range, which O_DIRECT can't do I/O from, and the scans
+//      of the boards have to be interleaved anyway.
+//
+// OPTIONS: none
+//
+//
+// NOTES:   See notice below.
+//
+//
+//-----------------------------------------------------------------------
+//
+//      Copyright (C) 2004 United Electronic Industries, Inc.
+//      All rights reserved.
+//      United Electronic Industries Confidential Information.
+//
+//-----------------------------------------------------------------------
+
+#define _GNU_SOURCE     // O_DIRECT
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "../include/win_sdk_types.h"
+#include "../include/powerdaq.h"
+#include "../include/powerdaq32.h"
+#include "../include/pd_debug.h"
+#include "../include/pdgroup.h"
+#include "../include/pdrecord.h"
+
+// ======================================================================
+// Module constants & variables
+
+#define PD_REC_DEFAULT_BUFFERS  3           // triple buffering
+#define PD_REC_MIN_BLOCK        (256*1024)  // smallest write, in bytes
+
+struct _PD_RECORDER
+{
+    int                 fd;
+    PD_GROUP*           pGroup;
+    PD_REC_HEADER*      pHeader;            // PD_REC_HEADER_SIZE, aligned
+    DWORD               totalChannels;
+    DWORD               blockScans;         // scans in a full block
+    DWORD               blockBytes;
+    DWORD               nbBuffers;
+    BYTE*               pBuffer[PD_REC_MAX_BUFFERS];
+    DWORD               bufScans[PD_REC_MAX_BUFFERS]; // scans in each block
+    unsigned long long  bufFirst[PD_REC_MAX_BUFFERS]; // its first scan
+    DWORD               bufSeq[PD_REC_MAX_BUFFERS];   // its block number
+    int                 current;            // block being filled, -1: none
+    int                 freeList[PD_REC_MAX_BUFFERS];
+    int                 nbFree;
+    int                 fullList[PD_REC_MAX_BUFFERS]; // FIFO of blocks to write
+    int                 fullHead;
+    int                 nbFull;
+    unsigned long long  nextScan;           // scans copied so far
+    DWORD               nextSeq;            // blocks filled so far
+    pthread_t           thread;
+    int                 bThread;
+    int                 bClosing;
+    pthread_mutex_t     lock;               // protects the lists and status
+    pthread_cond_t      condFull;           // a block is ready to write
+    pthread_cond_t      condFree;           // a block has been written
+    PD_REC_STATUS       status;
+};
+
+
+//+
+// ----------------------------------------------------------------------
+// Function:    PdRecorderGetTime
+//
+// Parameters:  clockid_t clock -- CLOCK_xxx
+//
+// Returns:     Time in ns
+//
+// ----------------------------------------------------------------------
+//-
+static unsigned long long PdRecorderGetTime(clockid_t clock)
+{
+    struct timespec ts;
+
+    clock_gettime(clock, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+//+
+// ----------------------------------------------------------------------
+// Function:    PdRecorderThreadProc
+//
+// Parameters:  void* arg -- recorder
+//
+// Returns:     NULL
+//
+// Description: Writes the full blocks in order until the recorder is
+//              closed and every block has been written. Block n goes
+//              at PD_REC_HEADER_SIZE + n * blockBytes. After a write
+//              error the blocks are dropped, the error is kept.
+//
+// ----------------------------------------------------------------------
+//-
+static void* PdRecorderThreadProc(void* arg)
+{
+    PD_RECORDER* pRec = (PD_RECORDER*)arg;
+    off_t offset;
+    ssize_t ret;
+    int buf, error;
+
+    pthread_mutex_lock(&pRec->lock);
+    for (;;)
+    {
+        while (!pRec->nbFull && !pRec->bClosing)
+            pthread_cond_wait(&pRec->condFull, &pRec->lock);
+        if (!pRec->nbFull)
+            break;
+
+        buf = pRec->fullList[pRec->fullHead];
+        error = pRec->status.error;
+        pthread_mutex_unlock(&pRec->lock);
+
+        if (!error)
+        {
+            offset = PD_REC_HEADER_SIZE + (off_t)pRec->bufSeq[buf] * pRec->blockBytes;
+            ret = pwrite(pRec->fd, pRec->pBuffer[buf], pRec->blockBytes, offset);
+            if (ret != (ssize_t)pRec->blockBytes)
+                error = (ret < 0) ? errno : ENOSPC;
+        }
+
+        pthread_mutex_lock(&pRec->lock);
+        if (error)
+        {
+            if (!pRec->status.error)
+            {
+                DPRINTK_F("PdRecorderThreadProc: write error %d\n", error);
+                pRec->status.error = error;
+            }
+        }
+        else
+        {
+            pRec->status.scans += pRec->bufScans[buf];
+            pRec->status.blocks++;
+        }
+        pRec->fullHead = (pRec->fullHead + 1) % PD_REC_MAX_BUFFERS;
+        pRec->nbFull--;
+        pRec->freeList[pRec->nbFree++] = buf;
+        pthread_cond_signal(&pRec->condFree);
+    }
+    pthread_mutex_unlock(&pRec->lock);
+
+    return NULL;
+}
+
+
+//+
+// ----------------------------------------------------------------------
+// Function:    PdRecorderSubmit
+//
+// Parameters:  PD_RECORDER* pRec -- recorder
+//
+// Description: Fills the header of the current block, pads it and
+//              queues it for the writer thread
+//
+// ----------------------------------------------------------------------
+//-
+static void PdRecorderSubmit(PD_RECORDER* pRec)
+{
+    int buf = pRec->current;
+    PD_REC_BLOCK* pBlock = (PD_REC_BLOCK*)pRec->pBuffer[buf];
+    DWORD dataBytes = pRec->bufScans[buf] * pRec->totalChannels * sizeof(WORD);
+    tDaqBufCtrl* pCtrl;
+    tFrameStamp stamp;
+    DWORD count, numRet;
+    int b;
+
+    memset(pBlock, 0, PD_REC_BLOCK_HEADER_SIZE);
+    pBlock->magic = PD_REC_BLOCK_MAGIC;
+    pBlock->seq = pRec->bufSeq[buf];
+    pBlock->numScans = pRec->bufScans[buf];
+    pBlock->firstScan = pRec->bufFirst[buf];
+    pBlock->hostTime = PdRecorderGetTime(CLOCK_MONOTONIC);
+
+    // last stamp of each board, ties the block to the host clock
+    for (b = 0; b < PD_REC_MAX_BOARDS; b++)
+    {
+        pBlock->stamps[b].Seq = PD_FRAMESTAMP_INVALID;
+        pCtrl = _PdGroupGetDaqBufCtrl(pRec->pGroup, b);
+        if (!pCtrl)
+            continue;
+
+        count = ((volatile tDaqBufCtrl*)pCtrl)->StampCount;
+        if (!count)
+            continue;
+        _PdAInGetFrameStamps(pCtrl, count - 1, &stamp, 1, &numRet, NULL);
+        if (numRet)
+            pBlock->stamps[b] = stamp;
+    }
+
+    // the last block is usually partial
+    memset(pRec->pBuffer[buf] + PD_REC_BLOCK_HEADER_SIZE + dataBytes, 0,
+           pRec->blockBytes - PD_REC_BLOCK_HEADER_SIZE - dataBytes);
+
+    pthread_mutex_lock(&pRec->lock);
+    pRec->fullList[(pRec->fullHead + pRec->nbFull) % PD_REC_MAX_BUFFERS] = buf;
+    pRec->nbFull++;
+    if (pRec->nbFull > pRec->status.maxQueued)
+        pRec->status.maxQueued = pRec->nbFull;
+    pthread_cond_signal(&pRec->condFull);
+    pthread_mutex_unlock(&pRec->lock);
+
+    pRec->current = -1;
+}
+
+
+//+
+// ----------------------------------------------------------------------
+// Function:    PdRecorderFillHeader
+//
+// Parameters:  PD_RECORDER* pRec        -- recorder
+//              PD_GROUP_CONFIG* pConfig -- group configuration
+//
+// Returns:     Negative error code or 0
+//
+// Description: Describes the boards, channels and raw to volts
+//              conversion in the file header
+//
+// ----------------------------------------------------------------------
+//-
+static int PdRecorderFillHeader(PD_RECORDER* pRec, PD_GROUP_CONFIG* pConfig)
+{
+    PD_REC_HEADER* pHeader = pRec->pHeader;
+    PD_REC_BOARD* pBoard;
+    PPD_AIN_CONVERTER pConv;
+    Adapter_Info adInfo;
+    DWORD first = 0, i;
+    int b, ret;
+
+    memset(pHeader, 0, PD_REC_HEADER_SIZE);
+    pHeader->magic = PD_REC_MAGIC;
+    pHeader->version = PD_REC_VERSION;
+    pHeader->headerSize = PD_REC_HEADER_SIZE;
+    pHeader->blockHeaderSize = PD_REC_BLOCK_HEADER_SIZE;
+    pHeader->blockBytes = pRec->blockBytes;
+    pHeader->blockScans = pRec->blockScans;
+    pHeader->sampleSize = sizeof(WORD);
+    pHeader->nbBoards = pConfig->nbBoards;
+    pHeader->totalChannels = pRec->totalChannels;
+    pHeader->syncMode = pConfig->syncMode;
+    pHeader->groupFlags = pConfig->flags;
+    pHeader->scanRate = pConfig->scanRate;
+    pHeader->startTime = PdRecorderGetTime(CLOCK_REALTIME);
+
+    for (b = 0; b < pConfig->nbBoards; b++)
+    {
+        pBoard = &pHeader->boards[b];
+        pBoard->board = pConfig->boards[b].board;
+        pBoard->nbChannels = pConfig->boards[b].nbChannels;
+        pBoard->firstChannel = first;
+        pBoard->aiCfg = pConfig->boards[b].aiCfg;
+        for (i = 0; i < pBoard->nbChannels; i++)
+            pBoard->channelList[i] = pConfig->boards[b].channelList[i];
+        first += pBoard->nbChannels;
+
+        if (_PdGetAdapterInfo(pBoard->board, &adInfo) >= 0)
+            memcpy(pBoard->serialNumber, adInfo.lpSerialNum, sizeof(pBoard->serialNumber));
+
+        // range, polarity and gains of the channels
+        ret = PdAInCreateConverter(pBoard->board, pBoard->aiCfg, pBoard->nbChannels,
+                                   pConfig->boards[b].channelList, &pConv);
+        if (ret < 0)
+            return ret;
+
+        pBoard->andMask = pConv->wAndMask;
+        pBoard->xorMask = pConv->wXorMask;
+        for (i = 0; i < pBoard->nbChannels; i++)
+        {
+            pBoard->scale[i] = pConv->pdScale[i];
+            pBoard->offset[i] = pConv->pdOffset[i];
+        }
+        PdAInFreeConverter(pConv);
+    }
+
+    return 0;
+}
+
+
+//+
+// ----------------------------------------------------------------------
+// Function:    _PdRecorderCreate
+//
+// Parameters:  const char* fileName -- file to create (truncated)
+//              PD_GROUP* pGroup     -- group to record, created
+//              DWORD nbBuffers      -- blocks in the pool, 2 to 8,
+//                                      0 for the default (3)
+//              DWORD flags          -- PD_REC_xxx
+//              PD_RECORDER** ppRec  -- OUT: recorder
+//
+// Returns:     Negative error code or 0
+//
+// Description: Creates the file, writes its header and starts the
+//              writer thread. Start the group with
+//              _PdRecorderGroupCallback and the recorder as argument,
+//              or pass the scans to _PdRecorderWrite from your own
+//              callback.
+//
+// Notes:       O_DIRECT is used unless PD_REC_NODIRECT is set or the
+//              file system refuses it, see PD_REC_STATUS.bDirect.
+//              A block holds whole group frames and at least 256KB.
+//
+// ----------------------------------------------------------------------
+//-
+int _PdRecorderCreate(const char* fileName, PD_GROUP* pGroup, DWORD nbBuffers,
+                      DWORD flags, PD_RECORDER** ppRec)
+{
+    PD_RECORDER* pRec;
+    PD_GROUP_CONFIG config;
+    DWORD frameBytes, framesPerBlock;
+    int b, ret;
+
+    if (!fileName || !pGroup || !ppRec)
+        return -EINVAL;
+    if (nbBuffers == 0)
+        nbBuffers = PD_REC_DEFAULT_BUFFERS;
+    if ((nbBuffers < 2) || (nbBuffers > PD_REC_MAX_BUFFERS))
+        return -EINVAL;
+
+    _PdGroupGetConfig(pGroup, &config);
+
+    pRec = (PD_RECORDER*)calloc(1, sizeof(PD_RECORDER));
+    if (!pRec)
+        return -ENOMEM;
+
+    pRec->fd = -1;
+    pRec->pGroup = pGroup;
+    pRec->current = -1;
+    pRec->nbBuffers = nbBuffers;
+    pthread_mutex_init(&pRec->lock, NULL);
+    pthread_cond_init(&pRec->condFull, NULL);
+    pthread_cond_init(&pRec->condFree, NULL);
+
+    for (b = 0; b < config.nbBoards; b++)
+        pRec->totalChannels += config.boards[b].nbChannels;
+
+    frameBytes = config.scansPerFrame * pRec->totalChannels * sizeof(WORD);
+    framesPerBlock = (PD_REC_MIN_BLOCK + frameBytes - 1) / frameBytes;
+    pRec->blockScans = framesPerBlock * config.scansPerFrame;
+    pRec->blockBytes = (PD_REC_BLOCK_HEADER_SIZE + framesPerBlock * frameBytes +
+                        PD_REC_ALIGN - 1) & ~(PD_REC_ALIGN - 1);
+
+    ret = -ENOMEM;
+    if (posix_memalign((void**)&pRec->pHeader, PD_REC_ALIGN, PD_REC_HEADER_SIZE))
+    {
+        pRec->pHeader = NULL;
+        goto error;
+    }
+    for (b = 0; b < nbBuffers; b++)
+    {
+        if (posix_memalign((void**)&pRec->pBuffer[b], PD_REC_ALIGN, pRec->blockBytes))
+        {
+            pRec->pBuffer[b] = NULL;
+            goto error;
+        }
+        pRec->freeList[pRec->nbFree++] = b;
+    }
+
+    ret = PdRecorderFillHeader(pRec, &config);
+    if (ret < 0)
+        goto error;
+
+    if (!(flags & PD_REC_NODIRECT))
+    {
+        pRec->fd = open(fileName, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+        pRec->status.bDirect = (pRec->fd >= 0);
+    }
+    if ((pRec->fd < 0) && ((flags & PD_REC_NODIRECT) || (errno == EINVAL)))
+        pRec->fd = open(fileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (pRec->fd < 0)
+    {
+        ret = -errno;
+        goto error;
+    }
+
+    // the totals are filled in by _PdRecorderClose
+    if (pwrite(pRec->fd, pRec->pHeader, PD_REC_HEADER_SIZE, 0) != PD_REC_HEADER_SIZE)
+    {
+        ret = -EIO;
+        goto error;
+    }
+
+    ret = pthread_create(&pRec->thread, NULL, PdRecorderThreadProc, pRec);
+    if (ret)
+    {
+        ret = -ret;
+        goto error;
+    }
+    pRec->bThread = 1;
+
+    *ppRec = pRec;
+    return 0;
+
+error:
+    DPRINTK_F("_PdRecorderCreate: error %d\n", ret);
+    _PdRecorderClose(pRec);
+    return ret;
+}
+
+
+//+
+// ----------------------------------------------------------------------
+// Function:    _PdRecorderWrite
+//
+// Parameters:  PD_RECORDER* pRec -- recorder
+//              WORD* pScans      -- interleaved scans of the group
+//              DWORD numScans    -- number of scans
+//
+// Returns:     Negative error code or 0
+//
+// Description: Copies the scans into the blocks and queues the full
+//              ones. Waits when all the blocks are queued: this holds
+//              the group's consumer thread, which holds the frames in
+//              the DAQ buffers, so a slow disk ends in an over run.
+//
+// Notes:       Call it from one thread only
+//
+// ----------------------------------------------------------------------
+//-
+int _PdRecorderWrite(PD_RECORDER* pRec, WORD* pScans, DWORD numScans)
+{
+    DWORD count, bytes;
+    int buf, error;
+
+    while (numScans)
+    {
+        if (pRec->current < 0)
+        {
+            pthread_mutex_lock(&pRec->lock);
+            if (!pRec->nbFree)
+            {
+                pRec->status.stalls++;
+                while (!pRec->nbFree)
+                    pthread_cond_wait(&pRec->condFree, &pRec->lock);
+            }
+            buf = pRec->freeList[--pRec->nbFree];
+            error = pRec->status.error;
+            pthread_mutex_unlock(&pRec->lock);
+
+            if (error)
+            {
+                pthread_mutex_lock(&pRec->lock);
+                pRec->freeList[pRec->nbFree++] = buf;
+                pthread_mutex_unlock(&pRec->lock);
+                return -error;
+            }
+
+            pRec->current = buf;
+            pRec->bufScans[buf] = 0;
+            pRec->bufFirst[buf] = pRec->nextScan;
+            pRec->bufSeq[buf] = pRec->nextSeq++;
+        }
+
+        buf = pRec->current;
+        count = pRec->blockScans - pRec->bufScans[buf];
+        if (count > numScans)
+            count = numScans;
+
+        bytes = count * pRec->totalChannels * sizeof(WORD);
+        memcpy(pRec->pBuffer[buf] + PD_REC_BLOCK_HEADER_SIZE +
+               pRec->bufScans[buf] * pRec->totalChannels * sizeof(WORD), pScans, bytes);
+
+        pRec->bufScans[buf] += count;
+        pRec->nextScan += count;
+        pScans += count * pRec->totalChannels;
+        numScans -= count;
+
+        if (pRec->bufScans[buf] == pRec->blockScans)
+            PdRecorderSubmit(pRec);
+    }
+
+    return 0;
+}
+
+
+//+
+// ----------------------------------------------------------------------
+// Function:    _PdRecorderGroupCallback
+//
+// Parameters:  see PD_GROUP_CALLBACK, arg is the recorder
+//
+// Description: Group callback that records the stream. The end of the
+//              stream on an error is recorded by _PdRecorderClose.
+//
+// ----------------------------------------------------------------------
+//-
+void _PdRecorderGroupCallback(void* arg, WORD* pScans, DWORD numScans,
+                              unsigned long long firstScan)
+{
+    if (pScans)
+        _PdRecorderWrite((PD_RECORDER*)arg, pScans, numScans);
+}
+
+
+//+
+// ----------------------------------------------------------------------
+// Function:    _PdRecorderGetStatus
+//
+// Parameters:  PD_RECORDER* pRec      -- recorder
+//              PD_REC_STATUS* pStatus -- OUT: status
+//
+// Returns:     0
+//
+// Description: Scans and blocks on disk, stalls and the first error
+//
+// ----------------------------------------------------------------------
+//-
+int _PdRecorderGetStatus(PD_RECORDER* pRec, PD_REC_STATUS* pStatus)
+{
+    pthread_mutex_lock(&pRec->lock);
+    *pStatus = pRec->status;
+    pthread_mutex_unlock(&pRec->lock);
+
+    return 0;
+}
+
+
+//+
+// ----------------------------------------------------------------------
+// Function:    _PdRecorderClose
+//
+// Parameters:  PD_RECORDER* pRec -- recorder
+//
+// Returns:     Negative error code of the first write error or 0
+//
+// Description: Writes the partial block, waits for the writer thread,
+//              updates the header with the totals and closes the file
+//
+// Notes:       Stop the group first. Get the status before: the
+//              recorder is freed.
+//
+// ----------------------------------------------------------------------
+//-
+int _PdRecorderClose(PD_RECORDER* pRec)
+{
+    int b, error;
+
+    if (pRec->current >= 0)
+        PdRecorderSubmit(pRec);
+
+    if (pRec->bThread)
+    {
+        pthread_mutex_lock(&pRec->lock);
+        pRec->bClosing = 1;
+        pthread_cond_signal(&pRec->condFull);
+        pthread_mutex_unlock(&pRec->lock);
+        pthread_join(pRec->thread, NULL);
+    }
+
+    error = pRec->status.error;
+
+    if ((pRec->fd >= 0) && pRec->bThread)
+    {
+        pRec->pHeader->totalScans = pRec->status.scans;
+        pRec->pHeader->nbBlocks = pRec->status.blocks;
+        pRec->pHeader->error = error;
+        if ((pwrite(pRec->fd, pRec->pHeader, PD_REC_HEADER_SIZE, 0) != PD_REC_HEADER_SIZE) &&
+            !error)
+            error = EIO;
+        if (fsync(pRec->fd) && !error)
+            error = errno;
+    }
+    if (pRec->fd >= 0)
+        close(pRec->fd);
+
+    for (b = 0; b < PD_REC_MAX_BUFFERS; b++)
+        free(pRec->pBuffer[b]);
+    free(pRec->pHeader);
+    pthread_cond_destroy(&pRec->condFree);
+    pthread_cond_destroy(&pRec->condFull);
+    pthread_mutex_destroy(&pRec->lock);
+    free(pRec);
+
+    return -error;
+}
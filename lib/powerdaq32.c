@@ -32,6 +32,7 @@
 #else
 #include <errno.h>
 #include <fcntl.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
@@ -57,6 +58,7 @@ static const key_t shmkey = 0x44455246;
 
 #include "../include/powerdaq.h"
 #include "../include/powerdaq32.h"
+#include "../include/pd_ioctl_size.h"
 #include "../include/pd_debug.h"
 
 void __attribute__ ((constructor)) my_init(void);
@@ -91,6 +93,66 @@ int G_NbBoards = 0;
 
 #define DIO_REGS_NUM    8
 
+// v2 ioctls: -1 not known yet, 0 the driver only has the tCmd ones, 1 yes
+static int G_IoctlV2 = -1;
+
+//+
+// static int PdIoctl(int handle, DWORD code, tCmd* pCmd)
+// Sends a command to the driver, copying only the part of tCmd it uses
+//
+// Arguments:  int handle -- handle to the subsystem
+//             DWORD code -- IOCTL_PWRDAQ_xxx
+//             tCmd* pCmd -- argument
+//
+// Returns: the ioctl result
+//
+// Note: The first call finds out if the driver has the v2 ioctls. A driver
+//       without them fails the v2 code with ENODEV, before running it.
+//-
+static int PdIoctl(int handle, DWORD code, tCmd* pCmd)
+{
+#ifdef _PD_RTLPRO
+    // the driver works on the caller's tCmd, nothing is copied
+    return PD_IOCTL(handle, code, pCmd);
+#else
+    int ret, noDev;
+
+    if (G_IoctlV2)
+    {
+        ret = PD_IOCTL(handle, PD_IOC_V2(code, pd_ioctl_size(code, pCmd)), pCmd);
+        if (G_IoctlV2 > 0)
+            return ret;
+
+#ifdef _PD_XENOMAI
+        noDev = (ret == -ENODEV);
+#else
+        noDev = (ret < 0) && (errno == ENODEV);
+#endif
+        if (!noDev)
+        {
+            G_IoctlV2 = 1;
+            return ret;
+        }
+    }
+
+    ret = PD_IOCTL(handle, code, pCmd);
+
+#ifdef _PD_XENOMAI
+    noDev = (ret == -ENODEV);
+#else
+    noDev = (ret < 0) && (errno == ENODEV);
+#endif
+    // the command is known, so v2 wasn't
+    if ((G_IoctlV2 < 0) && !noDev)
+    {
+        DPRINTK("PdIoctl: the driver has no v2 ioctls\n");
+        G_IoctlV2 = 0;
+    }
+
+    return ret;
+#endif
+}
+
 //+
 // int PdGetVersion(PPWRDAQ_VERSION pVersion)
 // Returns version of the driver/library
@@ -133,7 +195,7 @@ int PdGetNumberAdapters( void )
        return -1;
     }
 
-    ret = PD_IOCTL(pd_ain_fd, IOCTL_PWRDAQ_GET_NUMBER_ADAPTER, &cmd);
+    ret = PdIoctl(pd_ain_fd, IOCTL_PWRDAQ_GET_NUMBER_ADAPTER, &cmd);
     
     DPRINTK("PdGetNumberAdapters: fd=%d, boards=%d, ret=%d\n", pd_ain_fd, cmd.dwParam[0], ret);
 
@@ -164,7 +226,7 @@ int PdGetPciConfiguration(int handle, PPWRDAQ_PCI_CONFIG pPciConfig)
 {
     int ret;
     tCmd cmd;
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_PRIVATE_GETCFG, &cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_PRIVATE_GETCFG, &cmd);
     memcpy(pPciConfig, &cmd.PciConfig, sizeof(PWRDAQ_PCI_CONFIG));
     return ret;
 }
@@ -247,7 +309,7 @@ int PdAcquireSubsystem(int board, int dwSubsystem, int Action)
       {
          Cmd.AcqSS.subSystem = dwSubsystem;
          Cmd.AcqSS.fileDescriptor = fd;
-         ret = PD_IOCTL(fd, IOCTL_PWRDAQ_OPENSUBSYSTEM, &Cmd);
+         ret = PdIoctl(fd, IOCTL_PWRDAQ_OPENSUBSYSTEM, &Cmd);
       }
       else
       {
@@ -269,7 +331,7 @@ int PdAcquireSubsystem(int board, int dwSubsystem, int Action)
       {
          Cmd.AcqSS.subSystem = dwSubsystem;
          Cmd.AcqSS.fileDescriptor = fd;
-         ret = PD_IOCTL(fd, IOCTL_PWRDAQ_CLOSESUBSYSTEM, &Cmd);
+         ret = PdIoctl(fd, IOCTL_PWRDAQ_CLOSESUBSYSTEM, &Cmd);
 
          // Release subsystem
          PD_CLOSE(fd);
@@ -356,7 +418,7 @@ int _PdSetUserEvents(int handle, PD_SUBSYSTEM Subsystem, DWORD dwEvents)
 
    Cmd.dwParam[0] = Subsystem;
    Cmd.dwParam[1] = dwEvents;
-   ret = PD_IOCTL(handle, IOCTL_PWRDAQ_SET_USER_EVENTS, &Cmd);
+   ret = PdIoctl(handle, IOCTL_PWRDAQ_SET_USER_EVENTS, &Cmd);
 
    return ret;
 }
@@ -397,7 +459,7 @@ int _PdClearUserEvents(int handle, PD_SUBSYSTEM Subsystem, DWORD dwEvents)
 
     Cmd.dwParam[0] = Subsystem;
     Cmd.dwParam[1] = dwEvents;
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_CLEAR_USER_EVENTS, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_CLEAR_USER_EVENTS, &Cmd);
 
     return ret;
 }
@@ -430,7 +492,7 @@ int _PdGetUserEvents(int handle, PD_SUBSYSTEM Subsystem, DWORD *pdwEvents)
     int ret;
 
     Cmd.dwParam[0] = Subsystem;
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_GET_USER_EVENTS, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_GET_USER_EVENTS, &Cmd);
     *pdwEvents = Cmd.dwParam[1];
 
 
@@ -512,7 +574,7 @@ int _PdAdapterGetBoardStatus(int handle, tEvents* pEvents)
     tCmd   Cmd;
     int ret;
 
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_BRDSTATUS, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_BRDSTATUS, &Cmd);
 
     *pEvents = Cmd.Event;
 
@@ -546,7 +608,7 @@ int _PdAdapterSetBoardEvents1(int handle, DWORD dwEvents)
     int ret;
 
     Cmd.dwParam[0] = (DWORD)dwEvents;
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_BRDSETEVNTS1, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_BRDSETEVNTS1, &Cmd);
 
     return ret;
 }
@@ -596,7 +658,7 @@ int _PdAdapterSetBoardEvents2(int handle, DWORD dwEvents)
     int ret;
 
     Cmd.dwParam[0] = (DWORD)dwEvents;
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_BRDSETEVNTS2, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_BRDSETEVNTS2, &Cmd);
 
     return ret;
 }
@@ -626,11 +688,186 @@ int _PdAdapterEnableInterrupt(int handle, DWORD dwEnable)
     int ret;
 
     Cmd.dwParam[0] = (DWORD)dwEnable;
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_BRDENABLEINTERRUPT, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_BRDENABLEINTERRUPT, &Cmd);
 
     return ret;
 }
 
+//+
+// Function:    int _PdAdapterSetBottomHalfCpu
+//
+// Parameters:  int handle -- handle to adapter
+//              int cpu  -- CPU to run the interrupt bottom half on,
+//                          -1: CPU that took the interrupt
+//
+// Returns:     Negative error code or 0
+//
+// Description: Pins the bottom half that drains the board FIFOs to a
+//              CPU, so the acquisition can be kept on isolated cores.
+//              The same can be done at load time with the bh_cpu
+//              module parameter.
+//
+// Notes:       The interrupt itself is routed with /proc/irq/N/smp_affinity
+//-
+int _PdAdapterSetBottomHalfCpu(int handle, int cpu)
+{
+    tCmd   Cmd;
+
+    Cmd.dwParam[0] = (DWORD)cpu;
+    return PdIoctl(handle, IOCTL_PWRDAQ_SET_BH_CPU, &Cmd);
+}
+
+//+
+// Function:    _PdBatchInit
+//
+// Parameters:  PPD_BATCH pBatch -- batch to initialize
+//              DWORD dwFlags -- PD_BATCH_STOPONERROR or 0
+//
+// Returns:     Nothing
+//
+// Description: Empties a batch. A batch collects up to PD_MAX_BATCH
+//              commands that _PdBatchExecute runs with a single ioctl,
+//              back to back, while the driver holds the board lock once.
+//              A polled control loop builds the batch once and executes
+//              it every cycle.
+//
+// Notes:       Commands can target any subsystem of the board, whatever
+//              subsystem handle is passed to _PdBatchExecute.
+//              Only the commands that use dwParam can be batched.
+//-
+void _PdBatchInit(PPD_BATCH pBatch, DWORD dwFlags)
+{
+    pBatch->dwCount = 0;
+    pBatch->dwFlags = dwFlags;
+    pBatch->dwExecuted = 0;
+}
+
+//+
+// Function:    _PdBatchAdd
+//
+// Parameters:  PPD_BATCH pBatch -- batch
+//              DWORD dwCommand -- IOCTL_PWRDAQ_xxx command
+//              DWORD dwNumParams -- number of parameters (up to 8)
+//              DWORD* pdwParams -- parameters, NULL if dwNumParams is 0
+//
+// Returns:     Index of the entry or negative error code
+//
+// Description: Appends a command to the batch. Parameters go to
+//              dwParam[0..dwNumParams-1] the way the single call wrapper
+//              would set them.
+//-
+int _PdBatchAdd(PPD_BATCH pBatch, DWORD dwCommand, DWORD dwNumParams, DWORD* pdwParams)
+{
+    tBatchEntry* pEntry;
+    int index = pBatch->dwCount;
+
+    if (index >= PD_MAX_BATCH) return -ENOSPC;
+    if (dwNumParams > 8) return -EINVAL;
+
+    pEntry = &pBatch->Entry[index];
+    memset(pEntry, 0, sizeof(tBatchEntry));
+    pEntry->Command = dwCommand;
+    if (dwNumParams)
+        memcpy(pEntry->dwParam, pdwParams, dwNumParams * sizeof(DWORD));
+
+    pBatch->dwCount++;
+    return index;
+}
+
+// Builders for the commands used in polled loops
+int _PdBatchAddAInSwClStart(PPD_BATCH pBatch)
+{
+    return _PdBatchAdd(pBatch, IOCTL_PWRDAQ_AISWCLSTART, 0, NULL);
+}
+
+int _PdBatchAddAInGetValue(PPD_BATCH pBatch)
+{
+    return _PdBatchAdd(pBatch, IOCTL_PWRDAQ_AIGETVALUE, 0, NULL);
+}
+
+int _PdBatchAddAOutPutValue(PPD_BATCH pBatch, DWORD dwValue)
+{
+    return _PdBatchAdd(pBatch, IOCTL_PWRDAQ_AOPUTVALUE, 1, &dwValue);
+}
+
+int _PdBatchAddDInRead(PPD_BATCH pBatch)
+{
+    return _PdBatchAdd(pBatch, IOCTL_PWRDAQ_DIREAD, 0, NULL);
+}
+
+int _PdBatchAddDOutWrite(PPD_BATCH pBatch, DWORD dwValue)
+{
+    return _PdBatchAdd(pBatch, IOCTL_PWRDAQ_DOWRITE, 1, &dwValue);
+}
+
+int _PdBatchAddDIO256CmdWriteAll(PPD_BATCH pBatch, DWORD* pdwValues)
+{
+    return _PdBatchAdd(pBatch, IOCTL_PWRDAQ_DIO256CMDWR_ALL, 8, pdwValues);
+}
+
+int _PdBatchAddDIO256CmdReadAll(PPD_BATCH pBatch)
+{
+    return _PdBatchAdd(pBatch, IOCTL_PWRDAQ_DIO256CMDRD_ALL, 0, NULL);
+}
+
+//+
+// Function:    _PdBatchExecute
+//
+// Parameters:  int handle -- handle to any subsystem of the adapter
+//              PPD_BATCH pBatch -- batch to run
+//
+// Returns:     Number of entries run or negative error code
+//
+// Description: Runs all the commands of the batch with one ioctl.
+//              Each entry gets its own result, see _PdBatchGetResult.
+//              With PD_BATCH_STOPONERROR the entries following a failed
+//              one are not run.
+//
+// Notes:       Entries keep the parameters returned by the driver, so a
+//              batch that writes values must be rebuilt (or its entries
+//              updated) before it is executed again.
+//-
+int _PdBatchExecute(int handle, PPD_BATCH pBatch)
+{
+    tCmd   Cmd;
+    int ret;
+    unsigned long addr = (unsigned long)pBatch->Entry;
+
+    Cmd.dwParam[0] = pBatch->dwCount;
+    Cmd.dwParam[1] = (DWORD)addr;
+    Cmd.dwParam[2] = (DWORD)((unsigned long long)addr >> 32);
+    Cmd.dwParam[3] = pBatch->dwFlags;
+
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_BATCH, &Cmd);
+    if (ret < 0) return ret;
+
+    pBatch->dwExecuted = Cmd.dwParam[0];
+    return pBatch->dwExecuted;
+}
+
+//+
+// Function:    _PdBatchGetResult
+//
+// Parameters:  PPD_BATCH pBatch -- executed batch
+//              int nIndex -- entry index returned by _PdBatchAdd
+//              DWORD* pdwValue -- first returned parameter (sample, input
+//                                 value, status...), can be NULL
+//
+// Returns:     Result of the command, negative error code on failure
+//
+// Description: Gets the outcome of a batched command. Commands returning
+//              more than one value leave them in pBatch->Entry[nIndex].dwParam
+//-
+int _PdBatchGetResult(PPD_BATCH pBatch, int nIndex, DWORD* pdwValue)
+{
+    if ((nIndex < 0) || (nIndex >= (int)pBatch->dwCount)) return -EINVAL;
+
+    if (pdwValue)
+        *pdwValue = pBatch->Entry[nIndex].dwParam[0];
+
+    return pBatch->Entry[nIndex].Result;
+}
+
 
 //+
 // Function:    _PdAdapterEepromRead
@@ -656,7 +893,7 @@ int _PdAdapterEepromRead(int handle, DWORD dwMaxSize, WORD *pwReadBuf, DWORD *pd
     tCmd  cmd;
 
     cmd.EepromAcc.MaxSize = dwMaxSize;
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_BRDEEPROMREAD, &cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_BRDEEPROMREAD, &cmd);
     *pdwWords = cmd.EepromAcc.WordsRead;
 
     for (i = 0; (i < dwMaxSize)&&(i< cmd.EepromAcc.WordsRead)&&(i< PD_EEPROM_SIZE); i++)
@@ -691,7 +928,7 @@ int _PdAdapterEepromWrite(int handle, WORD *pwWriteBuf, DWORD dwSize)
     for (i = 0; (i < dwSize)&&(i< PD_EEPROM_SIZE); i++)
         cmd.EepromAcc.Buffer[i] = *(pwWriteBuf+i);
 
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_BRDEEPROMWRITE, &cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_BRDEEPROMWRITE, &cmd);
     return ret;
 }
 
@@ -811,7 +1048,7 @@ int _PdAInAsyncInit(int handle,
     for (i=0; (i < dwChListSize)&&(i < PD_MAX_CL_SIZE); i++)
         Cmd.AsyncCfg.dwChList[i] = *(pdwChList+i);
 
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_AIN_ASYNC_INIT, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_AIN_ASYNC_INIT, &Cmd);
     return ret;
 }
 
@@ -919,7 +1156,7 @@ int _PdDIAsyncInit(int handle,
    for ( i = 0; i < dwChListSize; i++ )
         Cmd.AsyncCfg.dwChList[i] = dwFirstChannel + i;
    
-   ret = PD_IOCTL(handle, IOCTL_PWRDAQ_AIN_ASYNC_INIT, &Cmd);
+   ret = PdIoctl(handle, IOCTL_PWRDAQ_AIN_ASYNC_INIT, &Cmd);
    return ret;
 }
 
@@ -1021,7 +1258,7 @@ int _PdCTAsyncInit(int handle,
    for ( i = 0; i < dwChListSize; i++ )
         Cmd.AsyncCfg.dwChList[i] = i;
    
-   ret = PD_IOCTL(handle, IOCTL_PWRDAQ_AIN_ASYNC_INIT, &Cmd);
+   ret = PdIoctl(handle, IOCTL_PWRDAQ_AIN_ASYNC_INIT, &Cmd);
    return ret;
 }
 
@@ -1126,7 +1363,7 @@ int _PdAOutAsyncInit(int handle, DWORD dwAOutCfg,
    for ( i = 0; i < 2; i++ )
        Cmd.AsyncCfg.dwChList[i] = i;
 
-   ret = PD_IOCTL(handle, IOCTL_PWRDAQ_AO_ASYNC_INIT, &Cmd);
+   ret = PdIoctl(handle, IOCTL_PWRDAQ_AO_ASYNC_INIT, &Cmd);
    return ret;
 }
 
@@ -1251,7 +1488,7 @@ int _PdAOAsyncInit(int handle, DWORD dwAOutCfg,
       for ( i = 0; i < dwChListSize; i++ )
          Cmd.AsyncCfg.dwChList[i] = *(pdwChList+i); // in DMA mode ChList[0] = first channel
 
-   ret = PD_IOCTL(handle, IOCTL_PWRDAQ_AO_ASYNC_INIT, &Cmd);
+   ret = PdIoctl(handle, IOCTL_PWRDAQ_AO_ASYNC_INIT, &Cmd);
    return ret;
 }
 
@@ -1360,7 +1597,7 @@ int _PdDOAsyncInit(int handle, DWORD dwDOutCfg,
       for ( i = 0; i < dwChListSize; i++ )
          Cmd.AsyncCfg.dwChList[i] = *(pdwChList+i); // in DMA mode ChList[0] = first channel
 
-   ret = PD_IOCTL(handle, IOCTL_PWRDAQ_AO_ASYNC_INIT, &Cmd);
+   ret = PdIoctl(handle, IOCTL_PWRDAQ_AO_ASYNC_INIT, &Cmd);
    return ret;
 }
 
@@ -1798,7 +2035,7 @@ int _PdAInGetScans(int handle, DWORD NumScans, DWORD ScanRetMode, DWORD *pScanIn
    cmd.ScanInfo.ScanIndex = 0;
    cmd.ScanInfo.NumValidScans = 0;
 
-   ret = PD_IOCTL(handle, IOCTL_PWRDAQ_GET_DAQBUF_SCANS, &cmd);
+   ret = PdIoctl(handle, IOCTL_PWRDAQ_GET_DAQBUF_SCANS, &cmd);
 
    *pScanIndex = cmd.ScanInfo.ScanIndex;
    *pNumValidScans = cmd.ScanInfo.NumValidScans;
@@ -1806,6 +2043,203 @@ int _PdAInGetScans(int handle, DWORD NumScans, DWORD ScanRetMode, DWORD *pScanIn
    return ret;
 }
 
+//+
+// Function:    _PdAInPollScans
+//
+// Parameters:  tDaqBufCtrl* pCtrl   -- control page mapped by _PdMapDaqBufCtrl
+//              DWORD ScanIndex       -- IN:  index of the next scan to read
+//              DWORD NumScans        -- IN:  maximum number of scans to get
+//              DWORD *pNumValidScans -- OUT: number of valid scans available
+//                                            from ScanIndex up to the end of
+//                                            the buffer
+//
+// Returns:     Negative error code or 0
+//
+// Description: Same as _PdAInGetScans, but reads Head from the control page,
+//              no system call is made. The application keeps its own scan
+//              index and gives frames back with _PdAInReleaseScans.
+//
+// Notes:
+//
+//-
+int _PdAInPollScans(tDaqBufCtrl* pCtrl, DWORD ScanIndex, DWORD NumScans, 
+                    DWORD *pNumValidScans)
+{
+   volatile tDaqBufCtrl* pVCtrl = pCtrl;
+   DWORD Seq, Head, MaxValues, ScanValues;
+   DWORD HeadScan, MaxScans, AvailScans;
+
+   if (!pCtrl) return -EINVAL;
+
+   // read a consistent snapshot of the page
+   do
+   {
+      Seq = pVCtrl->Seq;
+      __sync_synchronize();
+      Head = pVCtrl->Head;
+      MaxValues = pVCtrl->MaxValues;
+      ScanValues = pVCtrl->ScanValues;
+      __sync_synchronize();
+   } while ((Seq & 1) || (Seq != pVCtrl->Seq));
+
+   *pNumValidScans = 0;
+   if (!ScanValues) return 0;
+
+   HeadScan = Head / ScanValues;
+   MaxScans = MaxValues / ScanValues;
+
+   if ( ScanIndex == HeadScan )
+      AvailScans = 0;
+   else if ( ScanIndex < HeadScan )
+      AvailScans = HeadScan - ScanIndex;
+   else
+      AvailScans = MaxScans - ScanIndex;
+
+   *pNumValidScans = (NumScans < AvailScans) ? NumScans : AvailScans;
+
+   return 0;
+}
+
+//+
+// Function:    _PdAInGetFrameStamps
+//
+// Parameters:  tDaqBufCtrl* pCtrl   -- control page mapped by _PdMapDaqBufCtrl
+//              DWORD FirstSeq        -- IN:  first stamp wanted, 0 for all of them
+//              tFrameStamp* pStamps  -- OUT: stamps, oldest first
+//              DWORD MaxStamps       -- IN:  size of pStamps
+//              DWORD* pNumRet        -- OUT: number of stamps returned in pStamps
+//              DWORD* pNumStamps     -- OUT: number of stamps since async init
+//
+// Returns:     Negative error code or 0
+//
+// Description: Copies the frame completion stamps logged by the driver.
+//              Each pairs the absolute index of a value with the
+//              CLOCK_MONOTONIC time it got to the host, which lets the
+//              application place the samples in time without relying on
+//              the nominal clock rate. No system call is made.
+//
+// Notes:       The control page keeps the last PD_FRAMESTAMP_RING_SIZE
+//              stamps, older ones are skipped: check Seq of the stamps
+//              returned. There are no stamps on RT kernels.
+//
+//-
+int _PdAInGetFrameStamps(tDaqBufCtrl* pCtrl, DWORD FirstSeq, tFrameStamp* pStamps,
+                         DWORD MaxStamps, DWORD* pNumRet, DWORD* pNumStamps)
+{
+   volatile tDaqBufCtrl* pVCtrl = pCtrl;
+   volatile tFrameStamp* pSrc;
+   DWORD Count, Seq, n = 0;
+
+   if (!pCtrl || !pNumRet) return -EINVAL;
+
+   Count = pVCtrl->StampCount;
+   __sync_synchronize();
+
+   if ((Count > PD_FRAMESTAMP_RING_SIZE) && (FirstSeq < Count - PD_FRAMESTAMP_RING_SIZE))
+      FirstSeq = Count - PD_FRAMESTAMP_RING_SIZE;
+
+   for (Seq = FirstSeq; (Seq < Count) && (n < MaxStamps); Seq++)
+   {
+      pSrc = &pVCtrl->Stamp[Seq % PD_FRAMESTAMP_RING_SIZE];
+
+      if (pSrc->Seq != Seq)
+         continue;
+      __sync_synchronize();
+      pStamps[n].ValueIndexLow = pSrc->ValueIndexLow;
+      pStamps[n].ValueIndexHigh = pSrc->ValueIndexHigh;
+      pStamps[n].TimestampLow = pSrc->TimestampLow;
+      pStamps[n].TimestampHigh = pSrc->TimestampHigh;
+      __sync_synchronize();
+
+      // rewritten by the driver while we were copying it
+      if (pSrc->Seq != Seq)
+         continue;
+
+      pStamps[n].Seq = Seq;
+      n++;
+   }
+
+   *pNumRet = n;
+   if (pNumStamps)
+      *pNumStamps = Count;
+
+   return 0;
+}
+
+//+
+// Function:    _PdAInReleaseScans
+//
+// Parameters:  int handle -- handle to adapter
+//              DWORD ScanIndex -- IN: index of the next scan to read
+//
+// Returns:     Negative error code or 0
+//
+// Description: Gives back to the driver all the frames before ScanIndex.
+//              Used with _PdAInPollScans in place of _PdAInGetScans.
+//
+// Notes:
+//
+//-
+int _PdAInReleaseScans(int handle, DWORD ScanIndex)
+{
+   tCmd cmd;
+   cmd.ScanInfo.Subsystem = AnalogIn;
+   cmd.ScanInfo.NumScans = 0;
+   cmd.ScanInfo.ScanIndex = ScanIndex;
+   cmd.ScanInfo.NumValidScans = 0;
+   cmd.ScanInfo.ScanRetMode = 0;
+
+   return PdIoctl(handle, IOCTL_PWRDAQ_RELEASE_DAQBUF_SCANS, &cmd);
+}
+
+//+
+// Function:    _PdAInGetGaps
+//
+// Parameters:  int handle -- handle to adapter
+//              DWORD FirstSeq -- IN: first gap wanted, 0 for all of them
+//              tGapInfo* pGaps -- OUT: gaps, oldest first
+//              DWORD MaxGaps -- IN: size of pGaps
+//              DWORD* pNumRet -- OUT: number of gaps returned in pGaps
+//              DWORD* pNumGaps -- OUT: number of gaps since async init
+//
+// Returns:     Negative error code or 0
+//
+// Description: Returns the FIFO overrun restarts of an acquisition whose
+//              buffer was allocated with BUF_AUTORESTART. A restart drops
+//              LostScans scans (estimate, 0 if unknown) just before the
+//              value at Head in wrap WrapCount. The scans between two
+//              gaps are contiguous.
+//
+// Notes:       The driver keeps the last PD_GAP_LOG_SIZE gaps, older ones
+//              are skipped: check Seq of the first gap returned. Poll
+//              GapCount on the control page (or wait for eBufferError)
+//              to know when to call this function.
+//
+//-
+int _PdAInGetGaps(int handle, DWORD FirstSeq, tGapInfo* pGaps, DWORD MaxGaps,
+                  DWORD* pNumRet, DWORD* pNumGaps)
+{
+   tCmd cmd;
+   int ret;
+
+   memset(&cmd.GapQuery, 0, sizeof(tGapQuery));
+   cmd.GapQuery.FirstSeq = FirstSeq;
+
+   ret = PdIoctl(handle, IOCTL_PWRDAQ_AIN_GET_GAPS, &cmd);
+   if (ret < 0)
+      return ret;
+
+   if (MaxGaps > cmd.GapQuery.NumRet)
+      MaxGaps = cmd.GapQuery.NumRet;
+   memcpy(pGaps, cmd.GapQuery.Gap, MaxGaps * sizeof(tGapInfo));
+
+   *pNumRet = MaxGaps;
+   if (pNumGaps)
+      *pNumGaps = cmd.GapQuery.NumGaps;
+
+   return 0;
+}
+
 // ----------------------------------------------------------------------
 // Function:    _PdAInGetBufState
 //
@@ -1920,7 +2354,7 @@ int _PdAOutGetBufState(int handle, DWORD NumScans, DWORD ScanRetMode,
    cmd.ScanInfo.ScanIndex = 0;
    cmd.ScanInfo.NumValidScans = 0;
 
-   ret = PD_IOCTL(handle, IOCTL_PWRDAQ_GET_DAQBUF_SCANS, &cmd);
+   ret = PdIoctl(handle, IOCTL_PWRDAQ_GET_DAQBUF_SCANS, &cmd);
 
    *pScanIndex = cmd.ScanInfo.ScanIndex;
    *pNumValidScans = cmd.ScanInfo.NumValidScans;
@@ -1964,7 +2398,7 @@ int _PdAOGetBufState(int handle, DWORD NumScans, DWORD ScanRetMode,
    cmd.ScanInfo.ScanIndex = 0;
    cmd.ScanInfo.NumValidScans = 0;
 
-   ret = PD_IOCTL(handle, IOCTL_PWRDAQ_GET_DAQBUF_SCANS, &cmd);
+   ret = PdIoctl(handle, IOCTL_PWRDAQ_GET_DAQBUF_SCANS, &cmd);
 
    *pScanIndex = cmd.ScanInfo.ScanIndex;
    *pNumValidScans = cmd.ScanInfo.NumValidScans;
@@ -2008,7 +2442,7 @@ int _PdDOGetBufState(int handle, DWORD NumScans, DWORD ScanRetMode,
    cmd.ScanInfo.ScanIndex = 0;
    cmd.ScanInfo.NumValidScans = 0;
 
-   ret = PD_IOCTL(handle, IOCTL_PWRDAQ_GET_DAQBUF_SCANS, &cmd);
+   ret = PdIoctl(handle, IOCTL_PWRDAQ_GET_DAQBUF_SCANS, &cmd);
 
    *pScanIndex = cmd.ScanInfo.ScanIndex;
    *pNumValidScans = cmd.ScanInfo.NumValidScans;
@@ -2064,7 +2498,7 @@ int _PdAInSetCfg(int handle, DWORD dwAInCfg, DWORD dwAInPreTrig, DWORD dwAInPost
     Cmd.dwParam[1] = dwAInPreTrig;
     Cmd.dwParam[2] = dwAInPostTrig;
 
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_AISETCFG, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_AISETCFG, &Cmd);
     return ret;
 }
 
@@ -2097,7 +2531,7 @@ int _PdAInSetCvClk(int handle, DWORD dwClkDiv)
     int ret;
 
     Cmd.dwParam[0] = dwClkDiv;
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_AISETCVCLK, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_AISETCVCLK, &Cmd);
     return ret;
 }
 
@@ -2128,7 +2562,7 @@ int _PdAInSetClClk(int handle, DWORD dwClkDiv)
     int ret;
 
     Cmd.dwParam[0] = dwClkDiv;
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_AISETCLCLK, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_AISETCLCLK, &Cmd);
     return ret;
 }
 
@@ -2176,7 +2610,7 @@ int _PdAInSetChList(int handle, DWORD dwCh, DWORD *pdwChList)
         Cmd.SyncCfg.dwChList[i] = *(pdwChList + i);
     }
 
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_AISETCHLIST, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_AISETCHLIST, &Cmd);
     return ret;
 }
 
@@ -2213,7 +2647,7 @@ int _PdAInEnableConv(int handle, DWORD dwEnable)
     int ret;
 
     Cmd.dwParam[0] = dwEnable;
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_AICVEN, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_AICVEN, &Cmd);
     return ret;
 }
 
@@ -2243,7 +2677,7 @@ int _PdAInSetEvents(int handle, DWORD dwEvents)
     int ret;
 
     Cmd.dwParam[0] = dwEvents;
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_AISETEVNT, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_AISETEVNT, &Cmd);
     return ret;
 }
 
@@ -2410,7 +2844,7 @@ int _PdAInGetValue(int handle, WORD *pwSample)
 {
     int ret;
     tCmd cmd;
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_AIGETVALUE, &cmd); 
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_AIGETVALUE, &cmd); 
     *pwSample = cmd.dwParam[0];
     return ret;
 }
@@ -2431,7 +2865,7 @@ int _PdAInGetDataCount(int handle, DWORD *pdwSamples)
 {
     int ret;
     tCmd cmd;
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_AIGETSAMPLECOUNT, &cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_AIGETSAMPLECOUNT, &cmd);
     *pdwSamples = cmd.dwParam[0];
     return ret;
 }
@@ -2462,7 +2896,7 @@ int _PdAInGetSamples(int handle, DWORD dwMaxBufSize, WORD *pwBuf, DWORD *pdwSamp
     }
     cmd.bufParam.size = dwMaxBufSize*sizeof(WORD);
     
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_AIGETSAMPLES, &cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_AIGETSAMPLES, &cmd);
 
     *pdwSamples = cmd.bufParam.size/sizeof(WORD);
     memcpy(pwBuf, cmd.bufParam.buffer, cmd.bufParam.size);
@@ -2509,7 +2943,7 @@ int _PdAInGetXFerSamples(int handle, DWORD dwMaxBufSize, WORD *pwBuf, DWORD *pdw
 
     cmd.bufParam.size = dwMaxBufSize*sizeof(WORD);
 
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_AIGETXFERSAMPLES, &cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_AIGETXFERSAMPLES, &cmd);
 
     *pdwSamples = cmd.bufParam.size/sizeof(WORD);
     memcpy(pwBuf, cmd.bufParam.buffer, cmd.bufParam.size);
@@ -2527,7 +2961,7 @@ int _PdAInSetSSHGain(int handle, DWORD dwCfg)
     int ret;
 
     Cmd.dwParam[0] = dwCfg;
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_AISETSSHGAIN, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_AISETSSHGAIN, &Cmd);
     return ret;
 }
 
@@ -2550,7 +2984,7 @@ int _PdAInSetXferSize(int handle, DWORD size)
     int ret;
 
     Cmd.dwParam[0] = size;
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_AISETXFERSIZE, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_AISETXFERSIZE, &Cmd);
     return ret;
 }
 
@@ -2592,7 +3026,7 @@ int _PdAOutSetCfg(int handle, DWORD dwAOutCfg, DWORD dwAOutPostTrig)
 
     Cmd.dwParam[0] = dwAOutCfg;
     Cmd.dwParam[1] = dwAOutPostTrig;
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_AOSETCFG, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_AOSETCFG, &Cmd);
     return ret;
 }
 
@@ -2616,7 +3050,7 @@ int _PdAOutSetCvClk(int handle, DWORD dwClkDiv)
     int ret;
 
     Cmd.dwParam[0] = dwClkDiv;
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_AOSETCVCLK, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_AOSETCVCLK, &Cmd);
     return ret;
 }
 
@@ -2646,7 +3080,7 @@ int _PdAOutSetEvents(int handle, DWORD dwEvents)
     int ret;
 
     Cmd.dwParam[0] = dwEvents;
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_AOSETEVNT, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_AOSETEVNT, &Cmd);
     return ret;
 }
 
@@ -2668,7 +3102,7 @@ int _PdAOutGetStatus(int handle, DWORD *pdwStatus)
     tCmd cmd;
     int ret;
 
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_AOSTATUS, &cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_AOSTATUS, &cmd);
     *pdwStatus = cmd.dwParam[0];
     return ret;
 }
@@ -2708,7 +3142,7 @@ int _PdAOutEnableConv(int handle, DWORD dwEnable)
     int ret;
 
     Cmd.dwParam[0] = dwEnable;
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_AOCVEN, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_AOCVEN, &Cmd);
     return ret;
 }
 
@@ -2834,7 +3268,7 @@ int _PdAOutPutValue(int handle, DWORD dwValue)
     int ret;
 
     Cmd.dwParam[0] = dwValue;
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_AOPUTVALUE, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_AOPUTVALUE, &Cmd);
     return ret;
 }
 
@@ -2871,7 +3305,7 @@ int _PdAOutPutBlock(int handle, DWORD dwValues, DWORD *pdwBuf, DWORD *pdwCount)
 
     Cmd.bufParam.size = dwValues * sizeof(DWORD);
     memcpy(Cmd.bufParam.buffer, pdwBuf, dwValues*sizeof(DWORD));
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_AOPUTBLOCK, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_AOPUTBLOCK, &Cmd);
     *pdwCount = Cmd.bufParam.size;
 
     return ret;
@@ -2908,7 +3342,7 @@ int _PdDInSetCfg(int handle, DWORD dwDInCfg)
     int ret;
 
     Cmd.dwParam[0] = dwDInCfg;
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_DISETCFG, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_DISETCFG, &Cmd);
     return ret;
 }
 
@@ -2939,7 +3373,7 @@ int _PdDInGetStatus(int handle, DWORD *pdwEvents)
     tCmd   Cmd;
     int ret;
 
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_DISTATUS, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_DISTATUS, &Cmd);
     *pdwEvents = Cmd.dwParam[0];
 
     return ret;
@@ -2966,7 +3400,7 @@ int _PdDInRead(int handle, DWORD *pdwValue)
     tCmd   Cmd;
     int ret;
 
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_DIREAD, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_DIREAD, &Cmd);
     *pdwValue = Cmd.dwParam[0];
 
     return ret;
@@ -3032,7 +3466,7 @@ int _PdDOutWrite(int handle, DWORD dwValue)
     int ret;
 
     Cmd.dwParam[0] = (DWORD)dwValue;
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_DOWRITE, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_DOWRITE, &Cmd);
     return ret;
 }
 
@@ -3080,7 +3514,7 @@ int _PdDIO256CmdWrite(int handle, DWORD dwCmd, DWORD dwValue)
     Cmd.dwParam[0] = dwCmd;
     Cmd.dwParam[1] = dwValue;
 
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_DIO256CMDWR, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_DIO256CMDWR, &Cmd);
 
     return ret;
 }
@@ -3106,7 +3540,7 @@ int _PdDIO256CmdRead(int handle, DWORD dwCmd, DWORD *pdwValue)
 
     Cmd.dwParam[0] = dwCmd;
 
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_DIO256CMDRD, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_DIO256CMDRD, &Cmd);
     *pdwValue = Cmd.dwParam[1];
 
     return ret;
@@ -3177,7 +3611,7 @@ int _PdDIO256CmdWriteAll(int handle, DWORD *pdwValue)
 
     memcpy(Cmd.dwParam, pdwValue, DIO_REGS_NUM/2*sizeof(DWORD));
     
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_DIO256CMDWR_ALL, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_DIO256CMDWR_ALL, &Cmd);
 
     return ret;
 }
@@ -3201,7 +3635,7 @@ int _PdDIO256CmdReadAll(int handle, DWORD *pdwValue)
     tCmd   Cmd;
     int    ret;
     
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_DIO256CMDRD_ALL, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_DIO256CMDRD_ALL, &Cmd);
 
     memcpy(pdwValue, Cmd.dwParam, DIO_REGS_NUM/2*sizeof(DWORD));
 
@@ -3506,7 +3940,7 @@ int _PdDIOIntrEnable(int handle, DWORD dwEnable)
    int ret;
 
    Cmd.dwParam[0] = (DWORD)dwEnable;
-   ret = PD_IOCTL(handle, IOCTL_PWRDAQ_DIO256INTRREENABLE, &Cmd);
+   ret = PdIoctl(handle, IOCTL_PWRDAQ_DIO256INTRREENABLE, &Cmd);
    return ret;
 }
 
@@ -3538,7 +3972,7 @@ int _PdDIOSetIntrMask(int handle, DWORD* dwIntMask)
    }
 
    cmd.bufParam.size = 8*sizeof(DWORD);
-   ret = PD_IOCTL(handle, IOCTL_PWRDAQ_DIO256SETINTRMASK, &cmd);
+   ret = PdIoctl(handle, IOCTL_PWRDAQ_DIO256SETINTRMASK, &cmd);
    return ret;
 }
 
@@ -3569,7 +4003,7 @@ int _PdDIOGetIntrData(int handle, DWORD* dwIntData, DWORD* dwEdgeData)
       
    cmd.bufParam.size = 16*sizeof(DWORD);
       
-   ret = PD_IOCTL(handle, IOCTL_PWRDAQ_DIO256GETINTRDATA, &cmd);
+   ret = PdIoctl(handle, IOCTL_PWRDAQ_DIO256GETINTRDATA, &cmd);
 
    for (i = 0; i < 8; i++) 
    {
@@ -3580,6 +4014,171 @@ int _PdDIOGetIntrData(int handle, DWORD* dwIntData, DWORD* dwEdgeData)
    return ret;
 }
 
+//+
+// Function:    _PdDIOCosStart
+//
+// Parameters:  int handle -- handle to DIn subsystem
+//
+// Returns:     Negative error code or 0
+//
+// Description: Starts the change of state queue of a PD2-DIO board. For
+//              each DIn interrupt the driver reads the interrupt and edge
+//              data (see _PdDIOGetIntrData) right away, logs them with
+//              the interrupt time and re-enables the interrupt, so that
+//              no _PdDIOGetIntrData/_PdDIOIntrEnable round trip is
+//              needed and the changes that follow are not merged. Read
+//              the records with _PdDIOCosMap and _PdDIOCosRead.
+//
+// Notes:       Set the interrupt mask with _PdDIOSetIntrMask first.
+//              Subscribe to eDInEvent (_PdSubscribeUserEvents with
+//              DigitalIn|EdgeDetect) to be woken up when records come.
+//-
+int _PdDIOCosStart(int handle)
+{
+   tCmd   Cmd;
+
+   return PdIoctl(handle, IOCTL_PWRDAQ_DIO256COSSTART, &Cmd);
+}
+
+//+
+// Function:    _PdDIOCosStop
+//
+// Parameters:  int handle -- handle to DIn subsystem
+//
+// Returns:     Negative error code or 0
+//
+// Description: Stops the change of state queue and disables the DIn
+//              interrupt. The records logged stay readable.
+//-
+int _PdDIOCosStop(int handle)
+{
+   tCmd   Cmd;
+
+   return PdIoctl(handle, IOCTL_PWRDAQ_DIO256COSSTOP, &Cmd);
+}
+
+//+
+// Function:    _PdDIOCosMap
+//
+// Parameters:  int handle -- handle to DIn subsystem
+//              tCosRing** ppRing -- pointer to store the ring address
+//
+// Returns:     Negative error code or 0
+//
+// Description: Maps (read-only) the change of state ring. The driver
+//              allocates it on the first _PdDIOCosStart.
+//-
+int _PdDIOCosMap(int handle, tCosRing** ppRing)
+{
+   void* ring;
+   long pagesize = sysconf(_SC_PAGESIZE);
+   size_t size = ((sizeof(tCosRing) + pagesize - 1) / pagesize) * pagesize;
+
+   *ppRing = NULL;
+
+   ring = mmap(NULL, size, PROT_READ, MAP_SHARED|MAP_FILE, handle, PD_COS_MMAP_OFFSET);
+   if( ring == (void *) -1 ) return -errno;
+   *ppRing = (tCosRing*)ring;
+
+   return 0;
+}
+
+//+
+// Function:    _PdDIOCosUnmap
+//
+// Parameters:  tCosRing* pRing -- ring mapped by _PdDIOCosMap
+//
+// Returns:     negative value on error
+//-
+int _PdDIOCosUnmap(tCosRing* pRing)
+{
+   long pagesize = sysconf(_SC_PAGESIZE);
+
+   if (!pRing)
+      return -EINVAL;
+
+   return munmap((void*)pRing, ((sizeof(tCosRing) + pagesize - 1) / pagesize) * pagesize);
+}
+
+//+
+// Function:    _PdDIOCosRead
+//
+// Parameters:  tCosRing* pRing       -- ring mapped by _PdDIOCosMap
+//              DWORD* pNextSeq       -- IN:  first record wanted, 0 after start
+//                                       OUT: record to ask for next time
+//              tCosRecord* pRecs     -- OUT: records, oldest first
+//              DWORD MaxRecs         -- IN:  size of pRecs
+//              DWORD* pNumRet        -- OUT: number of records returned
+//              DWORD* pNumLost       -- OUT: records overwritten before they
+//                                            could be read, NULL if not needed
+//
+// Returns:     Negative error code or 0
+//
+// Description: Copies the change of state records logged since *pNextSeq.
+//              No system call is made.
+//
+// Notes:       The ring keeps the last PD_COS_RING_SIZE records: read it
+//              at least that often. pRing->Errors counts the interrupts
+//              whose data couldn't be read.
+//-
+int _PdDIOCosRead(tCosRing* pRing, DWORD* pNextSeq, tCosRecord* pRecs,
+                  DWORD MaxRecs, DWORD* pNumRet, DWORD* pNumLost)
+{
+   volatile tCosRing* pVRing = pRing;
+   volatile tCosRecord* pSrc;
+   DWORD Count, Seq, Lost = 0, n = 0;
+   int i;
+
+   if (!pRing || !pNextSeq || !pNumRet) return -EINVAL;
+
+   Count = pVRing->Count;
+   __sync_synchronize();
+
+   Seq = *pNextSeq;
+   if ((Count > PD_COS_RING_SIZE) && (Seq < Count - PD_COS_RING_SIZE))
+   {
+      Lost = Count - PD_COS_RING_SIZE - Seq;
+      Seq = Count - PD_COS_RING_SIZE;
+   }
+
+   for (; (Seq < Count) && (n < MaxRecs); Seq++)
+   {
+      pSrc = &pVRing->Rec[Seq % PD_COS_RING_SIZE];
+
+      if (pSrc->Seq != Seq)
+      {
+         Lost++;
+         continue;
+      }
+      __sync_synchronize();
+      pRecs[n].TimestampLow = pSrc->TimestampLow;
+      pRecs[n].TimestampHigh = pSrc->TimestampHigh;
+      for (i = 0; i < PD_DIO256_REGS; i++)
+      {
+         pRecs[n].IntData[i] = pSrc->IntData[i];
+         pRecs[n].EdgeData[i] = pSrc->EdgeData[i];
+      }
+      __sync_synchronize();
+
+      // rewritten by the driver while we were copying it
+      if (pSrc->Seq != Seq)
+      {
+         Lost++;
+         continue;
+      }
+
+      pRecs[n].Seq = Seq;
+      n++;
+   }
+
+   *pNextSeq = Seq;
+   *pNumRet = n;
+   if (pNumLost)
+      *pNumLost = Lost;
+
+   return 0;
+}
+
 //+
 // ---------------------------------------------------------------------------
 // Function:    _PdDIOSetIntCh
@@ -3628,7 +4227,7 @@ int _PdDIODMASet(int handle, DWORD dwOffset, DWORD dwCount, DWORD dwSource)
    Cmd.dwParam[1] = dwCount;
    Cmd.dwParam[2] = dwSource;
 
-   ret = PD_IOCTL(handle, IOCTL_PWRDAQ_DIODMASET, &Cmd);
+   ret = PdIoctl(handle, IOCTL_PWRDAQ_DIODMASET, &Cmd);
    return ret;
 }
 
@@ -3804,7 +4403,7 @@ int _PdAODMASet(int handle, DWORD dwOffset, DWORD dwCount, DWORD dwSource)
    Cmd.dwParam[1] = dwCount;
    Cmd.dwParam[2] = dwSource;
 
-   ret = PD_IOCTL(handle, IOCTL_PWRDAQ_AODMASET, &Cmd);
+   ret = PdIoctl(handle, IOCTL_PWRDAQ_AODMASET, &Cmd);
    return ret;
 }
 
@@ -3851,7 +4450,7 @@ int _PdUctSetCfg(int handle, DWORD dwUctCfg)
     int    ret;
 
     Cmd.dwParam[0] = (DWORD)dwUctCfg;
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_UCTSETCFG, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_UCTSETCFG, &Cmd);
     return ret;
 }
 
@@ -3891,7 +4490,7 @@ int _PdUctGetStatus(int handle, DWORD *pdwStatus)
     tCmd   Cmd;
     int    ret;
 
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_UCTSTATUS, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_UCTSTATUS, &Cmd);
     *pdwStatus = Cmd.dwParam[0];
 
     return ret;
@@ -3962,7 +4561,7 @@ int _PdUctWrite(int handle, DWORD dwUctWord)
     int    ret;
 
     Cmd.dwParam[0] = (DWORD)dwUctWord;
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_UCTWRITE, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_UCTWRITE, &Cmd);
     return ret;
 }
 
@@ -4015,7 +4614,7 @@ int _PdUctRead(int handle, DWORD dwUctReadCfg, DWORD *pdwUctWORD)
     int    ret;
 
     Cmd.dwParam[0] = (DWORD)dwUctReadCfg;
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_UCTREAD, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_UCTREAD, &Cmd);
     *pdwUctWORD = Cmd.dwParam[1];
 
     return ret;
@@ -4046,7 +4645,7 @@ int _PdUctSwSetGate(int handle, DWORD dwGateLevels)
     int    ret;
 
     Cmd.dwParam[0] = (DWORD)dwGateLevels;
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_UCTSWGATE, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_UCTSWGATE, &Cmd);
     return ret;
 }
 
@@ -4249,7 +4848,7 @@ int _PdCalDACWrite(int handle, DWORD dwCalDACValue)
     tCmd   Cmd;
     int ret;
     Cmd.dwParam[0] = (DWORD)dwCalDACValue;
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_CALDACWRITE, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_CALDACWRITE, &Cmd);
     return ret;
 }
 
@@ -4295,7 +4894,7 @@ int _PdDspRegWrite(int handle, DWORD reg, DWORD data)
 
     Cmd.dwParam[0] = reg;
     Cmd.dwParam[1] = data;
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_BRDREGWR, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_BRDREGWR, &Cmd);
     return ret;
 }
 
@@ -4317,7 +4916,7 @@ int _PdDspRegRead(int handle, DWORD reg, DWORD *data)
     int ret;
 
     Cmd.dwParam[0] = reg;
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_BRDREGRD, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_BRDREGRD, &Cmd);
     *data = Cmd.dwParam[1];
 
     return ret;
@@ -4360,19 +4959,89 @@ int _PdWaitForEvent(int handle, int events, int timeoutms) {
 
     Cmd.dwParam[0] = (DWORD)events;
     Cmd.dwParam[1] = (DWORD)timeoutms;
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_PRIVATE_SET_EVENT, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_PRIVATE_SET_EVENT, &Cmd);
+    return ret;
+}
+
+//+
+// Function:    _PdSubscribeUserEvents
+//
+// Parameters:  int handle -- handle to adapter
+//              PD_SUBSYSTEM Subsystem  -- subsystem type
+//              DWORD dwEvents  -- IN: user events to subscribe to
+//
+// Returns:     Negative error code or 0
+//
+// Description: Sets the events like _PdSetUserEvents, but they stay
+//              armed after they are notified: there is no need to set
+//              them again after each wait. The driver accumulates the
+//              events notified, and counts them, until _PdWaitForEvents
+//              takes them.
+//
+//              _PdClearUserEvents ends the subscription of the events it
+//              clears. An AIn/AOut async init ends all the subscriptions
+//              of the subsystem.
+//
+// Notes:       See _PdSetUserEvents for events definition
+//-
+int _PdSubscribeUserEvents(int handle, PD_SUBSYSTEM Subsystem, DWORD dwEvents)
+{
+    tCmd   Cmd;
+    int ret;
+
+    Cmd.dwParam[0] = Subsystem;
+    Cmd.dwParam[1] = dwEvents;
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_SUBSCRIBE_EVENTS, &Cmd);
+
     return ret;
 }
 
+//+
+// Function:    _PdWaitForEvents
+//
+// Parameters:  int handle -- handle to subsystem
+//              int events -- event flags subscribed to (see _PdSetUserEvents)
+//              int timeoutms -- ms to wait events
+//              DWORD *pCounts -- OUT: PD_EVENT_COUNTERS counts, NULL if not needed
+//
+// Returns:     Event flags notified since the last call, eTimeout if none
+//              came before timeoutms. Negative on error
+//
+// Description: Waits for events subscribed with _PdSubscribeUserEvents.
+//              All the events notified since the last call are returned
+//              at once and cleared, with pCounts[n] the number of times
+//              event bit n occurred: for eFrameDone the number of frames
+//              completed, even if the driver notified them at once. If
+//              there are some already, the call doesn't wait.
+//
+// Note:        Same as _PdWaitForEvent, this is a blocking call
+//-
+int _PdWaitForEvents(int handle, int events, int timeoutms, DWORD *pCounts)
+{
+    tCmd   Cmd;
+    int ret;
+
+    Cmd.EventWait.Events = (DWORD)events;
+    Cmd.EventWait.Timeout = (DWORD)timeoutms;
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_WAIT_EVENTS, &Cmd);
+    if (ret < 0)
+        return ret;
+
+    if (pCounts)
+        memcpy(pCounts, Cmd.EventWait.Count, sizeof(Cmd.EventWait.Count));
+
+    return Cmd.EventWait.Events;
+}
+
 int _PdSleepOn(int handle, int timeoutms) {
     tCmd Cmd;
     Cmd.dwParam[0] = (DWORD)timeoutms;
-    return PD_IOCTL(handle, IOCTL_PWRDAQ_PRIVATE_SLEEP_ON, &Cmd);
+    return PdIoctl(handle, IOCTL_PWRDAQ_PRIVATE_SLEEP_ON, &Cmd);
 }
 
 int _PdWakeUp(int handle) {
     tCmd Cmd;
-    return PD_IOCTL(handle, IOCTL_PWRDAQ_PRIVATE_WAKE_UP, &Cmd);
+    return PdIoctl(handle, IOCTL_PWRDAQ_PRIVATE_WAKE_UP, &Cmd);
 }
 
 //-----------------------------------------------------------------------
@@ -4380,7 +5049,7 @@ int _PdTestEvent(int handle)
 {
     tCmd Cmd;
     memset(&Cmd,0,sizeof(tCmd));
-    return PD_IOCTL(handle, IOCTL_PWRDAQ_TESTEVENTS, &Cmd);
+    return PdIoctl(handle, IOCTL_PWRDAQ_TESTEVENTS, &Cmd);
 }
 
 //----------------------------------------------------------------------------
@@ -4389,7 +5058,7 @@ int _PdGetADCFifoSize(int handle, DWORD *fifoSize)
    tCmd   Cmd;
    int ret;
 
-   ret = PD_IOCTL(handle, IOCTL_PWRDAQ_GETADCFIFOSIZE, &Cmd);
+   ret = PdIoctl(handle, IOCTL_PWRDAQ_GETADCFIFOSIZE, &Cmd);
    *fifoSize = Cmd.dwParam[0];
 
    return ret;
@@ -4402,7 +5071,7 @@ int _PdGetSerialNumber(int handle, char serialNumber[PD_SERIALNUMBER_SIZE])
    int ret;
 
    Cmd.bufParam.size = PD_SERIALNUMBER_SIZE;
-   ret = PD_IOCTL(handle, IOCTL_PWRDAQ_GETSERIALNUMBER, &Cmd);
+   ret = PdIoctl(handle, IOCTL_PWRDAQ_GETSERIALNUMBER, &Cmd);
    memcpy(serialNumber, Cmd.bufParam.buffer, PD_SERIALNUMBER_SIZE);
    
    return ret;
@@ -4414,7 +5083,7 @@ int _PdGetManufactureDate(int handle, char manfctrDate[PD_DATE_SIZE])
    int   ret;
 
    Cmd.bufParam.size = PD_DATE_SIZE;
-   ret = PD_IOCTL(handle, IOCTL_PWRDAQ_GETMANFCTRDATE, &Cmd);
+   ret = PdIoctl(handle, IOCTL_PWRDAQ_GETMANFCTRDATE, &Cmd);
    memcpy(manfctrDate, Cmd.bufParam.buffer, PD_DATE_SIZE);
    
    return ret;
@@ -4427,7 +5096,7 @@ int _PdGetCalibrationDate(int handle, char calDate[PD_DATE_SIZE])
    int   ret;
 
    Cmd.bufParam.size = PD_DATE_SIZE;
-   ret = PD_IOCTL(handle, IOCTL_PWRDAQ_GETCALIBRATIONDATE, &Cmd);
+   ret = PdIoctl(handle, IOCTL_PWRDAQ_GETCALIBRATIONDATE, &Cmd);
    memcpy(calDate, Cmd.bufParam.buffer, PD_DATE_SIZE);
 
    return ret;
@@ -4440,7 +5109,7 @@ int _PdGetLastIntTsc(int handle, unsigned int tsc[2])
    tCmd   Cmd;
    int ret;
 
-   ret = PD_IOCTL(handle, IOCTL_PWRDAQ_MEASURE_LATENCY, &Cmd);
+   ret = PdIoctl(handle, IOCTL_PWRDAQ_MEASURE_LATENCY, &Cmd);
    tsc[0] = Cmd.dwParam[0];
    tsc[1] = Cmd.dwParam[1];
    
@@ -4511,6 +5180,14 @@ void showEvents(DWORD events)
 //
 // Function returns actual number of bytes allocated or negative value
 // on error
+//
+// Notes:       pBuffer can be NULL when the buffer is only drained with
+//              read()/write(), as on Xenomai where RTDM devices can't be
+//              mmaped
+//
+//              On DIO boards an input buffer must be at least one page
+//              smaller than 1GB (PD_COS_MMAP_OFFSET), its control page
+//              is mapped right after it
 //-
 int _PdRegisterBuffer(int handle,PWORD* pBuffer,
                                  DWORD dwSubsystem,
@@ -4524,7 +5201,9 @@ int _PdRegisterBuffer(int handle,PWORD* pBuffer,
     int ret;
     void* buf;
     int sizebytes;
-    *pBuffer = NULL;
+
+    if (pBuffer)
+        *pBuffer = NULL;
 
     Cmd.dwParam[0] = dwScanSize;
     Cmd.dwParam[1] = dwScansFrm;
@@ -4534,7 +5213,7 @@ int _PdRegisterBuffer(int handle,PWORD* pBuffer,
 
     DPRINTK("PdRegistereBuffer: %d samples, %d scans, %d frames\n", Cmd.dwParam[0], Cmd.dwParam[1], Cmd.dwParam[2]);
 
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_REGISTER_BUFFER, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_REGISTER_BUFFER, &Cmd);
 
     // This ioctl returns the true buffer size allocated by the driver
     sizebytes = Cmd.dwParam[0];
@@ -4544,6 +5223,7 @@ int _PdRegisterBuffer(int handle,PWORD* pBuffer,
 
     // mmap buffer allocated in kernel
     if (ret < 0) return ret;
+    if (pBuffer == NULL) return ret;
    buf = mmap(NULL, sizebytes,
               PROT_WRITE|PROT_READ,MAP_SHARED|MAP_FILE,
               handle, 0);
@@ -4574,24 +5254,87 @@ int _PdUnregisterBuffer(int handle, PWORD pBuf, DWORD dwSubSystem)
     Cmd.dwParam[0] = dwSubSystem;
 
     // ioctl returns size of allocated buffer in Cmd.dwParam[1]
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_GETKERNELBUFSIZE, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_GETKERNELBUFSIZE, &Cmd);
 
     DPRINTK("Unmapping buffer, size %d\n", Cmd.dwParam[1]);
 
     // unmap buffer allocated in kernel
     if (!Cmd.dwParam[1]) 
         return -EIO;
-    munmap(pBuf, Cmd.dwParam[1]);
+    if (pBuf)
+        munmap(pBuf, Cmd.dwParam[1]);
 
     // free buffer
     Cmd.dwParam[0] = dwSubSystem;
 
     // ioctl returns size of allocated buffer in Cmd.dwParam[1]
-    ret = PD_IOCTL(handle, IOCTL_PWRDAQ_UNREGISTER_BUFFER, &Cmd);
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_UNREGISTER_BUFFER, &Cmd);
 
     return ret;
 }
 
+//+
+// Function:    int _PdMapDaqBufCtrl
+//
+// Parameters:  int handle -- handle to adapter
+//              DWORD dwSubsystem -- subsystem (AnalogIn or AnalogOut)
+//              tDaqBufCtrl** ppCtrl -- pointer to store control page address
+//
+// Returns:     negative value on error
+//
+// Description: function maps (read-only) the control page of the DAQ buffer
+//              registered with _PdRegisterBuffer. The driver publishes
+//              Head, WrapCount and state there, so the application can
+//              poll it with _PdAInPollScans without any system call
+//
+//-
+int _PdMapDaqBufCtrl(int handle, DWORD dwSubSystem, tDaqBufCtrl** ppCtrl)
+{
+    tCmd   Cmd;
+    int ret;
+    void* ctrl;
+    long pagesize = sysconf(_SC_PAGESIZE);
+    off_t offset;
+
+    *ppCtrl = NULL;
+    Cmd.dwParam[0] = dwSubSystem;
+
+    // ioctl returns size of allocated buffer in Cmd.dwParam[1]
+    ret = PdIoctl(handle, IOCTL_PWRDAQ_GETKERNELBUFSIZE, &Cmd);
+    if (ret < 0) return ret;
+    if (!Cmd.dwParam[1]) 
+        return -EIO;
+
+    // control page follows the data buffer
+    offset = ((Cmd.dwParam[1] + pagesize - 1) / pagesize) * pagesize;
+
+    DPRINTK("Mapping control page at offset 0x%lx\n", (long)offset);
+
+    ctrl = mmap(NULL, pagesize, PROT_READ, MAP_SHARED|MAP_FILE, handle, offset);
+    if( ctrl == (void *) -1 ) return -EINVAL;
+    *ppCtrl = (tDaqBufCtrl*)ctrl;
+
+    return 0;
+}
+
+//+
+// Function:    int _PdUnmapDaqBufCtrl
+//
+// Parameters:  tDaqBufCtrl* pCtrl -- control page mapped by _PdMapDaqBufCtrl
+//
+// Returns:     negative value on error
+//
+// Description: function unmaps the DAQ buffer control page
+//
+//-
+int _PdUnmapDaqBufCtrl(tDaqBufCtrl* pCtrl)
+{
+    if (!pCtrl)
+        return -EINVAL;
+
+    return munmap((void*)pCtrl, sysconf(_SC_PAGESIZE));
+}
+
 //
 //+
 // Function:    int _PdAcquireBuffer
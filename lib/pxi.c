@@ -142,7 +142,7 @@ PD_BOARD_PXI_LINES* _PdPXIGetAdapterInfo (int board)
     int id;
 
     // Check the adapter handle
-    if (board < G_NbBoards) 
+    if (board >= G_NbBoards) 
        return FALSE;
 
     if (PD_IS_PDXI(G_pAdapterInfo[board].dwBoardID))
@@ -17,13 +17,210 @@
 // For more informations on using and distributing this software, please see
 // the accompanying "LICENSE" file.
 //
+// The firmware of each board family is loaded once with request_firmware()
+// (see include/pdfw_bin.h for the file format) and kept in a cache shared
+// by all boards of that family. The segments are walked once when the
+// image is parsed. The built-in tables are used when there is no file,
+// unless the driver is built with NOBUILTINFW=1.
+//
 #include <linux/init.h>
 
 #include "../include/pdfwload_i.h"
+#include "../include/pdfw_bin.h"
+#ifndef PD_NO_BUILTIN_FW
 #include "../include/pdfwmain_i.h"
 #include "../include/pdfw_ao_iA.h"
 #include "../include/pdfw_dio_iD.h"
 #include "../include/pdfw_mf_iM.h"
 #include "../include/pdfw_lab_iL.h"
+#define PD_FW_QUIET 1                  // a missing file is covered by the tables
+#else
+#define PD_FW_QUIET 0
+#endif
+
+// parsed firmware segment, data points into the file copy or the tables
+typedef struct
+{
+   u32  dwMemType;
+   u32  dwMemAdrs;
+   u32  dwMemSize;
+   const u32* pdwMemData;
+} TFwSeg;
+
+typedef struct
+{
+   int    bLoaded;                 // image is ready to download
+   int    bFile;                   // image comes from the firmware file
+   u32    dwExecAdrs;
+   u32    nSegs;
+   TFwSeg Segs[PD_FW_MAXSEGS];
+   void*  pBlob;                   // copy of the firmware file
+} TFwImage;
+
+static TFwImage pd_fw_cache[PD_FW_FAMILIES];
+static const char* pd_fw_files[PD_FW_FAMILIES] = PD_FW_FILES;
+
+// Checks and indexes a firmware file. Returns 1 if it is usable.
+static int pd_fw_parse(TFwImage* pImg, const u32* pWords, u32 size)
+{
+   const PD_FW_HEADER* pHdr = (const PD_FW_HEADER*)pWords;
+   const PD_FW_SEGHEADER* pSeg;
+   u32 i, pos, words = size / sizeof(u32);
+
+   if ((size % sizeof(u32)) || (words < sizeof(PD_FW_HEADER)/sizeof(u32)))
+      return 0;
+   if ((pHdr->Magic != PD_FW_MAGIC) || (pHdr->Version != PD_FW_VERSION) ||
+       (pHdr->NumSegs == 0) || (pHdr->NumSegs > PD_FW_MAXSEGS))
+      return 0;
+
+   pos = sizeof(PD_FW_HEADER)/sizeof(u32);
+   for (i = 0; i < pHdr->NumSegs; i++)
+   {
+      if (words - pos < sizeof(PD_FW_SEGHEADER)/sizeof(u32))
+         return 0;
+      pSeg = (const PD_FW_SEGHEADER*)(pWords + pos);
+      pos += sizeof(PD_FW_SEGHEADER)/sizeof(u32);
+
+      if ((pSeg->MemType < 1) || (pSeg->MemType > 3) ||
+          (pSeg->MemSize > PD_FW_MAXWORDS) || (words - pos < pSeg->MemSize))
+         return 0;
+
+      pImg->Segs[i].dwMemType = pSeg->MemType;
+      pImg->Segs[i].dwMemAdrs = pSeg->MemAdrs;
+      pImg->Segs[i].dwMemSize = pSeg->MemSize;
+      pImg->Segs[i].pdwMemData = pWords + pos;
+      pos += pSeg->MemSize;
+   }
+   if (pos != words)
+      return 0;
+
+   pImg->nSegs = pHdr->NumSegs;
+   pImg->dwExecAdrs = pHdr->ExecAdrs;
+   return 1;
+}
+
+#ifndef PD_NO_BUILTIN_FW
+// Indexes one of the built-in tables
+static int pd_fw_builtin(TFwImage* pImg, int family)
+{
+   FW_MEMSEGMENT* pData;
+   u32 i, n, exec;
+
+   switch (family)
+   {
+   case PD_FW_MF:  pData = FWDownloadDataM; n = nFWMemSegmentsM; exec = dwFWExecAdrsM; break;
+   case PD_FW_AO:  pData = FWDownloadDataA; n = nFWMemSegmentsA; exec = dwFWExecAdrsA; break;
+   case PD_FW_DIO: pData = FWDownloadDataD; n = nFWMemSegmentsD; exec = dwFWExecAdrsD; break;
+   case PD_FW_LAB: pData = FWDownloadDataL; n = nFWMemSegmentsL; exec = dwFWExecAdrsL; break;
+   default:        pData = FWDownloadData;  n = nFWMemSegments;  exec = dwFWExecAdrs;  break;
+   }
+
+   if (n > PD_FW_MAXSEGS)
+      return 0;
+
+   for (i = 0; i < n; i++)
+   {
+      pImg->Segs[i].dwMemType = pData[i].dwMemType;
+      pImg->Segs[i].dwMemAdrs = pData[i].dwMemAdrs;
+      pImg->Segs[i].dwMemSize = pData[i].dwMemSize;
+      pImg->Segs[i].pdwMemData = pData[i].dwMemData;
+   }
+   pImg->nSegs = n;
+   pImg->dwExecAdrs = exec;
+   return 1;
+}
+#endif
+
+// Firmware family of a board
+static int pd_fw_family(int board)
+{
+#ifdef USECOMMONFW
+   return PD_FW_MAIN;
+#else
+   u32 id;
+
+   if (PD_IS_PDXI(pd_board[board].PCI_Config.SubsystemID))
+      id = pd_board[board].PCI_Config.SubsystemID - 0x100;
+   else
+      id = pd_board[board].PCI_Config.SubsystemID;
+
+   if (PD_IS_LABMF(id)) return PD_FW_LAB;
+   if (PD_IS_DIO(id))   return PD_FW_DIO;
+   if (PD_IS_AO(id))    return PD_FW_AO;
+   if (PD_IS_MFX(id))   return PD_FW_MF;
+   return PD_FW_MAIN;
+#endif
+}
+
+//+
+// Function:    pd_fw_get_image
+//
+// Parameters:  int board -- board index
+//
+// Returns:     TFwImage* -- firmware image for the board family, NULL if
+//                           there is none
+//
+// Description: Returns the cached firmware image of the board family.
+//              The first board of a family loads and parses the firmware
+//              file, or indexes the built-in table if there is no usable
+//              file. The image stays cached until pd_fw_cache_free().
+//
+// Notes:       Boards are brought up concurrently, the cache is filled
+//              under pd_fw_cache_lock().
+//
+//-
+static TFwImage* pd_fw_get_image(int board)
+{
+   int family = pd_fw_family(board);
+   TFwImage* pImg = &pd_fw_cache[family];
+   void* pBlob;
+   u32 size;
+
+   pd_fw_cache_lock();
+   if (!pImg->bLoaded)
+   {
+      if (pd_request_firmware(board, pd_fw_files[family], &pBlob, &size, PD_FW_QUIET) == 0)
+      {
+         if (pd_fw_parse(pImg, (const u32*)pBlob, size))
+         {
+            pImg->pBlob = pBlob;
+            pImg->bFile = 1;
+            pImg->bLoaded = 1;
+            PRINTK("board %d: using firmware file %s\n", board, pd_fw_files[family]);
+         }
+         else
+         {
+            DPRINTK_F("board %d: firmware file %s is corrupted\n", board, pd_fw_files[family]);
+            pd_kfree(pBlob);
+         }
+      }
+#ifndef PD_NO_BUILTIN_FW
+      if (!pImg->bLoaded)
+         pImg->bLoaded = pd_fw_builtin(pImg, family);
+#endif
+   }
+   pd_fw_cache_unlock();
+
+   if (!pImg->bLoaded)
+   {
+      DPRINTK_F("board %d: no firmware available (%s)\n", board, pd_fw_files[family]);
+      return NULL;
+   }
+
+   return pImg;
+}
+
+// Releases the firmware files kept in the cache (module unload)
+void pd_fw_cache_free(void)
+{
+   int i;
+
+   for (i = 0; i < PD_FW_FAMILIES; i++)
+   {
+      if (pd_fw_cache[i].pBlob)
+         pd_kfree(pd_fw_cache[i].pBlob);
+      memset(&pd_fw_cache[i], 0, sizeof(TFwImage));
+   }
+}
 
 
@@ -83,18 +83,27 @@ extern void pd_udelay(u32 usecs);
 extern void pd_mdelay(u32 msecs);
 extern void* pd_alloc_bigbuf(u32 size);
 extern void pd_free_bigbuf(void* mem, u32 size);
+extern void* pd_alloc_contig_bigbuf(int board, u32 size, dma_addr_t* pHandle);
+extern void pd_free_contig_bigbuf(int board, void* mem, u32 size, dma_addr_t handle);
+extern void pd_kfree(void* adr);
+extern int pd_request_firmware(int board, const char* name, void** ppData, u32* pSize, int bQuiet);
+extern void pd_fw_cache_lock(void);
+extern void pd_fw_cache_unlock(void);
 
 // Firmware interface itself
 #include "firmware.c"
 #include "pdl_fwi.c"
 #include "pdl_brd.c"
 #include "pdl_ain.c"
+#include "pdl_aopack.c"
+#include "pdl_gap.c"
 #include "pdl_aio.c"
 #include "pdl_ao.c"
 #include "pdl_dio.c"
 #include "pdl_dao.c"
 #include "pdl_uct.c"
 #include "pdl_int.c"
+#include "pdl_bmring.c"
 #include "pdl_event.c"
 #include "pdl_init.c"
 #include "pdl_dspuct.c"
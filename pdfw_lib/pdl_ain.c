@@ -456,9 +456,29 @@ int pd_ain_set_ssh_gain(int board, u32 dwCfg)
 //
 int pd_ain_get_samples(int board, int max_samples, u16* buffer, u32* samples) 
 {
-   int i;
-   int nSamples;
-   u32 dwSample = 0;
+   return pd_ain_get_samples_split(board, max_samples, buffer, (u32)max_samples, 
+                                   buffer + max_samples, samples);
+}
+
+//
+//       NAME:  pd_ain_get_samples_split
+//
+//   FUNCTION:  Get any available samples from the ADC FIFO into a buffer
+//              made of two segments (ring buffer split at the wrap point).
+//
+//  ARGUMENTS:  int board        -- The board in question.
+//              int max_samples  -- Read at most this many samples.
+//              u16 buf1[]       -- Put the first len1 samples here.
+//              u32 len1         -- Size of the first segment.
+//              u16 buf2[]       -- Put the rest of the samples here.
+//
+//    RETURNS:  The number of samples actually read.
+//
+//       NOTE:  Last value read must always by ERR_RET.
+//
+int pd_ain_get_samples_split(int board, int max_samples, u16* buf1, u32 len1, 
+                             u16* buf2, u32* samples) 
+{
    unsigned long id;
 
    DPRINTK_P("getting ain %d samples from board %d\n", max_samples, board);
@@ -480,31 +500,14 @@ int pd_ain_get_samples(int board, int max_samples, u16* buffer, u32* samples)
    }
 
    pd_dsp_write(board, (u32)max_samples);
-   nSamples = 0;
-   for (i = 0; i < max_samples + 1; i++) 
-   {
-      if(pd_board[board].dwXFerMode == XFERMODE_NORMAL) 
-         dwSample = pd_dsp_read(board);
-      else
-         dwSample = pd_readl(pd_board[board].address + PCI_HRXS);
 
-      if (dwSample == ERR_RET) 
-      {
-         DPRINTK_F("end of samples (%d)\n", nSamples);
-         break;
-      }
-
-      if (i < max_samples) 
-      {
-        *(buffer+nSamples++) = (u16)dwSample;
-      }
-   }
-
-   if (dwSample != ERR_RET) {
+   // Read block of max_samples+1 from receive register until ERR_RET.
+   if (!pd_dsp_read_block_term_split(board, buf1, len1, buf2, (u32)max_samples, samples)) {
       DPRINTK_F("ERROR! no end of buffer in pd_ain_get_samples!\n");
       return FALSE;
    }
-   *samples = nSamples;
+
+   DPRINTK_F("end of samples (%d)\n", *samples);
    return TRUE;
 }
 
@@ -685,13 +688,43 @@ int pd_ain_clear_data(int board)
 
 int pd_ain_flush_fifo(int board, int from_isr)
 {
-    u32   dwMaxSamples;
     u16*  pwBuf = (u16*)pd_board[board].AinSS.pXferBuf;
-    u32   dwCount;
-    u32   dwSample = ERR_RET;
+    u32   dwMaxSamples = pd_board[board].AinSS.XferBufValues;
+
+    return pd_ain_flush_fifo_split(board, from_isr, pwBuf, dwMaxSamples, pwBuf + dwMaxSamples);
+}
+
+//
+// Function:    pd_ain_flush_fifo_split
+//
+// Parameters:  int board
+//              int from_isr    -- called from the ISR
+//              u16* pwSeg1     -- first segment of the destination
+//              u32 dwSeg1      -- size of the first segment (samples)
+//              u16* pwSeg2     -- second segment of the destination
+//
+// Returns:     1 if it worked, 0 if it failed.
+//
+// Description: Same as pd_ain_flush_fifo() but the samples are stored in
+//              a destination made of two segments: the first dwSeg1
+//              samples go to pwSeg1, the rest of them to pwSeg2. This lets
+//              the bottom half flush the FIFO straight into the DAQ buffer
+//              at Head, split at the wrap point.
+//
+// Notes:       The caller must make sure the two segments can hold all
+//              the samples (XferBufValues). The number of samples read
+//              is stored in XferBufValueCount.
+//
+int pd_ain_flush_fifo_split(int board, int from_isr, u16* pwSeg1, u32 dwSeg1, u16* pwSeg2)
+{
+    u32   dwMaxSamples;
+    u16*  pwBuf = pwSeg1;
+    u32   dwLeft = dwSeg1;          // samples left in the current segment
+    u32   dwCount, dwRead;
     u32   i;
     u32   total, dwCnt, dwXfr;
     u32   id;
+    int   bTerm;
     
     dwMaxSamples = pd_board[board].AinSS.XferBufValues;             //0x400
 
@@ -716,23 +749,26 @@ int pd_ain_flush_fifo(int board, int from_isr)
       // Issue PD_AIN_BLK_XFER command w/o return value.
       pd_dsp_cmd_no_ret(board, PD_AIN_BLK_XFER);
 
-      if (pd_board[board].dwXFerMode == XFERMODE_NORMAL) 
+      // Read fixed size block of samples from receive register.
+      if (!pd_dsp_read_block_split(board, pwBuf, dwLeft, pwSeg2, dwCnt))
+      {
+         DPRINTK_F("Error: PD_AIN_BLK_XFER block read failed in pd_ain_flush_fifo\n");
+         pd_board[board].AinSS.XferBufValueCount = total;
+         return FALSE;
+      }
+
+      // Advance to the next free sample, switch segment at the wrap point.
+      if (dwCnt < dwLeft)
       {
-  
-         // Read fixed size block of samples from receive register.
-         for (dwCount = 0; dwCount < dwCnt; dwCount++, total++)
-         {
-            *(pwBuf++) = (u16)pd_dsp_read_x(board);
-         }
+         pwBuf += dwCnt;
+         dwLeft -= dwCnt;
       }
       else
       {
-         // Read fixed size block of samples from receive register.
-         for (dwCount = 0; dwCount < dwCnt; dwCount++, total++ ) 
-         {
-            *(pwBuf++) = (u16)pd_readl(pd_board[board].address + PCI_HRXS);
-         }
+         pwBuf = pwSeg2 + (dwCnt - dwLeft);
+         dwLeft = dwMaxSamples;
       }
+      total += dwCnt;
     }
     dwCount = total;
     
@@ -753,23 +789,11 @@ int pd_ain_flush_fifo(int board, int from_isr)
        pd_dsp_write(board, (dwMaxSamples-dwCount)); 
    
        // Read block of dwMaxBufSize+1 from receive register until ERR_RET.
-       for ( ; dwCount < (dwMaxSamples+1); dwCount++ )
-       {
-          if(pd_board[board].dwXFerMode == XFERMODE_NORMAL) 
-             dwSample = pd_dsp_read_x(board);
-          else
-             dwSample = pd_readl(pd_board[board].address + PCI_HRXS);
-           
-          if (dwSample == ERR_RET)
-             break;
-   
-          if (dwCount < dwMaxSamples)
-          {
-             *(pwBuf++) = (USHORT)dwSample;
-          }          
-       }
+       bTerm = pd_dsp_read_block_term_split(board, pwBuf, dwLeft, pwSeg2, 
+                                            (dwMaxSamples-dwCount), &dwRead);
+       dwCount += dwRead;
 
-       if (dwSample != ERR_RET)
+       if (!bTerm)
        {
           if ((pd_board[board].dwXFerMode == XFERMODE_NORMAL)||
               (pd_board[board].dwXFerMode == XFERMODE_FAST))
@@ -39,6 +39,7 @@ int pd_register_daq_buffer(int board, u32 SubSystem, u32 ScanSize, u32 FrameSize
 {
     void* buf;
     PTBuf_Info pDaqBuf = NULL;
+    u32 id;
     
 
     if ((SubSystem == AnalogIn) ||
@@ -64,6 +65,31 @@ int pd_register_daq_buffer(int board, u32 SubSystem, u32 ScanSize, u32 FrameSize
         return 0;
     }
 
+    // the restart is done on the FIFO transfer path, in bus master modes
+    // an overrun is a bus master error and stops the acquisition
+    if ((bWrap & BUF_AUTORESTART) && (pDaqBuf == &pd_board[board].AinSS.BufInfo) &&
+        (pd_board[board].dwXFerMode != XFERMODE_NORMAL) &&
+        (pd_board[board].dwXFerMode != XFERMODE_FAST))
+    {
+        DPRINTK_I("pd_register_daq_buffer: BUF_AUTORESTART needs xferMode 0 or 1\n");
+        return 0;
+    }
+
+    // on DIO boards the DIn minor maps the control page right after the
+    // buffer, it must stay below the change of state ring offset
+    if (PD_IS_PDXI(pd_board[board].PCI_Config.SubsystemID))
+        id = pd_board[board].PCI_Config.SubsystemID - 0x100;
+    else
+        id = pd_board[board].PCI_Config.SubsystemID;
+
+    if ((pDaqBuf == &pd_board[board].AinSS.BufInfo) && PD_IS_DIO(id) &&
+        ((u64)NumFrames * FrameSize * ScanSize *
+         ((bWrap & BUF_DWORDVALUES) ? sizeof(u32) : sizeof(u16)) > PD_COS_MMAP_OFFSET - PAGE_SIZE))
+    {
+        DPRINTK_I("pd_register_daq_buffer: DIn buffer must be one page smaller than 1GB\n");
+        return 0;
+    }
+
     pDaqBuf->ScanSize = ScanSize;
     pDaqBuf->FrameSize = FrameSize;
     pDaqBuf->NumFrames = NumFrames;
@@ -72,9 +98,11 @@ int pd_register_daq_buffer(int board, u32 SubSystem, u32 ScanSize, u32 FrameSize
     pDaqBuf->bRecycle = bWrap & BUF_BUFFERRECYCLED;
     pDaqBuf->bDWValues = bWrap & BUF_DWORDVALUES;
     pDaqBuf->bFixedDMA = bWrap & BUF_FIXEDDMA;
+    pDaqBuf->bAutoRestart = bWrap & BUF_AUTORESTART;
 
     pDaqBuf->FirstTimestamp = 0;
     pDaqBuf->LastTimestamp = 0;
+    pDaqBuf->StampCount = 0;
 
     pDaqBuf->FrameValues = pDaqBuf->FrameSize * pDaqBuf->ScanSize;
     pDaqBuf->ScanValues = pDaqBuf->ScanSize;
@@ -95,7 +123,19 @@ int pd_register_daq_buffer(int board, u32 SubSystem, u32 ScanSize, u32 FrameSize
 
     // try to allocate buffer memory
     DPRINTK_I("Trying to allocate %d bytes\n", pDaqBuf->BufSizeInBytes);
-    buf = pd_alloc_bigbuf(pDaqBuf->BufSizeInBytes);
+    pDaqBuf->bContig = 0;
+    buf = NULL;
+    if (bWrap & BUF_CONTIGUOUS)
+    {
+        buf = pd_alloc_contig_bigbuf(board, pDaqBuf->BufSizeInBytes,
+                                     &pDaqBuf->ContigHandle);
+        if (buf)
+            pDaqBuf->bContig = 1;
+        else
+            DPRINTK_I("pd_register_daq_buffer: no contiguous memory, using vmalloc\n");
+    }
+    if (!buf)
+        buf = pd_alloc_bigbuf(pDaqBuf->BufSizeInBytes);
 
     if (buf) {
         pDaqBuf->databuf = (u16*)buf;
@@ -105,7 +145,14 @@ int pd_register_daq_buffer(int board, u32 SubSystem, u32 ScanSize, u32 FrameSize
         return 0;
     }
 
-    DPRINTK_I("pd_register_daq_buffer: Allocated buffer for SS %d, size %d\n", SubSystem, pDaqBuf->BufSizeInBytes);
+    // control page mmap'd by the user right after the buffer
+    pDaqBuf->pCtrl = (tDaqBufCtrl*)pd_alloc_bigbuf(sizeof(tDaqBufCtrl));
+    if (!pDaqBuf->pCtrl)
+        DPRINTK_F("pd_register_daq_buffer: no control page, mmap polling disabled\n");
+
+    DPRINTK_I("pd_register_daq_buffer: Allocated %s buffer for SS %d, size %d\n",
+              (pDaqBuf->bContig) ? "contiguous" : "vmalloc",
+              SubSystem, pDaqBuf->BufSizeInBytes);
 
     return (pDaqBuf->BufSizeInBytes);
 }
@@ -127,9 +174,20 @@ int pd_unregister_daq_buffer(int board, u32 SubSystem)
     if (!pDaqBuf) return 0;
 
     if (pDaqBuf->databuf)
-        pd_free_bigbuf(pDaqBuf->databuf,
-                       pDaqBuf->BufSizeInBytes);
+    {
+        if (pDaqBuf->bContig)
+            pd_free_contig_bigbuf(board, pDaqBuf->databuf,
+                                  pDaqBuf->BufSizeInBytes, pDaqBuf->ContigHandle);
+        else
+            pd_free_bigbuf(pDaqBuf->databuf,
+                           pDaqBuf->BufSizeInBytes);
+    }
     pDaqBuf->databuf = NULL;
+    pDaqBuf->bContig = 0;
+
+    if (pDaqBuf->pCtrl)
+        pd_free_bigbuf(pDaqBuf->pCtrl, sizeof(tDaqBufCtrl));
+    pDaqBuf->pCtrl = NULL;
 
     DPRINTK_I("pd_unregister_daq_buf: Freed buffer for SS %d, size %d\n", SubSystem, pDaqBuf->BufSizeInBytes);
 
@@ -196,8 +254,10 @@ int pd_clear_daq_buffer(int board, int subsystem)
     pDaqBuf->WrapCount = 0;
     pDaqBuf->FirstTimestamp = 0;
     pDaqBuf->LastTimestamp = 0;
+    pDaqBuf->StampCount = 0;
     pDaqBuf->ValueIndex = 0;
     pDaqBuf->ScanIndex = 0;
+    pd_gap_reset(&pDaqBuf->GapLog);
     
     // do clear events
     if (subsystem == AnalogIn)
@@ -208,6 +268,8 @@ int pd_clear_daq_buffer(int board, int subsystem)
        pd_board[board].AinSS.dwEventsNotify = 0;
        pd_board[board].AinSS.dwEventsStatus = 0;
        pd_board[board].AinSS.dwEventsNew = 0;
+       pd_board[board].AinSS.dwFramesNew = 0;
+       pd_board[board].AinSS.dwDataNew = 0;
 
        pd_board[board].AinSS.XferBufValueCount = 0;
     }
@@ -225,9 +287,12 @@ int pd_clear_daq_buffer(int board, int subsystem)
        pd_board[board].AoutSS.dwEventsNotify = 0;
        pd_board[board].AoutSS.dwEventsStatus = 0;
        pd_board[board].AoutSS.dwEventsNew = 0;
+       pd_board[board].AoutSS.dwFramesNew = 0;
        pd_board[board].AoutSS.XferBufValueCount = 0;
     } 
 
+    pd_daqbuf_ctrl_publish(pDaqBuf, ssConfig, 0);
+
     return 1;
 }
 
@@ -426,6 +491,7 @@ int pd_ain_async_init(int board, tAsyncCfg* pAInCfg)
    pd_board[board].AinSS.BufInfo.Tail = 0;
    pd_board[board].AinSS.BufInfo.FirstTimestamp = 0;
    pd_board[board].AinSS.BufInfo.LastTimestamp = 0;
+   pd_board[board].AinSS.BufInfo.StampCount = 0;
    pd_board[board].AinSS.BufInfo.ValueCount = 0;
    pd_board[board].AinSS.BufInfo.WrapCount = 0;
    pd_board[board].AinSS.BufInfo.ScanIndex = 0;
@@ -435,8 +501,11 @@ int pd_ain_async_init(int board, tAsyncCfg* pAInCfg)
    pd_board[board].AinSS.bAsyncMode = TRUE;
 
    pd_board[board].AinSS.dwEventsNotify = 0;
+   pd_board[board].AinSS.dwEventsPersist = 0;
    pd_board[board].AinSS.dwEventsStatus = 0;
    pd_board[board].AinSS.dwEventsNew = 0;
+   pd_board[board].AinSS.dwFramesNew = 0;
+   pd_board[board].AinSS.dwDataNew = 0;
 
    pd_board[board].AinSS.BlkXferValues = AIN_BLKSIZE;
    pd_board[board].AinSS.XferBufValueCount = 0;
@@ -747,6 +816,7 @@ int pd_aout_async_init(int board, tAsyncCfg* pAOutCfg)
    pd_board[board].AoutSS.BufInfo.Tail = 0;
    pd_board[board].AoutSS.BufInfo.FirstTimestamp = 0;
    pd_board[board].AoutSS.BufInfo.LastTimestamp = 0;
+   pd_board[board].AoutSS.BufInfo.StampCount = 0;
    pd_board[board].AoutSS.BufInfo.ValueCount = 0;
    pd_board[board].AoutSS.BufInfo.WrapCount = 0;
    pd_board[board].AoutSS.BufInfo.ScanIndex = 0;
@@ -763,8 +833,10 @@ int pd_aout_async_init(int board, tAsyncCfg* pAOutCfg)
       pd_board[board].AoutSS.bCheckFifoError = FALSE;
 
    pd_board[board].AoutSS.dwEventsNotify = 0;
+   pd_board[board].AoutSS.dwEventsPersist = 0;
    pd_board[board].AoutSS.dwEventsStatus = 0;
    pd_board[board].AoutSS.dwEventsNew = 0;
+   pd_board[board].AoutSS.dwFramesNew = 0;
 
    //-----------------------------------------------------------------------
    // Program AOut subsystem:
@@ -814,6 +886,10 @@ int pd_aout_async_init(int board, tAsyncCfg* pAOutCfg)
       for (i = 0; (i < pAOutCfg->dwChListSize)&&(i<PD_MAX_CL_SIZE); i++)
             pd_board[board].AoutSS.ChList[i] = *(pAOutCfg->dwChList + i);
    }
+   // unroll it into the tag pattern used by pd_aout_put_xbuf
+   pd_board[board].AoutSS.ChTagLen = pd_aout_build_tags(pd_board[board].AoutSS.ChTags,
+                                                        pd_board[board].AoutSS.ChList,
+                                                        pd_board[board].AoutSS.dwChListChan);
    
    // Check - do we need to use AOB_REGENERATE
    BufVal = pd_board[board].AoutSS.BufInfo.BufSizeInBytes >> (pd_board[board].AoutSS.BufInfo.DataWidth >> 1);
@@ -1048,6 +1124,8 @@ int pd_ain_async_start(int board)
       }
 
    pd_board[board].AinSS.SubsysState = ssRunning;
+   pd_gap_start(&pd_board[board].AinSS.BufInfo.GapLog, pd_get_time_ns());
+   pd_bm_ring_reset(board);
 
    return 1;
 }
@@ -1219,7 +1297,11 @@ int pd_ain_async_retrieve(int board)
         dwFrameCtr = pd_dsp_read(board); // read frame counter
         pd_dsp_read_ack(board);
 
-        // 3. retrieve exisiting data and put into into the user buffer
+        // 3. retrieve exisiting data and put into into the user buffer,
+        //    the full pages in the bus-master ring first
+        if (pd_board[board].BmRing.Slots)
+           pd_bm_ring_drain(board);
+
         if (pd_board[board].cp == AI_PAGE0) 
            dwPage = AI_PAGE1; 
         else 
@@ -1406,6 +1488,9 @@ int pd_ain_get_scans(int board, tScanInfo* pScanInfo)
     );
     //
 
+    pd_daqbuf_ctrl_publish(pDaqBuf, pd_board[board].AinSS.SubsysState, 
+                           pd_board[board].AinSS.dwEventsStatus);
+
     // Check if buffer is empty and notify user.
     if (pDaqBuf->Count == 0)
     {
@@ -1416,6 +1501,74 @@ int pd_ain_get_scans(int board, tScanInfo* pScanInfo)
     return 1;
 }
 
+//---------------------------------------------------------------------------
+// Function:    pd_ain_release_scans
+//
+// Parameters:  int board
+//              u32 ScanIndex -- index of the next scan the user will read
+//
+// Returns:     1 = SUCCESS
+//
+// Description: Used by applications that follow Head through the control
+//              page instead of calling pd_ain_get_scans for each block.
+//              Moves the driver scan index up to ScanIndex and releases
+//              (recycles) all the frames before it, exactly as a sequence
+//              of pd_ain_get_scans calls would do.
+//
+// Notes:       * This routine must be called with device spinlock held! *
+//
+int pd_ain_release_scans(int board, u32 ScanIndex)
+{
+    PTBuf_Info pDaqBuf = &pd_board[board].AinSS.BufInfo;
+    tScanInfo ScanInfo;
+    u32 MaxScans;
+    int i;
+
+    if (!pDaqBuf->databuf || !pDaqBuf->ScanValues)
+        return 0;
+
+    MaxScans = pDaqBuf->MaxValues / pDaqBuf->ScanValues;
+    if (ScanIndex >= MaxScans)
+        return 0;
+
+    // at most two steps: up to the end of the buffer, then from the start
+    for (i = 0; (i < 2) && (pDaqBuf->ScanIndex != ScanIndex); i++)
+    {
+        ScanInfo.NumScans = (ScanIndex + MaxScans - pDaqBuf->ScanIndex) % MaxScans;
+        pd_ain_get_scans(board, &ScanInfo);
+        if (!ScanInfo.NumValidScans)
+            break;
+    }
+
+    // release frames behind the new scan index
+    ScanInfo.NumScans = 0;
+    pd_ain_get_scans(board, &ScanInfo);
+
+    return (pDaqBuf->ScanIndex == ScanIndex);
+}
+
+//---------------------------------------------------------------------------
+// Function:    pd_ain_get_gaps
+//
+// Parameters:  int board
+//              tGapQuery* pQuery -- IN: FirstSeq, OUT: NumGaps, NumRet, Gap[]
+//
+// Returns:     1 = SUCCESS
+//
+// Description: Returns the AIn FIFO overrun restarts logged from gap
+//              FirstSeq on (BUF_AUTORESTART buffers only).
+//
+// Notes:       * This routine must be called with device spinlock held! *
+//
+int pd_ain_get_gaps(int board, tGapQuery* pQuery)
+{
+    PTBuf_Info pDaqBuf = &pd_board[board].AinSS.BufInfo;
+
+    pQuery->NumGaps = pd_gap_get(&pDaqBuf->GapLog, pQuery->FirstSeq,
+                                 pQuery->Gap, PD_GAP_LOG_SIZE, &pQuery->NumRet);
+    return 1;
+}
+
 //---------------------------------------------------------------------------
 // Function:    pd_aout_get_scans
 //
@@ -1537,6 +1690,9 @@ int pd_aout_get_scans(int board, tScanInfo* pScanInfo)
     }
     */
 
+    pd_daqbuf_ctrl_publish(pDaqBuf, pd_board[board].AoutSS.SubsysState, 
+                           pd_board[board].AoutSS.dwEventsStatus);
+
     return 1;
 }
 
@@ -1704,7 +1860,6 @@ int pd_aout_dmaSet(int board, u32 offset, u32 count, u32 source)
 //
 //-----------------------------------------------------------------------
 
-#define USEASMPUTBLOCKAO
 int pd_aout_put_xbuf(int board, u32 NumToCopy, u32 *UserBufCopied)
 {
    u32   Count;                  // num samples in buffer (queue)
@@ -1713,7 +1868,7 @@ int pd_aout_put_xbuf(int board, u32 NumToCopy, u32 *UserBufCopied)
    u32   FrameValues;            // num values in frame
    u32   MaxValues;              // max buffer samples
    u32   SamplesA, SamplesB;     // A: from head to the end, B: from the beginning
-   u32   i, j, dwVal0, dwVal1, AvlSamples, id;
+   u32   AvlSamples, id, L;
    u32   SamplesCopied, XFerSize, dwAdj, dwReply, dwWords, dwAllowed;
    u32*  pBuf;
    u32*  pdwUserBuf;
@@ -1776,134 +1931,60 @@ int pd_aout_put_xbuf(int board, u32 NumToCopy, u32 *UserBufCopied)
 
    XFerSize = NumToCopy;
 
-   // put data to the XFer buffer from the user buffer
+   // put data to the XFer buffer from the user buffer (see pdl_aopack.c)
+   // SamplesB part always goes right after SamplesA part in XFer buffer
+   L = pd_board[board].AoutSS.ChTagLen;
    if (pd_board[board].AoutSS.BufInfo.DataWidth == sizeof(ULONG))
    {
       // DWORD user buffer
-      if ( PD_IS_MFX(id) ||PDL_IS_MFX(id))
+      if ( PD_IS_MFX(id) ||PDL_IS_MFX(id) || !L)
       {
          // (case 2, PD2-MF(S) with DWORD buffer - output directly)
-         //RtlCopyBytes(pBuf, pdwUserBuf+Head, (SamplesA * sizeof(ULONG)) );
-         //RtlCopyBytes(pBuf, pdwUserBuf, (SamplesB * sizeof(ULONG)) );
-         for (i = 0; i < SamplesA; i++)
-         {
-            (*(pBuf + i)) = (*(pdwUserBuf + i + Head));
-         }
+         // (case 5, PD2-AO with DWORD buffer and BUF_FIXEDDMA)
+         memcpy(pBuf, pdwUserBuf+Head, (SamplesA * sizeof(u32)));
          if (SamplesB)
-         {
-            j = i;
-            for (i = 0; i < SamplesB; i++, j++)
-            {
-               *(pBuf + j) = *(pdwUserBuf + i);
-            }
-         }
-
+            memcpy(pBuf+SamplesA, pdwUserBuf, (SamplesB * sizeof(u32)));
       }
       else
       {
-         if (pd_board[board].AoutSS.dwChListChan)
-         {
-            // (case 4, PD2-AO with DWORD buffer)
-            // combine channels data with channel list entries
-            for (i = 0; i < SamplesA; i++)
-            {
-               *(pBuf + i) = *(pdwUserBuf + i + Head) |
-                        pd_board[board].AoutSS.ChList[(i+Head)%pd_board[board].AoutSS.dwChListChan]<<16;
-            }
-            if (SamplesB)
-            {
-               j = i; // j - pointer in the XFer buffer
-               for (i = 0; i < SamplesB; i++, j++)
-               {
-                  *(pBuf + j) = *(pdwUserBuf + i) |
-                        pd_board[board].AoutSS.ChList[i%pd_board[board].AoutSS.dwChListChan]<<16;
-               }
-            }
-         }
-         else
-         {
-
-            // (case 5, PD2-AO with DWORD buffer and BUF_FIXEDDMA)
-            // do direct copy if buffer filled with DWORDs - if MFS or direct AO
-            //RtlCopyBytes(pBuf, pdwUserBuf+Head, (SamplesA * sizeof(ULONG)) );
-            memcpy(pBuf, pdwUserBuf+Head, (SamplesA * sizeof(u32)));
-            if (SamplesB)
-               memcpy(pBuf, pdwUserBuf, (SamplesB * sizeof(u32)) );
-         }
+         // (case 4, PD2-AO with DWORD buffer)
+         // combine channels data with channel list entries
+         pd_aopack_tag32(pBuf, pdwUserBuf+Head, SamplesA,
+                         pd_board[board].AoutSS.ChTags, L, Head % L);
+         if (SamplesB)
+            pd_aopack_tag32(pBuf+SamplesA, pdwUserBuf, SamplesB,
+                            pd_board[board].AoutSS.ChTags, L, 0);
       }
-
    }
    else
    {
-
       // WORD user buffer
-
       if (PD_IS_MFX(id) ||PDL_IS_MFX(id))
       {
          // (case 1, PD2-MF(S) with WORD buffer)
          // combine two WORDs from user buffer into DWORD in XFer buffer for MF(S)
-         for (i = 0; i < SamplesA; i+=2)
-         {
-            dwVal0 = *(pwUserBuf + i + Head);
-            dwVal1 = *(pwUserBuf + i + 1 + Head);
-            *(pBuf + (i>>1)) = (dwVal0 >> 4) | (dwVal1 << 8);
-         }
+         pd_aopack_mfx16(pBuf, pwUserBuf+Head, (SamplesA+1)>>1);
          if (SamplesB)
-         {
-            j = i;
-            for (i = 0; i < SamplesB; i+=2, j+=2)
-            {
-               dwVal0 = *(pwUserBuf + i);
-               dwVal1 = *(pwUserBuf + i + 1);
-               *(pBuf + (j>>1)) = (dwVal0 >> 4) | (dwVal1 << 8);
-            }
-         }
+            pd_aopack_mfx16(pBuf+((SamplesA+1)>>1), pwUserBuf, (SamplesB+1)>>1);
          dwAdj = 2;
          XFerSize = NumToCopy/dwAdj;
-
+      }
+      else if (L)
+      {
+         // (case 3, PD2-AO with WORD buffer)
+         // complement WORD value with CL entry
+         pd_aopack_tag16(pBuf, pwUserBuf+Head, SamplesA,
+                         pd_board[board].AoutSS.ChTags, L, Head % L);
+         if (SamplesB)
+            pd_aopack_tag16(pBuf+SamplesA, pwUserBuf, SamplesB,
+                            pd_board[board].AoutSS.ChTags, L, 0);
       }
       else
       {
-         if(pd_board[board].AoutSS.dwChListChan)
-         //if (!((pd_board[board].AoutSS.BufInfo.bFixedDMA)||(pd_board[board].AoutSS.SubsysConfig & AOB_DMAEN)))
-         {
-            //(case 3, PD2-AO with WORD buffer)
-            // complement WORD value with CL entry
-            for (i = 0; i < SamplesA; i++)
-            {
-               dwVal0 = *(pwUserBuf + i + Head);
-               *(pBuf + i) = dwVal0 |
-                             pd_board[board].AoutSS.ChList[(i+Head)%pd_board[board].AoutSS.dwChListChan]<<16;
-            }
-            if (SamplesB)
-            {
-               j = i;
-               for (i = 0; i < SamplesB; i++)
-               {
-                  dwVal0 = *(pwUserBuf + i);
-                  *(pBuf + j) = dwVal0 |
-                                pd_board[board].AoutSS.ChList[i%pd_board[board].AoutSS.dwChListChan]<<16;
-               }
-            }
-         }
-         else
-         {
-            // (case 6, PD2-AO with WORD buffer and BUF_FIXEDDMA)
-            for (i = 0; i < SamplesA; i++)
-            {
-               dwVal0 = *(pwUserBuf + i + Head);
-               *(pBuf + i) = (USHORT)dwVal0;
-            }
-            if (SamplesB)
-            {
-               j = i;
-               for (i = 0; i < SamplesB; i++, j++)
-               {
-                  dwVal0 = *(pwUserBuf + i);
-                  *(pBuf + j) = (USHORT)dwVal0;
-               }
-            }
-         }
+         // (case 6, PD2-AO with WORD buffer and BUF_FIXEDDMA)
+         pd_aopack_widen16(pBuf, pwUserBuf+Head, SamplesA);
+         if (SamplesB)
+            pd_aopack_widen16(pBuf+SamplesA, pwUserBuf, SamplesB);
       }
    }
 
@@ -1918,31 +1999,7 @@ int pd_aout_put_xbuf(int board, u32 NumToCopy, u32 *UserBufCopied)
    pd_dsp_write(board, dwWords);
 
    // Write block of dwWords to transmit register.
-   if (pd_board[board].dwXFerMode != XFERMODE_NORMAL)
-   {
-      u32*  pulSrc = (u32*)pBuf;
-      u32*  pulDest = (u32*)(pd_board[board].address + PCI_HTXR);
-      u32   ulCnt   = dwWords & 0xFFF;
-
-      asm ("rep movsl;"
-		:	/* no output */	
-		:"S"(pulSrc), "D"(pulDest), "c"(ulCnt)		/* input */
-		);	/* clobbered register */
-      /*__asm   cld
-      __asm   mov ecx,ulCnt
-      __asm   mov esi,pulSrc
-      __asm   mov edi,pulDest
-      __asm   rep movsd */
-   }
-   else
-   {
-      for ( i = 0; i < dwWords; i++ )
-      {
-         //PdAdapterWrite(pAdapter, *(pBuf + i));
-         //dwReply = *(pBuf + i); //0xFFFFFF * (i%2);
-         pd_dsp_write(board, *(pBuf + i));
-      }
-   }
+   pd_dsp_write_block(board, pBuf, dwWords);
 
    SamplesCopied = dwWords;
    dwReply = pd_dsp_read_ack(board);
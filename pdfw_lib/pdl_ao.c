@@ -366,7 +366,7 @@ int pd_aout_put_value(int board, u32 dwValue)
 //
 int pd_aout_put_block(int board, u32 dwNumValues, u32* pdwBuf, u32* pdwCount)
 {
-    u32  i, dwReply, dwWords, value;
+    u32  dwReply, dwWords;
 
     // Issue PD_AOPUTBLOCK command and read remaining buffer size.
     dwReply = pd_dsp_cmd_ret_value(board, PD_AOPUTBLOCK);
@@ -376,13 +376,7 @@ int pd_aout_put_block(int board, u32 dwNumValues, u32* pdwBuf, u32* pdwCount)
     pd_dsp_write(board, dwWords);
 
     // Write block of dwWords to transmit register.
-    //FIXME: this code shall be rewritten with copy_toio when FW will be available
-    for ( i = 0; i < dwWords; i++ )
-    {
-        // get data from user buffer
-        value = *(pdwBuf + i);
-        pd_dsp_write(board, value);
-    }
+    pd_dsp_write_block(board, pdwBuf, dwWords);
 
     *pdwCount = dwWords;
 
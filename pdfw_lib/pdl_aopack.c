@@ -0,0 +1,220 @@
+//===========================================================================
+//
+// NAME:    pdl_aopack.c
+//
+// DESCRIPTION:
+//
+//          Packing kernels used by pd_aout_put_xbuf() to move samples from
+//          the AOut user buffer into the transfer buffer.
+//
+//          Channel list entries are not looked up per sample. Instead
+//          pd_aout_build_tags() unrolls the list into a tag pattern whose
+//          length is a multiple of the list length, stored twice, so the
+//          inner loops run on a plain pointer without any modulo.
+//
+//          The merge/widen kernels work on 64-bit words (two transfer
+//          words per store). This is integer only code - no FPU/SSE state
+//          is touched, so it is safe in interrupt and bottom half context
+//          and in the RT variants. Big-endian hosts use the scalar loops.
+//
+//          The file has no kernel dependencies so it can be built in
+//          user space (see examples/AOutPackBench).
+//
+//---------------------------------------------------------------------------
+//      Copyright (C) 2000,2004 United Electronic Industries, Inc.
+//      All rights reserved.
+//---------------------------------------------------------------------------
+// For more informations on using and distributing this software, please see
+// the accompanying "LICENSE" file.
+//
+//===========================================================================
+
+#ifndef PD_AO_TAG_PATTERN
+#define PD_AO_TAG_PATTERN 64   // minimum tag pattern length, <= PD_MAX_CL_SIZE/2
+#endif
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define PD_AOPACK_SWAR
+#endif
+
+#ifdef PD_AOPACK_SWAR
+static inline u64 pd_aopack_ld64(const void *p)
+{
+   u64 v;
+   memcpy(&v, p, sizeof(v));
+   return v;
+}
+
+static inline void pd_aopack_st64(void *p, u64 v)
+{
+   memcpy(p, &v, sizeof(v));
+}
+
+// Widen four WORDs packed in v to four DWORDs, returned as two QWORDs
+static inline void pd_aopack_widen4(u64 v, u64 *pLo, u64 *pHi)
+{
+   *pLo = (v & 0xFFFFULL) | ((v & 0xFFFF0000ULL) << 16);
+   *pHi = ((v >> 32) & 0xFFFFULL) | ((v >> 16) & 0xFFFF00000000ULL);
+}
+#endif
+
+//+
+// Function:    pd_aout_build_tags
+//
+// Parameters:  u32* pTags   -- tag buffer, 2 * PD_MAX_CL_SIZE entries
+//              u32* pChList -- channel list
+//              u32  dwChan  -- number of entries in channel list
+//
+// Returns:     u32 -- pattern length L (0 if channel list is empty)
+//
+// Description: Builds pTags[k] = ChList[k % dwChan] << 16 for k < 2*L.
+//              L is the smallest multiple of dwChan not less than
+//              PD_AO_TAG_PATTERN, so the pattern starting at any phase
+//              below L is valid for L consecutive samples.
+//
+//-
+u32 pd_aout_build_tags(u32 *pTags, const u32 *pChList, u32 dwChan)
+{
+   u32 i, L;
+
+   if (!dwChan) return 0;
+   if (dwChan > PD_MAX_CL_SIZE) dwChan = PD_MAX_CL_SIZE;
+
+   L = ((PD_AO_TAG_PATTERN + dwChan - 1) / dwChan) * dwChan;
+   for (i = 0; i < L; i++)
+      pTags[i] = pTags[i + L] = pChList[i % dwChan] << 16;
+
+   return L;
+}
+
+//+
+// Function:    pd_aopack_tag16
+//
+// Parameters:  u32* pDst   -- transfer buffer
+//              u16* pSrc   -- WORD user buffer
+//              u32  dwNum  -- number of samples
+//              u32* pTags  -- tag pattern from pd_aout_build_tags()
+//              u32  L      -- pattern length
+//              u32  dwPhase-- channel list position of pSrc[0], < L
+//
+// Description: pDst[i] = pSrc[i] | ChList[(phase + i) % dwChan] << 16
+//              (case 3, PD2-AO with WORD buffer)
+//
+//-
+void pd_aopack_tag16(u32 *pDst, const u16 *pSrc, u32 dwNum,
+                     const u32 *pTags, u32 L, u32 dwPhase)
+{
+   const u32 *pT = pTags + dwPhase;
+   u32 i, run;
+
+   while (dwNum)
+   {
+      run = (dwNum < L) ? dwNum : L;
+      i = 0;
+#ifdef PD_AOPACK_SWAR
+      for (; i + 4 <= run; i += 4)
+      {
+         u64 lo, hi;
+         pd_aopack_widen4(pd_aopack_ld64(pSrc + i), &lo, &hi);
+         pd_aopack_st64(pDst + i, lo | pd_aopack_ld64(pT + i));
+         pd_aopack_st64(pDst + i + 2, hi | pd_aopack_ld64(pT + i + 2));
+      }
+#endif
+      for (; i < run; i++)
+         pDst[i] = pSrc[i] | pT[i];
+
+      pDst += run;
+      pSrc += run;
+      dwNum -= run;
+   }
+}
+
+//+
+// Function:    pd_aopack_tag32
+//
+// Description: pDst[i] = pSrc[i] | ChList[(phase + i) % dwChan] << 16
+//              (case 4, PD2-AO with DWORD buffer). Parameters are the same
+//              as for pd_aopack_tag16().
+//
+//-
+void pd_aopack_tag32(u32 *pDst, const u32 *pSrc, u32 dwNum,
+                     const u32 *pTags, u32 L, u32 dwPhase)
+{
+   const u32 *pT = pTags + dwPhase;
+   u32 i, run;
+
+   while (dwNum)
+   {
+      run = (dwNum < L) ? dwNum : L;
+      i = 0;
+#ifdef PD_AOPACK_SWAR
+      for (; i + 4 <= run; i += 4)
+      {
+         pd_aopack_st64(pDst + i, pd_aopack_ld64(pSrc + i) | pd_aopack_ld64(pT + i));
+         pd_aopack_st64(pDst + i + 2, pd_aopack_ld64(pSrc + i + 2) | pd_aopack_ld64(pT + i + 2));
+      }
+#endif
+      for (; i < run; i++)
+         pDst[i] = pSrc[i] | pT[i];
+
+      pDst += run;
+      pSrc += run;
+      dwNum -= run;
+   }
+}
+
+//+
+// Function:    pd_aopack_mfx16
+//
+// Parameters:  u32* pDst   -- transfer buffer
+//              u16* pSrc   -- WORD user buffer
+//              u32  dwPairs-- number of DWORDs to produce
+//
+// Description: pDst[k] = (pSrc[2k] >> 4) | (pSrc[2k+1] << 8)
+//              (case 1, PD2-MF(S) with WORD buffer)
+//
+//-
+void pd_aopack_mfx16(u32 *pDst, const u16 *pSrc, u32 dwPairs)
+{
+   u32 k = 0;
+
+#ifdef PD_AOPACK_SWAR
+   // two pairs per QWORD: low 4 bits of the even WORD are dropped, odd
+   // WORD moves up by 8 bits into the adjacent DWORD lane
+   for (; k + 4 <= dwPairs; k += 4)
+   {
+      u64 v0 = pd_aopack_ld64(pSrc + 2*k);
+      u64 v1 = pd_aopack_ld64(pSrc + 2*k + 4);
+      pd_aopack_st64(pDst + k,     ((v0 & 0x0000FFF00000FFF0ULL) >> 4) |
+                                   ((v0 >> 8) & 0x00FFFF0000FFFF00ULL));
+      pd_aopack_st64(pDst + k + 2, ((v1 & 0x0000FFF00000FFF0ULL) >> 4) |
+                                   ((v1 >> 8) & 0x00FFFF0000FFFF00ULL));
+   }
+#endif
+   for (; k < dwPairs; k++)
+      pDst[k] = ((u32)pSrc[2*k] >> 4) | ((u32)pSrc[2*k + 1] << 8);
+}
+
+//+
+// Function:    pd_aopack_widen16
+//
+// Description: pDst[i] = pSrc[i]
+//              (case 6, PD2-AO with WORD buffer and BUF_FIXEDDMA)
+//
+//-
+void pd_aopack_widen16(u32 *pDst, const u16 *pSrc, u32 dwNum)
+{
+   u32 i = 0;
+
+#ifdef PD_AOPACK_SWAR
+   for (; i + 4 <= dwNum; i += 4)
+   {
+      u64 lo, hi;
+      pd_aopack_widen4(pd_aopack_ld64(pSrc + i), &lo, &hi);
+      pd_aopack_st64(pDst + i, lo);
+      pd_aopack_st64(pDst + i + 2, hi);
+   }
+#endif
+   for (; i < dwNum; i++)
+      pDst[i] = pSrc[i];
+}
@@ -0,0 +1,175 @@
+//===========================================================================
+//
+// NAME:    pdl_bmring.c
+//
+// DESCRIPTION:
+//
+//          AIn bus-master page ring (bm_ring=N module option).
+//
+//          The firmware masters AIn into two pages, one after the other,
+//          and raises a page done event for each. Without the ring, the
+//          bottom half moves a page into the DAQ buffer, and the board
+//          must not complete the other page before that: a bottom half
+//          delayed by more than a page time loses data.
+//
+//          With the ring, the ISR copies each completed page into the
+//          next of N slots, clears the page done event and re-enables the
+//          board interrupt itself. The bottom half then moves all the
+//          filled slots into the DAQ buffer in one go, whenever it gets to
+//          run. It can be late by up to N page times. Each slot keeps the
+//          time its page was done, for the frame stamps.
+//
+//          The slots can't be given to the board instead of being copied:
+//          the firmware takes the two page addresses once per acquisition,
+//          and the pages hold 32-bit values while most DAQ buffers hold
+//          16-bit ones.
+//
+//---------------------------------------------------------------------------
+//      Copyright (C) 2000,2004 United Electronic Industries, Inc.
+//      All rights reserved.
+//---------------------------------------------------------------------------
+// For more informations on using and distributing this software, please see
+// the accompanying "LICENSE" file.
+//
+//===========================================================================
+
+//+
+// Function:    pd_bm_ring_reset
+//
+// Parameters:  int board
+//
+// Description: Empties the ring (AIn async start).
+//
+// Notes:       * This routine must be called with device spinlock held! *
+//
+//-
+void pd_bm_ring_reset(int board)
+{
+   TBmRing* pRing = &pd_board[board].BmRing;
+
+   pRing->Put = 0;
+   pRing->Get = 0;
+   pRing->Count = 0;
+   pRing->bOverrun = FALSE;
+}
+
+//+
+// Function:    pd_bm_ring_isr
+//
+// Parameters:  int board
+//              u64 Now     -- ISR entry time, ns
+//
+// Returns:     number of pages moved into the ring
+//
+// Description: Called from the ISR during a bus-master acquisition.
+//              Copies the pages the board completed into the ring and
+//              clears their page done events. If both pages are done, the
+//              one after cp was done first. When the ring is full the page
+//              is dropped and bOverrun is set for the bottom half.
+//
+// Notes:       * This routine must be called with device spinlock held! *
+//
+//-
+int pd_bm_ring_isr(int board, u64 Now)
+{
+   TBmRing* pRing = &pd_board[board].BmRing;
+   tEvents Events;
+   tEvents ClearEvents = {0};
+   u32 Done, Values, First, page, n;
+   TBmSlot* pSlot;
+   int Moved = 0;
+
+   if (!pd_adapter_get_board_status(board, &Events))
+      return 0;
+
+   Done = Events.AInIntr & (AIB_BMPg0DoneSC | AIB_BMPg1DoneSC);
+   if (!Done)
+      return 0;
+
+   Values = pd_board[board].AinSS.BmPageXFers * pd_board[board].AinSS.AIBMTXSize;
+   if (Values > pRing->SlotValues)
+      Values = pRing->SlotValues;
+
+   // the page after cp first, then cp itself
+   First = pd_board[board].cp ^ 1;
+   for (n = 0; n < 2; n++)
+   {
+      page = (n == 0) ? First : (First ^ 1);
+      if (!(Done & ((page == AI_PAGE0) ? AIB_BMPg0DoneSC : AIB_BMPg1DoneSC)))
+         continue;
+
+      if (pRing->Count < pRing->Slots)
+      {
+         pSlot = &pRing->pSlot[pRing->Put];
+         memcpy(pSlot->pValues, pd_board[board].pSysBMB[page], Values * sizeof(u32));
+         pSlot->Values = Values;
+         pSlot->Time = Now;
+
+         pRing->Put = (pRing->Put + 1) % pRing->Slots;
+         pRing->Count++;
+         Moved++;
+      }
+      else
+      {
+         pRing->bOverrun = TRUE;
+      }
+
+      pd_board[board].cp = page;
+   }
+
+   // clear the page done events, keep the masks as they are
+   ClearEvents.AInIntr = (Events.AInIntr & (AIB_BMPgDoneIm |
+                                            AIB_BMErrIm |
+                                            AIB_StartIm |
+                                            AIB_StopIm |
+                                            AIB_BMEnabled |
+                                            AIB_BMActive)) |
+                         Done;
+   pd_enable_events(board, &ClearEvents);
+
+   DPRINTK_T("i>pd_bm_ring_isr: %d pages, %d in the ring\n", Moved, pRing->Count);
+
+   return Moved;
+}
+
+//+
+// Function:    pd_bm_ring_drain
+//
+// Parameters:  int board
+//
+// Returns:     number of slots moved into the DAQ buffer
+//
+// Description: Bottom half side of the ring: moves the filled slots into
+//              the DAQ buffer, oldest first. If the ISR had to drop a
+//              page, the acquisition is stopped with eBufferError after
+//              the slots before it are moved.
+//
+// Notes:       * This routine must be called with device spinlock held! *
+//
+//-
+u32 pd_bm_ring_drain(int board)
+{
+   TBmRing* pRing = &pd_board[board].BmRing;
+   TBmSlot* pSlot;
+   u32 n = 0;
+
+   while (pRing->Count)
+   {
+      pSlot = &pRing->pSlot[pRing->Get];
+      pd_process_ain_move_values(board, pSlot->pValues, pSlot->Values, pSlot->Time);
+
+      pRing->Get = (pRing->Get + 1) % pRing->Slots;
+      pRing->Count--;
+      n++;
+   }
+
+   if (pRing->bOverrun)
+   {
+      DPRINTK_E("bh>pd_bm_ring_drain: ring full, page lost\n");
+      pRing->bOverrun = FALSE;
+      pd_stop_and_disable_ain(board);
+      pd_board[board].AinSS.dwEventsNew |= eStopped | eBufferError;
+   }
+
+   return n;
+}
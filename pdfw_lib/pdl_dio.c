@@ -215,14 +215,9 @@ int pd_dio256_write_output(int board, u32 cmd, u32 val)
 //
 int pd_dio256_write_all(int board, u32* pdata)
 {
-    int i;
-    
     pd_dsp_cmd_no_ret(board, PD_DIO256WR_ALL);
 
-    for (i = 0; i < DIO_REGS_NUM/2; i++)  
-    {
-        pd_dsp_write(board, *(pdata+i));
-    }
+    pd_dsp_write_block(board, pdata, DIO_REGS_NUM/2);
 
     // Read ack
     return pd_dsp_read_ack(board);
@@ -406,6 +401,100 @@ int pd_dio256_intrEnable(int board, u32 enable)
 }
 
 
+//-----------------------------------------------------------------------
+// Function:    int pd_dio256_cos_start(int board)
+//
+// Returns:     BOOLEAN status  -- TRUE:  command succeeded
+//                                 FALSE: command failed
+//
+// Description: Starts the change of state queue: from now on the bottom
+//              half reads the interrupt and edge words of each DIn
+//              interrupt and re-arms the interrupt right away, see
+//              pd_dio256_cos_log. The interrupt mask is the one set with
+//              pd_dio256_setIntrMask.
+//
+// Notes:       The ring must have been allocated, pd_dio256_cos_alloc.
+//              * This routine must be called with device spinlock held! *
+//
+//-----------------------------------------------------------------------
+int pd_dio256_cos_start(int board)
+{
+    tEvents FwEvents = {0};
+    tCosRing* pRing = pd_board[board].DinSS.pCosRing;
+    int i;
+
+    if (!pRing)
+        return 0;
+
+    for (i = 0; i < PD_COS_RING_SIZE; i++)
+        pRing->Rec[i].Seq = PD_COS_INVALID;
+    pRing->Errors = 0;
+    pRing->Count = 0;
+
+    pd_board[board].DinSS.bCosRunning = TRUE;
+
+    FwEvents.ADUIntr = DIB_IntrIm | DIB_IntrSC;
+    if (!pd_enable_events(board, &FwEvents))
+        return 0;
+
+    pd_adapter_enable_interrupt(board, 1);
+
+    return pd_dio256_intrEnable(board, 1);
+}
+
+//-----------------------------------------------------------------------
+// Function:    int pd_dio256_cos_stop(int board)
+//
+// Returns:     BOOLEAN status  -- TRUE:  command succeeded
+//                                 FALSE: command failed
+//
+// Description: Stops the change of state queue and disables the DIn
+//              interrupt. The records stay in the ring.
+//
+// Notes:       * This routine must be called with device spinlock held! *
+//
+//-----------------------------------------------------------------------
+int pd_dio256_cos_stop(int board)
+{
+    tEvents FwEvents = {0};
+
+    if (!pd_board[board].DinSS.bCosRunning)
+        return 1;
+
+    pd_board[board].DinSS.bCosRunning = FALSE;
+
+    FwEvents.ADUIntr = DIB_IntrIm | DIB_IntrSC;
+    pd_disable_events(board, &FwEvents);
+
+    return pd_dio256_intrEnable(board, 0);
+}
+
+//-----------------------------------------------------------------------
+// Function:    void pd_dio256_cos_log(int board, u64 Now)
+//
+// Parameters:  int board
+//              u64 Now     -- ISR entry time, ns
+//
+// Description: Bottom half side of the change of state queue. Reads the
+//              interrupt and edge words latched by the board, logs them
+//              and re-arms the DIn interrupt, so that the next change
+//              doesn't wait for the application.
+//
+// Notes:       * This routine must be called with device spinlock held! *
+//
+//-----------------------------------------------------------------------
+void pd_dio256_cos_log(int board, u64 Now)
+{
+    u32 *pIntData = pd_board[board].DinSS.intrData;
+
+    if (pd_dio256_getIntrData(board))
+        pd_dio256_cos_put(board, Now, pIntData, pIntData + DIO_REGS_NUM);
+    else
+        pd_board[board].DinSS.pCosRing->Errors++;
+
+    pd_dio256_intrEnable(board, 1);
+}
+
 // -------------------------------------------------------------------------- 
 //       NAME:  pd_dsp_reg_write()
 //
@@ -457,6 +457,48 @@ int pd_set_user_events(int board, u32 subsystem, u32 events)
     return Status;
 }
 
+//
+// Function:    pd_subscribe_user_events
+//
+// Parameters:  int board
+//              u32 subsystem
+//              u32 events
+//
+// Returns:     1 = SUCCESS
+//
+// Description: Sets the events like pd_set_user_events, but they stay
+//              armed once notified: pd_notify_user_events doesn't clear
+//              their notification bits, so the DLL doesn't have to set
+//              them again after each wait. pd_notify_event accumulates
+//              and counts them until the next IOCTL_PWRDAQ_WAIT_EVENTS.
+//
+//              pd_clear_user_events, or an AIn/AOut async init, ends the
+//              subscription.
+//
+// Notes:       * This routine must be called with device spinlock held! *
+//
+int pd_subscribe_user_events(int board, u32 subsystem, u32 events)
+{
+    u32* pPersist;
+
+    if ( subsystem == AnalogIn )
+        pPersist = &pd_board[board].AinSS.dwEventsPersist;
+    else if ( subsystem == AnalogOut )
+        pPersist = &pd_board[board].AoutSS.dwEventsPersist;
+    else if ( subsystem == DigitalIn )
+        pPersist = &pd_board[board].DinSS.dwEventsPersist;
+    else if ( subsystem == CounterTimer || subsystem == DSPCounter )
+        pPersist = &pd_board[board].UctSS.dwEventsPersist;
+    else
+        return 0;
+
+    if ( !pd_set_user_events(board, subsystem, events) )
+        return 0;
+
+    *pPersist |= events;
+    return 1;
+}
+
 //
 // Function:    pd_clear_user_events
 //
@@ -497,6 +539,7 @@ int pd_clear_user_events(int board, u32 subsystem, u32 events)
     {
         // Clear driver event notification bits and clear event status bits.
         pd_board[board].AinSS.dwEventsNotify &= ~events;
+        pd_board[board].AinSS.dwEventsPersist &= ~events;
         pd_board[board].AinSS.dwEventsStatus &= ~events;
 
         // Clear firmware events.
@@ -530,6 +573,7 @@ int pd_clear_user_events(int board, u32 subsystem, u32 events)
     {
         // Clear driver event notification bits and clear event status bits.
         pd_board[board].AoutSS.dwEventsNotify &= ~events;
+        pd_board[board].AoutSS.dwEventsPersist &= ~events;
         pd_board[board].AoutSS.dwEventsStatus &= ~events;
 
         // Clear firmware events.
@@ -568,6 +612,7 @@ int pd_clear_user_events(int board, u32 subsystem, u32 events)
     {
         // Set driver event notification bits and clear event status bits.
         pd_board[board].DinSS.dwEventsNotify |= ~events;
+        pd_board[board].DinSS.dwEventsPersist &= ~events;
         pd_board[board].DinSS.dwEventsStatus &= ~events;
 
         // trigger events
@@ -584,6 +629,7 @@ int pd_clear_user_events(int board, u32 subsystem, u32 events)
     {
         // Set driver event notification bits and clear event status bits.
         pd_board[board].UctSS.dwEventsNotify |= ~events;
+        pd_board[board].UctSS.dwEventsPersist &= ~events;
         pd_board[board].UctSS.dwEventsStatus &= ~events;
 
         if ( events & (eUct0Event | eUct1Event | eUct2Event))
@@ -147,6 +147,93 @@ inline void pd_dsp_write_x(int board, u32 data)
    pd_writel(data, (pd_board[board].address + PCI_HTXR));
 }
 
+// 
+//       name:  pd_dsp_wait_write_ready()
+//
+//   function:  Busy-waits until the PowerDAQ transmit data register can
+//              take data (HSTR_HTRQ).
+//
+//  arguments:  The board (index) to wait on.
+//  
+//    returns:  1 if the board is ready, 0 on timeout.
+//
+inline int pd_dsp_wait_write_ready(int board) 
+{
+   unsigned long i;
+
+   for (i = 0; !(pd_dsp_get_status(board) & (1 << HSTR_HTRQ)) && (i < MAX_PCI_BUSY_WAIT); i ++) { }
+   if (i == MAX_PCI_BUSY_WAIT) {
+      DPRINTK_F("ERROR! board not responding during PCI block write\n");
+      return 0;
+   }
+
+   return 1;
+}
+
+// 
+//       name:  pd_dsp_write_block()
+//
+//   function:  Writes a block of words to the PowerDAQ transmit data
+//              register. The DSP status is checked once for the whole
+//              block, then the words are written back to back; the host
+//              interface holds the bus off while its FIFO is full.
+//              Boards loaded with xferMode=XFERMODE_NORMAL keep the
+//              status check before every word.
+//
+//  arguments:  The board (index) to write to, the buffer and the number
+//              of words to write.
+//  
+//    returns:  1 if it worked, 0 if the board is not ready.
+//
+int pd_dsp_write_block(int board, const u32* buffer, u32 count) 
+{
+   u32 i;
+
+   if (!count)
+      return 1;
+
+   if (pd_board[board].dwXFerMode == XFERMODE_NORMAL)
+   {
+      for (i = 0; i < count; i++)
+      {
+         if (!pd_dsp_wait_write_ready(board))
+            return 0;
+         pd_dsp_write_x(board, buffer[i]);
+      }
+      return 1;
+   }
+
+   if (!pd_dsp_wait_write_ready(board))
+      return 0;
+
+   pd_writel_rep32(pd_board[board].address + PCI_HTXR, buffer, count);
+
+   return 1;
+}
+
+// 
+//       name:  pd_dsp_wait_read_ready()
+//
+//   function:  Busy-waits until the PowerDAQ receive data register has
+//              data (HSTR_HRRQ).
+//
+//  arguments:  The board (index) to wait on.
+//  
+//    returns:  1 if the board is ready, 0 on timeout.
+//
+inline int pd_dsp_wait_read_ready(int board) 
+{
+   unsigned long i;
+
+   for (i = 0; !(pd_dsp_get_status(board) & (1 << HSTR_HRRQ)) && (i < MAX_PCI_BUSY_WAIT); i ++) { }
+   if (i == MAX_PCI_BUSY_WAIT) {
+      DPRINTK_F("ERROR! board not responding during PCI read\n");
+      return 0;
+   }
+
+   return 1;
+}
+
 // 
 //       name:  pd_dsp_read()
 //
@@ -158,15 +245,10 @@ inline void pd_dsp_write_x(int board, u32 data)
 //
 inline u32 pd_dsp_read(int board) 
 {
-   unsigned long i;
-
    // DPRINTK_T("want to read data, waiting for board to be ready\n");
 
-   for (i = 0; !(pd_dsp_get_status(board) & (1 << HSTR_HRRQ)) && (i < MAX_PCI_BUSY_WAIT); i ++) { }
-   if (i == MAX_PCI_BUSY_WAIT) {
-      DPRINTK_F("ERROR! board not responding during PCI read\n");
+   if (!pd_dsp_wait_read_ready(board))
       return -1;
-   }
 
    // DPRINTK_T("board is ready, reading\n");
    return pd_readl(pd_board[board].address + PCI_HRXS);
@@ -184,6 +266,116 @@ inline u32 pd_dsp_read_x(int board)
    return pd_readl(pd_board[board].address + PCI_HRXS);
 }
 
+// 
+//       name:  pd_dsp_read_block_split()
+//
+//   function:  Reads a fixed size block of words from the PowerDAQ slave
+//              receive data register. The DSP status is checked once for
+//              the whole block, then the words are read back to back and
+//              their low 16 bits are stored. The first len1 words go to
+//              buf1, the rest of them to buf2 (ring buffer wrap point).
+//
+//  arguments:  The board (index) to read from, the first segment and its
+//              size, the second segment and the number of words to read.
+//  
+//    returns:  1 if it worked, 0 if the board is not ready.
+//
+int pd_dsp_read_block_split(int board, u16* buf1, u32 len1, u16* buf2, u32 count) 
+{
+   void* address = pd_board[board].address + PCI_HRXS;
+
+   if (!count)
+      return 1;
+
+   if (!pd_dsp_wait_read_ready(board))
+      return 0;
+
+   if (len1 >= count)
+   {
+      pd_readl_rep16(address, buf1, count);
+   }
+   else
+   {
+      pd_readl_rep16(address, buf1, len1);
+      pd_readl_rep16(address, buf2, count - len1);
+   }
+
+   return 1;
+}
+
+// 
+//       name:  pd_dsp_read_block()
+//
+//   function:  Reads a fixed size block of words from the PowerDAQ slave
+//              receive data register into a linear buffer.
+//
+//  arguments:  The board (index) to read from, the buffer and the number
+//              of words to read.
+//  
+//    returns:  1 if it worked, 0 if the board is not ready.
+//
+int pd_dsp_read_block(int board, u16* buffer, u32 count) 
+{
+   return pd_dsp_read_block_split(board, buffer, count, NULL, count);
+}
+
+// 
+//       name:  pd_dsp_read_block_term_split()
+//
+//   function:  Reads a block of words terminated by ERR_RET from the
+//              PowerDAQ slave receive data register (PD_AIGETSAMPLES
+//              reply). The DSP status is checked once for the whole block.
+//              The first len1 words go to buf1, the rest of them to buf2.
+//
+//  arguments:  The board (index) to read from, the first segment and its
+//              size, the second segment, the maximum number of words the
+//              segments can take and where to store the number of words
+//              actually read.
+//  
+//    returns:  1 if the block was terminated by ERR_RET, 0 otherwise.
+//
+int pd_dsp_read_block_term_split(int board, u16* buf1, u32 len1, u16* buf2, 
+                                 u32 max_words, u32* words) 
+{
+   void* address = pd_board[board].address + PCI_HRXS;
+   int bTerm;
+
+   *words = 0;
+
+   if (!pd_dsp_wait_read_ready(board))
+      return 0;
+
+   if (len1 > max_words)
+      len1 = max_words;
+
+   *words = pd_readl_rep16_term(address, buf1, len1, ERR_RET, &bTerm);
+   if (!bTerm && (max_words > len1))
+      *words += pd_readl_rep16_term(address, buf2, max_words - len1, ERR_RET, &bTerm);
+
+   // buffer is full, the next word must be the terminator
+   if (!bTerm)
+      bTerm = (pd_readl(address) == ERR_RET);
+
+   return bTerm;
+}
+
+// 
+//       name:  pd_dsp_read_block_term()
+//
+//   function:  Reads a block of words terminated by ERR_RET from the
+//              PowerDAQ slave receive data register into a linear buffer.
+//
+//  arguments:  The board (index) to read from, the buffer, the maximum
+//              number of words the buffer can take and where to store
+//              the number of words actually read.
+//  
+//    returns:  1 if the block was terminated by ERR_RET, 0 otherwise.
+//
+int pd_dsp_read_block_term(int board, u16* buffer, u32 max_words, u32* words) 
+{
+   return pd_dsp_read_block_term_split(board, buffer, max_words, NULL, max_words, words);
+}
+
 
 // Function:    u32 pd_dsp_read_ack()
 //
@@ -445,11 +637,10 @@ int pd_reset_board(int board)
 //
 int pd_download_firmware(int board) 
 {
-   int i, j;
-   u32 dwReply, id;
-   int* pnFWMemSegments = NULL;
-   FW_MEMSEGMENT* pFWDownloadData = NULL;
-   u32* pdwFWExecAdrs = NULL;
+   u32 i;
+   u32 dwReply;
+   TFwImage* pImg;
+   TFwSeg* pSeg;
 
 
    if (pd_dsp_get_flags(board) != 1) 
@@ -459,55 +650,16 @@ int pd_download_firmware(int board)
    }
    DPRINTK_T("DSP is ready, downloading firmware\n");
 
-// Find out what kind of board are we dealing with...
-#ifdef USECOMMONFW
-    pnFWMemSegments = (int*)&nFWMemSegments;
-    pdwFWExecAdrs = (DWORD*)&dwFWExecAdrs;
-    pFWDownloadData = FWDownloadData;
-
-#else
-   if (PD_IS_PDXI(pd_board[board].PCI_Config.SubsystemID))
-      id = pd_board[board].PCI_Config.SubsystemID - 0x100;
-   else
-      id = pd_board[board].PCI_Config.SubsystemID;
-
-   if (PD_IS_MFX(id))
-   {
-      DPRINTK_T("Downloading MFx firmware\n");
-      pnFWMemSegments = (int*)&nFWMemSegmentsM;
-      pdwFWExecAdrs = (u32*)&dwFWExecAdrsM;
-      pFWDownloadData = FWDownloadDataM;
-   }
-   if (PD_IS_AO(id))
-   {
-      DPRINTK_T("Downloading AO firmware\n");
-      pnFWMemSegments = (int*)&nFWMemSegmentsA;
-      pdwFWExecAdrs = (u32*)&dwFWExecAdrsA;
-      pFWDownloadData = FWDownloadDataA;
-   }
-   if (PD_IS_DIO(id))
-   {
-      DPRINTK_T("Downloading DIO firmware\n");
-      pnFWMemSegments = (int*)&nFWMemSegmentsD;
-      pdwFWExecAdrs = (u32*)&dwFWExecAdrsD;
-      pFWDownloadData = FWDownloadDataD;
-   }
-
-   if (PD_IS_LABMF(id))
-   {
-      DPRINTK_T("Downloading Labmf firmware\n");
-      pnFWMemSegments = (int*)&nFWMemSegmentsL;
-      pdwFWExecAdrs = (u32*)&dwFWExecAdrsL;
-      pFWDownloadData = FWDownloadDataL;
-   }
-
-#endif
+   // Find out what kind of board are we dealing with...
+   pImg = pd_fw_get_image(board);
+   if (!pImg)
+      return 0;
 
-   for (i = 0; i < *pnFWMemSegments; i ++) 
+   for (i = 0; i < pImg->nSegs; i ++) 
    {
-      // DPRINTK_T("memory segment %d type is %ld\n", i, FWDownloadData[i].dwMemType);
+      pSeg = &pImg->Segs[i];
 
-      switch (pFWDownloadData[i].dwMemType) 
+      switch (pSeg->dwMemType) 
       {
       case 1:
          pd_dsp_set_flags(board, 1);
@@ -526,30 +678,30 @@ int pd_download_firmware(int board)
       }
 
       // Write number of words to load.
-      pd_dsp_write(board, pFWDownloadData[i].dwMemSize);
+      pd_dsp_write(board, pSeg->dwMemSize);
 
       // Write starting address to load.
-      pd_dsp_write(board, pFWDownloadData[i].dwMemAdrs);
+      pd_dsp_write(board, pSeg->dwMemAdrs);
       
       // Issue PCI_LOAD command to initiate loading and read return value.
       pd_dsp_command(board, PCI_LOAD);
 
       // Check if word read equals block size.
-      if (pd_dsp_read(board) != pFWDownloadData[i].dwMemSize) 
+      if (pd_dsp_read(board) != pSeg->dwMemSize) 
       {
 	     return 0;
       }
 
       // Write code or data words to transmit register.
-      for (j = 0; (u32)j < pFWDownloadData[i].dwMemSize; j ++) 
+      if (!pd_dsp_write_block(board, pSeg->pdwMemData, pSeg->dwMemSize))
       {
-	     pd_dsp_write(board, pFWDownloadData[i].dwMemData[j]);
+         return 0;
       }
 
       // Read 1 word return ack and check if word read equals
       //      (starting address + block size).
       dwReply = pd_dsp_read(board);
-      if (dwReply != (pFWDownloadData[i].dwMemAdrs + pFWDownloadData[i].dwMemSize) ) 
+      if (dwReply != (pSeg->dwMemAdrs + pSeg->dwMemSize) ) 
       {
 	     return 0;
       }
@@ -565,12 +717,12 @@ int pd_download_firmware(int board)
    }
 
    // Write address to start execution.
-   pd_dsp_write(board, *pdwFWExecAdrs);
+   pd_dsp_write(board, pImg->dwExecAdrs);
    
    // Issue PCI_EXEC command to execute code and read return value
    pd_dsp_command(board, PCI_EXEC);
    dwReply = pd_dsp_read(board);
-   if (dwReply != *pdwFWExecAdrs) 
+   if (dwReply != pImg->dwExecAdrs) 
    {
       return 0;
    }
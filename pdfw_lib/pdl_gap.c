@@ -0,0 +1,252 @@
+//===========================================================================
+//
+// NAME:    pdl_gap.c
+//
+// DESCRIPTION:
+//
+//          Gap accounting for AIn buffers registered with BUF_AUTORESTART.
+//          On a FIFO overrun pd_ain_overrun_restart() clears the FIFO and
+//          re-arms the conversions instead of stopping, and these helpers
+//          estimate how much was lost and log the restart so that the
+//          application can find it with _PdAInGetGaps().
+//
+//          The number of values lost is the time since the last transfer
+//          from the FIFO times the value rate. The rate is measured from
+//          the transfers themselves, so it works with external clocks too.
+//          Where the driver has no clock (RT kernels) it stays unknown.
+//
+//          The file has no kernel dependencies so it can be built in
+//          user space (see examples/AInGapSim).
+//
+//---------------------------------------------------------------------------
+//      Copyright (C) 2000,2004 United Electronic Industries, Inc.
+//      All rights reserved.
+//---------------------------------------------------------------------------
+// For more informations on using and distributing this software, please see
+// the accompanying "LICENSE" file.
+//
+//===========================================================================
+
+//+
+// Function:    pd_gap_reset
+//
+// Parameters:  TGapLog* pLog -- gap log
+//
+// Description: Empties the log and forgets the measured rate
+//              (async init).
+//
+//-
+void pd_gap_reset(TGapLog *pLog)
+{
+   memset(pLog, 0, sizeof(TGapLog));
+}
+
+//+
+// Function:    pd_gap_start
+//
+// Parameters:  TGapLog* pLog -- gap log
+//              u64 Now       -- current time, ns
+//
+// Description: Acquisition (re)started: the next transfer is not used to
+//              measure the rate as the time before it includes the start.
+//
+//-
+void pd_gap_start(TGapLog *pLog, u64 Now)
+{
+   pLog->RefTime = Now;
+   pLog->bRefXfer = 0;
+}
+
+//+
+// Function:    pd_gap_note_xfer
+//
+// Parameters:  TGapLog* pLog -- gap log
+//              u32 Values    -- values read from the FIFO
+//              u64 Now       -- current time, ns
+//
+// Description: Accounts a transfer from the FIFO. The rate is averaged
+//              over roughly the last PD_GAP_RATE_WINDOW ns.
+//
+//-
+void pd_gap_note_xfer(TGapLog *pLog, u32 Values, u64 Now)
+{
+   if (pLog->bRefXfer && (Now > pLog->RefTime))
+   {
+      pLog->RateValues += Values;
+      pLog->RateNs += Now - pLog->RefTime;
+      if (pLog->RateNs > PD_GAP_RATE_WINDOW)
+      {
+         pLog->RateValues >>= 1;
+         pLog->RateNs >>= 1;
+      }
+   }
+
+   pLog->RefTime = Now;
+   pLog->bRefXfer = 1;
+}
+
+// Values * ElapsedNs / SpanNs. The operands are scaled down together so
+// the product fits in 64 bits and the divisor in 32 bits (do_div).
+static u32 pd_gap_scale(u64 Values, u64 SpanNs, u64 ElapsedNs)
+{
+   u64 prod;
+
+   while ((Values > 0xFFFFFFFFULL) || (SpanNs > 0xFFFFFFFFULL))
+   {
+      Values >>= 1;
+      SpanNs >>= 1;
+   }
+   while (ElapsedNs > 0xFFFFFFFFULL)
+   {
+      ElapsedNs >>= 1;
+      SpanNs >>= 1;
+   }
+   if (!SpanNs)
+      return 0xFFFFFFFF;
+
+   prod = Values * ElapsedNs;
+   do_div(prod, (u32)SpanNs);
+
+   return (prod > 0xFFFFFFFFULL) ? 0xFFFFFFFF : (u32)prod;
+}
+
+//+
+// Function:    pd_gap_lost_values
+//
+// Parameters:  TGapLog* pLog  -- gap log
+//              u64 Now        -- time of the overrun, ns
+//              u32 MinValues  -- lower bound, the FIFO size
+//
+// Returns:     u32 -- estimated number of values lost, 0 if unknown
+//
+// Description: Everything acquired since the last transfer is lost: it
+//              is either in the FIFO, which gets cleared, or did not fit
+//              in it.
+//
+//-
+u32 pd_gap_lost_values(TGapLog *pLog, u64 Now, u32 MinValues)
+{
+   u32 lost;
+
+   if (!pLog->RateNs || !pLog->RateValues || (Now <= pLog->RefTime))
+      return 0;
+
+   lost = pd_gap_scale(pLog->RateValues, pLog->RateNs, Now - pLog->RefTime);
+
+   return (lost < MinValues) ? MinValues : lost;
+}
+
+//+
+// Function:    pd_gap_lost_scans
+//
+// Parameters:  u32 LostValues -- from pd_gap_lost_values(), 0 if unknown
+//              u32 Trimmed    -- values dropped by pd_gap_trim_scan()
+//              u32 ScanValues -- values in a scan
+//
+// Returns:     u32 -- estimated number of scans lost, 0 if unknown
+//
+// Description: The scan trimmed at Head counts as lost, rounded up.
+//
+//-
+u32 pd_gap_lost_scans(u32 LostValues, u32 Trimmed, u32 ScanValues)
+{
+   if (!LostValues || !ScanValues)
+      return 0;
+
+   // Trimmed < ScanValues, so this cannot overflow
+   Trimmed += LostValues % ScanValues;
+   return LostValues / ScanValues + (Trimmed + ScanValues - 1) / ScanValues;
+}
+
+//+
+// Function:    pd_gap_trim_scan
+//
+// Parameters:  u32* pHead     -- IN/OUT: buffer head, values
+//              u32* pCount    -- IN/OUT: values in the buffer
+//              u32 ScanValues -- values in a scan
+//
+// Returns:     u32 -- number of values dropped
+//
+// Description: Moves Head back to the start of the incomplete scan it is
+//              in, the channel list starts over after the restart.
+//              Head never wraps back as the buffer holds whole scans.
+//
+//-
+u32 pd_gap_trim_scan(u32 *pHead, u32 *pCount, u32 ScanValues)
+{
+   u32 partial;
+
+   if (!ScanValues)
+      return 0;
+
+   // Tail is always on a scan boundary, so Count covers the partial scan
+   partial = *pHead % ScanValues;
+   if (partial > *pCount)
+      return 0;
+
+   *pHead -= partial;
+   *pCount -= partial;
+
+   return partial;
+}
+
+//+
+// Function:    pd_gap_record
+//
+// Parameters:  TGapLog* pLog  -- gap log
+//              u32 Head       -- buffer index of the first value after the gap
+//              u32 WrapCount  -- buffer wrap count
+//              u32 LostScans  -- estimated number of scans lost, 0 if unknown
+//              u64 Now        -- time of the restart, ns
+//
+// Returns:     u32 -- number of gaps recorded so far
+//
+// Description: Logs a restart, overwriting the oldest entry when the log
+//              is full.
+//
+//-
+u32 pd_gap_record(TGapLog *pLog, u32 Head, u32 WrapCount, u32 LostScans, u64 Now)
+{
+   tGapInfo *pGap = &pLog->Gap[pLog->Num % PD_GAP_LOG_SIZE];
+
+   pGap->Seq = pLog->Num;
+   pGap->Head = Head;
+   pGap->WrapCount = WrapCount;
+   pGap->LostScans = LostScans;
+   pGap->TimestampLow = (u32)Now;
+   pGap->TimestampHigh = (u32)(Now >> 32);
+
+   pd_gap_start(pLog, Now);
+
+   return ++pLog->Num;
+}
+
+//+
+// Function:    pd_gap_get
+//
+// Parameters:  TGapLog* pLog   -- gap log
+//              u32 FirstSeq    -- first gap wanted
+//              tGapInfo* pGap  -- where to copy the gaps
+//              u32 MaxGaps     -- size of pGap
+//              u32* pNumRet    -- OUT: number of gaps copied
+//
+// Returns:     u32 -- number of gaps recorded so far
+//
+// Description: Copies the gaps from FirstSeq on, oldest first. Gaps that
+//              dropped out of the log are skipped: the caller sees it
+//              from the Seq of the first entry.
+//
+//-
+u32 pd_gap_get(TGapLog *pLog, u32 FirstSeq, tGapInfo *pGap, u32 MaxGaps, u32 *pNumRet)
+{
+   u32 seq, n = 0;
+
+   if ((pLog->Num > PD_GAP_LOG_SIZE) && (FirstSeq < pLog->Num - PD_GAP_LOG_SIZE))
+      FirstSeq = pLog->Num - PD_GAP_LOG_SIZE;
+
+   for (seq = FirstSeq; (seq < pLog->Num) && (n < MaxGaps); seq++, n++)
+      pGap[n] = pLog->Gap[seq % PD_GAP_LOG_SIZE];
+
+   *pNumRet = n;
+   return pLog->Num;
+}
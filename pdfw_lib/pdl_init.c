@@ -170,9 +170,9 @@ void  pd_init_calibration(int board)
          }
   
          // if reasonable ADC FIFO sizes has found - initializte FlashFifo()
-         size = pd_board[num_pd_boards].Eeprom.u.Header.ADCFifoSize;
+         size = pd_board[board].Eeprom.u.Header.ADCFifoSize;
          if (( size < 1) && (size > 64)) 
-            pd_board[num_pd_boards].Eeprom.u.Header.ADCFifoSize = 1;
+            pd_board[board].Eeprom.u.Header.ADCFifoSize = 1;
             
             // we decided to use several 512 transfers instead of one big.
             // it should help with multiboard support
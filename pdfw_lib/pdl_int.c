@@ -60,6 +60,98 @@ void pd_stop_and_disable_ain(int board)
 }
 
 
+//
+// Function:    pd_ain_overrun_restart
+//
+// Parameters:  int board
+//
+// Returns:     1 = SUCCESS
+//              0 = acquisition could not be re-armed, caller stops it
+//
+// Description: Recovers from an AIn FIFO overrun without stopping the
+//              acquisition (BUF_AUTORESTART buffers): conversions are
+//              disabled, the FIFO is cleared, the channel list is reset,
+//              the incomplete scan at Head is dropped and conversions
+//              are enabled again. The DAQ buffer and its mapping are kept.
+//
+//              The restart is logged as a gap (see pdl_gap.c) and
+//              eBufferError is asserted, eStopped is not.
+//
+//              With a hardware start trigger the acquisition resumes on
+//              the next trigger.
+//
+// Notes:       * This routine must be called with device spinlock held! *
+//
+int pd_ain_overrun_restart(int board)
+{
+   PTBuf_Info pDaqBuf = &pd_board[board].AinSS.BufInfo;
+   u64   now = pd_get_time_ns();
+   u32   LostValues, Trimmed, LostScans;
+   u32   Head, Count;
+
+   if ((pd_board[board].AinSS.SubsysState != ssRunning) || !pDaqBuf->ScanValues)
+      return 0;
+
+   // the FIFO was full, at least that much is lost
+   LostValues = pd_gap_lost_values(&pDaqBuf->GapLog, now,
+                                   pd_board[board].AinSS.FifoValues);
+
+   if (!pd_ain_set_enable_conversion(board, 0) ||
+       !pd_ain_clear_data(board) ||
+       !pd_ain_reset_cl(board))
+   {
+      DPRINTK_F("pd_ain_overrun_restart: cannot clear AIn FIFO\n");
+      return 0;
+   }
+
+   // the channel list starts over: drop the incomplete scan at Head
+   Head = pDaqBuf->Head;
+   Count = pDaqBuf->Count;
+   Trimmed = pd_gap_trim_scan(&Head, &Count, pDaqBuf->ScanValues);
+   pDaqBuf->Head = Head;
+   pDaqBuf->Count = Count;
+   pd_board[board].AinSS.XferBufValueCount = 0;
+
+   if (!pd_ain_set_enable_conversion(board, 1))
+   {
+      DPRINTK_F("pd_ain_overrun_restart: pd_ain_set_enable_conversion fails\n");
+      return 0;
+   }
+
+   if ((pd_board[board].AinSS.dwAInCfg & (AIB_STARTTRIG0 | AIB_STARTTRIG1)) == 0)
+      if (!pd_ain_sw_start_trigger(board))
+      {
+         DPRINTK_F("pd_ain_overrun_restart: pd_ain_sw_start_trigger fails\n");
+         return 0;
+      }
+
+   LostScans = pd_gap_lost_scans(LostValues, Trimmed, pDaqBuf->ScanValues);
+   pd_gap_record(&pDaqBuf->GapLog, Head, pDaqBuf->WrapCount, LostScans, now);
+
+   pd_board[board].AinSS.dwEventsNew |= eBufferError;
+
+   DPRINTK_E("bh>pd_ain_overrun_restart: gap %d at %d, %d scans lost\n",
+             pDaqBuf->GapLog.Num - 1, Head, LostScans);
+   return 1;
+}
+
+//
+// Number of AIn frames completed by moving the buffer head from its
+// current position to Head, eFrameDone counts them
+//
+static u32 pd_ain_frames_done(int board, u32 Head, int bWrapped)
+{
+   PTBuf_Info pDaqBuf = &pd_board[board].AinSS.BufInfo;
+   u32 Frames;
+
+   Frames = Head / pDaqBuf->FrameValues - pDaqBuf->Head / pDaqBuf->FrameValues;
+   if (bWrapped)
+      Frames += pDaqBuf->NumFrames;
+
+   return Frames;
+}
+
+
 //
 // Function:    PdProcessAInGetSamples
 //
@@ -93,6 +185,10 @@ void pd_stop_and_disable_ain(int board)
 //
 //              Driver events are updated on change of status.
 //
+//              When the DAQ buffer has room for a whole transfer the FIFO
+//              is flushed straight into it at Head (split at the wrap
+//              point) and the copy from the transfer buffer is skipped.
+//
 // Notes:       * This routine must be called with device spinlock held! *
 //
 //
@@ -109,9 +205,17 @@ void pd_process_pd_ain_get_samples(int board, int bFHFState)
    u32   NumCopied = 0;          // num samples already copied
 
    int  bWrapped = FALSE;
+   int  bDirect = FALSE;         // samples flushed straight into DAQ buffer
+   int  bFrameDone = FALSE;
+   u32  Frames;                  // frames completed by this transfer
    int  res;
+   u64  now;                     // time the samples got to the host
 
    u16* pBuf = (u16*)pd_board[board].AinSS.pXferBuf;
+   u16* pSeg1;                   // where the samples are flushed to
+   u16* pSeg2;
+   u32  dwSeg1;
+   u32  dwNeed;                  // max samples a single transfer returns
 
    DPRINTK_T("bh>pd_process_pd_ain_get_samples: board %d, FHF %d\n", board, bFHFState);
 
@@ -144,6 +248,28 @@ void pd_process_pd_ain_get_samples(int board, int bFHFState)
    DPRINTK_T("bh>pd_process_pd_ain_get_samples(1):Count 0x%x Head 0x%x Tail 0x%x FrameValues 0x%x MaxValues 0x%x UseHeavy=%d\n",
              Count, Head, Tail, FrameValues, MaxValues, pd_board[board].bUseHeavyIsr);
 
+   // By default samples go to the transfer buffer and are copied later.
+   pSeg1  = pBuf;
+   dwSeg1 = pd_board[board].AinSS.XferBufValues;
+   pSeg2  = pBuf + dwSeg1;
+
+   // Flush straight into the DAQ buffer if it has room for the largest
+   // possible transfer: then the samples read are exactly what the copy
+   // below would put at Head and no frame needs to be recycled.
+   dwNeed = pd_board[board].AinSS.XferBufValues;
+   if (bFHFState && (pd_board[board].AinSS.FifoXFerCycles * 
+                     pd_board[board].AinSS.BlkXferValues > dwNeed))
+      dwNeed = pd_board[board].AinSS.FifoXFerCycles * pd_board[board].AinSS.BlkXferValues;
+
+   if (!pd_board[board].bUseHeavyIsr && !pd_board[board].bImmUpdate &&
+       ((MaxValues - Count) > dwNeed))
+   {
+      bDirect = TRUE;
+      pSeg1  = pd_board[board].AinSS.BufInfo.databuf + Head;
+      dwSeg1 = (Head >= Tail) ? (MaxValues - Head) : (Tail - Head);
+      pSeg2  = pd_board[board].AinSS.BufInfo.databuf;
+   }
+
    if (!pd_board[board].bUseHeavyIsr)
    {
       if ( bFHFState )
@@ -153,7 +279,7 @@ void pd_process_pd_ain_get_samples(int board, int bFHFState)
          // Get samples acquired and stored on board using AIn Block Transfer
          // We should get 512 samples in the BURST mode (4+512+4 clocks)
          // and rest of them in GETSAMPLES mode (samples*4 clocks)
-         if ( !pd_ain_flush_fifo(board, 0))
+         if ( !pd_ain_flush_fifo_split(board, 0, pSeg1, dwSeg1, pSeg2))
          {
             // Error: cannot execute PdAInFlushFifo.
             DPRINTK_F("bh>pd_process_pd_ain_get_samples: cannot execute pd_ain_flush_fifo\n");
@@ -165,10 +291,10 @@ void pd_process_pd_ain_get_samples(int board, int bFHFState)
          DPRINTK_E("bh>pd_process_pd_ain_get_samples: !bFHFState\n");
 
          // Get all samples acquired and stored on board.
-         res = pd_ain_get_samples(board, 
-                                  pd_board[board].AinSS.XferBufValues,
-                                  (u16*)pd_board[board].AinSS.pXferBuf,
-                                  &pd_board[board].AinSS.XferBufValueCount);
+         res = pd_ain_get_samples_split(board, 
+                                        pd_board[board].AinSS.XferBufValues,
+                                        pSeg1, dwSeg1, pSeg2,
+                                        &pd_board[board].AinSS.XferBufValueCount);
          if (!res)
          {
             DPRINTK_F("bh>pd_process_pd_ain_get_samples: no samples\n");
@@ -208,6 +334,11 @@ void pd_process_pd_ain_get_samples(int board, int bFHFState)
       return;
    }
 
+   now = pd_get_time_ns();
+
+   if (pd_board[board].AinSS.BufInfo.bAutoRestart)
+      pd_gap_note_xfer(&pd_board[board].AinSS.BufInfo.GapLog, NumSamplesRead, now);
+
    //-----------------------------------------------------------------------
    // Check if we need to recycle a frame past NumSamples read.
    if ( pd_board[board].AinSS.BufInfo.bRecycle )
@@ -252,8 +383,9 @@ void pd_process_pd_ain_get_samples(int board, int bFHFState)
       NumToCopy = (NumSamplesRead < (MaxValues - Head))?
                   NumSamplesRead : (MaxValues - Head);
 
-      memcpy((pd_board[board].AinSS.BufInfo.databuf + Head),
-                                       pBuf, (NumToCopy * 2) );
+      if (!bDirect)
+         memcpy((pd_board[board].AinSS.BufInfo.databuf + Head),
+                                          pBuf, (NumToCopy * 2) );
 
       /*DPRINTK_T("0:0x%x 1:0x%x 2:0x%x 3:0x%x\n", 
                 *(pd_board[board].AinSS.BufInfo.databuf + Head+0),
@@ -289,8 +421,9 @@ void pd_process_pd_ain_get_samples(int board, int bFHFState)
       NumToCopy = ((NumSamplesRead - NumCopied) < (Tail - Head))?
                   (NumSamplesRead - NumCopied) : (Tail - Head);
 
-      memcpy((pd_board[board].AinSS.BufInfo.databuf + Head),
-                                       (pBuf + NumCopied), (NumToCopy * 2) );
+      if (!bDirect)
+         memcpy((pd_board[board].AinSS.BufInfo.databuf + Head),
+                                          (pBuf + NumCopied), (NumToCopy * 2) );
 
       /*DPRINTK_T("0:0x%x 1:0x%x 2:0x%x 3:0x%x\n", 
                 *(pd_board[board].AinSS.BufInfo.databuf + Head+0),
@@ -308,6 +441,7 @@ void pd_process_pd_ain_get_samples(int board, int bFHFState)
    if ( NumCopied > 0 )
    {
       pd_board[board].AinSS.dwEventsNew |= eDataAvailable;
+      pd_board[board].AinSS.dwDataNew++;
 
       // Check if we reached end of buffer.
       if ( bWrapped )
@@ -317,17 +451,21 @@ void pd_process_pd_ain_get_samples(int board, int bFHFState)
       }
 
       // Check if we crossed a frame boundry.
-      if ( bWrapped || ((Head / pd_board[board].AinSS.BufInfo.FrameValues) > 
-                        (pd_board[board].AinSS.BufInfo.Head / 
-                         pd_board[board].AinSS.BufInfo.FrameValues)))
+      Frames = pd_ain_frames_done(board, Head, bWrapped);
+      if ( Frames )
       {
          pd_board[board].AinSS.dwEventsNew |= eFrameDone;
+         pd_board[board].AinSS.dwFramesNew += Frames;
          DPRINTK_E("bh>pd_process_pd_ain_get_samples: eFrameDone\n");
+         bFrameDone = TRUE;
       }
 
       pd_board[board].AinSS.BufInfo.Count = Count; // value count
       pd_board[board].AinSS.BufInfo.Head  = Head;
       pd_board[board].AinSS.BufInfo.Tail  = Tail;
+
+      if (bFrameDone)
+         pd_daqbuf_ctrl_stamp(&pd_board[board].AinSS.BufInfo, now);
    }
 
    DPRINTK_T("bh>pd_process_pd_ain_get_samples(4):Count 0x%x Head 0x%x Tail 0x%x\n",
@@ -369,8 +507,32 @@ void pd_process_pd_ain_get_samples(int board, int bFHFState)
 //              physical bus-master page into the buffer. This function
 //              cannot be used along with GetSamples and Immediate update
 //
+//              Samples are moved straight from the page into the DAQ
+//              buffer at Head (split at the wrap point), the transfer
+//              buffer is not used.
+//
 //---------------------------------------------------------------------------
 void pd_process_ain_move_samples(int board, u32 page, u32 numready) 
+{
+    pd_process_ain_move_values(board, (u32*)pd_board[board].pSysBMB[page], 
+                               numready, pd_get_time_ns());
+}
+
+//---------------------------------------------------------------------------
+// Function:    pd_process_ain_move_values
+//
+// Parameters:  int board  
+//              u32* pSrc     -- bus-master page or a copy of it
+//              u32 numready  -- values in it
+//              u64 now       -- time the values got to the host, ns
+//
+// Returns:     VOID
+//
+// Description: Does the work of pd_process_ain_move_samples(), for a page
+//              that may have been copied to the bus-master ring earlier.
+//
+//---------------------------------------------------------------------------
+void pd_process_ain_move_values(int board, u32* pSrc, u32 numready, u64 now)
 {
     u32   Count, i;               // num samples in buffer (queue)
     u32   Head;                   // queue head (wrapped buffer)
@@ -383,10 +545,11 @@ void pd_process_ain_move_samples(int board, u32 page, u32 numready)
     u32   NumCopied = 0;          // num samples already copied
 
     u16*  pBuf = (u16*)pd_board[board].AinSS.pXferBuf;
-    //u32*  plBuf = (u32*)pd_board[board].AinSS.pXferBuf;
 
     BOOLEAN bWrapped = FALSE;
+    BOOLEAN bFrameDone = FALSE;
     BOOLEAN bLong = pd_board[board].AinSS.BufInfo.bDWValues;
+    u32   Frames;                 // frames completed by this transfer
 
     //-----------------------------------------------------------------------
     // Verify that a buffer has been registered.
@@ -478,19 +641,13 @@ void pd_process_ain_move_samples(int board, u32 page, u32 numready)
        NumToCopy = (NumSamplesRead < (MaxValues - Head)) ? NumSamplesRead : (MaxValues - Head);
        if (!bLong)
        {
+           u16* pDst = pd_board[board].AinSS.BufInfo.databuf + Head;
            for (i=0; i<NumToCopy; i++) 
-           {
-                *(pd_board[board].AinSS.BufInfo.databuf + Head + i) = 
-                         (u16)*((u32*)pd_board[board].pSysBMB[page]+i);
-           }
+                pDst[i] = (u16)pSrc[i];
        }
        else
        {
-           for (i=0; i<NumToCopy; i++) 
-           {
-                *((u32*)pd_board[board].AinSS.BufInfo.databuf + Head + i) = 
-                         *((u32*)pd_board[board].pSysBMB[page]+i);
-           }
+           memcpy((u32*)pd_board[board].AinSS.BufInfo.databuf + Head, pSrc, NumToCopy * 4);
        } 
 
        Count += NumToCopy;
@@ -524,19 +681,13 @@ void pd_process_ain_move_samples(int board, u32 page, u32 numready)
                     (NumSamplesRead - NumCopied) : (Tail - Head);
        if (!bLong)
        {
+           u16* pDst = pd_board[board].AinSS.BufInfo.databuf + Head;
            for (i = 0; i < NumToCopy; i++) 
-           {
-               *(pd_board[board].AinSS.BufInfo.databuf + Head + i) = 
-                        (u16)*((u32*)pd_board[board].pSysBMB[page]+i+NumCopied);
-           }
+               pDst[i] = (u16)pSrc[i + NumCopied];
        }
        else
        {
-           for (i = 0; i < NumToCopy; i++) 
-           {
-               *((PULONG)pd_board[board].AinSS.BufInfo.databuf + Head + i) = 
-                        *((u32*)pd_board[board].pSysBMB[page]+i+NumCopied);
-           }
+           memcpy((u32*)pd_board[board].AinSS.BufInfo.databuf + Head, pSrc + NumCopied, NumToCopy * 4);
        } 
 
        Count += NumToCopy;
@@ -549,6 +700,7 @@ void pd_process_ain_move_samples(int board, u32 page, u32 numready)
     if (NumCopied > 0)
     {
         pd_board[board].AinSS.dwEventsNew |= eDataAvailable;
+        pd_board[board].AinSS.dwDataNew++;
 
         // Check if we reached end of buffer.
         if (bWrapped) 
@@ -558,17 +710,21 @@ void pd_process_ain_move_samples(int board, u32 page, u32 numready)
         }
 
         // Check if we crossed a frame boundry.
-        if (bWrapped || ((Head / pd_board[board].AinSS.BufInfo.FrameValues) > 
-                         (pd_board[board].AinSS.BufInfo.Head / 
-                          pd_board[board].AinSS.BufInfo.FrameValues)) )
+        Frames = pd_ain_frames_done(board, Head, bWrapped);
+        if (Frames)
         {
             pd_board[board].AinSS.dwEventsNew |= eFrameDone;
+            pd_board[board].AinSS.dwFramesNew += Frames;
             DPRINTK_E("eFrameDone.\n");
+            bFrameDone = TRUE;
         }
 
         pd_board[board].AinSS.BufInfo.Count = Count; // value count
         pd_board[board].AinSS.BufInfo.Head  = Head;
         pd_board[board].AinSS.BufInfo.Tail  = Tail;
+
+        if (bFrameDone)
+            pd_daqbuf_ctrl_stamp(&pd_board[board].AinSS.BufInfo, now);
     }
 
     DPRINTK_T("bh>pd_process_ain_move_samples(4):Count 0x%x Head 0x%x Tail 0x%x\n",
@@ -775,6 +931,8 @@ void pd_process_aout_put_samples(int board, int bFHFState)
    {
       pd_board[board].AoutSS.dwEventsNew |= eBufferDone;
       pd_board[board].AoutSS.dwEventsNew |= eFrameDone;   // buffer_size = N * frame_size
+      pd_board[board].AoutSS.dwFramesNew += pDaqBuf->NumFrames + pDaqBuf->Head / pDaqBuf->FrameValues
+                                            - Head / pDaqBuf->FrameValues;
       DPRINTK_F("bh>pd_process_aout_put_samples: eBD+eFD\n");
    }
    else
@@ -782,6 +940,8 @@ void pd_process_aout_put_samples(int board, int bFHFState)
       if ( (pDaqBuf->Head / pDaqBuf->FrameValues) > (Head / pDaqBuf->FrameValues) )
       {
          pd_board[board].AoutSS.dwEventsNew |= eFrameDone;
+         pd_board[board].AoutSS.dwFramesNew += pDaqBuf->Head / pDaqBuf->FrameValues
+                                               - Head / pDaqBuf->FrameValues;
          DPRINTK_F("bh>pd_process_aout_put_samples: eFD\n");
       }
    }
@@ -806,12 +966,17 @@ void pd_process_driver_events(int board, tEvents* pEvents)
 {
    tEvents ClearEvents = {0};
    ULONG bAOPutData = FALSE;
+   int bRestarted = FALSE;
 
    DPRINTK("bh>pd_process_driver_events: Entering\n");
 
    if ((pd_board[board].dwXFerMode == XFERMODE_BM) || 
       (pd_board[board].dwXFerMode == XFERMODE_BM8WORD)) 
    {
+       // pages the ISR already put in the bus-master ring come first
+       if (pd_board[board].BmRing.Slots)
+          pd_bm_ring_drain(board);
+
        // check for non-recoverable errors
        if (pEvents->AInIntr & AIB_BMErrSC) 
        {
@@ -820,6 +985,10 @@ void pd_process_driver_events(int board, tEvents* pEvents)
           ClearEvents.AInIntr |= AIB_BMErrSC;
           pd_board[board].AinSS.dwEventsNew |= eStopped | eBufferError;
        } 
+       else if (pd_board[board].BmRing.Slots)
+       {
+          // page done events are handled by the ISR, see pd_bm_ring_isr
+       }
        else // is there new page of data available?
        if ((pEvents->AInIntr & AIB_BMPg0DoneSC)||(pEvents->AInIntr & AIB_BMPg1DoneSC)) 
        {
@@ -857,17 +1026,21 @@ void pd_process_driver_events(int board, tEvents* pEvents)
           ((pEvents->AIOIntr & AIB_FFSC) ||(pEvents->ADUIntr & AIB_FF)))
       {
          // Process AIn Fifo Full (Overrun Error) hardware interrupt event.
-         //if ( pd_board[board].AinSS.dwChListChan > 1 )
+         // BUF_AUTORESTART: stop; clear FIFO; adjust buffer; start
+         if (pd_board[board].AinSS.BufInfo.bAutoRestart &&
+             pd_ain_overrun_restart(board))
+         {
+            // FIFO is empty now, FHF status read before is stale
+            ClearEvents.AIOIntr |= AIB_FFSC | AIB_FHFSC;
+            bRestarted = TRUE;
+         }
+         else
          {
             // Stop acquisition and disable A/D conversions.
             pd_stop_and_disable_ain(board);
             pd_board[board].AinSS.dwEventsNew |= eStopped | eBufferError;
          }
    
-         //TODO: MORE WORK HERE:
-         // Apparently add restart flag and if it's set:
-         // stop ; clear FIFO; adjust buffer; start 
-   
          if ( !(pd_board[board].AinSS.dwEventsNew & eStopped) )
          {
             ClearEvents.AIOIntr |= AIB_FFSC;
@@ -881,7 +1054,7 @@ void pd_process_driver_events(int board, tEvents* pEvents)
       // Check AIn FHF hardware interrupt event.
       DPRINTK_T("bh|AIB_FHF:%ld AIB_FHFSC:%ld\n",(pEvents->ADUIntr & AIB_FHF),(pEvents->AIOIntr & AIB_FHFSC));
    
-      if (pd_board[board].AinSS.bCheckHalfDone)
+      if (pd_board[board].AinSS.bCheckHalfDone && !bRestarted)
       {
          if((pEvents->ADUIntr & AIB_FHF) || (pEvents->AIOIntr & AIB_FHFSC))
          {
@@ -904,6 +1077,7 @@ void pd_process_driver_events(int board, tEvents* pEvents)
    // AOut
    // Check AOut Underrun Error hardware interrupt event.
    pd_board[board].AoutSS.dwEventsNew = 0;
+   pd_board[board].AoutSS.dwFramesNew = 0;
 
    if (!pd_board[board].AoutSS.bRev3Mode) // OLD WAY
    {
@@ -928,6 +1102,7 @@ void pd_process_driver_events(int board, tEvents* pEvents)
             ClearEvents.AOutIntr |= AOB_HalfDoneSC;
 
          pd_board[board].AoutSS.dwEventsNew |= eFrameDone;
+         pd_board[board].AoutSS.dwFramesNew++;
       }
 
       // Check AOut Buffer done hardware interrupt event
@@ -977,6 +1152,7 @@ void pd_process_driver_events(int board, tEvents* pEvents)
          else
          {
             pd_board[board].AoutSS.dwEventsNew |= eFrameDone;
+            pd_board[board].AoutSS.dwFramesNew++;
             DPRINTK_E("bh>pd_process_driver_events: eFrameDone. You shouldn't see it in Async mode\n");
          }
       }
@@ -1036,7 +1212,13 @@ void pd_process_driver_events(int board, tEvents* pEvents)
    if (pEvents->ADUIntr & DIB_IntrSC) //AI90821
    {
       // Process DIn hardware interrupt event.
-      if ( !(pd_board[board].DinSS.dwEventsNew & eDInEvent) )
+      if (pd_board[board].DinSS.bCosRunning)
+      {
+         // DIO-256 change of state queue: logged and re-armed here
+         pd_dio256_cos_log(board, pd_board[board].LatIsrEntry);
+         ClearEvents.ADUIntr |= DIB_IntrSC;
+      }
+      else if ( !(pd_board[board].DinSS.dwEventsNew & eDInEvent) )
          ClearEvents.ADUIntr |= DIB_IntrSC;
 
       pd_board[board].DinSS.dwEventsNew |= eDInEvent;
@@ -1120,6 +1302,8 @@ void pd_process_driver_events(int board, tEvents* pEvents)
 //              notification bit is set and the new event bit is set.
 //              The event notification bits are cleared for which events
 //              asserted and the driver event status bits are cleared.
+//              Events subscribed with pd_subscribe_user_events stay set
+//              in the notification bits.
 //
 // Notes:       This function is called for each hardware interrupt,
 //              therefore, we need to be as efficient as possible here.
@@ -1155,12 +1339,21 @@ int pd_notify_user_events(int board, tEvents* pNewFwEvents)
    {
       // Report AIn Driver generated events.
       bNotifyUser = TRUE;
-      pd_notify_event(board, AnalogIn, pd_board[board].AinSS.dwEventsNew);
+      pd_notify_event(board, AnalogIn, pd_board[board].AinSS.dwEventsNew,
+                      pd_board[board].AinSS.dwFramesNew, pd_board[board].AinSS.dwDataNew);
 
       // Clear notification of asserted AIn Driver events.
-      pd_board[board].AinSS.dwEventsNotify &= ~pd_board[board].AinSS.dwEventsNew;
+      pd_board[board].AinSS.dwEventsNotify &= ~(pd_board[board].AinSS.dwEventsNew &
+                                              ~pd_board[board].AinSS.dwEventsPersist);
       pd_board[board].AinSS.dwEventsStatus |= pd_board[board].AinSS.dwEventsNew;
       pd_board[board].AinSS.dwEventsNew = 0;
+      pd_board[board].AinSS.dwFramesNew = 0;
+      pd_board[board].AinSS.dwDataNew = 0;
+   }
+   else if ( pd_board[board].AinSS.dwEventsPoll & pd_board[board].AinSS.dwEventsNew )
+   {
+      // Only wake pd_poll(), the events stay pending for the user.
+      pd_event_signal(board, pd_board[board].AinSS.synch);
    }
 
    DPRINTK_E("bh>pd_notify_user_events AI: dwEventsNotify: 0x%x dwEventsStatus: 0x%x dwEventsNew: 0x%x\n", 
@@ -1175,12 +1368,20 @@ int pd_notify_user_events(int board, tEvents* pNewFwEvents)
    {
       // Report AOut Driver generated events.
       bNotifyUser = TRUE;
-      pd_notify_event(board, AnalogOut, pd_board[board].AoutSS.dwEventsNew);
+      pd_notify_event(board, AnalogOut, pd_board[board].AoutSS.dwEventsNew,
+                      pd_board[board].AoutSS.dwFramesNew, 0);
 
       // Clear notification of asserted AOut Driver events.
-      pd_board[board].AoutSS.dwEventsNotify &= ~pd_board[board].AoutSS.dwEventsNew;
+      pd_board[board].AoutSS.dwEventsNotify &= ~(pd_board[board].AoutSS.dwEventsNew &
+                                              ~pd_board[board].AoutSS.dwEventsPersist);
       pd_board[board].AoutSS.dwEventsStatus |= pd_board[board].AoutSS.dwEventsNew;
       pd_board[board].AoutSS.dwEventsNew = 0;
+      pd_board[board].AoutSS.dwFramesNew = 0;
+   }
+   else if ( pd_board[board].AoutSS.dwEventsPoll & pd_board[board].AoutSS.dwEventsNew )
+   {
+      // Only wake pd_poll(), the events stay pending for the user.
+      pd_event_signal(board, pd_board[board].AoutSS.synch);
    }
 
    DPRINTK_E("bh>pd_notify_user_events AO: dwEventsNotify: 0x%x dwEventsStatus: 0x%x dwEventsNew: 0x%x\n", 
@@ -1197,10 +1398,11 @@ int pd_notify_user_events(int board, tEvents* pNewFwEvents)
    {
       // Report DIn Driver generated events.
       bNotifyUser = TRUE;
-      pd_notify_event(board, DigitalIn, pd_board[board].DinSS.dwEventsNew);
+      pd_notify_event(board, DigitalIn, pd_board[board].DinSS.dwEventsNew, 0, 0);
 
       // Clear notification of asserted DIn Driver events.
-      pd_board[board].DinSS.dwEventsNotify &= ~pd_board[board].DinSS.dwEventsNew;
+      pd_board[board].DinSS.dwEventsNotify &= ~(pd_board[board].DinSS.dwEventsNew &
+                                              ~pd_board[board].DinSS.dwEventsPersist);
       pd_board[board].DinSS.dwEventsStatus |= pd_board[board].DinSS.dwEventsNew;
       pd_board[board].DinSS.dwEventsNew = 0;
    }
@@ -1218,10 +1420,11 @@ int pd_notify_user_events(int board, tEvents* pNewFwEvents)
    {
       // Report UCT Driver generated events.
       bNotifyUser = TRUE;
-      pd_notify_event(board, CounterTimer, pd_board[board].UctSS.dwEventsNew);
+      pd_notify_event(board, CounterTimer, pd_board[board].UctSS.dwEventsNew, 0, 0);
 
       // Clear notification of asserted UCT Driver events.
-      pd_board[board].UctSS.dwEventsNotify &= ~pd_board[board].UctSS.dwEventsNew;
+      pd_board[board].UctSS.dwEventsNotify &= ~(pd_board[board].UctSS.dwEventsNew &
+                                              ~pd_board[board].UctSS.dwEventsPersist);
       pd_board[board].UctSS.dwEventsStatus |= pd_board[board].UctSS.dwEventsNew;
       pd_board[board].UctSS.dwEventsNew = 0;
    }
@@ -1276,6 +1479,14 @@ void pd_process_events(int board)
    // Process driver handled events.
    pd_process_driver_events(board, &pd_board[board].FwEventsStatus);
 
+   // Publish new buffer state before waking anybody up.
+   pd_daqbuf_ctrl_publish(&pd_board[board].AinSS.BufInfo,
+                          pd_board[board].AinSS.SubsysState,
+                          pd_board[board].AinSS.dwEventsStatus | pd_board[board].AinSS.dwEventsNew);
+   pd_daqbuf_ctrl_publish(&pd_board[board].AoutSS.BufInfo,
+                          pd_board[board].AoutSS.SubsysState,
+                          pd_board[board].AoutSS.dwEventsStatus | pd_board[board].AoutSS.dwEventsNew);
+
    DPRINTK_S("bh>pd_process_events: AIOIntr: 0x%x\n", pd_board[board].FwEventsStatus.AIOIntr);
 
    if (pd_notify_user_events(board, &pd_board[board].FwEventsStatus))
@@ -30,6 +30,7 @@
 //
 #define PD_GLOBAL_PREFIX 
 #include "include/powerdaq_kernel.h"
+#include "include/pd_ioctl_size.h"
 
 #include "kvmem.c" // include part of mbuff driver by Tomasz Motylewski
 
@@ -38,16 +39,34 @@
 int xferMode = 1;
 int pd_major = PD_MAJOR;
 int rqstirq = 1;
+// bring up the boards concurrently, one kernel thread per board
+int parinit = 1;
+// CPU running the bottom half of each board, -1 = any (bh_cpu=2,3,...)
+int bh_cpu[PD_MAX_BOARDS] = { [0 ... PD_MAX_BOARDS-1] = -1 };
+// AIn bus-master ring slots (xferMode=2 or 3), 0 = the two pages only
+int bm_ring = 0;
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 5, 0)
    module_param(xferMode, int, 0);
    module_param(pd_major, int, 0);
    module_param(rqstirq, int, 0);
+   module_param(parinit, int, 0);
+   module_param_array(bh_cpu, int, NULL, 0);
+   module_param(bm_ring, int, 0);
    MODULE_ALIAS_CHARDEV_MAJOR(PD_MAJOR);
    MODULE_LICENSE("GPL");
+#ifdef MODULE_FIRMWARE
+   MODULE_FIRMWARE("pwrdaq/pdfw_main.bin");
+   MODULE_FIRMWARE("pwrdaq/pdfw_mf.bin");
+   MODULE_FIRMWARE("pwrdaq/pdfw_ao.bin");
+   MODULE_FIRMWARE("pwrdaq/pdfw_dio.bin");
+   MODULE_FIRMWARE("pwrdaq/pdfw_lab.bin");
+#endif
 #else
    MODULE_PARM(xferMode,"i");
    MODULE_PARM(pd_major,"i");
    MODULE_PARM(rqstirq,"i");
+   MODULE_PARM(parinit,"i");
+   MODULE_PARM(bm_ring,"i");
 #endif
 
 
@@ -78,22 +97,24 @@ int rqstirq = 1;
 //       name:  deal_with_device
 //
 //   function:  Checks if the passed-in device is one we know how to deal
-//              with, and if so deals with it.
+//              with, and if so claims the board slot for it: maps the
+//              registers and stores the PCI configuration. The DSP is
+//              not touched here, see pd_bringup_board().
 //
 //  arguments:  The PCI device to deal with.  It is expected to have
 //              Motorola's Vendor ID and the DSP56301's Device ID.
+//              The board slot to use.
 //
-//    returns:  Nothing.
+//    returns:  1 if the board slot has been claimed, 0 if not.
 //
 //
-static void deal_with_device(struct pci_dev *dev) 
+static int deal_with_device(struct pci_dev *dev, int board) 
 {
    u16 sub_vendor_id;
    u8  u8val;
    u16 u16val;
    u16 sub_device_id;
-   int ret, t;
-   char* model_name;
+   int ret;
 
 
    if (dev == NULL)
@@ -116,7 +137,7 @@ static void deal_with_device(struct pci_dev *dev)
    }
 
    pci_read_config_word(dev, PCI_SUBSYSTEM_ID, &sub_device_id);
-   DPRINTK_N("SubSystemID of board %d is 0x%x\n", num_pd_boards, sub_device_id);
+   DPRINTK_N("SubSystemID of board %d is 0x%x\n", board, sub_device_id);
    if ( (sub_device_id < PD_SUBSYSTEMID_FIRST) || (sub_device_id > PD_SUBSYSTEMID_LAST) )
    {
       DPRINTK_F("subdeviceid=%08X: this model of PowerDAQ board is not supported, skipping\n", sub_device_id);
@@ -137,223 +158,359 @@ static void deal_with_device(struct pci_dev *dev)
 #endif
 
    // initialize data structures
-   memset(&pd_board[num_pd_boards], 0, sizeof(pd_board_t));
+   memset(&pd_board[board], 0, sizeof(pd_board_t));
+   _fw_spin_init(board)
 
-   pd_board[num_pd_boards].dev = dev;
-   pd_board[num_pd_boards].caps_idx = sub_device_id - PD_SUBSYSTEMID_FIRST;
-   pd_board[num_pd_boards].index = num_pd_boards;
-   pd_board[num_pd_boards].size = 65536;
+   pd_board[board].dev = dev;
+   pd_board[board].caps_idx = sub_device_id - PD_SUBSYSTEMID_FIRST;
+   pd_board[board].index = board;
+   pd_board[board].size = 65536;
 
 #if LINUX_VERSION_CODE < KERNEL_VERSION(2,4,0)
-   pd_board[num_pd_boards].address = ioremap(PCI_BASE_ADDRESS_MEM_MASK & dev->base_address[0], pd_board[num_pd_boards].size);
+   pd_board[board].address = ioremap(PCI_BASE_ADDRESS_MEM_MASK & dev->base_address[0], pd_board[board].size);
    DPRINTK_N("\tbus address: 0x%08lX\n", (unsigned long)dev->base_address[0]);
 #else
-   pd_board[num_pd_boards].address = ioremap(PCI_BASE_ADDRESS_MEM_MASK & dev->resource[0].start, pd_board[num_pd_boards].size);
+   pd_board[board].address = ioremap(PCI_BASE_ADDRESS_MEM_MASK & dev->resource[0].start, pd_board[board].size);
    DPRINTK_N("\tbus address: 0x%08lX\n", (unsigned long)dev->resource[0].start);
 #endif
-   DPRINTK_N("\tvirt address: 0x%08lX\n", (unsigned long)pd_board[num_pd_boards].address);
+   DPRINTK_N("\tvirt address: 0x%08lX\n", (unsigned long)pd_board[board].address);
 
    // store PCI configuration
    pci_read_config_word(dev, PCI_VENDOR_ID, &u16val);
-   pd_board[num_pd_boards].PCI_Config.VendorID = u16val;
+   pd_board[board].PCI_Config.VendorID = u16val;
 
    pci_read_config_word(dev, PCI_DEVICE_ID, &u16val);
-   pd_board[num_pd_boards].PCI_Config.DeviceID = u16val;
+   pd_board[board].PCI_Config.DeviceID = u16val;
 
    pci_read_config_word(dev, PCI_COMMAND, &u16val);
-   pd_board[num_pd_boards].PCI_Config.Command = u16val;
+   pd_board[board].PCI_Config.Command = u16val;
 
    pci_read_config_word(dev, PCI_STATUS, &u16val);
-   pd_board[num_pd_boards].PCI_Config.Status = u16val;
+   pd_board[board].PCI_Config.Status = u16val;
 
    pci_read_config_byte(dev, PCI_REVISION_ID, &u8val);
-   pd_board[num_pd_boards].PCI_Config.RevisionID = u8val;
+   pd_board[board].PCI_Config.RevisionID = u8val;
 
    pci_read_config_byte(dev, PCI_CACHE_LINE_SIZE, &u8val);
-   pd_board[num_pd_boards].PCI_Config.CacheLineSize = u8val;
+   pd_board[board].PCI_Config.CacheLineSize = u8val;
 
    pci_read_config_byte(dev, PCI_LATENCY_TIMER, &u8val);
-   pd_board[num_pd_boards].PCI_Config.LatencyTimer = u8val;
+   pd_board[board].PCI_Config.LatencyTimer = u8val;
 
 #if LINUX_VERSION_CODE < KERNEL_VERSION(2,4,0)
-   pd_board[num_pd_boards].PCI_Config.BaseAddress0 = dev->base_address[0];
+   pd_board[board].PCI_Config.BaseAddress0 = dev->base_address[0];
 #else
-   pd_board[num_pd_boards].PCI_Config.BaseAddress0 = dev->resource[0].start;
+   pd_board[board].PCI_Config.BaseAddress0 = dev->resource[0].start;
 #endif
-   pd_board[num_pd_boards].PCI_Config.SubsystemVendorID = sub_vendor_id;
-   pd_board[num_pd_boards].PCI_Config.SubsystemID = sub_device_id;
+   pd_board[board].PCI_Config.SubsystemVendorID = sub_vendor_id;
+   pd_board[board].PCI_Config.SubsystemID = sub_device_id;
 
-   pd_board[num_pd_boards].PCI_Config.InterruptLine = dev->irq;
+   pd_board[board].PCI_Config.InterruptLine = dev->irq;
 
    pci_read_config_byte(dev, PCI_INTERRUPT_PIN, &u8val);
-   pd_board[num_pd_boards].PCI_Config.InterruptPin = u8val;
+   pd_board[board].PCI_Config.InterruptPin = u8val;
 
    pci_read_config_byte(dev, PCI_MIN_GNT, &u8val);
-   pd_board[num_pd_boards].PCI_Config.MinimumGrant = u8val;
+   pd_board[board].PCI_Config.MinimumGrant = u8val;
 
    pci_read_config_byte(dev, PCI_MAX_LAT, &u8val);
-   pd_board[num_pd_boards].PCI_Config.MaximumLatency = u8val;
+   pd_board[board].PCI_Config.MaximumLatency = u8val;
+
+   return 1;
+
+   fail0:  return 0;
+}
+
+// ns to us for the init timing log (no 64-bit division on 32-bit kernels)
+static u32 pd_ns_to_us(u64 ns)
+{
+   do_div(ns, 1000);
+   return (u32)ns;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//
+//       name:  pd_bringup_board
+//
+//   function:  Starts the DSP of a board claimed by deal_with_device():
+//              resets it and downloads the firmware if needed, runs the
+//              echo test, reads the EEPROM and loads the calibration.
+//              Only the board's own registers are used, so the boards
+//              are brought up concurrently (see pd_bringup_all()).
+//
+//  arguments:  The board (index).
+//
+//    returns:  1 if it worked, 0 if the board has to be skipped.
+//
+static int pd_bringup_board(int board) 
+{
+   u64 t0, t1;
 
    // check FW state and download it if necessarily
-   if (!pd_dsp_startup (num_pd_boards)) goto fail1;
+   t0 = pd_get_time_ns();
+   if (!pd_dsp_startup(board)) 
+      return 0;
+   t1 = pd_get_time_ns();
+   pd_board[board].InitTime[initDspStartup] = t1 - t0;
+
+   // read EEPROM and firmware revision
+   pd_init_pd_board(board);
+   t0 = pd_get_time_ns();
+   pd_board[board].InitTime[initBoard] = t0 - t1;
+
+   // initialize calibration values
+   pd_init_calibration(board);
+   pd_board[board].InitTime[initCalibration] = pd_get_time_ns() - t0;
+
+   return 1;
+}
+
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,0)) && !defined(_PD_RTLPRO)
+typedef struct
+{
+   int board;
+   int ok;
+   struct completion done;
+} pd_bringup_job_t;
+
+static int pd_bringup_thread(void *data)
+{
+   pd_bringup_job_t *job = (pd_bringup_job_t *)data;
+
+   job->ok = pd_bringup_board(job->board);
+   complete(&job->done);
+   return 0;
+}
+#endif
+
+//////////////////////////////////////////////////////////////////////////
+//
+//       name:  pd_bringup_all
+//
+//   function:  Runs pd_bringup_board() for all claimed boards, one kernel
+//              thread per board (parinit=1) or one after another.
+//
+//  arguments:  The number of claimed boards and the array receiving
+//              the result of each of them.
+//
+//    returns:  Nothing.
+//
+static void pd_bringup_all(int count, int *ok)
+{
+   int i;
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,0)) && !defined(_PD_RTLPRO)
+   pd_bringup_job_t *jobs;
+   struct task_struct *task;
 
-   pd_board[num_pd_boards].irq = dev->irq;
-   pd_board[num_pd_boards].open = 0;
+   if (parinit && (count > 1) &&
+       ((jobs = kmalloc(count * sizeof(pd_bringup_job_t), GFP_KERNEL)) != NULL))
+   {
+      for (i = 0; i < count; i++)
+      {
+         jobs[i].board = i;
+         jobs[i].ok = 0;
+         init_completion(&jobs[i].done);
+
+         task = kthread_run(pd_bringup_thread, &jobs[i], "pwrdaq_init%d", i);
+         if (IS_ERR(task))
+         {
+            DPRINTK_F("couldn't start init thread for board %d\n", i);
+            jobs[i].ok = pd_bringup_board(i);
+            complete(&jobs[i].done);
+         }
+      }
+
+      for (i = 0; i < count; i++)
+      {
+         wait_for_completion(&jobs[i].done);
+         ok[i] = jobs[i].ok;
+      }
+
+      kfree(jobs);
+      return;
+   }
+#endif
+
+   for (i = 0; i < count; i++)
+      ok[i] = pd_bringup_board(i);
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+//
+//       name:  pd_setup_board
+//
+//   function:  Finishes the initialization of a board brought up by
+//              pd_bringup_board(): gets hold on the interrupt line,
+//              creates the synch objects and allocates the memory
+//              chunks for bus-mastering.
+//
+//  arguments:  The board (index).
+//
+//    returns:  1 if it worked, 0 if the board has to be skipped.
+//
+static int pd_setup_board(int board) 
+{
+   int ret, t;
+   char* model_name;
+   u64 start = pd_get_time_ns();
+
+   pd_board[board].irq = pd_board[board].dev->irq;
+   pd_board[board].open = 0;
 
    // get hold on interrupt line
+   pd_board[board].bh_cpu = -1;
    if (rqstirq)
    {
-      if (pd_driver_request_irq(num_pd_boards, NULL))
+      if (pd_driver_request_irq(board, NULL))
       {
          DPRINTK_F("couldnt allocate ISR, skipping card\n");
          goto fail1;
       }
+
+      if (bh_cpu[board] >= 0)
+         pd_driver_set_bh_cpu(board, bh_cpu[board]);
    } 
    else
    {
       DPRINTK("rqstirq=0 interrupts disabled\n");
    }
 
-   pd_init_pd_board(num_pd_boards);
-
-   if (pd_event_create(num_pd_boards, &pd_board[num_pd_boards].AinSS.synch) != 0)
+   if (pd_event_create(board, &pd_board[board].AinSS.synch) != 0)
    {
       DPRINTK_T("Could not create the Ain synch object.\n");
       goto fail1;
    }
 
-   if (pd_event_create(num_pd_boards, &pd_board[num_pd_boards].AoutSS.synch) != 0)
+   if (pd_event_create(board, &pd_board[board].AoutSS.synch) != 0)
    {
       DPRINTK_T("Could not create the Aout synch object.\n");
       goto fail1;
    }
    
-   if (pd_event_create(num_pd_boards, &pd_board[num_pd_boards].DinSS.synch) != 0)
+   if (pd_event_create(board, &pd_board[board].DinSS.synch) != 0)
    {
       DPRINTK_T("Could not create the Din synch object.\n");
       goto fail1;
    }
    
-   if (pd_event_create(num_pd_boards, &pd_board[num_pd_boards].DoutSS.synch) != 0)
+   if (pd_event_create(board, &pd_board[board].DoutSS.synch) != 0)
    {
       DPRINTK_T("Could not create the Dout synch object.\n");
       goto fail1;
    }
    
-   if (pd_event_create(num_pd_boards, &pd_board[num_pd_boards].UctSS.synch) != 0)
+   if (pd_event_create(board, &pd_board[board].UctSS.synch) != 0)
    {
       DPRINTK_T("Could not create the Uct synch object.\n");
       goto fail1;
    }
 
-   pd_board[num_pd_boards].AinSS.synch->subsystem = AnalogIn;
-   pd_board[num_pd_boards].AoutSS.synch->subsystem = AnalogOut;
-   pd_board[num_pd_boards].DinSS.synch->subsystem = DigitalIn;
-   pd_board[num_pd_boards].DoutSS.synch->subsystem = DigitalOut;
-   pd_board[num_pd_boards].UctSS.synch->subsystem = CounterTimer;
+   pd_board[board].AinSS.synch->subsystem = AnalogIn;
+   pd_board[board].AoutSS.synch->subsystem = AnalogOut;
+   pd_board[board].DinSS.synch->subsystem = DigitalIn;
+   pd_board[board].DoutSS.synch->subsystem = DigitalOut;
+   pd_board[board].UctSS.synch->subsystem = CounterTimer;
 
    // Set the Xferm mode to whatever the user passed as a parameter
-   pd_board[num_pd_boards].dwXFerMode = xferMode;
+   pd_board[board].dwXFerMode = xferMode;
    DPRINTK_N("Xfer mode is %d\n", xferMode);
 
-   // initialize calibration values
-   pd_init_calibration(num_pd_boards);
-
    {
       u32 XBMPageSz, XAOPageSz;
       tAllocContigMem Mem;
       
       // Verify that we do have enough memory for our games
       // load ADC FIFO transfer size
-      if (( pd_board[num_pd_boards].Eeprom.u.Header.ADCFifoSize >= 1 ) &&
-          ( pd_board[num_pd_boards].Eeprom.u.Header.ADCFifoSize <= 0x40 ))
+      if (( pd_board[board].Eeprom.u.Header.ADCFifoSize >= 1 ) &&
+          ( pd_board[board].Eeprom.u.Header.ADCFifoSize <= 0x40 ))
       {
-          pd_board[num_pd_boards].AinSS.FifoValues = pd_board[num_pd_boards].Eeprom.u.Header.ADCFifoSize << 10; // kbytes->bytes
-          if (pd_board[num_pd_boards].AinSS.FifoValues <= PD_AIN_MAX_FIFO_VALUES)
-              pd_board[num_pd_boards].AinSS.XferBufValues = pd_board[num_pd_boards].AinSS.FifoValues;
+          pd_board[board].AinSS.FifoValues = pd_board[board].Eeprom.u.Header.ADCFifoSize << 10; // kbytes->bytes
+          if (pd_board[board].AinSS.FifoValues <= PD_AIN_MAX_FIFO_VALUES)
+              pd_board[board].AinSS.XferBufValues = pd_board[board].AinSS.FifoValues;
           else
-              pd_board[num_pd_boards].AinSS.XferBufValues = PD_AIN_MAX_FIFO_VALUES;    // maximum limited by transfer buffer
+              pd_board[board].AinSS.XferBufValues = PD_AIN_MAX_FIFO_VALUES;    // maximum limited by transfer buffer
       }
       else
       {
-          pd_board[num_pd_boards].AinSS.FifoValues = PD_AIN_FIFO_VALUES;  // minimum size for 1kS FIFO
-          pd_board[num_pd_boards].Eeprom.u.Header.ADCFifoSize = 1;
+          pd_board[board].AinSS.FifoValues = PD_AIN_FIFO_VALUES;  // minimum size for 1kS FIFO
+          pd_board[board].Eeprom.u.Header.ADCFifoSize = 1;
       }
 
 
       // calculate how many times we have to make 512 (1/2K FIFO) or 1024 ((4/8/16/32/64K FIFO)) samples transfer. 
       // The idea is that we can make 1/2 ADC FIFO transfers
-      pd_board[num_pd_boards].AinSS.FifoXFerCycles = (pd_board[num_pd_boards].AinSS.FifoValues / PD_AIN_FIFO_VALUES);
+      pd_board[board].AinSS.FifoXFerCycles = (pd_board[board].AinSS.FifoValues / PD_AIN_FIFO_VALUES);
 
       // Set up bus-mastering pages parameters
-      pd_board[num_pd_boards].AinSS.DoGetSamples = TRUE;
+      pd_board[board].AinSS.DoGetSamples = TRUE;
 
       // calculate this in pages: minimum - 1 page, maximum - x pages
       // please notice that XFer requres only one page where BM requires two
       XBMPageSz = 4;
-      switch (pd_board[num_pd_boards].Eeprom.u.Header.ADCFifoSize) 
+      switch (pd_board[board].Eeprom.u.Header.ADCFifoSize) 
       {
       case 1:
-         pd_board[num_pd_boards].AinSS.BmFHFXFers = 1;
-         pd_board[num_pd_boards].AinSS.BmPageXFers = 8;
-         pd_board[num_pd_boards].AinSS.AIBMTXSize = AIBM_TXSIZE512;
+         pd_board[board].AinSS.BmFHFXFers = 1;
+         pd_board[board].AinSS.BmPageXFers = 8;
+         pd_board[board].AinSS.AIBMTXSize = AIBM_TXSIZE512;
          break;
       case 2:
-         pd_board[num_pd_boards].AinSS.BmFHFXFers = 1;
-         pd_board[num_pd_boards].AinSS.BmPageXFers = 8;
-         pd_board[num_pd_boards].AinSS.AIBMTXSize = AIBM_TXSIZE512;
+         pd_board[board].AinSS.BmFHFXFers = 1;
+         pd_board[board].AinSS.BmPageXFers = 8;
+         pd_board[board].AinSS.AIBMTXSize = AIBM_TXSIZE512;
          break;
       case 4:
-         pd_board[num_pd_boards].AinSS.BmFHFXFers = 2;
-         pd_board[num_pd_boards].AinSS.BmPageXFers = 4;
-         pd_board[num_pd_boards].AinSS.AIBMTXSize = AIBM_TXSIZE1024;
+         pd_board[board].AinSS.BmFHFXFers = 2;
+         pd_board[board].AinSS.BmPageXFers = 4;
+         pd_board[board].AinSS.AIBMTXSize = AIBM_TXSIZE1024;
          break;
       case 8:
-         pd_board[num_pd_boards].AinSS.BmFHFXFers = 4;
-         pd_board[num_pd_boards].AinSS.BmPageXFers = 4;
-         pd_board[num_pd_boards].AinSS.AIBMTXSize = AIBM_TXSIZE1024;
+         pd_board[board].AinSS.BmFHFXFers = 4;
+         pd_board[board].AinSS.BmPageXFers = 4;
+         pd_board[board].AinSS.AIBMTXSize = AIBM_TXSIZE1024;
          break;
       case 16:
-         pd_board[num_pd_boards].AinSS.BmFHFXFers = 8;
-         pd_board[num_pd_boards].AinSS.BmPageXFers = 4;
-         pd_board[num_pd_boards].AinSS.AIBMTXSize = AIBM_TXSIZE1024;
+         pd_board[board].AinSS.BmFHFXFers = 8;
+         pd_board[board].AinSS.BmPageXFers = 4;
+         pd_board[board].AinSS.AIBMTXSize = AIBM_TXSIZE1024;
          XBMPageSz = 8;
          break;
       case 32:
-         pd_board[num_pd_boards].AinSS.BmFHFXFers = 8;
-         pd_board[num_pd_boards].AinSS.BmPageXFers = 4;
-         pd_board[num_pd_boards].AinSS.AIBMTXSize = AIBM_TXSIZE1024;
+         pd_board[board].AinSS.BmFHFXFers = 8;
+         pd_board[board].AinSS.BmPageXFers = 4;
+         pd_board[board].AinSS.AIBMTXSize = AIBM_TXSIZE1024;
          XBMPageSz = 8;
          break;
       case 64:
-         pd_board[num_pd_boards].AinSS.BmFHFXFers = 8;
-         pd_board[num_pd_boards].AinSS.BmPageXFers = 4;
-         pd_board[num_pd_boards].AinSS.AIBMTXSize = AIBM_TXSIZE1024;
+         pd_board[board].AinSS.BmFHFXFers = 8;
+         pd_board[board].AinSS.BmPageXFers = 4;
+         pd_board[board].AinSS.AIBMTXSize = AIBM_TXSIZE1024;
          XBMPageSz = 16;
          break;
       default:
-         pd_board[num_pd_boards].AinSS.BmFHFXFers = 1;
-         pd_board[num_pd_boards].AinSS.BmPageXFers = 8;
-         pd_board[num_pd_boards].AinSS.AIBMTXSize = AIBM_TXSIZE512;
+         pd_board[board].AinSS.BmFHFXFers = 1;
+         pd_board[board].AinSS.BmPageXFers = 8;
+         pd_board[board].AinSS.AIBMTXSize = AIBM_TXSIZE512;
          break;
       }
 
-      if(pd_board[num_pd_boards].dwXFerMode == XFERMODE_RTBM)
+      if(pd_board[board].dwXFerMode == XFERMODE_RTBM)
       {
-         pd_board[num_pd_boards].AinSS.BmFHFXFers = RTModeBmFHFXFers;
-         pd_board[num_pd_boards].AinSS.BmPageXFers = RTModeBmPageXFers;
+         pd_board[board].AinSS.BmFHFXFers = RTModeBmFHFXFers;
+         pd_board[board].AinSS.BmPageXFers = RTModeBmPageXFers;
       }
 
       // Initialize memory chunks 0 and 1 for bus-mastering operations
       Mem.idx = AI_PAGE0;
       Mem.size = XBMPageSz;
-      ret = pd_alloc_contig_memory(num_pd_boards, &Mem);
+      ret = pd_alloc_contig_memory(board, &Mem);
       if (ret != 0) 
       {
-          pd_board[num_pd_boards].dwXFerMode = XFERMODE_NOAIMEM;
-          pd_board[num_pd_boards].AinSS.XferBufValues = 0; 
-          pd_board[num_pd_boards].AinSS.FifoValues = 0;
-          pd_board[num_pd_boards].AinSS.pXferBuf = NULL;
+          pd_board[board].dwXFerMode = XFERMODE_NOAIMEM;
+          pd_board[board].AinSS.XferBufValues = 0; 
+          pd_board[board].AinSS.FifoValues = 0;
+          pd_board[board].AinSS.pXferBuf = NULL;
 
           DPRINTK_F("pd_init ain error: couldn't allocate AIn buffer size 0x%x\n", XBMPageSz);
 
@@ -363,107 +520,124 @@ static void deal_with_device(struct pci_dev *dev)
       {
           Mem.idx = AI_PAGE1;
           Mem.size = XBMPageSz;
-          ret = pd_alloc_contig_memory(num_pd_boards, &Mem);
+          ret = pd_alloc_contig_memory(board, &Mem);
           if (ret != 0) 
           {
-              pd_board[num_pd_boards].dwXFerMode = XFERMODE_NOAIMEM;
-              pd_board[num_pd_boards].AinSS.XferBufValues = 0;
-              pd_board[num_pd_boards].AinSS.FifoValues = 0;
-              pd_board[num_pd_boards].AinSS.pXferBuf = NULL;
+              pd_board[board].dwXFerMode = XFERMODE_NOAIMEM;
+              pd_board[board].AinSS.XferBufValues = 0;
+              pd_board[board].AinSS.FifoValues = 0;
+              pd_board[board].AinSS.pXferBuf = NULL;
               goto fail1;
           }
-          pd_board[num_pd_boards].AinSS.pXferBuf = pd_board[num_pd_boards].pSysBMB[AI_PAGE1];  // buffer address for XFer and BM
+          pd_board[board].AinSS.pXferBuf = pd_board[board].pSysBMB[AI_PAGE1];  // buffer address for XFer and BM
+      }
+
+      // ring of pages behind the two bus-master pages
+      if ((bm_ring > 0) &&
+          ((pd_board[board].dwXFerMode == XFERMODE_BM) ||
+           (pd_board[board].dwXFerMode == XFERMODE_BM8WORD)))
+      {
+         if (pd_bm_ring_alloc(board, bm_ring, 
+                              pd_board[board].AinSS.BmPageXFers * pd_board[board].AinSS.AIBMTXSize) != 0)
+         {
+            DPRINTK_F("pd_init ain: couldn't allocate a %d pages bus-master ring\n", bm_ring);
+         }
       }
 
       // load DAC FIFO transfer size
-      if (pd_board[num_pd_boards].Eeprom.u.Header.DACFifoSize > 0x80) // incorrect DA88C FIFO size
+      if (pd_board[board].Eeprom.u.Header.DACFifoSize > 0x80) // incorrect DA88C FIFO size
       {
-          pd_board[num_pd_boards].Eeprom.u.Header.DACFifoSize = 2;
+          pd_board[board].Eeprom.u.Header.DACFifoSize = 2;
       }
 
-      if (( pd_board[num_pd_boards].Eeprom.u.Header.DACFifoSize >= 2 ) &&
-          ( pd_board[num_pd_boards].Eeprom.u.Header.DACFifoSize <= 0x40 ))
+      if (( pd_board[board].Eeprom.u.Header.DACFifoSize >= 2 ) &&
+          ( pd_board[board].Eeprom.u.Header.DACFifoSize <= 0x40 ))
       {
-          pd_board[num_pd_boards].AoutSS.FifoValues = pd_board[num_pd_boards].Eeprom.u.Header.DACFifoSize << 10; // kbytes->bytes
-          if (pd_board[num_pd_boards].AoutSS.FifoValues <= PD_AOUT_MAX_FIFO_VALUES)
+          pd_board[board].AoutSS.FifoValues = pd_board[board].Eeprom.u.Header.DACFifoSize << 10; // kbytes->bytes
+          if (pd_board[board].AoutSS.FifoValues <= PD_AOUT_MAX_FIFO_VALUES)
           {
-             pd_board[num_pd_boards].AoutSS.XferBufValues = pd_board[num_pd_boards].AoutSS.FifoValues;
+             pd_board[board].AoutSS.XferBufValues = pd_board[board].AoutSS.FifoValues;
           }
           else
           {
-             pd_board[num_pd_boards].AoutSS.XferBufValues = ANALOG_XFERBUF_VALUES;    // maximum limited by transfer buffer
+             pd_board[board].AoutSS.XferBufValues = ANALOG_XFERBUF_VALUES;    // maximum limited by transfer buffer
           }
       } 
       else 
       {
-          pd_board[num_pd_boards].AoutSS.FifoValues = PD_AOUT_MAX_FIFO_VALUES;  // minimum size for 1kS FIFO
+          pd_board[board].AoutSS.FifoValues = PD_AOUT_MAX_FIFO_VALUES;  // minimum size for 1kS FIFO
       }
 
-      pd_board[num_pd_boards].AoutSS.TranSize = pd_board[num_pd_boards].AoutSS.FifoValues;
+      pd_board[board].AoutSS.TranSize = pd_board[board].AoutSS.FifoValues;
 
       // calculate how many pages need to be allocated
-      XAOPageSz = (pd_board[num_pd_boards].Eeprom.u.Header.DACFifoSize << 12)/PAGE_SIZE;
-      if ((pd_board[num_pd_boards].Eeprom.u.Header.DACFifoSize << 12)%PAGE_SIZE) 
+      XAOPageSz = (pd_board[board].Eeprom.u.Header.DACFifoSize << 12)/PAGE_SIZE;
+      if ((pd_board[board].Eeprom.u.Header.DACFifoSize << 12)%PAGE_SIZE) 
       {
          XAOPageSz++;
       }
 
       Mem.idx = AO_PAGE0;
       Mem.size = XAOPageSz;
-      ret = pd_alloc_contig_memory(num_pd_boards, &Mem);
+      ret = pd_alloc_contig_memory(board, &Mem);
       if (ret != 0) 
       {
-         pd_board[num_pd_boards].AoutSS.TranSize = 0;
-         pd_board[num_pd_boards].AoutSS.FifoValues = 0;
-         pd_board[num_pd_boards].AoutSS.pXferBuf = NULL;
-         pd_board[num_pd_boards].dwXFerMode = XFERMODE_NOAOMEM;
+         pd_board[board].AoutSS.TranSize = 0;
+         pd_board[board].AoutSS.FifoValues = 0;
+         pd_board[board].AoutSS.pXferBuf = NULL;
+         pd_board[board].dwXFerMode = XFERMODE_NOAOMEM;
 
          DPRINTK_F("pd_init AO/AO32 error: couldn't allocate AOut buffer size 0x%x\n", XAOPageSz);
       }
-      pd_board[num_pd_boards].AoutSS.pXferBuf = pd_board[num_pd_boards].pSysBMB[AO_PAGE0];
+      pd_board[board].AoutSS.pXferBuf = pd_board[board].pSysBMB[AO_PAGE0];
    }
 
    DPRINTK_N("AI: XferBufValues = %d, BlkXferValues = %d, FifoValues = %d, FifoXFerCycles = %d\n", 
-                    pd_board[num_pd_boards].AinSS.XferBufValues,
-                    pd_board[num_pd_boards].AinSS.BlkXferValues, 
-                    pd_board[num_pd_boards].AinSS.FifoValues, 
-                    pd_board[num_pd_boards].AinSS.FifoXFerCycles);
+                    pd_board[board].AinSS.XferBufValues,
+                    pd_board[board].AinSS.BlkXferValues, 
+                    pd_board[board].AinSS.FifoValues, 
+                    pd_board[board].AinSS.FifoXFerCycles);
+
 
+   DPRINTK_N("AI0:0x%lx AI1:0x%lx AO0:0x%lx\n", (unsigned long)pd_board[board].pSysBMB[AI_PAGE0], 
+                                           (unsigned long)pd_board[board].pSysBMB[AI_PAGE1], 
+                                           (unsigned long)pd_board[board].pSysBMB[AO_PAGE0]);
 
-   DPRINTK_N("AI0:0x%lx AI1:0x%lx AO0:0x%lx\n", (unsigned long)pd_board[num_pd_boards].pSysBMB[AI_PAGE0], 
-                                           (unsigned long)pd_board[num_pd_boards].pSysBMB[AI_PAGE1], 
-                                           (unsigned long)pd_board[num_pd_boards].pSysBMB[AO_PAGE0]);
+   pd_board[board].InitTime[initSetup] = pd_get_time_ns() - start;
 
-   DPRINTK_N("pd_board[%d] has been initialized\n", num_pd_boards);
+   DPRINTK_N("pd_board[%d] has been initialized\n", board);
    
-   model_name = pd_get_board_name(num_pd_boards);
+   model_name = pd_get_board_name(board);
 
-   PRINTK("Board %d:\n", num_pd_boards);
+   PRINTK("Board %d:\n", board);
    PRINTK("\tName: %s\n", model_name);
-   PRINTK("\tSerial Number: %8s\n", pd_board[num_pd_boards].Eeprom.u.Header.SerialNumber);
-   PRINTK("\tInput FIFO size: %d samples\n", pd_board[num_pd_boards].Eeprom.u.Header.ADCFifoSize*1024);
-   PRINTK("\tInput channel list FIFO size: %d entries\n", pd_board[num_pd_boards].Eeprom.u.Header.CLFifoSize*256);
-   PRINTK("\tOutput FIFO size: %d samples\n", pd_board[num_pd_boards].Eeprom.u.Header.DACFifoSize*1024);
-   PRINTK("\tManufacture date: %s\n", pd_board[num_pd_boards].Eeprom.u.Header.ManufactureDate);
-   PRINTK("\tCalibration date: %s\n", pd_board[num_pd_boards].Eeprom.u.Header.CalibrationDate);
-   PRINTK("\tBase address: 0x%x\n", pd_board[num_pd_boards].PCI_Config.BaseAddress0);
-   PRINTK("\tIRQ line: 0x%x\n", pd_board[num_pd_boards].PCI_Config.InterruptLine); 
-   PRINTK("\tDSP Rev: v%d\n", (pd_board[num_pd_boards].fwTimestamp[0]&0x0F0000)>>16);  
-   t =  pd_board[num_pd_boards].fwTimestamp[0]>>20;
+   PRINTK("\tSerial Number: %8s\n", pd_board[board].Eeprom.u.Header.SerialNumber);
+   PRINTK("\tInput FIFO size: %d samples\n", pd_board[board].Eeprom.u.Header.ADCFifoSize*1024);
+   PRINTK("\tInput channel list FIFO size: %d entries\n", pd_board[board].Eeprom.u.Header.CLFifoSize*256);
+   PRINTK("\tOutput FIFO size: %d samples\n", pd_board[board].Eeprom.u.Header.DACFifoSize*1024);
+   if (pd_board[board].BmRing.Slots)
+      PRINTK("\tBus-master ring: %d pages of %d samples\n", pd_board[board].BmRing.Slots,
+             pd_board[board].BmRing.SlotValues);
+   PRINTK("\tManufacture date: %s\n", pd_board[board].Eeprom.u.Header.ManufactureDate);
+   PRINTK("\tCalibration date: %s\n", pd_board[board].Eeprom.u.Header.CalibrationDate);
+   PRINTK("\tBase address: 0x%x\n", pd_board[board].PCI_Config.BaseAddress0);
+   PRINTK("\tIRQ line: 0x%x\n", pd_board[board].PCI_Config.InterruptLine); 
+   PRINTK("\tDSP Rev: v%d\n", (pd_board[board].fwTimestamp[0]&0x0F0000)>>16);  
+   t =  pd_board[board].fwTimestamp[0]>>20;
    PRINTK("\tFirmware type: %s, rev: %d.%d/%x\n",
           (t < 1)?"Generic": ((t<2)?"AO": ((t<3)?"DIO":((t<4)?"LMF":((t<5)?"MFx":"Unknown")))),
-          (pd_board[num_pd_boards].fwTimestamp[0]&0xF00)>>8,
-          pd_board[num_pd_boards].fwTimestamp[0]&0xFF,
-          pd_board[num_pd_boards].fwTimestamp[1]); 
+          (pd_board[board].fwTimestamp[0]&0xF00)>>8,
+          pd_board[board].fwTimestamp[0]&0xFF,
+          pd_board[board].fwTimestamp[1]); 
 
-   num_pd_boards ++;
-   return;
+   return 1;
 
-   fail1:  iounmap(pd_board[num_pd_boards].address);
-   fail0:  return;
+   fail1:  return 0;
 }
 
 
+
+
 ///////////////////////////////////////////////////////////////////////
 //
 //       Name:  pd_fasync
@@ -551,6 +725,8 @@ int rt_pd_open(struct rtdm_dev_context *context,
 
 
    ctx = (pd_rtdm_ctx_t *)context->dev_private;
+   ctx->board = board;
+   ctx->nonblock = (oflags & O_NONBLOCK) ? 1 : 0;
 
    return (pd_driver_open(board, minor));
 }
@@ -569,6 +745,78 @@ int rt_pd_close(struct rtdm_dev_context *context,
    return(pd_driver_close(board, minor));
 }
 
+ssize_t rt_pd_read(struct rtdm_dev_context *context,
+                   rtdm_user_info_t *user_info, void *buf, size_t nbyte)
+{
+   pd_rtdm_ctx_t *ctx = (pd_rtdm_ctx_t *)context->dev_private;
+   int  dev_id = context->device->device_id;
+   int  board = dev_id / PD_MINOR_RANGE;
+   int  minor = dev_id % PD_MINOR_RANGE;
+   int  flags = (ctx->nonblock) ? PD_RW_NONBLOCK : 0;
+
+   if (nbyte > 0x7FFFFFFF)
+      nbyte = 0x7FFFFFFF;
+
+   // check the whole buffer up front, the copies are done in pieces
+   if (user_info)
+   {
+      if (!rtdm_rw_user_ok(user_info, buf, nbyte))
+         return -EFAULT;
+   }
+   else
+   {
+      flags |= PD_RW_KERNEL;
+   }
+
+   return pd_driver_read(board, minor, (char*)buf, nbyte, flags, user_info);
+}
+
+ssize_t rt_pd_write(struct rtdm_dev_context *context,
+                    rtdm_user_info_t *user_info, const void *buf, size_t nbyte)
+{
+   pd_rtdm_ctx_t *ctx = (pd_rtdm_ctx_t *)context->dev_private;
+   int  dev_id = context->device->device_id;
+   int  board = dev_id / PD_MINOR_RANGE;
+   int  minor = dev_id % PD_MINOR_RANGE;
+   int  flags = (ctx->nonblock) ? PD_RW_NONBLOCK : 0;
+
+   if (nbyte > 0x7FFFFFFF)
+      nbyte = 0x7FFFFFFF;
+
+   if (user_info)
+   {
+      if (!rtdm_read_user_ok(user_info, buf, nbyte))
+         return -EFAULT;
+   }
+   else
+   {
+      flags |= PD_RW_KERNEL;
+   }
+
+   return pd_driver_write(board, minor, (const char*)buf, nbyte, flags, user_info);
+}
+
+//
+// Commands that allocate or free memory, or take Linux locks. From a
+// real-time task they return -ENOSYS, RTDM then reissues them through
+// ioctl_nrt (the task switches to secondary mode for the duration).
+//
+static int rt_pd_ioctl_nrt_only(unsigned int request)
+{
+   switch (request)
+   {
+   case IOCTL_PWRDAQ_REGISTER_BUFFER:
+   case IOCTL_PWRDAQ_UNREGISTER_BUFFER:
+   case IOCTL_PWRDAQ_DIO256COSSTART:
+   case IOCTL_PWRDAQ_BATCH:
+   case IOCTL_PWRDAQ_BRDFWLOAD:
+   case IOCTL_PWRDAQ_SET_BH_CPU:
+      return 1;
+   }
+
+   return 0;
+}
+
 int rt_pd_ioctl_rt(struct rtdm_dev_context *context,
                     rtdm_user_info_t *user_info, unsigned int request, void *arg)
 {
@@ -577,33 +825,52 @@ int rt_pd_ioctl_rt(struct rtdm_dev_context *context,
    int  minor = dev_id % PD_MINOR_RANGE;
    int  ret = 0;
    tCmd argcmd;
-      
-   if(arg != NULL)
+   u32  size = sizeof(tCmd);
+
+   // v2 codes carry the size of their argument
+   if (PD_IOC_IS_V2(request))
+   {
+      size = _IOC_SIZE(request);
+      if (size > sizeof(tCmd))
+         return -EINVAL;
+      request = PD_IOC_CODE(request);
+   }
+
+   if (rtdm_in_rt_context() && rt_pd_ioctl_nrt_only(request))
+      return -ENOSYS;
+
+   // a v2 command may not fill tCmd, the rest must not be stack leftovers
+   memset(&argcmd, 0, sizeof(argcmd));
+
+   if((arg != NULL) && size)
    {
       if (user_info)
       {
-         if (!rtdm_rw_user_ok(user_info, arg, sizeof(tCmd)) ||
-            rtdm_copy_from_user(user_info, &argcmd, arg, sizeof(tCmd)))
+         if (!rtdm_rw_user_ok(user_info, arg, size) ||
+            rtdm_copy_from_user(user_info, &argcmd, arg, size))
          return -EFAULT;
       } 
       else
       {
-         memcpy(&argcmd, arg, sizeof(tCmd));
+         memcpy(&argcmd, arg, size);
       }
    }
 
+   if (size < pd_ioctl_size(request, &argcmd))
+      return -EINVAL;
+
    ret = pd_driver_ioctl(board, minor, request, &argcmd);
    
-   if(arg != NULL)
+   if((arg != NULL) && size)
    {
       if (user_info)
       {
-         if(rtdm_copy_to_user(user_info, arg, &argcmd, sizeof(tCmd)))
+         if(rtdm_copy_to_user(user_info, arg, &argcmd, size))
             return -EFAULT;
       } 
       else
       {
-         memcpy(arg, &argcmd, sizeof(tCmd));
+         memcpy(arg, &argcmd, size);
       }
    }
 
@@ -615,25 +882,26 @@ static const struct rtdm_device __initdata pd_rtdm_device_tmpl =
     struct_version:     RTDM_DEVICE_STRUCT_VER,
 
     device_flags:       RTDM_NAMED_DEVICE | RTDM_EXCLUSIVE,
-    context_size:       0,
+    context_size:       sizeof(pd_rtdm_ctx_t),
     device_name:        "",
 
-    // open_rt and close_rt are not real-time safe due to calls to kmalloc/kfree
-    open_rt:            NULL,
+    // open and close only flag the subsystem, the synch objects they use
+    // are preallocated when the board is probed
+    open_rt:            rt_pd_open,
     open_nrt:           rt_pd_open,
 
     ops: {
-        close_rt:       NULL,
+        close_rt:       rt_pd_close,
         close_nrt:      rt_pd_close,
 
         ioctl_rt:       rt_pd_ioctl_rt,
         ioctl_nrt:      rt_pd_ioctl_rt,
 
-        read_rt:        NULL,
-        read_nrt:       NULL,
+        read_rt:        rt_pd_read,
+        read_nrt:       rt_pd_read,
 
-        write_rt:       NULL,
-        write_nrt:      NULL,
+        write_rt:       rt_pd_write,
+        write_nrt:      rt_pd_write,
 
         recvmsg_rt:     NULL,
         recvmsg_nrt:    NULL,
@@ -734,6 +1002,10 @@ int rtl_pd_ioctl(struct rtl_file *filp, unsigned int request,
       rtl_memcpy(&argcmd, arg, sizeof(tCmd));
    } */
 
+   // the driver works on the caller's tCmd, the size doesn't matter
+   if (PD_IOC_IS_V2(request))
+      request = PD_IOC_CODE(request);
+
    ret = pd_driver_ioctl(board, minor, request, arg/*&argcmd*/);
    
    /*if(arg != NULL)
@@ -868,12 +1140,14 @@ int pd_release(
 //
 //       Name:  pd_read()
 //
-//   Function:  Reads data from the board.
+//   Function:  Reads whole scans from the DAQ buffer registered on the
+//              AIn, DIn or UCT subsystem.
 //
 //  Arguments:  The file being read from, the userspace buffer to read into,
-//              the number of bytes to read, and the offset (what's this?)...
+//              the number of bytes to read, and the offset (unused).
 //
-//    Returns:  Number of bytes actually read.
+//    Returns:  Number of bytes actually read, 0 once a stopped
+//              acquisition is drained.
 //
 ssize_t pd_read(
                struct file *file,
@@ -897,50 +1171,12 @@ ssize_t pd_read(
    DPRINTK_I("trying to read from board %d, %s (minor %u)\n", board,
              pd_devices_by_minor[board_minor], real_minor);
 
-   _fw_spinlock    // set spin lock
-
-   switch (board_minor)
-   {
-   case PD_MINOR_AIN:
-      if (!(pd_board[board].AinSS.SubsysState & ssActive))
-      {
-         //ret = pd_ain_read_scan(board, buffer, count);
-      }
-      break;
-
-   case PD_MINOR_AOUT:
-      if (!(pd_board[board].AoutSS.SubsysState & ssActive))
-      {
-         DPRINTK_I("not implemented yet...\n");
-      }
-      ret = -ENODEV;
-      break;
-
-   case PD_MINOR_DIN:
-      if (!(pd_board[board].DinSS.SubsysState & ssActive))
-      {
-         //ret = pd_din_read(board, buffer, count);
-      }
-      break;
+   // returned byte count must fit into an int
+   if (count > 0x7FFFFFFF)
+      count = 0x7FFFFFFF;
 
-   case PD_MINOR_DOUT:
-      if (!(pd_board[board].DoutSS.SubsysState & ssActive))
-      {
-         //ret = pd_din_read(board, buffer, count);
-      }
-      ret = -ENODEV;
-      break;
-
-   case PD_MINOR_UCT:
-      if (!(pd_board[board].UctSS.SubsysState & ssActive))
-      {
-         DPRINTK_I("not implemented yet...\n");
-      }
-      ret = -ENODEV;
-      break;
-   }
-
-   _fw_spinunlock    // release spin lock
+   ret = pd_driver_read(board, board_minor, buffer, count,
+                        (file->f_flags & O_NONBLOCK) ? PD_RW_NONBLOCK : 0, NULL);
 
    return ret;
 }
@@ -950,9 +1186,11 @@ ssize_t pd_read(
 //
 //       Name:  pd_write()
 //
-//   Function:  Writes data to the board.
+//   Function:  Writes whole scans into the DAQ buffer registered on the
+//              AOut or DOut subsystem.
 //
-//  Arguments:  Hmmm...
+//  Arguments:  The file being written to, the userspace buffer to write
+//              from, the number of bytes to write, and the offset (unused).
 //
 //    Returns:  Number of bytes actually written.
 //
@@ -978,54 +1216,124 @@ ssize_t pd_write(
    DPRINTK_I("trying to write to board %d, %s (minor %u)\n",
              board, pd_devices_by_minor[board_minor], real_minor);
 
-   _fw_spinlock    // set spin lock
+   // returned byte count must fit into an int
+   if (count > 0x7FFFFFFF)
+      count = 0x7FFFFFFF;
+
+   ret = pd_driver_write(board, board_minor, buffer, count,
+                         (file->f_flags & O_NONBLOCK) ? PD_RW_NONBLOCK : 0, NULL);
+
+   return ret;
+}
+
+#if !(defined(_PD_RTL) || defined(_PD_RTLPRO) || defined(_PD_RTAI) || defined(_PD_XENOMAI))
+///////////////////////////////////////////////////////////////////////
+//
+//       Name:  pd_poll()
+//
+//   Function:  Reports whether read() or write() would block on a
+//              subsystem minor. The wait queue of the subsystem TSynchSS
+//              is woken from the bottom half on the dwEventsPoll events,
+//              whether the user armed them in dwEventsNotify or not.
+//
+//  Arguments:  The file being polled and the poll table.
+//
+//    Returns:  POLLIN  - scans are available in the input DAQ buffer or
+//                        the acquisition stopped (read() returns 0)
+//              POLLOUT - free scans are available in the output DAQ buffer
+//              POLLPRI - buffer over/under run (eBufferError) is latched
+//
+unsigned int pd_poll(struct file *file, poll_table *wait)
+{
+   int real_minor, board, board_minor;
+   PTBuf_Info pDaqBuf;
+   TSynchSS *synch;
+   u32 events;
+   unsigned int mask = 0;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 19, 0)
+   real_minor = iminor(file->f_path.dentry->d_inode);
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(2, 5, 0)
+   real_minor = iminor(file->f_dentry->d_inode);
+#else
+   real_minor = MINOR(file->f_dentry->d_inode->i_rdev);
+#endif
+   board = real_minor / PD_MINOR_RANGE;
+   board_minor = real_minor % PD_MINOR_RANGE;
 
    switch (board_minor)
    {
-   
    case PD_MINOR_AIN:
-      if (!(pd_board[board].AinSS.SubsysState & ssActive))
-      {
-         //DPRINTK_I("not implemented yet...\n");
-      }
-      ret = -ENODEV;
+   case PD_MINOR_DIN:
+   case PD_MINOR_UCT:
+      synch = pd_board[board].AinSS.synch;
       break;
 
    case PD_MINOR_AOUT:
-      if (!(pd_board[board].AoutSS.SubsysState & ssActive))
-      {
-         //ret = pd_aout_write_scan(board, buffer, count);
-      }
+   case PD_MINOR_DOUT:
+      synch = pd_board[board].AoutSS.synch;
       break;
 
-   case PD_MINOR_DIN:
-      if (!(pd_board[board].DinSS.SubsysState & ssActive))
-      {
-         //ret = pd_dout_write(board, buffer, count);
-      }
-      ret = -ENODEV;
-      break;
+   default:
+      return POLLERR;
+   }
 
-   case PD_MINOR_DOUT:
-      if (!(pd_board[board].DoutSS.SubsysState & ssActive))
+   poll_wait(file, &synch->wait_q, wait);
+
+   _fw_spinlock(board)    // set spin lock
+
+   if (synch == pd_board[board].AinSS.synch)
+   {
+      pDaqBuf = &pd_board[board].AinSS.BufInfo;
+
+      // the bottom half wakes us up on these events, the user's
+      // notification mask is left alone
+      pd_board[board].AinSS.dwEventsPoll = eDataAvailable | eFrameDone |
+                                           eBufferError | eStopped;
+      events = pd_board[board].AinSS.dwEventsNew | pd_board[board].AinSS.dwEventsStatus;
+
+      if (pDaqBuf->databuf && pDaqBuf->ScanValues)
       {
-         //ret = pd_dout_write(board, buffer, count);
+         if ((pDaqBuf->ScanIndex != pDaqBuf->Head / pDaqBuf->ScanValues) ||
+             (pd_board[board].AinSS.SubsysState == ssStopped))
+            mask |= POLLIN | POLLRDNORM;
       }
-      break;
+   }
+   else
+   {
+      pDaqBuf = &pd_board[board].AoutSS.BufInfo;
 
-   case PD_MINOR_UCT:
-      if (!(pd_board[board].UctSS.SubsysState & ssActive))
+      pd_board[board].AoutSS.dwEventsPoll = eFrameDone | eBufferDone |
+                                            eBufferError | eStopped;
+      events = pd_board[board].AoutSS.dwEventsNew | pd_board[board].AoutSS.dwEventsStatus;
+
+      if (pDaqBuf->databuf && pDaqBuf->ScanValues)
       {
-         DPRINTK_I("not implemented yet...\n");
+         if (pd_board[board].AoutSS.SubsysState == ssRunning)
+         {
+            if (pDaqBuf->ScanIndex != pDaqBuf->Head / pDaqBuf->ScanValues)
+               mask |= POLLOUT | POLLWRNORM;
+         }
+         else if (pd_board[board].AoutSS.SubsysState == ssStopped)
+         {
+            mask |= POLLERR;
+         }
+         else if (pDaqBuf->ValueCount < pDaqBuf->MaxValues)
+         {
+            // buffer is still being primed, see pd_driver_write()
+            mask |= POLLOUT | POLLWRNORM;
+         }
       }
-      ret = -ENODEV;
-      break;
    }
 
-   _fw_spinunlock    // release spin lock
+   if (events & eBufferError)
+      mask |= POLLPRI;
 
-   return ret;
+   _fw_spinunlock(board)    // release spin lock
+
+   return mask;
 }
+#endif
 
 ///////////////////////////////////////////////////////////////////////
 //
@@ -1052,18 +1360,33 @@ int pd_rt_ioctl(int board, unsigned int command, unsigned long arg)
 {
    int retcode;
    tCmd argcmd;
-      
-   if((void*)arg != NULL)
+   u32 size = sizeof(tCmd);
+
+   if (PD_IOC_IS_V2(command))
    {
-      pd_copy_from_user32((u32*)&argcmd, (u32*)arg, sizeof(tCmd));
+      size = _IOC_SIZE(command);
+      if (size > sizeof(tCmd))
+         return -EINVAL;
+      command = PD_IOC_CODE(command);
+   }
+
+   // a v2 command may not fill tCmd, the rest must not be stack leftovers
+   memset(&argcmd, 0, sizeof(argcmd));
 
+   if(((void*)arg != NULL) && size)
+   {
+      if (pd_copy_from_user32((u32*)&argcmd, (u32*)arg, size))
+         return -EFAULT;
    }
 
+   if (size < pd_ioctl_size(command, &argcmd))
+      return -EINVAL;
+
    retcode = pd_driver_ioctl(board, 0, command, &argcmd);
 
-   if((void*)arg != NULL)
+   if(((void*)arg != NULL) && size)
    {
-      pd_copy_to_user32((u32*)arg, (u32*)&argcmd, sizeof(tCmd));
+      pd_copy_to_user32((u32*)arg, (u32*)&argcmd, size);
    }
 
    return retcode;
@@ -1086,6 +1409,7 @@ int pd_ioctl(
 {
    int real_minor, board, board_minor;
    tCmd argcmd;
+   u32 size;
    int ret = 0;
    
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 19, 0)
@@ -1098,6 +1422,34 @@ int pd_ioctl(
    board = real_minor / PD_MINOR_RANGE;
    board_minor = real_minor % PD_MINOR_RANGE;
 
+   // v2: copy only the part of tCmd the command uses, a single point
+   // read or write moves a few bytes instead of the whole union
+   if (PD_IOC_IS_V2(command))
+   {
+      size = _IOC_SIZE(command);
+      if (size > sizeof(tCmd))
+         return -EINVAL;
+
+      // the part of tCmd that isn't copied must not be stack leftovers
+      memset(&argcmd, 0, sizeof(argcmd));
+
+      if (((void*)arg != NULL) && size &&
+          pd_copy_from_user32((u32*)&argcmd, (u32*)arg, size))
+         return -EFAULT;
+
+      // reject commands that don't carry all of their argument
+      if (size < pd_ioctl_size(PD_IOC_CODE(command), &argcmd))
+         return -EINVAL;
+
+      ret = pd_driver_ioctl(board, board_minor, PD_IOC_CODE(command), &argcmd);
+
+      if (((void*)arg != NULL) && size &&
+          pd_copy_to_user32((u32*)arg, (u32*)&argcmd, size))
+         return -EFAULT;
+
+      return ret;
+   }
+
    if((void*)arg != NULL)
    {
       pd_copy_from_user32((u32*)&argcmd, (u32*)arg, sizeof(tCmd));
@@ -1197,6 +1549,14 @@ static int pd_proc_open(struct inode *inode, struct file *file)
 	return single_open(file, pd_proc_show, NULL);
 }
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5,6,0)
+static const struct proc_ops pd_proc_fops = {
+	.proc_open	= pd_proc_open,
+	.proc_read	= seq_read,
+	.proc_lseek	= seq_lseek,
+	.proc_release	= single_release,
+};
+#else
 static const struct file_operations pd_proc_fops = {
 	.owner		= THIS_MODULE,
 	.open		= pd_proc_open,
@@ -1204,6 +1564,102 @@ static const struct file_operations pd_proc_fops = {
 	.llseek		= seq_lseek,
 	.release	= single_release,
 };
+#endif
+
+///////////////////////////////////////////////////////////////////////
+//
+//       Name:  pd_proc_lat_show/pd_proc_lat_write
+//
+//   Function:  /proc/pwrdaq_latency prints the interrupt path latency
+//              histograms of each board, writing anything to it
+//              clears them
+//
+//  Arguments:  Defined in proc_fs.h
+//
+static const char* pd_lat_names[latNum] = 
+{
+   "isr period (ns)",
+   "isr duration (ns)",
+   "isr to bottom half (ns)",
+   "bottom half duration (ns)",
+   "bottom half AIn values",
+   "event to waiter wakeup (ns)",
+   "bus-master ring pages per bottom half"
+};
+
+static int pd_proc_lat_show (struct seq_file *sfp, void *vp)
+{
+   int i, j, k;
+   TLatHist Hist;
+
+   for (i = 0; i < num_pd_boards; i++)
+   {
+      seq_printf(sfp, "PowerDAQ board #%d\n", i+1);
+
+      for (j = 0; j < latNum; j++)
+      {
+         // take a copy so that the numbers printed agree with each other
+         _fw_spinlock(i)
+         Hist = pd_board[i].LatHist[j];
+         _fw_spinunlock(i)
+
+         seq_printf(sfp, "  %s: count %u avg %llu max %u\n", pd_lat_names[j],
+                    Hist.Count, 
+                    (Hist.Count) ? div_u64(Hist.Sum, Hist.Count) : 0ULL,
+                    Hist.Max);
+
+         for (k = 0; k < PD_LAT_BUCKETS; k++)
+         {
+            if (Hist.Bucket[k])
+               seq_printf(sfp, "    [%10u, %10u) %u\n", 
+                          (k) ? (1U << k) : 0, 
+                          (k < 31) ? (1U << (k+1)) : 0xFFFFFFFF,
+                          Hist.Bucket[k]);
+         }
+      }
+      seq_printf(sfp, "\n");
+   }
+   return 0;
+}
+
+static int pd_proc_lat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, pd_proc_lat_show, NULL);
+}
+
+static ssize_t pd_proc_lat_write(struct file *file, const char __user *buf,
+                                 size_t count, loff_t *ppos)
+{
+   int i;
+
+   for (i = 0; i < num_pd_boards; i++)
+   {
+      _fw_spinlock(i)
+      pd_lat_reset(i);
+      _fw_spinunlock(i)
+   }
+
+   return count;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5,6,0)
+static const struct proc_ops pd_proc_lat_fops = {
+	.proc_open	= pd_proc_lat_open,
+	.proc_read	= seq_read,
+	.proc_write	= pd_proc_lat_write,
+	.proc_lseek	= seq_lseek,
+	.proc_release	= single_release,
+};
+#else
+static const struct file_operations pd_proc_lat_fops = {
+	.owner		= THIS_MODULE,
+	.open		= pd_proc_lat_open,
+	.read		= seq_read,
+	.write		= pd_proc_lat_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif
 
 #else
 
@@ -1301,6 +1757,31 @@ static int pd_get_info (char *buf, char **start, off_t offset, int len)
 
 ///////////////////////////////////////////////////////////////////////////
 
+//
+// Maps a driver page (control page, change of state ring) read-only,
+// mprotect() can't make it writable later
+//
+static int pd_mmap_ro(struct vm_area_struct *vma, void *ptr, unsigned long size)
+{
+   int ret;
+
+   if (vma->vm_flags & VM_WRITE)
+      return -EPERM;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,3,0)
+   vm_flags_clear(vma, VM_MAYWRITE);
+#else
+   vma->vm_flags &= ~VM_MAYWRITE;
+#endif
+   vma->vm_pgoff = 0;
+
+   if ((ret = rvmmap(ptr, size, vma)) < 0)
+   {
+      DPRINTK_F("read-only rvmmap fails with %d\n", ret);
+      return ret;
+   }
+   return 0;
+}
+
 int pd_mmap(struct file *file, struct vm_area_struct *vma)
 {
    int real_minor, board, board_minor;
@@ -1322,6 +1803,15 @@ int pd_mmap(struct file *file, struct vm_area_struct *vma)
    DPRINTK_I("trying to mmap board %d, %s (minor %u)\n",
              board, pd_devices_by_minor[board_minor], real_minor);
 
+   // DIO-256 change of state ring, read-only
+   if ((board_minor == PD_MINOR_DIN) &&
+       ((vma->vm_pgoff << PAGE_SHIFT) == PD_COS_MMAP_OFFSET))
+   {
+      if (!pd_board[board].DinSS.pCosRing)
+         return -EIO;
+      return pd_mmap_ro(vma, pd_board[board].DinSS.pCosRing, sizeof(tCosRing));
+   }
+
    // now let's check - was ain or aout buffer allocated
    switch (board_minor)
    {
@@ -1348,10 +1838,23 @@ int pd_mmap(struct file *file, struct vm_area_struct *vma)
    if (!pDaqBuf)
       return -EFAULT;
 
+   // control page lives right after the data buffer and is read-only
+   if ((vma->vm_pgoff << PAGE_SHIFT) == PAGE_ALIGN(pDaqBuf->BufSizeInBytes))
+   {
+      if (!pDaqBuf->pCtrl)
+         return -EIO;
+      return pd_mmap_ro(vma, pDaqBuf->pCtrl, sizeof(tDaqBufCtrl));
+   }
+
    buf = pDaqBuf->databuf;
 
    // map it!
-   if ((ret = rvmmap(buf, pDaqBuf->BufSizeInBytes, vma)) < 0)
+   if (pDaqBuf->bContig)
+      ret = pd_mmap_contig_bigbuf(board, buf, pDaqBuf->BufSizeInBytes,
+                                  pDaqBuf->ContigHandle, vma);
+   else
+      ret = rvmmap(buf, pDaqBuf->BufSizeInBytes, vma);
+   if (ret < 0)
    {
       DPRINTK_F("rvmmap fails with %d\n", ret);
       return ret;
@@ -1383,6 +1886,9 @@ struct file_operations pd_fops =
    .release = pd_release, 
    .fsync =   NULL,
    .fasync =  pd_fasync,  
+#if !(defined(_PD_RTL) || defined(_PD_RTLPRO) || defined(_PD_RTAI) || defined(_PD_XENOMAI))
+   .poll =    pd_poll,
+#endif
 };
 
 
@@ -1426,22 +1932,17 @@ static int powerdaq_init(void)
 {
    struct pci_dev *dev = NULL;
    int i, j, ret;
+   int nclaimed = 0;
+   int ok[PD_MAX_BOARDS];
+   u64 start;
    
    PRINTK("PowerDAQ Driver %d.%d.%d, Copyright (C) 2000,2009 United Electronic Industries, Inc.\n",
           PD_VERSION_MAJOR, PD_VERSION_MINOR, PD_VERSION_EXTRA);
 
    num_pd_boards = 0;
-#if defined(_PD_RTL)
-   pthread_spin_init(&pd_fw_lock, 0);
-#elif defined(_PD_RTLPRO)
-   rtl_pthread_spin_init(&pd_fw_lock, 0);
-#elif defined(_PD_RTAI)
-   pd_fw_lock = SPIN_LOCK_UNLOCKED;
-#elif defined(_PD_XENOMAI)
-   pd_fw_lock = RTDM_LOCK_UNLOCKED;
-#else
-   pd_fw_lock = (spinlock_t)SPIN_LOCK_UNLOCKED;
-#endif
+   _brd_spin_init
+
+   start = pd_get_time_ns();
 
    // Enumerate all PCI devices equipped with a Motorola DSP56301 chip.
    // We use the sub-vendor id to determine if it is a UEI device.
@@ -1451,11 +1952,62 @@ static int powerdaq_init(void)
    while ((dev = pci_find_device(MOTOROLA_VENDORID, DSP56301_DEVICEID, dev)))
 #endif   
    {
-      deal_with_device(dev);
+      if (nclaimed == PD_MAX_BOARDS)
+      {
+         DPRINTK_F("more than %d boards found, skipping\n", PD_MAX_BOARDS);
+         break;
+      }
+      if (deal_with_device(dev, nclaimed))
+         nclaimed++;
+   }
+
+   // bring up the DSPs of all boards at once
+   pd_bringup_all(nclaimed, ok);
+
+   // Boards that failed leave a hole, move the following ones down so
+   // that board numbers stay contiguous. Nothing refers to the board
+   // structure by address yet (no IRQ, no synch objects).
+   for (i = 0; i < nclaimed; i++)
+   {
+      if (!ok[i])
+      {
+         iounmap(pd_board[i].address);
+         continue;
+      }
+
+      if (i != num_pd_boards)
+      {
+         memcpy(&pd_board[num_pd_boards], &pd_board[i], sizeof(pd_board_t));
+         _fw_spin_init(num_pd_boards)
+         pd_board[num_pd_boards].index = num_pd_boards;
+      }
+
+      if (!pd_setup_board(num_pd_boards))
+      {
+         iounmap(pd_board[num_pd_boards].address);
+         continue;
+      }
+
+      _brd_spinlock
+      num_pd_boards ++;
+      _brd_spinunlock
+   }
+
+   // where did the time go
+   for (i = 0; i < num_pd_boards; i++)
+   {
+      PRINTK("Board %d init: dsp startup %u us, board %u us, calibration %u us, setup %u us\n", i,
+             pd_ns_to_us(pd_board[i].InitTime[initDspStartup]),
+             pd_ns_to_us(pd_board[i].InitTime[initBoard]),
+             pd_ns_to_us(pd_board[i].InitTime[initCalibration]),
+             pd_ns_to_us(pd_board[i].InitTime[initSetup]));
    }
+   PRINTK("%d board(s) initialized in %u ms\n", num_pd_boards,
+          pd_ns_to_us(pd_get_time_ns() - start) / 1000);
 
    if (num_pd_boards == 0)
    {
+      pd_fw_cache_free();
       PRINTK("No PowerDAQ board was found\n");
       return -ENODEV;
    }
@@ -1554,6 +2106,7 @@ static int powerdaq_init(void)
    create_proc_info_entry("pwrdaq", 0, NULL, pd_get_info);
 #else
    proc_create("pwrdaq", 0, NULL, &pd_proc_fops);
+   proc_create("pwrdaq_latency", 0644, NULL, &pd_proc_lat_fops);
 #endif
 //#endif
 
@@ -1611,6 +2164,9 @@ static void powerdaq_cleanup(void)
       Mem.idx = AO_PAGE0;
       pd_dealloc_contig_memory(i, &Mem);
 
+      pd_bm_ring_free(i);
+      pd_dio256_cos_free(i);
+
       // free the IRQ
       if(rqstirq)
       {
@@ -1656,9 +2212,13 @@ static void powerdaq_cleanup(void)
    proc_unregister(&proc_root, pd_proc_entry.low_ino);
 #else
    remove_proc_entry("pwrdaq", NULL);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,26)
+   remove_proc_entry("pwrdaq_latency", NULL);
+#endif
 #endif
 
    unregister_chrdev(pd_major, "powerdaq");
+   pd_fw_cache_free();
    DPRINTK_N("PowerDAQ driver unloaded\n>\n>\n>\n");
 }
 
@@ -41,18 +41,36 @@ void pd_work_func(struct work_struct* work)
 void pd_bottom_half(void *data)
 {
    long board = (long)data;
+   PTBuf_Info pDaqBuf = &pd_board[board].AinSS.BufInfo;
+   u64 start;
+   u32 head;
 
    DPRINTK_T("i>bottom half got board %ld\n", board);
 
-   _fw_spinlock    // set spin lock
+   _fw_spinlock(board)    // set spin lock
+
+   start = pd_get_time_ns();
+   pd_lat_since(board, latBhSched, pd_board[board].LatBhQueued, start);
+   pd_board[board].LatBhQueued = 0;
+   head = pDaqBuf->Head;
+   if (pd_board[board].BmRing.Count)
+      pd_lat_add(board, latBmRingPages, pd_board[board].BmRing.Count);
    
    // check what happens and process events
    pd_process_events(board);
    
    // re-enable interrupts on this board
    pd_adapter_enable_interrupt(board, 1);
+
+   pd_lat_since(board, latBh, start, pd_get_time_ns());
+   if (pDaqBuf->MaxValues && (pDaqBuf->Head != head))
+      pd_lat_add(board, latBhWords, 
+                 (pDaqBuf->Head + pDaqBuf->MaxValues - head) % pDaqBuf->MaxValues);
    
-   _fw_spinunlock    // release spin lock
+   _fw_spinunlock(board)    // release spin lock
+
+   // wake up the waiters now that the lock is free
+   pd_event_flush(board);
 }
 
 #if defined(_PD_RTL)
@@ -165,6 +183,7 @@ void pd_rt_bottom_half(int board)
 int pd_isr_serve_board(int board)
 {
    tEvents Events;
+   u64 entry = pd_get_time_ns();
 
 #ifdef MEASURE_LATENCY
    asm volatile
@@ -181,7 +200,10 @@ int pd_isr_serve_board(int board)
       return 0;
    }
 
-   _fw_spinlock    // set spin lock
+   _fw_spinlock(board)    // set spin lock
+   pd_lat_since(board, latIsrPeriod, pd_board[board].LatIsrEntry, entry);
+   pd_board[board].LatIsrEntry = entry;
+
    // acknowledge the interrupt
    if (!pd_dsp_acknowledge_interrupt(board))
       DPRINTK_F("isr: board %d not responding\n", board);
@@ -198,7 +220,7 @@ int pd_isr_serve_board(int board)
          DPRINTK_N("i>: testing interrupts...\n");
       }
       // get out of here
-      _fw_spinunlock    // release spin lock
+      _fw_spinunlock(board)    // release spin lock
       return 1;
    }
 
@@ -221,7 +243,7 @@ int pd_isr_serve_board(int board)
          if (!pd_ain_flush_fifo(board, 1))
          {
             DPRINTK_T("i>isr: No samples in the FIFO, sorry\n");
-            _fw_spinunlock    // release spin lock
+            _fw_spinunlock(board)    // release spin lock
             return 1;
          } else
          {
@@ -230,6 +252,18 @@ int pd_isr_serve_board(int board)
       }
    }
 
+   // bus-master ring: take the completed pages now and let the board
+   // interrupt again, the bottom half catches up with the ring later.
+   // Nothing moved means other events, they wait for the bottom half.
+   if (pd_board[board].BmRing.Slots &&
+       (pd_board[board].AinSS.SubsysState == ssRunning) &&
+       ((pd_board[board].dwXFerMode == XFERMODE_BM) ||
+        (pd_board[board].dwXFerMode == XFERMODE_BM8WORD)))
+   {
+      if (pd_bm_ring_isr(board, entry) && !pd_board[board].BmRing.bOverrun)
+         pd_adapter_enable_interrupt(board, 1);
+   }
+
 #if defined(_PD_RTL) 
    // wake-up thread
    pthread_wakeup_np (rt_bh_thread[board]);
@@ -249,7 +283,15 @@ int pd_isr_serve_board(int board)
    rt_enable_irq(pd_board[board].irq);
 #else
    // schedule bottom half to run
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,5,0)
+   pd_board[board].LatBhQueued = pd_get_time_ns();
+   pd_lat_since(board, latIsr, entry, pd_board[board].LatBhQueued);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,36)
+   if (pd_board[board].bh_cpu >= 0)
+      queue_work_on(pd_board[board].bh_cpu, pd_board[board].bh_wq, 
+                    &pd_board[board].worker);
+   else
+      queue_work(pd_board[board].bh_wq, &pd_board[board].worker);
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(2,5,0)
    schedule_work(&pd_board[board].worker);
 #else
    pd_board[board].worker.data = (void*)board;
@@ -259,7 +301,7 @@ int pd_isr_serve_board(int board)
 #endif
    //DPRINTK_T("i>isr: DPC is scheduled!\n");
 
-   _fw_spinunlock    // release spin lock
+   _fw_spinunlock(board)    // release spin lock
 
    return 1;
 }
@@ -482,10 +524,27 @@ int pd_driver_request_irq(int board, tPdIrqHandler handler)
 #else
     unsigned long flags =  SA_SHIRQ | SA_INTERRUPT;
 #endif
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,36)
+   // Bottom half gets its own high priority workqueue instead of
+   // waiting behind unrelated work on the system one
+   pd_board[board].bh_wq = alloc_workqueue("pwrdaq%d", WQ_HIGHPRI | WQ_MEM_RECLAIM,
+                                           1, board);
+   if (!pd_board[board].bh_wq)
+   {
+      DPRINTK_F("pd_driver_request_irq: can't create workqueue\n");
+      return -ENOMEM;
+   }
+#endif
+
    if ((ret = request_irq(pd_board[board].irq, pd_isr,
                    flags, "PowerDAQ",
                    (void *)&pd_board[board])))
    {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,36)
+      destroy_workqueue(pd_board[board].bh_wq);
+      pd_board[board].bh_wq = NULL;
+#endif
       return ret;
    }
    
@@ -537,8 +596,44 @@ int pd_driver_release_irq(int board)
    rt_sem_delete (&rt_bh_sem[board]);
 #else
    free_irq(pd_board[board].irq, (void *)&pd_board[board]);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,36)
+   // waits for a pending bottom half to complete
+   if (pd_board[board].bh_wq)
+      destroy_workqueue(pd_board[board].bh_wq);
+   pd_board[board].bh_wq = NULL;
+#endif
 #endif
   
    return 0;
 }
 
+////////////////////////////////////////////////////////////////////////
+//
+//       NAME:  pd_driver_set_bh_cpu
+//
+//   FUNCTION:  Pins the bottom half of the board to a CPU.
+//
+//  ARGUMENTS:  The board and the CPU number, -1 lets it run on the
+//              CPU that took the interrupt.
+//
+//    RETURNS:  0 or -EINVAL if the CPU is not online, -ENOSYS when
+//              the bottom half is not a Linux workqueue.
+//
+int pd_driver_set_bh_cpu(int board, int cpu)
+{
+#if defined(_PD_RTL) || defined(_PD_RTLPRO) || defined(_PD_RTAI) || \
+    (LINUX_VERSION_CODE < KERNEL_VERSION(2,6,36))
+   return -ENOSYS;
+#else
+   if (cpu < 0)
+      cpu = -1;
+   else if ((cpu >= nr_cpu_ids) || !cpu_online(cpu))
+      return -EINVAL;
+
+   pd_board[board].bh_cpu = cpu;
+   DPRINTK_N("board %d bottom half runs on CPU %d\n", board, cpu);
+
+   return 0;
+#endif
+}
+
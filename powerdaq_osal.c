@@ -122,6 +122,51 @@ void pd_free_bigbuf(void* mem, u32 size)
    rvfree(mem, size);
 }
 
+//-------------------------------------------------------------------
+// Physically contiguous DAQ buffer (BUF_CONTIGUOUS). The memory comes
+// from the DMA allocator (CMA when the kernel has it) and sits in the
+// linear mapping, which the kernel covers with huge pages, so the
+// bottom half copies into it without per-page TLB misses.
+// Returns NULL if it can't be had, caller falls back to pd_alloc_bigbuf
+void* pd_alloc_contig_bigbuf(int board, u32 size, dma_addr_t* pHandle)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3,6,0)
+   void* mem;
+
+   if (!pd_board[board].dev)
+      return NULL;
+
+   size = PAGE_ALIGN(size);
+   mem = dma_alloc_coherent(&pd_board[board].dev->dev, size, pHandle,
+                            GFP_KERNEL | __GFP_NOWARN);
+   if (mem)
+      memset(mem, 0, size);
+   return mem;
+#else
+   return NULL;
+#endif
+}
+
+void pd_free_contig_bigbuf(int board, void* mem, u32 size, dma_addr_t handle)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3,6,0)
+   if (mem)
+      dma_free_coherent(&pd_board[board].dev->dev, PAGE_ALIGN(size), mem, handle);
+#endif
+}
+
+int pd_mmap_contig_bigbuf(int board, void* mem, u32 size, dma_addr_t handle,
+                          struct vm_area_struct *vma)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3,6,0)
+   // one call maps the whole range, vm_pgoff is the offset in the buffer
+   return dma_mmap_coherent(&pd_board[board].dev->dev, vma, mem, handle,
+                            PAGE_ALIGN(size));
+#else
+   return -ENOSYS;
+#endif
+}
+
 //--------------------------------------------------------------------
 void* pd_kmalloc(u32 size, u32 priority)
 {
@@ -133,6 +178,79 @@ void pd_kfree(void* adr)
    kfree(adr);
 }
 
+//--------------------------------------------------------------------
+// Firmware files. request_firmware() needs a process context and the
+// firmware class, neither exists on RTLinux Pro and before 2.6.
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,0)) && !defined(_PD_RTLPRO)
+#define PD_HAS_FW_LOADER
+#endif
+
+#if defined(PD_HAS_FW_LOADER) && (LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,16))
+static DEFINE_MUTEX(pd_fw_mutex);
+#elif defined(PD_HAS_FW_LOADER)
+static DECLARE_MUTEX(pd_fw_sem);
+#endif
+
+// Loads a firmware file and returns a pd_kmalloc'ed copy of it in
+// *ppData, to be freed with pd_kfree(). Returns 0 or -errno.
+// bQuiet is set when the caller has a fallback for a missing file, the
+// kernel then doesn't log the failed lookup where it allows it.
+int pd_request_firmware(int board, const char* name, void** ppData, u32* pSize, int bQuiet)
+{
+#if defined(PD_HAS_FW_LOADER)
+   const struct firmware *fw;
+   int ret;
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,18,0)
+   if (bQuiet)
+      ret = firmware_request_nowarn(&fw, name, &pd_board[board].dev->dev);
+   else
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(3,14,0)
+   if (bQuiet)
+      ret = request_firmware_direct(&fw, name, &pd_board[board].dev->dev);
+   else
+#endif
+   ret = request_firmware(&fw, name, &pd_board[board].dev->dev);
+   if (ret)
+      return ret;
+
+   *ppData = pd_kmalloc(fw->size, GFP_KERNEL);
+   if (*ppData)
+   {
+      memcpy(*ppData, fw->data, fw->size);
+      *pSize = fw->size;
+   }
+   else
+   {
+      ret = -ENOMEM;
+   }
+
+   release_firmware(fw);
+   return ret;
+#else
+   return -ENOSYS;
+#endif
+}
+
+// Serializes the firmware cache fill between concurrent board bring-ups
+void pd_fw_cache_lock(void)
+{
+#if defined(PD_HAS_FW_LOADER) && (LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,16))
+   mutex_lock(&pd_fw_mutex);
+#elif defined(PD_HAS_FW_LOADER)
+   down(&pd_fw_sem);
+#endif
+}
+
+void pd_fw_cache_unlock(void)
+{
+#if defined(PD_HAS_FW_LOADER) && (LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,16))
+   mutex_unlock(&pd_fw_mutex);
+#elif defined(PD_HAS_FW_LOADER)
+   up(&pd_fw_sem);
+#endif
+}
+
 //--------------------------------------------------------------------
 unsigned int pd_readl(void *address)
 {
@@ -145,6 +263,187 @@ void pd_writel(unsigned int value, void *address)
    writel(value, address);
 }
 
+//--------------------------------------------------------------------
+// Writes count words back to back to the same register (the way
+// iowrite32_rep() does).
+void pd_writel_rep32(void *address, const u32 *buf, u32 count)
+{
+   while (count--)
+      writel(*(buf++), address);
+}
+
+//--------------------------------------------------------------------
+// Reads count words back to back from the same register (the way
+// ioread32_rep() does) and stores their low 16 bits.
+void pd_readl_rep16(void *address, u16 *buf, u32 count)
+{
+   while (count--)
+      *(buf++) = (u16)readl(address);
+}
+
+// Same as pd_readl_rep16() but stops at the terminator word, which is
+// not stored. Returns the number of words stored, *pbTerm tells whether
+// the terminator was read.
+u32 pd_readl_rep16_term(void *address, u16 *buf, u32 count, u32 term, int *pbTerm)
+{
+   u32 i, val;
+
+   *pbTerm = 0;
+   for (i = 0; i < count; i++)
+   {
+      val = readl(address);
+      if (val == term)
+      {
+         *pbTerm = 1;
+         break;
+      }
+      buf[i] = (u16)val;
+   }
+
+   return i;
+}
+
+//--------------------------------------------------------------------
+// Publishes DAQ buffer state to the control page shared with user space.
+// Seq is odd while the page is updated, readers retry in that case.
+// Must be called with the board spinlock held.
+void pd_daqbuf_ctrl_publish(PTBuf_Info pDaqBuf, u32 SubsysState, u32 Events)
+{
+   tDaqBufCtrl *pCtrl = pDaqBuf->pCtrl;
+   u64 ts;
+
+   if (!pCtrl)
+      return;
+
+   ts = pd_get_time_ns();
+
+   pCtrl->Seq++;
+   smp_wmb();
+
+   pCtrl->Head = pDaqBuf->Head;
+   pCtrl->Tail = pDaqBuf->Tail;
+   pCtrl->Count = pDaqBuf->Count;
+   pCtrl->WrapCount = pDaqBuf->WrapCount;
+   pCtrl->ScanIndex = pDaqBuf->ScanIndex;
+   pCtrl->SubsysState = SubsysState;
+   pCtrl->Events = Events;
+   pCtrl->TimestampLow = (u32)ts;
+   pCtrl->TimestampHigh = (u32)(ts >> 32);
+   pCtrl->MaxValues = pDaqBuf->MaxValues;
+   pCtrl->ScanValues = pDaqBuf->ScanValues;
+   pCtrl->FrameValues = pDaqBuf->FrameValues;
+   pCtrl->GapCount = pDaqBuf->GapLog.Num;
+   pCtrl->StampCount = pDaqBuf->StampCount;
+
+   smp_wmb();
+   pCtrl->Seq++;
+}
+
+//--------------------------------------------------------------------
+// Logs a frame completion in the stamp ring of the control page. The
+// entry is invalidated before it is rewritten, so a reader that sees
+// the same Seq before and after copying it got a consistent entry.
+// FirstTimestamp/LastTimestamp keep the first and last stamp in us.
+void pd_daqbuf_ctrl_stamp(PTBuf_Info pDaqBuf, u64 Now)
+{
+   tDaqBufCtrl *pCtrl = pDaqBuf->pCtrl;
+   tFrameStamp *pStamp;
+   u64 index, us;
+   u32 n = pDaqBuf->StampCount;
+
+   // no clock, nothing to align against
+   if (!Now)
+      return;
+
+   us = Now;
+   do_div(us, 1000);
+   if (!n)
+      pDaqBuf->FirstTimestamp = (u32)us;
+   pDaqBuf->LastTimestamp = (u32)us;
+   pDaqBuf->StampCount = n + 1;
+
+   if (!pCtrl)
+      return;
+
+   index = (u64)pDaqBuf->WrapCount * pDaqBuf->MaxValues + pDaqBuf->Head;
+   pStamp = &pCtrl->Stamp[n % PD_FRAMESTAMP_RING_SIZE];
+
+   pStamp->Seq = PD_FRAMESTAMP_INVALID;
+   smp_wmb();
+
+   pStamp->ValueIndexLow = (u32)index;
+   pStamp->ValueIndexHigh = (u32)(index >> 32);
+   pStamp->TimestampLow = (u32)Now;
+   pStamp->TimestampHigh = (u32)(Now >> 32);
+
+   smp_wmb();
+   pStamp->Seq = n;
+   smp_wmb();
+   pCtrl->StampCount = n + 1;
+}
+
+
+//--------------------------------------------------------------------
+// Monotonic time in ns, 0 where there is no such clock (RT kernels)
+u64 pd_get_time_ns(void)
+{
+#if defined(_PD_RTL) || defined(_PD_RTLPRO) || defined(_PD_RTAI)
+   return 0;
+#elif defined(_PD_XENOMAI)
+   // called from the RTDM ISR and RT tasks, the Linux timekeeper isn't safe there
+   return rtdm_clock_read_monotonic();
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(3,17,0)
+   return ktime_get_ns();
+#else
+   struct timespec tspec;
+   ktime_get_ts(&tspec);
+   return (u64)tspec.tv_sec * 1000000000 + tspec.tv_nsec;
+#endif
+}
+
+//--------------------------------------------------------------------
+// Latency histograms. Callers hold the board lock.
+void pd_lat_add(int board, int hist, u32 value)
+{
+   TLatHist *pHist = &pd_board[board].LatHist[hist];
+
+   pHist->Count++;
+   pHist->Sum += value;
+   if (value > pHist->Max)
+      pHist->Max = value;
+   pHist->Bucket[value ? fls(value) - 1 : 0]++;
+}
+
+void pd_lat_since(int board, int hist, u64 start, u64 now)
+{
+   u64 delta;
+
+   if (!start || (now < start))
+      return;
+
+   delta = now - start;
+   pd_lat_add(board, hist, (delta > 0xFFFFFFFF) ? 0xFFFFFFFF : (u32)delta);
+}
+
+void pd_lat_reset(int board)
+{
+   memset(pd_board[board].LatHist, 0, sizeof(pd_board[board].LatHist));
+   pd_board[board].LatIsrEntry = 0;
+   pd_board[board].LatBhQueued = 0;
+}
+
+#if defined(_PD_XENOMAI)
+//--------------------------------------------------------------------
+// Runs on the Linux side once pd_event_flush() pended the board's nrtSig
+static void pd_event_nrtsig(rtdm_nrtsig_t nrt_sig, void *arg)
+{
+   int board = (int)(long)arg;
+   int i;
+
+   for (i = 0; i < pd_board_ext[board].synchCount; i++)
+      wake_up_interruptible(&pd_board_ext[board].synch[i].wait_q);
+}
+#endif
 
 //--------------------------------------------------------------------
 int pd_event_create(int board, TSynchSS **synch)
@@ -154,6 +453,23 @@ int pd_event_create(int board, TSynchSS **synch)
 
    *synch = NULL;
 
+#if defined(_PD_XENOMAI)
+   // synch objects are preallocated in the board extension, nothing is
+   // allocated or freed on the real-time side
+   if (pd_board_ext[board].synchCount >= PD_MAX_SUBSYSTEMS)
+   {
+      DPRINTK_T("No synch object left for board %d.\n", board);
+      return -ENOMEM;
+   }
+   if (pd_board_ext[board].synchCount == 0)
+   {
+      ret = rtdm_nrtsig_init(&pd_board_ext[board].nrtSig, pd_event_nrtsig,
+                             (void *)(long)board);
+      if (ret < 0)
+         return ret;
+   }
+   pSynch = &pd_board_ext[board].synch[pd_board_ext[board].synchCount++];
+#else
    // allocates memory for the synchronization data structure
    pSynch = (TSynchSS *) pd_kmalloc(sizeof(TSynchSS), GFP_KERNEL);
    if (pSynch == NULL)
@@ -161,6 +477,7 @@ int pd_event_create(int board, TSynchSS **synch)
       DPRINTK_T("Could not allocate memory for the synch object.\n");
       return -ENOMEM;
    }
+#endif
 
    memset(pSynch, 0, sizeof(TSynchSS));
 
@@ -198,6 +515,10 @@ int pd_event_create(int board, TSynchSS **synch)
    // Initializes the mutex that protects access to the condition
    rt_mutex_init(&(pSynch->event_lock));
    ret = 0;
+#elif defined(_PD_XENOMAI)
+   rtdm_event_init(&(pSynch->event), 0);
+   init_waitqueue_head(&(pSynch->wait_q));
+   ret = 0;
 #else
    ret = 0;
 #if LINUX_VERSION_CODE < KERNEL_VERSION(2,4,0)
@@ -314,6 +635,43 @@ int pd_event_wait(int board, TSynchSS *synch, int timeoutms)
       tret = 1;
 
    rt_mutex_unlock(&synch->event_lock);
+#elif defined(_PD_XENOMAI)
+   rtdm_toseq_t toseq;
+   nanosecs_rel_t timeout = (nanosecs_rel_t)(timeoutms ? timeoutms : 1) * 1000000;
+
+   tret = 1;
+   if (rtdm_in_rt_context())
+   {
+      // the event may still be pending from a signal that was already
+      // consumed, so wait until events are really there
+      rtdm_toseq_init(&toseq, timeout);
+      while (!synch->notifiedEvents)
+      {
+         tret = rtdm_event_timedwait(&synch->event, timeout, &toseq);
+         if (tret < 0)
+            break;
+         tret = 1;
+      }
+   }
+   else
+   {
+      // Linux callers (ioctl_nrt, read_nrt) can't block on the rtdm_event,
+      // they sleep on wait_q that pd_event_nrtsig() wakes
+      wait_queue_t wait;
+
+      tret = (timeoutms * HZ + 999)/1000 + 1;
+      init_waitqueue_entry(&wait, current);
+      add_wait_queue(&synch->wait_q, &wait);
+      while (tret > 0 && !signal_pending(current))
+      {
+         set_current_state(TASK_INTERRUPTIBLE);
+         if (synch->notifiedEvents != 0)
+            break;
+         tret = schedule_timeout(tret);
+      }
+      set_current_state(TASK_RUNNING);
+      remove_wait_queue(&synch->wait_q, &wait);
+   }
 #else
    int toutjiffies;
    wait_queue_t wait;
@@ -355,7 +713,13 @@ int pd_event_signal(int board, TSynchSS *synch)
    rtl_sem_post(&synch->event);
 #elif defined(_PD_RTAI)
    rt_cond_signal(&synch->event);
+#elif defined(_PD_XENOMAI)
+   // callers hold the board lock, an RT waiter woken now would spin on
+   // it: the event is signaled by pd_event_flush() after the unlock
+   synch->signalTime = pd_get_time_ns();
+   synch->bSignal = TRUE;
 #else
+   synch->signalTime = pd_get_time_ns();
    wake_up_interruptible(&synch->wait_q);
 #endif // _PD_RTL
 
@@ -372,14 +736,59 @@ int pd_event_destroy(int board, TSynchSS *synch)
 #elif defined(_PD_RTAI)
    rt_cond_destroy(&synch->event);
    rt_mutex_destroy(&synch->event_lock);
+#elif defined(_PD_XENOMAI)
+   rtdm_event_destroy(&synch->event);
 #endif
 
+#if defined(_PD_XENOMAI)
+   // the synch object goes back to the board extension
+   if (pd_board_ext[board].synchCount > 0)
+   {
+      pd_board_ext[board].synchCount--;
+      if (pd_board_ext[board].synchCount == 0)
+         rtdm_nrtsig_destroy(&pd_board_ext[board].nrtSig);
+   }
+#else
    // free up the memory allocated for the synch object
    pd_kfree(synch);
+#endif
 
    return 0;
 }
 
+//
+// Signals the events that pd_event_signal() left pending while the board
+// lock was held. Called without the lock, only does something on Xenomai.
+//
+void pd_event_flush(int board)
+{
+#if defined(_PD_XENOMAI)
+   TSynchSS *synch;
+   int i, signal, nrt = 0;
+
+   for (i = 0; i < pd_board_ext[board].synchCount; i++)
+   {
+      synch = &pd_board_ext[board].synch[i];
+
+      _fw_spinlock(board)
+      signal = synch->bSignal;
+      synch->bSignal = FALSE;
+      _fw_spinunlock(board)
+
+      if (signal)
+      {
+         rtdm_event_signal(&synch->event);
+         nrt = 1;
+      }
+   }
+
+   // Linux waiters are woken from the Linux side, this may run in the
+   // RT domain
+   if (nrt)
+      rtdm_nrtsig_pend(&pd_board_ext[board].nrtSig);
+#endif
+}
+
 int pd_register_user_isr(int board, TUser_isr user_isr, void* user_param)
 {
 #if defined(_PD_RTL)
@@ -499,6 +908,137 @@ CLEANUP:
    return status;
 }
 
+//////////////////////////////////////////////////////////////////////////
+//
+// Routine Description:
+//
+//    Allocates the AIn bus-master ring (bm_ring=N): Slots slots of
+//    SlotValues values each, see pdfw_lib/pdl_bmring.c. Without it the
+//    board works with its two bus-master pages only.
+//
+//////////////////////////////////////////////////////////////////////////
+int pd_bm_ring_alloc(int board, u32 Slots, u32 SlotValues)
+{
+   TBmRing* pRing = &pd_board[board].BmRing;
+   u32 i;
+
+   if (Slots > PD_BM_RING_MAX)
+      Slots = PD_BM_RING_MAX;
+   if (!Slots || !SlotValues)
+      return -EINVAL;
+
+   pRing->pSlot = (TBmSlot*)pd_kmalloc(Slots * sizeof(TBmSlot), GFP_KERNEL);
+   pRing->pData = (u32*)pd_alloc_bigbuf(Slots * SlotValues * sizeof(u32));
+   if (!pRing->pSlot || !pRing->pData)
+   {
+      pRing->Slots = Slots;
+      pRing->SlotValues = SlotValues;
+      pd_bm_ring_free(board);
+      return -ENOMEM;
+   }
+
+   for (i = 0; i < Slots; i++)
+   {
+      pRing->pSlot[i].pValues = pRing->pData + i * SlotValues;
+      pRing->pSlot[i].Values = 0;
+      pRing->pSlot[i].Time = 0;
+   }
+
+   pRing->SlotValues = SlotValues;
+   pRing->Put = pRing->Get = pRing->Count = 0;
+   pRing->bOverrun = FALSE;
+   pRing->Slots = Slots;
+
+   DPRINTK("Bus-master ring: %d slots of %d values\n", Slots, SlotValues);
+
+   return 0;
+}
+
+void pd_bm_ring_free(int board)
+{
+   TBmRing* pRing = &pd_board[board].BmRing;
+
+   if (pRing->pData)
+      pd_free_bigbuf(pRing->pData, pRing->Slots * pRing->SlotValues * sizeof(u32));
+   if (pRing->pSlot)
+      pd_kfree(pRing->pSlot);
+
+   memset(pRing, 0, sizeof(TBmRing));
+}
+
+//////////////////////////////////////////////////////////////////////////
+//
+// Routine Description:
+//
+//    Allocates the DIO-256 change of state ring the first time it is
+//    needed, see pd_dio256_cos_start. It stays allocated, possibly mapped
+//    by an application, until the module is unloaded.
+//    Must be called without the board spinlock held.
+//
+//////////////////////////////////////////////////////////////////////////
+int pd_dio256_cos_alloc(int board)
+{
+   tCosRing* pRing;
+
+   if (pd_board[board].DinSS.pCosRing)
+      return 0;
+
+   pRing = (tCosRing*)pd_alloc_bigbuf(sizeof(tCosRing));
+   if (!pRing)
+      return -ENOMEM;
+   memset(pRing, 0, sizeof(tCosRing));
+
+   // another caller may have been faster
+   _fw_spinlock(board)
+   if (!pd_board[board].DinSS.pCosRing)
+   {
+      pd_board[board].DinSS.pCosRing = pRing;
+      pRing = NULL;
+   }
+   _fw_spinunlock(board)
+
+   if (pRing)
+      pd_free_bigbuf(pRing, sizeof(tCosRing));
+
+   return 0;
+}
+
+void pd_dio256_cos_free(int board)
+{
+   if (pd_board[board].DinSS.pCosRing)
+      pd_free_bigbuf(pd_board[board].DinSS.pCosRing, sizeof(tCosRing));
+   pd_board[board].DinSS.pCosRing = NULL;
+   pd_board[board].DinSS.bCosRunning = FALSE;
+}
+
+//--------------------------------------------------------------------
+// Logs a DIn interrupt in the change of state ring. Same protocol as
+// the frame stamps: the record is invalidated before it is rewritten,
+// a reader that sees the same Seq before and after copying it got a
+// consistent record.
+// Must be called with the board spinlock held.
+void pd_dio256_cos_put(int board, u64 Now, u32* pIntData, u32* pEdgeData)
+{
+   tCosRing *pRing = pd_board[board].DinSS.pCosRing;
+   tCosRecord *pRec;
+   u32 n = pRing->Count;
+
+   pRec = &pRing->Rec[n % PD_COS_RING_SIZE];
+
+   pRec->Seq = PD_COS_INVALID;
+   smp_wmb();
+
+   pRec->TimestampLow = (u32)Now;
+   pRec->TimestampHigh = (u32)(Now >> 32);
+   memcpy(pRec->IntData, pIntData, sizeof(pRec->IntData));
+   memcpy(pRec->EdgeData, pEdgeData, sizeof(pRec->EdgeData));
+
+   smp_wmb();
+   pRec->Seq = n;
+   smp_wmb();
+   pRing->Count = n + 1;
+}
+
 //////////////////////////////////////////////////////////////////////////
 //
 // Routine Description:
@@ -587,10 +1127,27 @@ TSynchSS* pd_get_synch(int board, PD_SUBSYSTEM ss, int event)
 }
 
 
+//
+// Records in latWakeup how long a waiter that got its events took to run
+// after pd_event_signal(). Called with the board lock held, signalTime is
+// written by the bottom half under the same lock.
+//
+static void pd_event_note_wakeup(int board, TSynchSS *synch, u64 now)
+{
+#if !(defined(_PD_RTL) || defined(_PD_RTLPRO) || defined(_PD_RTAI))
+   if (synch->notifiedEvents && synch->signalTime)
+   {
+      pd_lat_since(board, latWakeup, synch->signalTime, now);
+      synch->signalTime = 0;
+   }
+#endif
+}
+
 int pd_sleep_on_event(int board, PD_SUBSYSTEM ss, int event, int timeoutms)
 {
    int tret, everet;
    TSynchSS *synch;
+   u64 now;
 
    tret = everet = 0;
 
@@ -603,9 +1160,12 @@ int pd_sleep_on_event(int board, PD_SUBSYSTEM ss, int event, int timeoutms)
       synch->wakeupEvents = event;
 
       // unlock the spin lock so that we don't deadlock when the event occurs
-      _fw_spinunlock
+      _fw_spinunlock(board)
       tret = pd_event_wait(board, synch, timeoutms);
-      _fw_spinlock
+      now = pd_get_time_ns();
+      _fw_spinlock(board)
+
+      pd_event_note_wakeup(board, synch, now);
 
       everet = synch->notifiedEvents;
       synch->notifiedEvents = 0;
@@ -623,9 +1183,81 @@ int pd_sleep_on_event(int board, PD_SUBSYSTEM ss, int event, int timeoutms)
 }
 
 //
-// This function awakes a process
+// This function waits for the events subscribed with
+// IOCTL_PWRDAQ_SUBSCRIBE_EVENTS and hands over, all at once, the events
+// and counts accumulated since the last wait
+//
+int pd_wait_events(int board, PD_SUBSYSTEM ss, tEventWait* pWait)
+{
+   TSynchSS *synch;
+   int tret = 1;
+   u64 now;
+
+   synch = pd_get_synch(board, ss, pWait->Events);
+   if (NULL == synch)
+      return -EINVAL;
+
+   // events that came in since the last wait are returned right away
+   if (!synch->notifiedEvents)
+   {
+      synch->wakeupEvents = pWait->Events;
+
+      // unlock the spin lock so that we don't deadlock when the event occurs
+      _fw_spinunlock(board)
+      tret = pd_event_wait(board, synch, pWait->Timeout);
+      now = pd_get_time_ns();
+      _fw_spinlock(board)
+
+      pd_event_note_wakeup(board, synch, now);
+   }
+
+   pWait->Events = synch->notifiedEvents;
+   memcpy(pWait->Count, synch->eventCount, sizeof(pWait->Count));
+   synch->notifiedEvents = 0;
+   memset(synch->eventCount, 0, sizeof(synch->eventCount));
+
+   if (tret <= 0)
+      pWait->Events |= eTimeout;
+
+   return 0;
+}
+
+//
+// Records events for pd_notify_event: persistent events add up until
+// pd_wait_events takes them, the others replace the previous ones.
+// eFrameDone and eDataAvailable count the frames and transfers they
+// stand for, the other events count once.
+//
+static void pd_post_event(TSynchSS *synch, u32 persist, int event, u32 frames, u32 data)
+{
+   int n;
+
+   if (persist)
+   {
+      synch->notifiedEvents |= event;
+      for (n = 0; n < PD_EVENT_COUNTERS; n++)
+      {
+         if (!(event & (1 << n)))
+            continue;
+         if (((1 << n) == eFrameDone) && frames)
+            synch->eventCount[n] += frames;
+         else if (((1 << n) == eDataAvailable) && data)
+            synch->eventCount[n] += data;
+         else
+            synch->eventCount[n]++;
+      }
+   }
+   else
+   {
+      synch->notifiedEvents = event;
+   }
+}
+
+//
+// This function awakes a process. frames and data are the number of
+// eFrameDone and eDataAvailable occurrences in event, 0 if only one.
 //
-int pd_notify_event(int board, PD_SUBSYSTEM ss, int event)
+int pd_notify_event(int board, PD_SUBSYSTEM ss, int event, u32 frames, u32 data)
 {
    DPRINTK_N("wake up!: brd:%d ss:%d evt:%x\n",
              board, ss, event);
@@ -633,28 +1265,28 @@ int pd_notify_event(int board, PD_SUBSYSTEM ss, int event)
    switch (ss)
    {
    case AnalogIn:
-      pd_board[board].AinSS.synch->notifiedEvents = event;
+      pd_post_event(pd_board[board].AinSS.synch, pd_board[board].AinSS.dwEventsPersist, event, frames, data);
       pd_event_signal(board, pd_board[board].AinSS.synch);
       break;
 
    case AnalogOut:
-      pd_board[board].AoutSS.synch->notifiedEvents = event;
+      pd_post_event(pd_board[board].AoutSS.synch, pd_board[board].AoutSS.dwEventsPersist, event, frames, data);
       pd_event_signal(board, pd_board[board].AoutSS.synch);
       break;
 
    case DigitalIn:
-      pd_board[board].DinSS.synch->notifiedEvents = event;
+      pd_post_event(pd_board[board].DinSS.synch, pd_board[board].DinSS.dwEventsPersist, event, frames, data);
       pd_event_signal(board, pd_board[board].DinSS.synch);
       break;
 
    case DigitalOut:
-      pd_board[board].DoutSS.synch->notifiedEvents = event;
+      pd_post_event(pd_board[board].DoutSS.synch, pd_board[board].DoutSS.dwEventsPersist, event, frames, data);
       pd_event_signal(board, pd_board[board].DoutSS.synch);
       break;
 
    case CounterTimer:
    case DSPCounter:
-      pd_board[board].UctSS.synch->notifiedEvents = event;
+      pd_post_event(pd_board[board].UctSS.synch, pd_board[board].UctSS.dwEventsPersist, event, frames, data);
       pd_event_signal(board, pd_board[board].UctSS.synch);
       break;
 
@@ -792,6 +1424,12 @@ int pd_driver_close(int board, int minor)
          pd_board[board].DinSS.bInUse = FALSE;
          pd_board[board].fd[DigitalIn] = 0;
       }
+      if (pd_board[board].DinSS.bCosRunning)
+      {
+         _fw_spinlock(board)
+         pd_dio256_cos_stop(board);
+         _fw_spinunlock(board)
+      }
       break;
 
    case PD_MINOR_DOUT:
@@ -825,6 +1463,8 @@ int pd_driver_close(int board, int minor)
    DPRINTK_I("pd_driver_close: open count = %d\n", pd_board[board].open);
    if (!pd_board[board].open)
    {
+      pd_board[board].AinSS.dwEventsPoll = 0;
+      pd_board[board].AoutSS.dwEventsPoll = 0;
       pd_board[board].AinSS.bInUse = FALSE;
       pd_board[board].AoutSS.bInUse = FALSE;
       pd_board[board].DinSS.bInUse = FALSE;
@@ -835,39 +1475,282 @@ int pd_driver_close(int board, int minor)
    return 0;
 }
 
+// Interval at which blocked readers/writers recheck the buffer state.
+// Events are re-armed on each pass, so a missed notification costs at
+// most one interval.
+#define PD_RW_WAIT_MS   100
 
-int pd_driver_ioctl(int board, int board_minor, int command, tCmd* argcmd)
+// RTDM tasks call in from primary mode, their buffers are accessed with
+// rtdm_copy_to_user()/rtdm_copy_from_user() instead of the Linux helpers
+static unsigned long pd_rw_copy_to_user(pd_user_info_t* user_info, u8* to, u8* from, u32 len)
 {
-   int ret;
-   PD_SUBSYSTEM ss;
-   int retf = -ENODEV;
-   int i;
-   unsigned long id;
+#if defined(_PD_XENOMAI)
+   if (user_info)
+      return rtdm_copy_to_user(user_info, to, from, len);
+#endif
+   return pd_copy_to_user8(to, from, len);
+}
 
-   if (board_minor == PD_MINOR_AIN)
-      ss = AnalogIn;
-   else if (board_minor == PD_MINOR_AOUT)
-      ss = AnalogOut;
-   else if (board_minor == PD_MINOR_DIN)
-      ss = DigitalIn;
-   else if (board_minor == PD_MINOR_DOUT)
-      ss = DigitalOut;
-   else if (board_minor == PD_MINOR_UCT)
-      ss = CounterTimer;
-   else if (board_minor == PD_MINOR_DSPCT)
-      ss = DSPCounter;
-   else if (board_minor == PD_MINOR_DRV)
-      ss = BoardLevel;
-   else
-      ss = BoardLevel;
+static unsigned long pd_rw_copy_from_user(pd_user_info_t* user_info, u8* to, u8* from, u32 len)
+{
+#if defined(_PD_XENOMAI)
+   if (user_info)
+      return rtdm_copy_from_user(user_info, to, from, len);
+#endif
+   return pd_copy_from_user8(to, from, len);
+}
+
+//
+// Function:    pd_driver_read
+//
+// Parameters:  int board
+//              int minor       -- PD_MINOR_AIN, PD_MINOR_DIN or PD_MINOR_UCT
+//              char* buffer    -- user buffer
+//              u32 count       -- size of the user buffer in bytes
+//              int flags       -- PD_RW_NONBLOCK: don't sleep if no scans
+//                                 are available
+//                                 PD_RW_KERNEL: buffer is in kernel space
+//              pd_user_info_t* user_info -- RTDM caller, NULL otherwise
+//
+// Returns:     number of bytes copied, 0 at the end of a stopped
+//              acquisition or negative error code
+//
+// Description: Drains whole scans from the DAQ buffer registered on the
+//              input subsystems. Scans are obtained with pd_ain_get_scans()
+//              exactly as the DLL does it with the mmap'ed buffer, so the
+//              frames copied by one call are released on the next one.
+//
+// Notes:       The DAQ buffer is shared by AIn, DIn and UCT, so all input
+//              minors wait on the AIn synchronization object.
+//
+int pd_driver_read(int board, int minor, char* buffer, u32 count, int flags,
+                   pd_user_info_t* user_info)
+{
+   PTBuf_Info pDaqBuf = &pd_board[board].AinSS.BufInfo;
+   tScanInfo ScanInfo;
+   u32 ScanBytes, Bytes, Armed;
+   u8* pSrc;
+   int copied = 0;
+
+   if ((minor != PD_MINOR_AIN) && (minor != PD_MINOR_DIN) && (minor != PD_MINOR_UCT))
+      return -ENODEV;
+
+   _fw_spinlock(board)
+
+   while (1)
+   {
+      if (!pDaqBuf->databuf || !pDaqBuf->ScanValues)
+      {
+         _fw_spinunlock(board)
+         return (copied) ? copied : -EINVAL;
+      }
+
+      // only whole scans are transferred
+      ScanBytes = pDaqBuf->ScanValues * pDaqBuf->SampleSize;
+      if (count - copied < ScanBytes)
+      {
+         if (!copied)
+            copied = -EINVAL;
+         break;
+      }
+
+      ScanInfo.NumScans = (count - copied) / ScanBytes;
+      pd_ain_get_scans(board, &ScanInfo);
+
+      if (ScanInfo.NumValidScans == 0)
+      {
+         if (copied || (pd_board[board].AinSS.SubsysState == ssStopped))
+            break;
+
+         if (flags & PD_RW_NONBLOCK)
+         {
+            _fw_spinunlock(board)
+            return -EAGAIN;
+         }
+
+         // arm driver events and sleep until new data comes in, then
+         // disarm those the user didn't set
+         Armed = (eDataAvailable | eFrameDone | eBufferError | eStopped) &
+                 ~pd_board[board].AinSS.dwEventsNotify;
+         pd_board[board].AinSS.dwEventsNotify |= Armed;
+         pd_sleep_on_event(board, AnalogIn, eDataAvailable | eFrameDone |
+                           eBufferError | eStopped, PD_RW_WAIT_MS);
+         pd_board[board].AinSS.dwEventsNotify &= ~Armed;
+
+#if !(defined(_PD_RTL) || defined(_PD_RTLPRO) || defined(_PD_RTAI) || defined(_PD_XENOMAI))
+         if (signal_pending(current))
+         {
+            _fw_spinunlock(board)
+            return -ERESTARTSYS;
+         }
+#endif
+         continue;
+      }
+
+      pSrc = (u8*)pDaqBuf->databuf + ScanInfo.ScanIndex * ScanBytes;
+      Bytes = ScanInfo.NumValidScans * ScanBytes;
+
+      // copy to user space may fault, do it without the spinlock held
+      _fw_spinunlock(board)
+      if (flags & PD_RW_KERNEL)
+         memcpy(buffer + copied, pSrc, Bytes);
+      else if (pd_rw_copy_to_user(user_info, (u8*)buffer + copied, pSrc, Bytes))
+         return (copied) ? copied : -EFAULT;
+      copied += Bytes;
+      _fw_spinlock(board)
+   }
+
+   _fw_spinunlock(board)
+
+   return copied;
+}
+
+//
+// Function:    pd_driver_write
+//
+// Parameters:  int board
+//              int minor       -- PD_MINOR_AOUT or PD_MINOR_DOUT
+//              const char* buffer -- user buffer
+//              u32 count       -- size of the user buffer in bytes
+//              int flags       -- PD_RW_NONBLOCK: don't sleep if the buffer
+//                                 is full
+//                                 PD_RW_KERNEL: buffer is in kernel space
+//              pd_user_info_t* user_info -- RTDM caller, NULL otherwise
+//
+// Returns:     number of bytes copied or negative error code
+//
+// Description: Feeds whole scans into the DAQ buffer registered on the
+//              output subsystems. Before the output is started the buffer
+//              is primed from its beginning (ValueCount tracks how much of
+//              it was filled). Once running, free scans are obtained with
+//              pd_aout_get_scans() which also releases the frames already
+//              sent to the board by pd_process_aout_put_samples().
+//
+int pd_driver_write(int board, int minor, const char* buffer, u32 count, int flags,
+                    pd_user_info_t* user_info)
+{
+   PTBuf_Info pDaqBuf = &pd_board[board].AoutSS.BufInfo;
+   tScanInfo ScanInfo;
+   u32 ScanBytes, Bytes, MaxScans, Armed;
+   u8* pDest;
+   int copied = 0;
+
+   if ((minor != PD_MINOR_AOUT) && (minor != PD_MINOR_DOUT))
+      return -ENODEV;
+
+   _fw_spinlock(board)
+
+   while (1)
+   {
+      if (!pDaqBuf->databuf || !pDaqBuf->ScanValues)
+      {
+         _fw_spinunlock(board)
+         return (copied) ? copied : -EINVAL;
+      }
+
+      // only whole scans are transferred
+      ScanBytes = pDaqBuf->ScanValues * pDaqBuf->SampleSize;
+      if (count - copied < ScanBytes)
+      {
+         if (!copied)
+            copied = -EINVAL;
+         break;
+      }
+
+      ScanInfo.NumScans = (count - copied) / ScanBytes;
+      ScanInfo.NumValidScans = 0;
+
+      if (pd_board[board].AoutSS.SubsysState == ssRunning)
+      {
+         pd_aout_get_scans(board, &ScanInfo);
+      }
+      else if (pd_board[board].AoutSS.SubsysState == ssStopped)
+      {
+         _fw_spinunlock(board)
+         return (copied) ? copied : -EPIPE;
+      }
+      else
+      {
+         // prime the buffer before the output starts
+         MaxScans = pDaqBuf->MaxValues / pDaqBuf->ScanValues;
+         ScanInfo.ScanIndex = pDaqBuf->ValueCount / pDaqBuf->ScanValues;
+         ScanInfo.NumValidScans = MaxScans - ScanInfo.ScanIndex;
+         if (ScanInfo.NumScans < ScanInfo.NumValidScans)
+            ScanInfo.NumValidScans = ScanInfo.NumScans;
+         pDaqBuf->ValueCount += ScanInfo.NumValidScans * pDaqBuf->ScanValues;
+      }
+
+      if (ScanInfo.NumValidScans == 0)
+      {
+         if (copied)
+            break;
+
+         if (flags & PD_RW_NONBLOCK)
+         {
+            _fw_spinunlock(board)
+            return -EAGAIN;
+         }
+
+         // arm driver events and sleep until a frame is sent out, then
+         // disarm those the user didn't set
+         Armed = (eFrameDone | eBufferDone | eBufferError | eStopped) &
+                 ~pd_board[board].AoutSS.dwEventsNotify;
+         pd_board[board].AoutSS.dwEventsNotify |= Armed;
+         pd_sleep_on_event(board, AnalogOut, eFrameDone | eBufferDone |
+                           eBufferError | eStopped, PD_RW_WAIT_MS);
+         pd_board[board].AoutSS.dwEventsNotify &= ~Armed;
+
+#if !(defined(_PD_RTL) || defined(_PD_RTLPRO) || defined(_PD_RTAI) || defined(_PD_XENOMAI))
+         if (signal_pending(current))
+         {
+            _fw_spinunlock(board)
+            return -ERESTARTSYS;
+         }
+#endif
+         continue;
+      }
+
+      pDest = (u8*)pDaqBuf->databuf + ScanInfo.ScanIndex * ScanBytes;
+      Bytes = ScanInfo.NumValidScans * ScanBytes;
+
+      // copy from user space may fault, do it without the spinlock held
+      _fw_spinunlock(board)
+      if (flags & PD_RW_KERNEL)
+         memcpy(pDest, buffer + copied, Bytes);
+      else if (pd_rw_copy_from_user(user_info, pDest, (u8*)buffer + copied, Bytes))
+         return (copied) ? copied : -EFAULT;
+      copied += Bytes;
+      _fw_spinlock(board)
+   }
+
+   _fw_spinunlock(board)
+
+   return copied;
+}
 
-   DPRINTK_I("board %d, %s (minor %u) got ioctl 0x%X\n",
-             board, pd_devices_by_minor[board_minor], board_minor, command);
 
+//
+// Function:    pd_driver_board_id
+//
+// Returns:     board model id, PDXI boards report the PCI model id
+//
+static unsigned long pd_driver_board_id(int board)
+{
    if (PD_IS_PDXI(pd_board[board].PCI_Config.SubsystemID))
-      id = pd_board[board].PCI_Config.SubsystemID - 0x100;
+      return pd_board[board].PCI_Config.SubsystemID - 0x100;
    else
-      id = pd_board[board].PCI_Config.SubsystemID;
+      return pd_board[board].PCI_Config.SubsystemID;
+}
+
+//
+// Function:    pd_driver_check_model
+//
+// Returns:     -ENOSYS if the board model doesn't support the command, 0 otherwise
+//
+static int pd_driver_check_model(int board, int command)
+{
+   int retf;
+   unsigned long id = pd_driver_board_id(board);
 
    // check for board model before executing IOCTL
    if (PD_IS_DIO(id))
@@ -946,7 +1829,21 @@ int pd_driver_ioctl(int board, int board_minor, int command, tCmd* argcmd)
       }
    }
 
-   _fw_spinlock
+   return 0;
+}
+
+//
+// Function:    pd_driver_ioctl_locked
+//
+// Description: executes one ioctl command, called with the board lock held
+//
+static int pd_driver_ioctl_locked(int board, int board_minor, PD_SUBSYSTEM ss,
+                                  int command, tCmd* argcmd)
+{
+   int ret;
+   int retf = -ENODEV;
+   int i;
+   unsigned long id = pd_driver_board_id(board);
 
    switch (command)
    {
@@ -1003,7 +1900,7 @@ int pd_driver_ioctl(int board, int board_minor, int command, tCmd* argcmd)
    case IOCTL_PWRDAQ_PRIVATE_CLR_EVENT:
       // , // Event
       // for now - wake up from event
-      retf = pd_notify_event(board, ss, argcmd->dwParam[0]);
+      retf = pd_notify_event(board, ss, argcmd->dwParam[0], 0, 0);
 
       break;
 
@@ -1015,7 +1912,7 @@ int pd_driver_ioctl(int board, int board_minor, int command, tCmd* argcmd)
    case  IOCTL_PWRDAQ_REGISTER_BUFFER:
       // Release spinlock, the code in pd_register_daq_buffer
       // is not safe to run with spinlock held
-      _fw_spinunlock
+      _fw_spinunlock(board)
 
       retf = argcmd->dwParam[0] = pd_register_daq_buffer(board,
                                     argcmd->dwParam[4], // subsystem
@@ -1026,7 +1923,7 @@ int pd_driver_ioctl(int board, int board_minor, int command, tCmd* argcmd)
                                     argcmd->dwParam[3]);
 
       // Reaquire the lock
-      _fw_spinlock
+      _fw_spinlock(board)
 
       retf = (retf) ? retf : -EIO;
       break;
@@ -1044,13 +1941,13 @@ int pd_driver_ioctl(int board, int board_minor, int command, tCmd* argcmd)
    case  IOCTL_PWRDAQ_UNREGISTER_BUFFER:
       // Release spinlock, the code in pd_unregister_daq_buffer
       // is not safe to run with spinlock held
-      _fw_spinunlock
+      _fw_spinunlock(board)
 
       retf = argcmd->dwParam[1] =
              pd_unregister_daq_buffer(board, argcmd->dwParam[0]);
 
       // Reaquire the lock
-      _fw_spinlock
+      _fw_spinlock(board)
 
       retf = (retf) ? 0 : -EIO;
       break;
@@ -1089,6 +1986,41 @@ int pd_driver_ioctl(int board, int board_minor, int command, tCmd* argcmd)
                                  argcmd->dwParam[1]) ? 0 : -EIO);
       break;
 
+   case  IOCTL_PWRDAQ_SUBSCRIBE_EVENTS:
+      if (PD_IS_DIO(id) && !(argcmd->dwParam[0] & EdgeDetect))
+      {
+         if (argcmd->dwParam[0] == DigitalIn)
+            argcmd->dwParam[0] = AnalogIn;
+         if (argcmd->dwParam[0] == DigitalOut)
+            argcmd->dwParam[0] = AnalogOut;
+         if (argcmd->dwParam[0] == DSPCounter)
+            argcmd->dwParam[0] = AnalogIn;
+      }
+      else
+      {
+         argcmd->dwParam[0] = argcmd->dwParam[0] & 0xF;
+      }
+
+      // start counting from the subscription
+      {
+         TSynchSS *synch;
+         synch = pd_get_synch(board, argcmd->dwParam[0], argcmd->dwParam[1]);
+         if(synch != NULL)
+         {
+            synch->notifiedEvents = 0;
+            memset(synch->eventCount, 0, sizeof(synch->eventCount));
+         }
+      }
+
+      retf = (pd_subscribe_user_events(board,
+                                       argcmd->dwParam[0],
+                                       argcmd->dwParam[1]) ? 0 : -EIO);
+      break;
+
+   case  IOCTL_PWRDAQ_WAIT_EVENTS:
+      retf = pd_wait_events(board, ss, &argcmd->EventWait);
+      break;
+
    case  IOCTL_PWRDAQ_CLEAR_USER_EVENTS:
       if (PD_IS_DIO(id) && !(argcmd->dwParam[0] & EdgeDetect))
       {
@@ -1196,6 +2128,20 @@ int pd_driver_ioctl(int board, int board_minor, int command, tCmd* argcmd)
    case  IOCTL_PWRDAQ_CLEAR_DAQBUF: retf = -ENOSYS;
       break;
 
+   case  IOCTL_PWRDAQ_RELEASE_DAQBUF_SCANS:
+      if ((argcmd->ScanInfo.Subsystem == AnalogIn)||
+          (argcmd->ScanInfo.Subsystem == DigitalIn)||
+          (argcmd->ScanInfo.Subsystem == CounterTimer)||
+          (argcmd->ScanInfo.Subsystem == DSPCounter))
+         retf = pd_ain_release_scans(board, argcmd->ScanInfo.ScanIndex) ? 0 : -EINVAL;
+      else
+         retf = -EINVAL;
+      break;
+
+   case  IOCTL_PWRDAQ_AIN_GET_GAPS:
+      retf = pd_ain_get_gaps(board, &argcmd->GapQuery) ? 0 : -EINVAL;
+      break;
+
    case  IOCTL_PWRDAQ_BRDRESET: retf = -ENOSYS;
       break;
 
@@ -1229,6 +2175,10 @@ int pd_driver_ioctl(int board, int board_minor, int command, tCmd* argcmd)
       retf = (pd_adapter_enable_interrupt(board, argcmd->dwParam[0]) ? 0 : -EIO);
       break;
 
+   case  IOCTL_PWRDAQ_SET_BH_CPU:
+      retf = pd_driver_set_bh_cpu(board, (int)argcmd->dwParam[0]);
+      break;
+
    case  IOCTL_PWRDAQ_BRDTESTINTERRUPT:
       retf = (pd_adapter_test_interrupt(board) ? 0 : -EIO);
       break;
@@ -1542,6 +2492,22 @@ int pd_driver_ioctl(int board, int board_minor, int command, tCmd* argcmd)
       retf = (pd_dio256_intrEnable(board, argcmd->dwParam[0]))? 0 : -EIO;;
       break;
 
+      //---------------------------------------------------------------
+      // PdDIOCosStart -- log DIn interrupts in the change of state ring
+   case IOCTL_PWRDAQ_DIO256COSSTART:
+      // Release spinlock, the ring is allocated the first time
+      _fw_spinunlock(board)
+      retf = pd_dio256_cos_alloc(board);
+      _fw_spinlock(board)
+
+      if (!retf)
+         retf = (pd_dio256_cos_start(board))? 0 : -EIO;
+      break;
+
+   case IOCTL_PWRDAQ_DIO256COSSTOP:
+      retf = (pd_dio256_cos_stop(board))? 0 : -EIO;
+      break;
+
 
       // UCT
    case  IOCTL_PWRDAQ_UCTSETCFG:
@@ -1642,7 +2608,193 @@ int pd_driver_ioctl(int board, int board_minor, int command, tCmd* argcmd)
 
    } // switch
 
-   _fw_spinunlock
+   return retf;
+}
+
+//
+// Function:    pd_driver_batchable
+//
+// Returns:     TRUE if the command only uses dwParam and keeps the lock
+//
+static int pd_driver_batchable(u32 command)
+{
+   switch (command)
+   {
+   case IOCTL_PWRDAQ_BRDREGWR:
+   case IOCTL_PWRDAQ_BRDREGRD:
+   case IOCTL_PWRDAQ_AISETCFG:
+   case IOCTL_PWRDAQ_AISETCVCLK:
+   case IOCTL_PWRDAQ_AISETCLCLK:
+   case IOCTL_PWRDAQ_AISETEVNT:
+   case IOCTL_PWRDAQ_AISTATUS:
+   case IOCTL_PWRDAQ_AICVEN:
+   case IOCTL_PWRDAQ_AISTARTTRIG:
+   case IOCTL_PWRDAQ_AISTOPTRIG:
+   case IOCTL_PWRDAQ_AISWCVSTART:
+   case IOCTL_PWRDAQ_AISWCLSTART:
+   case IOCTL_PWRDAQ_AICLRESET:
+   case IOCTL_PWRDAQ_AICLRDATA:
+   case IOCTL_PWRDAQ_AIRESET:
+   case IOCTL_PWRDAQ_AIGETVALUE:
+   case IOCTL_PWRDAQ_AOSETCFG:
+   case IOCTL_PWRDAQ_AOSETCVCLK:
+   case IOCTL_PWRDAQ_AOSETEVNT:
+   case IOCTL_PWRDAQ_AOSTATUS:
+   case IOCTL_PWRDAQ_AOCVEN:
+   case IOCTL_PWRDAQ_AOSTARTTRIG:
+   case IOCTL_PWRDAQ_AOSTOPTRIG:
+   case IOCTL_PWRDAQ_AOSWCVSTART:
+   case IOCTL_PWRDAQ_AOCLRDATA:
+   case IOCTL_PWRDAQ_AORESET:
+   case IOCTL_PWRDAQ_AOPUTVALUE:
+   case IOCTL_PWRDAQ_DISETCFG:
+   case IOCTL_PWRDAQ_DISTATUS:
+   case IOCTL_PWRDAQ_DIREAD:
+   case IOCTL_PWRDAQ_DICLRDATA:
+   case IOCTL_PWRDAQ_DIRESET:
+   case IOCTL_PWRDAQ_DOWRITE:
+   case IOCTL_PWRDAQ_DORESET:
+   case IOCTL_PWRDAQ_DIO256CMDWR:
+   case IOCTL_PWRDAQ_DIO256CMDWR_ALL:
+   case IOCTL_PWRDAQ_DIO256CMDRD:
+   case IOCTL_PWRDAQ_DIO256CMDRD_ALL:
+   case IOCTL_PWRDAQ_DIO256INTRREENABLE:
+   case IOCTL_PWRDAQ_UCTSETCFG:
+   case IOCTL_PWRDAQ_UCTSTATUS:
+   case IOCTL_PWRDAQ_UCTWRITE:
+   case IOCTL_PWRDAQ_UCTREAD:
+   case IOCTL_PWRDAQ_UCTSWGATE:
+   case IOCTL_PWRDAQ_UCTSWCLK:
+   case IOCTL_PWRDAQ_UCTRESET:
+   case IOCTL_PWRDAQ_CALDACWRITE:
+      return TRUE;
+   }
+
+   return FALSE;
+}
+
+//
+// Function:    pd_driver_ioctl_batch
+//
+// Parameters:  argcmd->dwParam[0] -- IN: number of entries, OUT: entries executed
+//              argcmd->dwParam[1] -- IN: low 32 bits of the tBatchEntry array address
+//              argcmd->dwParam[2] -- IN: high 32 bits of the array address
+//              argcmd->dwParam[3] -- IN: PD_BATCH_* flags
+//
+// Returns:     0, or negative error if the batch couldn't be run at all
+//
+// Description: Runs an array of commands back to back under one hold of
+//              the board lock. Each entry gets its own result, and its
+//              dwParam are copied back. Only the commands that take their
+//              parameters in dwParam and don't sleep can be batched, the
+//              others get -EINVAL.
+//
+static int pd_driver_ioctl_batch(int board, int board_minor, PD_SUBSYSTEM ss,
+                                 tCmd* argcmd)
+{
+   tBatchEntry *pEntries;
+   tCmd cmd;
+   u32 count = argcmd->dwParam[0];
+   u32 flags = argcmd->dwParam[3];
+   void *pUser = (void*)(unsigned long)(((u64)argcmd->dwParam[2] << 32) | argcmd->dwParam[1]);
+   u32 i, done;
+
+   argcmd->dwParam[0] = 0;
+   if (!count || (count > PD_MAX_BATCH) || !pUser)
+      return -EINVAL;
+
+   pEntries = (tBatchEntry*)pd_kmalloc(count * sizeof(tBatchEntry), GFP_KERNEL);
+   if (!pEntries)
+      return -ENOMEM;
+
+   if (pd_copy_from_user32((u32*)pEntries, (u32*)pUser, count * sizeof(tBatchEntry)))
+   {
+      pd_kfree(pEntries);
+      return -EFAULT;
+   }
+
+   // everything that can fail without touching the board is checked first
+   for (i = 0; i < count; i++)
+   {
+      pEntries[i].Result = pd_driver_batchable(pEntries[i].Command) ?
+                           pd_driver_check_model(board, pEntries[i].Command) : -EINVAL;
+   }
+
+   _fw_spinlock(board)
+
+   for (done = 0; done < count; done++)
+   {
+      if (pEntries[done].Result == 0)
+      {
+         memcpy(cmd.dwParam, pEntries[done].dwParam, sizeof(cmd.dwParam));
+         pEntries[done].Result = pd_driver_ioctl_locked(board, board_minor, ss,
+                                                        pEntries[done].Command, &cmd);
+         memcpy(pEntries[done].dwParam, cmd.dwParam, sizeof(cmd.dwParam));
+      }
+
+      if ((pEntries[done].Result < 0) && (flags & PD_BATCH_STOPONERROR))
+      {
+         done++;
+         break;
+      }
+   }
+
+   _fw_spinunlock(board)
+
+   // entries that were not executed
+   for (i = done; i < count; i++)
+      pEntries[i].Result = -ECANCELED;
+
+   argcmd->dwParam[0] = done;
+   i = pd_copy_to_user32((u32*)pUser, (u32*)pEntries, count * sizeof(tBatchEntry));
+   pd_kfree(pEntries);
+
+   return (i) ? -EFAULT : 0;
+}
+
+int pd_driver_ioctl(int board, int board_minor, int command, tCmd* argcmd)
+{
+   PD_SUBSYSTEM ss;
+   int retf;
+
+   if (board_minor == PD_MINOR_AIN)
+      ss = AnalogIn;
+   else if (board_minor == PD_MINOR_AOUT)
+      ss = AnalogOut;
+   else if (board_minor == PD_MINOR_DIN)
+      ss = DigitalIn;
+   else if (board_minor == PD_MINOR_DOUT)
+      ss = DigitalOut;
+   else if (board_minor == PD_MINOR_UCT)
+      ss = CounterTimer;
+   else if (board_minor == PD_MINOR_DSPCT)
+      ss = DSPCounter;
+   else if (board_minor == PD_MINOR_DRV)
+      ss = BoardLevel;
+   else
+      ss = BoardLevel;
+
+   DPRINTK_I("board %d, %s (minor %u) got ioctl 0x%X\n",
+             board, pd_devices_by_minor[board_minor], board_minor, command);
+
+   if (command == IOCTL_PWRDAQ_BATCH)
+   {
+      retf = pd_driver_ioctl_batch(board, board_minor, ss, argcmd);
+      pd_event_flush(board);
+      return retf;
+   }
+
+   retf = pd_driver_check_model(board, command);
+   if (retf)
+      return retf;
+
+   _fw_spinlock(board)
+
+   retf = pd_driver_ioctl_locked(board, board_minor, ss, command, argcmd);
+
+   _fw_spinunlock(board)
+
+   pd_event_flush(board);
 
    return retf;
 }
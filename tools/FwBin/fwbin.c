@@ -0,0 +1,96 @@
+//===========================================================================
+//
+// NAME:    fwbin.c
+//
+// DESCRIPTION:
+//
+//          Writes the DSP firmware tables compiled into the driver
+//          (include/pdfw*_i*.h) as firmware files in the format of
+//          include/pdfw_bin.h, one per board family, in ./pwrdaq.
+//          Copy them to /lib/firmware/pwrdaq ("make install" does it).
+//
+//          Usage: fwbin [output directory]
+//
+//---------------------------------------------------------------------------
+//      Copyright (C) 2000,2004 United Electronic Industries, Inc.
+//      All rights reserved.
+//---------------------------------------------------------------------------
+// For more informations on using and distributing this software, please see
+// the accompanying "LICENSE" file.
+//
+//===========================================================================
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#define DWORD uint32_t
+
+#include "pdfw_bin.h"
+#include "pdfwmain_i.h"
+#include "pdfw_ao_iA.h"
+#include "pdfw_dio_iD.h"
+#include "pdfw_mf_iM.h"
+#include "pdfw_lab_iL.h"
+
+static int write_image(const char *dir, const char *name,
+                       FW_MEMSEGMENT *pData, int nSegs, DWORD execAdrs)
+{
+   char path[512];
+   PD_FW_HEADER hdr;
+   PD_FW_SEGHEADER seg;
+   FILE *f;
+   int i, words = 0;
+
+   // name is "pwrdaq/xxx.bin", the directory is given
+   snprintf(path, sizeof(path), "%s/%s", dir, strchr(name, '/') + 1);
+   f = fopen(path, "wb");
+   if (!f)
+   {
+      perror(path);
+      return -1;
+   }
+
+   hdr.Magic = PD_FW_MAGIC;
+   hdr.Version = PD_FW_VERSION;
+   hdr.ExecAdrs = execAdrs;
+   hdr.NumSegs = nSegs;
+   fwrite(&hdr, sizeof(hdr), 1, f);
+
+   for (i = 0; i < nSegs; i++)
+   {
+      seg.MemType = pData[i].dwMemType;
+      seg.MemAdrs = pData[i].dwMemAdrs;
+      seg.MemSize = pData[i].dwMemSize;
+      fwrite(&seg, sizeof(seg), 1, f);
+      fwrite(pData[i].dwMemData, sizeof(DWORD), seg.MemSize, f);
+      words += seg.MemSize;
+   }
+
+   if (fclose(f))
+   {
+      perror(path);
+      return -1;
+   }
+
+   printf("%s: %d segments, %d words\n", path, nSegs, words);
+   return 0;
+}
+
+int main(int argc, char *argv[])
+{
+   const char *files[PD_FW_FAMILIES] = PD_FW_FILES;
+   const char *dir = (argc > 1) ? argv[1] : "pwrdaq";
+   int err = 0;
+
+   mkdir(dir, 0755);
+
+   err |= write_image(dir, files[PD_FW_MAIN], FWDownloadData, nFWMemSegments, dwFWExecAdrs);
+   err |= write_image(dir, files[PD_FW_MF], FWDownloadDataM, nFWMemSegmentsM, dwFWExecAdrsM);
+   err |= write_image(dir, files[PD_FW_AO], FWDownloadDataA, nFWMemSegmentsA, dwFWExecAdrsA);
+   err |= write_image(dir, files[PD_FW_DIO], FWDownloadDataD, nFWMemSegmentsD, dwFWExecAdrsD);
+   err |= write_image(dir, files[PD_FW_LAB], FWDownloadDataL, nFWMemSegmentsL, dwFWExecAdrsL);
+
+   return err ? 1 : 0;
+}